@@ -0,0 +1,272 @@
+// assetpack.cpp: paquete binario de recursos (ver assetpack.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "assetpack.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "texloader.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static_assert(sizeof(AssetPackHeader) == 32, "AssetPackHeader tiene que ocupar 32 bytes");
+static_assert(sizeof(AssetPackEntry) % 8 == 0, "AssetPackEntry tiene que estar alineada a 8 bytes");
+
+static size_t align_up(size_t n) {
+  return (n + ASSET_PACK_ALIGN - 1) & ~(ASSET_PACK_ALIGN - 1);
+}
+
+size_t asset_level_bytes(const AssetTextureInfo &texture, int level) {
+  int w = (int) texture.width >> level, h = (int) texture.height >> level;
+  w = w > 0 ? w : 1;
+  h = h > 0 ? h : 1;
+  if (texture.format == BC_NONE)
+    return (size_t) w * h * 4;
+  return bc_level_bytes((BcFormat) texture.format, w, h);
+}
+
+AssetPack::~AssetPack() {
+  if (base)
+    munmap((void *) base, mapped);
+}
+
+bool AssetPack::open(const char *path) {
+  Clock::time_point start = Clock::now();
+
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    printf("ERROR: could not open asset pack %s\n", path);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(AssetPackHeader)) {
+    printf("ERROR: %s is not an asset pack\n", path);
+    close(fd);
+    return false;
+  }
+  mapped = (size_t) st.st_size;
+  void *p = mmap(NULL, mapped, PROT_READ, MAP_PRIVATE, fd, 0);
+  // La proyeccion sigue valida sin el descriptor
+  close(fd);
+  if (p == MAP_FAILED) {
+    printf("ERROR: could not map %s\n", path);
+    mapped = 0;
+    return false;
+  }
+  base = (const unsigned char *) p;
+  // Se leera casi todo: que el kernel empiece a traerlo ya
+  madvise(p, mapped, MADV_WILLNEED);
+
+  if (!validate(path)) {
+    munmap(p, mapped);
+    base = NULL;
+    mapped = 0;
+    return false;
+  }
+  open_time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  return true;
+}
+
+bool AssetPack::validate(const char *path) {
+  const AssetPackHeader *header = (const AssetPackHeader *) base;
+  if (header->magic != ASSET_PACK_MAGIC || header->version != ASSET_PACK_VERSION ||
+      header->file_size != mapped) {
+    printf("ERROR: %s is not an asset pack (version %u) or is truncated\n", path, ASSET_PACK_VERSION);
+    return false;
+  }
+  if (header->toc_offset % 8 != 0 || header->toc_offset > mapped ||
+      header->entry_count > (mapped - header->toc_offset) / sizeof(AssetPackEntry)) {
+    printf("ERROR: %s: bad table of contents\n", path);
+    return false;
+  }
+  entries = (const AssetPackEntry *) (base + header->toc_offset);
+  count = (int) header->entry_count;
+
+  for (int i = 0; i < count; i++) {
+    const AssetPackEntry &e = entries[i];
+    bool ok = memchr(e.name, '\0', ASSET_NAME_MAX) != NULL && e.offset % ASSET_PACK_ALIGN == 0 &&
+              e.offset <= mapped && e.size <= mapped - e.offset;
+    if (ok && e.type == ASSET_SHADER) {
+      ok = e.size > 0 && base[e.offset + e.size - 1] == '\0';
+    } else if (ok && e.type == ASSET_TEXTURE) {
+      uint64_t total = 0;
+      ok = e.texture.width > 0 && e.texture.height > 0 && e.texture.levels > 0 &&
+           e.texture.levels <= 32 && e.texture.format <= BC7;
+      for (uint32_t level = 0; ok && level < e.texture.levels; level++)
+        total += asset_level_bytes(e.texture, (int) level);
+      ok = ok && total <= e.size;
+    } else if (ok && e.type == ASSET_MESH) {
+      uint64_t vertex_bytes = (uint64_t) e.mesh.vertex_count * MESH_VERTEX_FLOATS * sizeof(float);
+      uint64_t index_bytes = (uint64_t) e.mesh.index_count * sizeof(uint32_t);
+      ok = e.mesh.index_offset % ASSET_PACK_ALIGN == 0 && vertex_bytes <= e.mesh.index_offset &&
+           e.mesh.index_offset + index_bytes <= e.size && e.mesh.index_count % 3 == 0;
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      printf("ERROR: %s: bad entry %d\n", path, i);
+      return false;
+    }
+  }
+  return true;
+}
+
+const AssetPackEntry *AssetPack::find(const char *name, AssetType type) const {
+  for (int i = 0; i < count; i++)
+    if (entries[i].type == type && strcmp(entries[i].name, name) == 0)
+      return &entries[i];
+  return NULL;
+}
+
+const char *AssetPack::shader(const char *name) const {
+  const AssetPackEntry *entry = find(name, ASSET_SHADER);
+  return entry ? (const char *) data(*entry) : NULL;
+}
+
+GLuint AssetPack::upload_texture(const AssetPackEntry &entry, size_t *gpu_bytes) const {
+  const AssetTextureInfo &info = entry.texture;
+  GLuint texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  // Directamente desde las paginas del fichero: sin PBO intermedio, que
+  // seria otra copia
+  const unsigned char *level_data = data(entry);
+  size_t total = 0;
+  for (uint32_t level = 0; level < info.levels; level++) {
+    int w = (int) info.width >> level, h = (int) info.height >> level;
+    w = w > 0 ? w : 1;
+    h = h > 0 ? h : 1;
+    size_t size = asset_level_bytes(info, (int) level);
+    if (info.format == BC_NONE)
+      glTexImage2D(GL_TEXTURE_2D, (GLint) level, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, level_data);
+    else
+      glCompressedTexImage2D(GL_TEXTURE_2D, (GLint) level, gl_compressed_format((BcFormat) info.format),
+                             w, h, 0, (GLsizei) size, level_data);
+    level_data += size;
+    total += size;
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) info.levels - 1);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  if (gpu_bytes)
+    *gpu_bytes = total;
+  return texture;
+}
+
+void AssetPack::read_mesh(const AssetPackEntry &entry, MeshData &mesh) const {
+  const float *vertices = (const float *) data(entry);
+  const uint32_t *indices = (const uint32_t *) (data(entry) + entry.mesh.index_offset);
+  mesh.vertices.assign(vertices, vertices + (size_t) entry.mesh.vertex_count * MESH_VERTEX_FLOATS);
+  mesh.indices.assign(indices, indices + entry.mesh.index_count);
+}
+
+AssetPackEntry &AssetPackWriter::add(const char *name, AssetType type) {
+  if (blobs.empty())
+    blobs.resize(sizeof(AssetPackHeader));
+  align();
+  toc.push_back(AssetPackEntry());
+  AssetPackEntry &entry = toc.back();
+  memset(&entry, 0, sizeof(entry));
+  strncpy(entry.name, name, ASSET_NAME_MAX - 1);
+  entry.type = type;
+  entry.offset = blobs.size();
+  return entry;
+}
+
+void AssetPackWriter::append(const void *data, size_t size) {
+  const unsigned char *bytes = (const unsigned char *) data;
+  blobs.insert(blobs.end(), bytes, bytes + size);
+  toc.back().size += size;
+}
+
+void AssetPackWriter::align() {
+  blobs.resize(align_up(blobs.size()));
+}
+
+static bool check_name(const char *name) {
+  if (strlen(name) >= ASSET_NAME_MAX) {
+    printf("Error: el nombre %s es demasiado largo (maximo %zu caracteres)\n", name, ASSET_NAME_MAX - 1);
+    return false;
+  }
+  return true;
+}
+
+bool AssetPackWriter::add_shader(const char *name, const char *source) {
+  if (!check_name(name))
+    return false;
+  add(name, ASSET_SHADER);
+  append(source, strlen(source) + 1);
+  return true;
+}
+
+bool AssetPackWriter::add_texture(const char *name, BcFormat format, int width, int height,
+                                  const std::vector<std::vector<unsigned char> > &levels) {
+  if (!check_name(name))
+    return false;
+  AssetPackEntry &entry = add(name, ASSET_TEXTURE);
+  entry.texture.width = (uint32_t) width;
+  entry.texture.height = (uint32_t) height;
+  entry.texture.levels = (uint32_t) levels.size();
+  entry.texture.format = format;
+  for (const std::vector<unsigned char> &level : levels)
+    append(level.data(), level.size());
+  return true;
+}
+
+bool AssetPackWriter::add_mesh(const char *name, const MeshData &mesh, bool optimized) {
+  if (!check_name(name))
+    return false;
+  AssetPackEntry &entry = add(name, ASSET_MESH);
+  entry.mesh.vertex_count = (uint32_t) mesh.vertex_count();
+  entry.mesh.index_count = (uint32_t) mesh.indices.size();
+  entry.mesh.optimized = optimized;
+  append(mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+  entry.mesh.index_offset = (uint32_t) align_up(entry.size);
+  blobs.resize(entry.offset + entry.mesh.index_offset);
+  entry.size = entry.mesh.index_offset;
+  append(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+  return true;
+}
+
+bool AssetPackWriter::write(const char *path) const {
+  AssetPackHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = ASSET_PACK_MAGIC;
+  header.version = ASSET_PACK_VERSION;
+  header.entry_count = (uint32_t) toc.size();
+  header.toc_offset = align_up(blobs.empty() ? sizeof(header) : blobs.size());
+  header.file_size = header.toc_offset + toc.size() * sizeof(AssetPackEntry);
+
+  FILE *fp = fopen(path, "wb");
+  if (!fp)
+    return false;
+  static const unsigned char zeros[ASSET_PACK_ALIGN] = {};
+  size_t blob_bytes = blobs.empty() ? 0 : blobs.size() - sizeof(header);
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            fwrite(blobs.data() + (blobs.empty() ? 0 : sizeof(header)), 1, blob_bytes, fp) == blob_bytes;
+  size_t padding = header.toc_offset - sizeof(header) - blob_bytes;
+  ok = ok && fwrite(zeros, 1, padding, fp) == padding;
+  ok = ok && fwrite(toc.data(), sizeof(AssetPackEntry), toc.size(), fp) == toc.size();
+  return fclose(fp) == 0 && ok;
+}
+
+void evict_file_cache(const char *path) {
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+    return;
+  // Las paginas sucias no se descartan: que se escriban antes
+  fdatasync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+}
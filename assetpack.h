@@ -0,0 +1,144 @@
+// assetpack.h: paquete binario de recursos (shaders, texturas y mallas)
+//
+// Lo genera offline packassets y el programa lo proyecta en memoria con
+// mmap: los shaders y las texturas se pasan tal cual a glShaderSource y
+// glTexImage2D / glCompressedTexImage2D, sin leer el fichero a un buffer ni
+// decodificar nada. Las mallas se copian a MeshData (de un memcpy, sin
+// parsear ni optimizar) porque el culling, la oclusion y el render por
+// software las usan en la CPU. Estructura del fichero:
+//
+//   AssetPackHeader
+//   blobs, cada uno empezando en un multiplo de 64 bytes
+//   tabla de contenidos: entry_count x AssetPackEntry
+//
+// - Shader: el texto con su '\0' final.
+// - Textura: los niveles de mipmap seguidos, del 0 al ultimo, en RGBA8
+//   (BC_NONE) o en bloques BCn como en el DDS de origen.
+// - Malla: MeshData ya indexada y optimizada, los vertices (8 floats) y
+//   despues los indices (uint32) a partir del siguiente multiplo de 64.
+//
+// Los recursos se buscan por el nombre con el que los pide el programa
+// (la ruta tal como se le paso a packassets).
+//////////////////////////////////////////////////////////////////////
+
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "bcn.h"
+#include "meshloader.h"
+
+static const uint32_t ASSET_PACK_MAGIC = 0x4b415053;  // "SPAK"
+static const uint32_t ASSET_PACK_VERSION = 1;
+static const size_t ASSET_PACK_ALIGN = 64;
+static const size_t ASSET_NAME_MAX = 64;
+
+enum AssetType : uint32_t {
+  ASSET_SHADER = 1,
+  ASSET_TEXTURE = 2,
+  ASSET_MESH = 3
+};
+
+struct AssetPackHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t reserved;
+  uint64_t toc_offset;
+  uint64_t file_size;
+};
+
+struct AssetTextureInfo {
+  uint32_t width, height;  // nivel 0
+  uint32_t levels;
+  uint32_t format;         // BcFormat
+};
+
+struct AssetMeshInfo {
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t index_offset;   // desde el principio del blob
+  uint32_t optimized;      // ya pasada por optimize_mesh()
+};
+
+struct AssetPackEntry {
+  char name[ASSET_NAME_MAX];
+  uint32_t type;           // AssetType
+  uint32_t reserved;
+  uint64_t offset, size;   // del blob, desde el principio del fichero
+  union {
+    AssetTextureInfo texture;
+    AssetMeshInfo mesh;
+  };
+};
+
+// Bytes del nivel level de una textura del paquete
+size_t asset_level_bytes(const AssetTextureInfo &texture, int level);
+
+class AssetPack {
+public:
+  AssetPack() {}
+  ~AssetPack();
+
+  // Proyecta el fichero y valida la cabecera, la tabla y que cada blob
+  // cabe en el fichero. Imprime el motivo si falla.
+  bool open(const char *path);
+
+  // NULL si no esta o es de otro tipo
+  const AssetPackEntry *find(const char *name, AssetType type) const;
+  const unsigned char *data(const AssetPackEntry &entry) const { return base + entry.offset; }
+
+  const char *shader(const char *name) const;
+  // Crea la textura y sube todos los niveles desde el fichero proyectado;
+  // gpu_bytes (puede ser NULL) recibe la memoria de video de los niveles
+  GLuint upload_texture(const AssetPackEntry &entry, size_t *gpu_bytes) const;
+  // Copia la malla a MeshData (los caminos de CPU la necesitan en vectores)
+  void read_mesh(const AssetPackEntry &entry, MeshData &mesh) const;
+
+  size_t size() const { return mapped; }
+  int entry_count() const { return count; }
+  double open_ms() const { return open_time; }
+
+private:
+  AssetPack(const AssetPack &) = delete;
+  AssetPack &operator=(const AssetPack &) = delete;
+
+  bool validate(const char *path);
+
+  const unsigned char *base = NULL;
+  size_t mapped = 0;
+  const AssetPackEntry *entries = NULL;
+  int count = 0;
+  double open_time = 0.0;
+};
+
+// Construye el paquete en memoria y lo escribe de una vez (packassets)
+class AssetPackWriter {
+public:
+  bool add_shader(const char *name, const char *source);
+  // levels[i]: RGBA8 (format == BC_NONE) o bloques BCn del nivel i
+  bool add_texture(const char *name, BcFormat format, int width, int height,
+                   const std::vector<std::vector<unsigned char> > &levels);
+  bool add_mesh(const char *name, const MeshData &mesh, bool optimized);
+
+  bool write(const char *path) const;
+
+private:
+  AssetPackEntry &add(const char *name, AssetType type);
+  void append(const void *data, size_t size);
+  void align();
+
+  std::vector<AssetPackEntry> toc;
+  std::vector<unsigned char> blobs;  // con el hueco de la cabecera delante
+};
+
+// Saca el fichero de la cache de paginas del sistema (posix_fadvise
+// DONTNEED) para medir un arranque en frio sin permisos de root
+void evict_file_cache(const char *path);
+
+#endif
@@ -0,0 +1,497 @@
+// bcn.cpp: compresion de texturas por bloques (ver bcn.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "bcn.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+const char *bc_format_name(BcFormat format) {
+  switch (format) {
+  case BC1: return "bc1";
+  case BC3: return "bc3";
+  case BC7: return "bc7";
+  default:  return "none";
+  }
+}
+
+BcFormat bc_format_from_name(const char *name) {
+  if (strcmp(name, "bc1") == 0)
+    return BC1;
+  if (strcmp(name, "bc3") == 0)
+    return BC3;
+  if (strcmp(name, "bc7") == 0)
+    return BC7;
+  return BC_NONE;
+}
+
+size_t bc_block_bytes(BcFormat format) {
+  return format == BC1 ? 8 : 16;
+}
+
+size_t bc_level_bytes(BcFormat format, int width, int height) {
+  return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * bc_block_bytes(format);
+}
+
+// Bloque de 4x4 texels RGBA
+typedef unsigned char Block[16][4];
+
+static void fetch_block(const unsigned char *rgba, int width, int height, int bx, int by,
+                        Block block) {
+  for (int y = 0; y < 4; y++) {
+    int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+    for (int x = 0; x < 4; x++) {
+      int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+      memcpy(block[y * 4 + x], rgba + ((size_t) sy * width + sx) * 4, 4);
+    }
+  }
+}
+
+static void store_block(unsigned char *rgba, int width, int height, int bx, int by,
+                        const Block block) {
+  for (int y = 0; y < 4 && by * 4 + y < height; y++)
+    for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+      memcpy(rgba + ((size_t) (by * 4 + y) * width + bx * 4 + x) * 4, block[y * 4 + x], 4);
+}
+
+static inline int clamp255(float v) {
+  int i = (int) (v + 0.5f);
+  return i < 0 ? 0 : (i > 255 ? 255 : i);
+}
+
+// Extremos del bloque sobre su eje principal (primeros channels canales).
+// La covarianza se diagonaliza por iteracion de potencias, que con 16
+// puntos converge de sobra en pocas vueltas.
+static void principal_endpoints(const Block block, int channels, float lo[4], float hi[4]) {
+  float mean[4] = { 0, 0, 0, 0 };
+  for (int i = 0; i < 16; i++)
+    for (int c = 0; c < channels; c++)
+      mean[c] += block[i][c];
+  for (int c = 0; c < channels; c++)
+    mean[c] /= 16.0f;
+
+  float cov[4][4] = {};
+  for (int i = 0; i < 16; i++) {
+    float d[4];
+    for (int c = 0; c < channels; c++)
+      d[c] = block[i][c] - mean[c];
+    for (int a = 0; a < channels; a++)
+      for (int b = 0; b < channels; b++)
+        cov[a][b] += d[a] * d[b];
+  }
+
+  // Arranque en la diagonal dominante
+  float axis[4] = { 0, 0, 0, 0 };
+  int best = 0;
+  for (int c = 1; c < channels; c++)
+    if (cov[c][c] > cov[best][best])
+      best = c;
+  axis[best] = 1.0f;
+  for (int iter = 0; iter < 8; iter++) {
+    float next[4] = { 0, 0, 0, 0 };
+    float len = 0.0f;
+    for (int a = 0; a < channels; a++) {
+      for (int b = 0; b < channels; b++)
+        next[a] += cov[a][b] * axis[b];
+      len += next[a] * next[a];
+    }
+    if (len < 1e-12f)
+      break;
+    len = 1.0f / sqrtf(len);
+    for (int c = 0; c < channels; c++)
+      axis[c] = next[c] * len;
+  }
+
+  float tmin = 1e30f, tmax = -1e30f;
+  for (int i = 0; i < 16; i++) {
+    float t = 0.0f;
+    for (int c = 0; c < channels; c++)
+      t += (block[i][c] - mean[c]) * axis[c];
+    tmin = t < tmin ? t : tmin;
+    tmax = t > tmax ? t : tmax;
+  }
+  for (int c = 0; c < channels; c++) {
+    lo[c] = mean[c] + axis[c] * tmin;
+    hi[c] = mean[c] + axis[c] * tmax;
+  }
+}
+
+// Indice de la entrada de la paleta mas cercana (distancia euclidea)
+static int nearest(const unsigned char *texel, const int palette[][4], int entries,
+                   int channels, int *error) {
+  int best = 0, best_err = 0x7fffffff;
+  for (int e = 0; e < entries; e++) {
+    int err = 0;
+    for (int c = 0; c < channels; c++) {
+      int d = texel[c] - palette[e][c];
+      err += d * d;
+    }
+    if (err < best_err) {
+      best_err = err;
+      best = e;
+    }
+  }
+  if (error)
+    *error += best_err;
+  return best;
+}
+
+//////////////////////////////////////////////////////////////////////
+// BC1 (color de BC1 y BC3)
+
+static uint16_t pack565(const float c[3]) {
+  int r = (int) (c[0] * 31.0f / 255.0f + 0.5f);
+  int g = (int) (c[1] * 63.0f / 255.0f + 0.5f);
+  int b = (int) (c[2] * 31.0f / 255.0f + 0.5f);
+  r = r < 0 ? 0 : (r > 31 ? 31 : r);
+  g = g < 0 ? 0 : (g > 63 ? 63 : g);
+  b = b < 0 ? 0 : (b > 31 ? 31 : b);
+  return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static void unpack565(uint16_t v, int c[4]) {
+  int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+  c[0] = (r << 3) | (r >> 2);
+  c[1] = (g << 2) | (g >> 4);
+  c[2] = (b << 3) | (b >> 2);
+  c[3] = 255;
+}
+
+// four_color: en BC3 el bloque de color siempre usa 4 colores
+static void color_palette(uint16_t c0, uint16_t c1, bool four_color, int palette[4][4]) {
+  unpack565(c0, palette[0]);
+  unpack565(c1, palette[1]);
+  if (four_color || c0 > c1) {
+    for (int c = 0; c < 3; c++) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    palette[2][3] = palette[3][3] = 255;
+  } else {
+    for (int c = 0; c < 3; c++) {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+    palette[2][3] = 255;
+    palette[3][3] = 0;
+  }
+}
+
+static uint32_t color_indices(const Block block, uint16_t c0, uint16_t c1, int *error) {
+  int palette[4][4];
+  color_palette(c0, c1, true, palette);
+  uint32_t indices = 0;
+  for (int i = 0; i < 16; i++)
+    indices |= (uint32_t) nearest(block[i], palette, 4, 3, error) << (2 * i);
+  return indices;
+}
+
+// Ajuste por minimos cuadrados de los extremos dados los indices: cada
+// texel es a * w + b * (1 - w) con w en {1, 0, 2/3, 1/3}
+static bool refine_endpoints(const Block block, uint32_t indices, float a[3], float b[3]) {
+  static const float weight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+  float aa = 0, bb = 0, ab = 0;
+  float ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+  for (int i = 0; i < 16; i++) {
+    float w = weight[(indices >> (2 * i)) & 3], v = 1.0f - w;
+    aa += w * w;
+    bb += v * v;
+    ab += w * v;
+    for (int c = 0; c < 3; c++) {
+      ax[c] += w * block[i][c];
+      bx[c] += v * block[i][c];
+    }
+  }
+  float det = aa * bb - ab * ab;
+  if (fabsf(det) < 1e-6f)
+    return false;
+  det = 1.0f / det;
+  for (int c = 0; c < 3; c++) {
+    a[c] = (ax[c] * bb - bx[c] * ab) * det;
+    b[c] = (bx[c] * aa - ax[c] * ab) * det;
+  }
+  return true;
+}
+
+static void encode_color(const Block block, unsigned char out[8]) {
+  float lo[4], hi[4];
+  principal_endpoints(block, 3, lo, hi);
+
+  uint16_t c0 = pack565(hi), c1 = pack565(lo);
+  int error = 0;
+  uint32_t indices = color_indices(block, c0, c1, &error);
+
+  float a[3], b[3];
+  if (refine_endpoints(block, indices, a, b)) {
+    uint16_t r0 = pack565(a), r1 = pack565(b);
+    int refined_error = 0;
+    uint32_t refined = color_indices(block, r0, r1, &refined_error);
+    if (refined_error < error) {
+      c0 = r0;
+      c1 = r1;
+      indices = refined;
+    }
+  }
+
+  // Modo de 4 colores: c0 > c1. Al intercambiarlos los indices 0 <-> 1 y
+  // 2 <-> 3 se invierten (xor con 1)
+  if (c0 < c1) {
+    uint16_t t = c0;
+    c0 = c1;
+    c1 = t;
+    indices ^= 0x55555555u;
+  } else if (c0 == c1) {
+    indices = 0;
+  }
+
+  out[0] = c0 & 0xff;
+  out[1] = c0 >> 8;
+  out[2] = c1 & 0xff;
+  out[3] = c1 >> 8;
+  for (int i = 0; i < 4; i++)
+    out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+static void decode_color(const unsigned char in[8], bool four_color, Block block) {
+  uint16_t c0 = in[0] | (in[1] << 8), c1 = in[2] | (in[3] << 8);
+  uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t) in[7] << 24);
+  int palette[4][4];
+  color_palette(c0, c1, four_color, palette);
+  for (int i = 0; i < 16; i++) {
+    const int *p = palette[(indices >> (2 * i)) & 3];
+    for (int c = 0; c < 4; c++)
+      block[i][c] = (unsigned char) p[c];
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// BC3 (alfa de 8 valores + color BC1)
+
+static void alpha_palette(int a0, int a1, int palette[8][4]) {
+  palette[0][0] = a0;
+  palette[1][0] = a1;
+  if (a0 > a1) {
+    for (int i = 1; i < 7; i++)
+      palette[i + 1][0] = ((7 - i) * a0 + i * a1) / 7;
+  } else {
+    for (int i = 1; i < 5; i++)
+      palette[i + 1][0] = ((5 - i) * a0 + i * a1) / 5;
+    palette[6][0] = 0;
+    palette[7][0] = 255;
+  }
+}
+
+static void encode_alpha(const Block block, unsigned char out[8]) {
+  int a0 = 0, a1 = 255;
+  for (int i = 0; i < 16; i++) {
+    a0 = block[i][3] > a0 ? block[i][3] : a0;
+    a1 = block[i][3] < a1 ? block[i][3] : a1;
+  }
+  out[0] = (unsigned char) a0;
+  out[1] = (unsigned char) a1;
+
+  uint64_t indices = 0;
+  if (a0 > a1) {
+    int palette[8][4];
+    alpha_palette(a0, a1, palette);
+    for (int i = 0; i < 16; i++)
+      indices |= (uint64_t) nearest(&block[i][3], palette, 8, 1, NULL) << (3 * i);
+  }
+  for (int i = 0; i < 6; i++)
+    out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+static void decode_alpha(const unsigned char in[8], Block block) {
+  int palette[8][4];
+  alpha_palette(in[0], in[1], palette);
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; i++)
+    indices |= (uint64_t) in[2 + i] << (8 * i);
+  for (int i = 0; i < 16; i++)
+    block[i][3] = (unsigned char) palette[(indices >> (3 * i)) & 7][0];
+}
+
+//////////////////////////////////////////////////////////////////////
+// BC7 modo 6: extremos RGBA de 7 bits + p-bit, indices de 4 bits
+
+static const int bc7_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BitWriter {
+  unsigned char *out;
+  int pos;
+  void put(uint32_t value, int bits) {
+    for (int i = 0; i < bits; i++, pos++)
+      if ((value >> i) & 1)
+        out[pos >> 3] |= (unsigned char) (1 << (pos & 7));
+  }
+};
+
+struct BitReader {
+  const unsigned char *in;
+  int pos;
+  uint32_t get(int bits) {
+    uint32_t value = 0;
+    for (int i = 0; i < bits; i++, pos++)
+      value |= (uint32_t) ((in[pos >> 3] >> (pos & 7)) & 1) << i;
+    return value;
+  }
+};
+
+// Cuantiza un extremo a 7 bits por canal + p-bit compartido, eligiendo el
+// p-bit con menor error
+static void bc7_quantize(const float e[4], int q[4], int *pbit) {
+  int best_err = 0x7fffffff;
+  for (int p = 0; p < 2; p++) {
+    int cand[4], err = 0;
+    for (int c = 0; c < 4; c++) {
+      int v = (int) floorf((e[c] - p) / 2.0f + 0.5f);
+      cand[c] = v < 0 ? 0 : (v > 127 ? 127 : v);
+      int d = ((cand[c] << 1) | p) - clamp255(e[c]);
+      err += d * d;
+    }
+    if (err < best_err) {
+      best_err = err;
+      *pbit = p;
+      memcpy(q, cand, sizeof(cand));
+    }
+  }
+}
+
+static void bc7_palette(const int q0[4], int p0, const int q1[4], int p1, int palette[16][4]) {
+  for (int c = 0; c < 4; c++) {
+    int e0 = (q0[c] << 1) | p0, e1 = (q1[c] << 1) | p1;
+    for (int i = 0; i < 16; i++)
+      palette[i][c] = ((64 - bc7_weights[i]) * e0 + bc7_weights[i] * e1 + 32) >> 6;
+  }
+}
+
+static void encode_bc7(const Block block, unsigned char out[16]) {
+  float lo[4], hi[4];
+  principal_endpoints(block, 4, lo, hi);
+
+  int q0[4], q1[4], p0, p1;
+  bc7_quantize(lo, q0, &p0);
+  bc7_quantize(hi, q1, &p1);
+
+  int palette[16][4];
+  bc7_palette(q0, p0, q1, p1, palette);
+  int indices[16];
+  for (int i = 0; i < 16; i++)
+    indices[i] = nearest(block[i], palette, 16, 4, NULL);
+
+  // El indice del texel 0 se guarda con 3 bits: su bit alto tiene que ser 0
+  if (indices[0] >= 8) {
+    int t[4];
+    memcpy(t, q0, sizeof(t));
+    memcpy(q0, q1, sizeof(t));
+    memcpy(q1, t, sizeof(t));
+    int tp = p0;
+    p0 = p1;
+    p1 = tp;
+    for (int i = 0; i < 16; i++)
+      indices[i] = 15 - indices[i];
+  }
+
+  memset(out, 0, 16);
+  BitWriter bits = { out, 0 };
+  bits.put(1 << 6, 7);  // modo 6
+  for (int c = 0; c < 4; c++) {
+    bits.put(q0[c], 7);
+    bits.put(q1[c], 7);
+  }
+  bits.put(p0, 1);
+  bits.put(p1, 1);
+  bits.put(indices[0], 3);
+  for (int i = 1; i < 16; i++)
+    bits.put(indices[i], 4);
+}
+
+static void decode_bc7(const unsigned char in[16], Block block) {
+  BitReader bits = { in, 0 };
+  if (bits.get(7) != (1 << 6)) {
+    // Solo se decodifica el modo que genera texcompress; el resto a magenta
+    for (int i = 0; i < 16; i++) {
+      block[i][0] = block[i][2] = block[i][3] = 255;
+      block[i][1] = 0;
+    }
+    return;
+  }
+  int q0[4], q1[4];
+  for (int c = 0; c < 4; c++) {
+    q0[c] = bits.get(7);
+    q1[c] = bits.get(7);
+  }
+  int p0 = bits.get(1), p1 = bits.get(1);
+
+  int palette[16][4];
+  bc7_palette(q0, p0, q1, p1, palette);
+  for (int i = 0; i < 16; i++) {
+    const int *p = palette[bits.get(i == 0 ? 3 : 4)];
+    for (int c = 0; c < 4; c++)
+      block[i][c] = (unsigned char) p[c];
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+
+void bc_compress(BcFormat format, const unsigned char *rgba, int width, int height,
+                 unsigned char *blocks) {
+  int bw = (width + 3) / 4, bh = (height + 3) / 4;
+  size_t block_bytes = bc_block_bytes(format);
+  for (int by = 0; by < bh; by++) {
+    for (int bx = 0; bx < bw; bx++) {
+      Block block;
+      fetch_block(rgba, width, height, bx, by, block);
+      unsigned char *out = blocks + ((size_t) by * bw + bx) * block_bytes;
+      if (format == BC1) {
+        encode_color(block, out);
+      } else if (format == BC3) {
+        encode_alpha(block, out);
+        encode_color(block, out + 8);
+      } else {
+        encode_bc7(block, out);
+      }
+    }
+  }
+}
+
+void bc_decompress(BcFormat format, const unsigned char *blocks, int width, int height,
+                   unsigned char *rgba) {
+  int bw = (width + 3) / 4, bh = (height + 3) / 4;
+  size_t block_bytes = bc_block_bytes(format);
+  for (int by = 0; by < bh; by++) {
+    for (int bx = 0; bx < bw; bx++) {
+      Block block;
+      const unsigned char *in = blocks + ((size_t) by * bw + bx) * block_bytes;
+      if (format == BC1) {
+        decode_color(in, false, block);
+      } else if (format == BC3) {
+        decode_color(in + 8, true, block);
+        decode_alpha(in, block);
+      } else {
+        decode_bc7(in, block);
+      }
+      store_block(rgba, width, height, bx, by, block);
+    }
+  }
+}
+
+void bc_downsample(const unsigned char *rgba, int width, int height,
+                   std::vector<unsigned char> &out) {
+  int w = width > 1 ? width / 2 : 1, h = height > 1 ? height / 2 : 1;
+  out.resize((size_t) w * h * 4);
+  for (int y = 0; y < h; y++) {
+    int y0 = y * 2 < height ? y * 2 : height - 1;
+    int y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+    for (int x = 0; x < w; x++) {
+      int x0 = x * 2 < width ? x * 2 : width - 1;
+      int x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+      for (int c = 0; c < 4; c++) {
+        int sum = rgba[((size_t) y0 * width + x0) * 4 + c] + rgba[((size_t) y0 * width + x1) * 4 + c] +
+                  rgba[((size_t) y1 * width + x0) * 4 + c] + rgba[((size_t) y1 * width + x1) * 4 + c];
+        out[((size_t) y * w + x) * 4 + c] = (unsigned char) ((sum + 2) / 4);
+      }
+    }
+  }
+}
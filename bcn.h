@@ -0,0 +1,41 @@
+// bcn.h: compresion de texturas por bloques (BC1, BC3, BC7)
+//
+// Codificador sencillo para la herramienta texcompress: extremos por el eje
+// principal (PCA) de cada bloque de 4x4, un refinado por minimos cuadrados
+// en BC1 y, en BC7, solo el modo 6 (RGBA, un subconjunto, indices de 4
+// bits). Los decodificadores se usan para medir el error y como respaldo si
+// el driver no soporta el formato.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef BCN_H
+#define BCN_H
+
+#include <stddef.h>
+
+#include <vector>
+
+enum BcFormat {
+  BC_NONE = 0,
+  BC1,  // RGB, 8 bytes por bloque (4 bpp)
+  BC3,  // RGBA, 16 bytes por bloque (8 bpp)
+  BC7   // RGBA, 16 bytes por bloque (8 bpp), mejor calidad
+};
+
+const char *bc_format_name(BcFormat format);
+BcFormat bc_format_from_name(const char *name);
+
+size_t bc_block_bytes(BcFormat format);
+size_t bc_level_bytes(BcFormat format, int width, int height);
+
+// rgba: width * height * 4 bytes. Los bordes que no completan un bloque se
+// rellenan repitiendo el ultimo pixel.
+void bc_compress(BcFormat format, const unsigned char *rgba, int width, int height,
+                 unsigned char *blocks);
+void bc_decompress(BcFormat format, const unsigned char *blocks, int width, int height,
+                   unsigned char *rgba);
+
+// Siguiente nivel de mipmap (filtro de caja 2x2, como glGenerateMipmap)
+void bc_downsample(const unsigned char *rgba, int width, int height,
+                   std::vector<unsigned char> &out);
+
+#endif
@@ -0,0 +1,120 @@
+// bench_culling.cpp: microbenchmark del frustum culling (culling.h)
+//
+// N objetos en la rejilla de --instances y una camara que gira dentro de
+// ella. En cada frame se mueve un 1% de los objetos (update + refit) y se
+// hace el culling con la BVH y probando todas las cajas una a una; los dos
+// tienen que dar los mismos objetos visibles o sale con error.
+//
+//   ./bench_culling [objetos] [frames]
+//////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "culling.h"
+#include "instancing.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double ms_since(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Referencia: todas las cajas contra los 6 planos
+static void brute_force(const Frustum &frustum, const std::vector<glm::vec3> &lo,
+                        const std::vector<glm::vec3> &hi, std::vector<int> &visible) {
+  visible.clear();
+  for (size_t i = 0; i < lo.size(); i++) {
+    bool inside = true;
+    for (const glm::vec4 &plane : frustum.planes) {
+      glm::vec3 p(plane.x > 0.0f ? hi[i].x : lo[i].x, plane.y > 0.0f ? hi[i].y : lo[i].y,
+                  plane.z > 0.0f ? hi[i].z : lo[i].z);
+      if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f) {
+        inside = false;
+        break;
+      }
+    }
+    if (inside)
+      visible.push_back((int) i);
+  }
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 200000;
+  int frames = argc > 2 ? atoi(argv[2]) : 100;
+
+  // Cubos y tetraedros de la escena instanciada, con la caja del cubo
+  int side = 1;
+  std::vector<glm::vec3> cells = instance_grid((count + 1) / 2, &side);
+  std::vector<glm::vec3> center(count), lo(count), hi(count);
+  const glm::vec3 half(0.433f);
+  for (int i = 0; i < count; i++) {
+    center[i] = cells[i / 2] + glm::vec3(i % 2 == 0 ? .75f : -.75f, 0.0f, 0.0f);
+    lo[i] = center[i] - half;
+    hi[i] = center[i] + half;
+  }
+
+  CullingBvh bvh;
+  Clock::time_point start = Clock::now();
+  bvh.build(lo, hi);
+  double build_ms = ms_since(start);
+
+  glm::mat4 projection = glm::perspective(glm::radians(50.0f), 640.0f / 480.0f, 0.1f, 1000.0f);
+  std::vector<int> visible, expected;
+  double refit_ms = 0.0, bvh_ms = 0.0, brute_ms = 0.0;
+  long long shown = 0;
+  bool ok = true;
+  unsigned seed = 12345;
+
+  for (int frame = 0; frame < frames; frame++) {
+    // Un 1% de los objetos se desplaza un poco
+    start = Clock::now();
+    for (int k = 0; k < count / 100; k++) {
+      seed = seed * 1103515245u + 12345u;
+      int id = (int) ((seed >> 8) % (unsigned) count);
+      float dy = 0.1f * sinf((float) frame + (float) id);
+      glm::vec3 c = center[id] + glm::vec3(0.0f, dy, 0.0f);
+      lo[id] = c - half;
+      hi[id] = c + half;
+      bvh.update(id, lo[id], hi[id]);
+    }
+    bvh.refit();
+    refit_ms += ms_since(start);
+
+    // Camara en el centro de la rejilla girando sobre Y
+    float a = 6.2831853f * (float) frame / (float) frames;
+    glm::vec3 eye(0.0f, 0.0f, 0.0f), target(sinf(a), 0.0f, -cosf(a));
+    glm::mat4 view_proj = projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    start = Clock::now();
+    bvh.cull(view_proj, visible);
+    bvh_ms += ms_since(start);
+
+    start = Clock::now();
+    brute_force(frustum_from_matrix(view_proj), lo, hi, expected);
+    brute_ms += ms_since(start);
+
+    std::sort(visible.begin(), visible.end());
+    if (visible != expected) {
+      printf("MISMATCH in frame %d: %zu visible, expected %zu\n", frame, visible.size(), expected.size());
+      ok = false;
+    }
+    shown += visible.size();
+  }
+
+  printf("Culling: %d objects x %d frames, build %.2f ms\n", count, frames, build_ms);
+  printf("refit    %8.3f ms/frame (%d moved)\n", refit_ms / frames, count / 100);
+  printf("bvh      %8.3f ms/frame  %6.2fx\n", bvh_ms / frames, brute_ms / bvh_ms);
+  printf("brute    %8.3f ms/frame\n", brute_ms / frames);
+  printf("visible  %8.1f of %d\n", (double) shown / frames, count);
+
+  return ok ? 0 : 1;
+}
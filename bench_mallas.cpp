@@ -0,0 +1,256 @@
+// bench_mallas.cpp: velocidad de carga de mallas (meshloader.h)
+//
+// Genera un toro de unos N triangulos con posiciones, normales y
+// coordenadas de textura, lo escribe como bench_malla.obj y bench_malla.glb
+// y lo carga con MeshLoader con un hilo y con todos. Las cuatro cargas
+// tienen que dar la misma malla indexada o sale con error. Tambien compara
+// parse_float() con strtof sobre los numeros del OBJ y mide optimize_mesh()
+// (meshopt.h) con el toro en el orden de la rejilla y con los triangulos
+// barajados: ACMR y ATVR antes y despues.
+//
+//   ./bench_mallas [triangulos] [repeticiones]
+//////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "meshloader.h"
+#include "meshopt.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double ms_since(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static const char *OBJ_PATH = "bench_malla.obj";
+static const char *GLB_PATH = "bench_malla.glb";
+
+// Toro de rings x sides vertices (sin repetir la costura: los indices dan la
+// vuelta), 2 triangulos por cuadrado
+static MeshData torus(int rings, int sides) {
+  MeshData mesh;
+  const float R = 1.0f, r = 0.35f, TAU = 6.2831853f;
+  for (int i = 0; i < rings; i++) {
+    for (int j = 0; j < sides; j++) {
+      float u = TAU * i / rings, v = TAU * j / sides;
+      float n[3] = { cosf(v) * cosf(u), cosf(v) * sinf(u), sinf(v) };
+      float vertex[MESH_VERTEX_FLOATS] = {
+        (R + r * cosf(v)) * cosf(u), (R + r * cosf(v)) * sinf(u), r * sinf(v),
+        n[0], n[1], n[2], (float) i / rings, (float) j / sides,
+      };
+      mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + MESH_VERTEX_FLOATS);
+    }
+  }
+  for (int i = 0; i < rings; i++) {
+    for (int j = 0; j < sides; j++) {
+      uint32_t a = i * sides + j, b = ((i + 1) % rings) * sides + j;
+      uint32_t c = ((i + 1) % rings) * sides + (j + 1) % sides, d = i * sides + (j + 1) % sides;
+      uint32_t tris[6] = { a, b, c, a, c, d };
+      mesh.indices.insert(mesh.indices.end(), tris, tris + 6);
+    }
+  }
+  return mesh;
+}
+
+static bool write_obj(const MeshData &mesh, const char *path) {
+  FILE *fp = fopen(path, "w");
+  if (!fp)
+    return false;
+  fprintf(fp, "# bench_mallas: %d vertices, %d triangles\no torus\n", mesh.vertex_count(), mesh.triangle_count());
+  for (int v = 0; v < mesh.vertex_count(); v++) {
+    const float *p = &mesh.vertices[MESH_VERTEX_FLOATS * v];
+    fprintf(fp, "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\nvt %.6f %.6f\n", p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]);
+  }
+  for (int t = 0; t < mesh.triangle_count(); t++) {
+    unsigned a = mesh.indices[3 * t] + 1, b = mesh.indices[3 * t + 1] + 1, c = mesh.indices[3 * t + 2] + 1;
+    fprintf(fp, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+  }
+  return fclose(fp) == 0;
+}
+
+// Vertices intercalados en un bufferView con byteStride y los indices en
+// otro, como los exporta cualquier herramienta
+static bool write_glb(const MeshData &mesh, const char *path) {
+  size_t vertex_bytes = mesh.vertices.size() * sizeof(float);
+  size_t index_bytes = mesh.indices.size() * sizeof(uint32_t);
+  char json_text[2048];
+  snprintf(json_text, sizeof(json_text),
+           "{\"asset\":{\"version\":\"2.0\",\"generator\":\"bench_mallas\"},\"scene\":0,"
+           "\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+           "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},"
+           "\"indices\":3}]}],"
+           "\"buffers\":[{\"byteLength\":%zu}],"
+           "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu,\"byteStride\":32},"
+           "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+           "\"accessors\":["
+           "{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\"},"
+           "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\"},"
+           "{\"bufferView\":0,\"byteOffset\":24,\"componentType\":5126,\"count\":%d,\"type\":\"VEC2\"},"
+           "{\"bufferView\":1,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}]}",
+           vertex_bytes + index_bytes, vertex_bytes, vertex_bytes, index_bytes, mesh.vertex_count(),
+           mesh.vertex_count(), mesh.vertex_count(), mesh.indices.size());
+  std::string json(json_text);
+  while (json.size() % 4 != 0)
+    json += ' ';
+
+  uint32_t bin_length = (uint32_t) (vertex_bytes + index_bytes);
+  uint32_t header[5] = { 0x46546C67u, 2, (uint32_t) (12 + 8 + json.size() + 8 + bin_length),
+                         (uint32_t) json.size(), 0x4E4F534Au };
+  uint32_t bin_header[2] = { bin_length, 0x004E4942u };
+
+  FILE *fp = fopen(path, "wb");
+  if (!fp)
+    return false;
+  fwrite(header, sizeof(header), 1, fp);
+  fwrite(json.data(), 1, json.size(), fp);
+  fwrite(bin_header, sizeof(bin_header), 1, fp);
+  fwrite(mesh.vertices.data(), 1, vertex_bytes, fp);
+  fwrite(mesh.indices.data(), 1, index_bytes, fp);
+  return fclose(fp) == 0;
+}
+
+// Orden de la cache de vertices: las mismas caras que antes y mejor o igual
+// ACMR, o sale con error
+static bool bench_optimize(const char *name, const MeshData &mesh) {
+  MeshData optimized = mesh;
+  Clock::time_point start = Clock::now();
+  optimize_mesh(optimized);
+  double ms = ms_since(start);
+  VertexCacheStats before = vertex_cache_stats(mesh), after = vertex_cache_stats(optimized);
+  printf("%-16s ACMR %.3f -> %.3f  ATVR %.3f -> %.3f  %8.1f ms\n", name, before.acmr, after.acmr, before.atvr,
+         after.atvr, ms);
+
+  std::vector<float> a = mesh_triangles(mesh), b = mesh_triangles(optimized);
+  std::vector<std::vector<float>> faces_a, faces_b;
+  for (size_t i = 0; i < a.size(); i += 3 * MESH_VERTEX_FLOATS) {
+    faces_a.emplace_back(a.begin() + i, a.begin() + i + 3 * MESH_VERTEX_FLOATS);
+    faces_b.emplace_back(b.begin() + i, b.begin() + i + 3 * MESH_VERTEX_FLOATS);
+  }
+  std::sort(faces_a.begin(), faces_a.end());
+  std::sort(faces_b.begin(), faces_b.end());
+  if (faces_a != faces_b || after.acmr > before.acmr) {
+    printf("MISMATCH optimizing %s\n", name);
+    return false;
+  }
+  return true;
+}
+
+// Mismos triangulos y mismo numero de vertices salvo el redondeo a 6
+// decimales del OBJ (el OBJ numera los vertices segun aparecen)
+static bool same_mesh(const MeshData &a, const MeshData &b) {
+  if (a.vertex_count() != b.vertex_count())
+    return false;
+  std::vector<float> ta = mesh_triangles(a), tb = mesh_triangles(b);
+  if (ta.size() != tb.size())
+    return false;
+  for (size_t i = 0; i < ta.size(); i++)
+    if (fabsf(ta[i] - tb[i]) > 2e-6f)
+      return false;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int triangles = argc > 1 ? atoi(argv[1]) : 2000000;
+  int repeat = argc > 2 ? atoi(argv[2]) : 3;
+  int sides = (int) sqrtf((float) triangles / 8.0f);
+  if (sides < 3)
+    sides = 3;
+  int rings = triangles / (2 * sides) > 3 ? triangles / (2 * sides) : 3;
+
+  MeshData reference = torus(rings, sides);
+  Clock::time_point start = Clock::now();
+  if (!write_obj(reference, OBJ_PATH) || !write_glb(reference, GLB_PATH)) {
+    fprintf(stderr, "ERROR: could not write %s or %s\n", OBJ_PATH, GLB_PATH);
+    return 1;
+  }
+  printf("Torus: %d triangles, %d vertices, written in %.0f ms\n", reference.triangle_count(),
+         reference.vertex_count(), ms_since(start));
+
+  bool ok = true;
+  std::vector<int> thread_counts = { 1 };
+  if (std::thread::hardware_concurrency() > 1)
+    thread_counts.push_back((int) std::thread::hardware_concurrency());
+  for (int t : thread_counts) {
+    for (const char *path : { OBJ_PATH, GLB_PATH }) {
+      MeshLoader loader(t);
+      MeshData mesh;
+      for (int r = 0; r < repeat; r++) {
+        if (!loader.load(path, mesh) || !same_mesh(mesh, reference)) {
+          printf("MISMATCH loading %s with %d threads\n", path, t);
+          ok = false;
+          break;
+        }
+      }
+      // La mejor de las repeticiones (la primera puede ir al disco)
+      const MeshLoadStats *best = &loader.stats()[0];
+      for (const MeshLoadStats &s : loader.stats())
+        if (s.total_ms < best->total_ms)
+          best = &s;
+      printf("%-16s %2d threads  %8.2f ms  %8.1f MB/s\n", path, t, best->total_ms,
+             best->file_bytes / (1024.0 * 1024.0) / (best->total_ms / 1000.0));
+    }
+  }
+
+  // Solo los numeros: parse_float contra strtof sobre el texto del OBJ
+  FILE *fp = fopen(OBJ_PATH, "rb");
+  std::vector<char> text;
+  if (fp) {
+    fseek(fp, 0, SEEK_END);
+    text.resize((size_t) ftell(fp) + 1);
+    fseek(fp, 0, SEEK_SET);
+    text.resize(fread(text.data(), 1, text.size() - 1, fp));
+    text.push_back('\0');
+    fclose(fp);
+  }
+  const char *end = text.data() + text.size() - 1;
+  double sums[2] = { 0.0, 0.0 }, times[2];
+  for (int method = 0; method < 2; method++) {
+    start = Clock::now();
+    for (const char *p = text.data(); p < end; p++) {
+      if (p[0] != 'v' || (p[1] != ' ' && p[1] != 'n' && p[1] != 't'))
+        continue;
+      p += p[1] == ' ' ? 1 : 2;
+      for (int k = 0; k < 3 && *p == ' '; k++) {
+        float value;
+        if (method == 0) {
+          p = parse_float(p + 1, end, &value);
+        } else {
+          char *s;
+          value = strtof(p + 1, &s);
+          p = s;
+        }
+        sums[method] += value;
+      }
+    }
+    times[method] = ms_since(start);
+  }
+  printf("Floats: parse_float %.1f ms, strtof %.1f ms (%.2fx)\n", times[0], times[1], times[1] / times[0]);
+  if (fabs(sums[0] - sums[1]) > 1e-3 * fabs(sums[1]) + 1e-3) {
+    printf("MISMATCH: parse_float sum %f, strtof sum %f\n", sums[0], sums[1]);
+    ok = false;
+  }
+
+  // Cache de vertices FIFO de 16 entradas
+  ok = bench_optimize("torus", reference) && ok;
+  MeshData shuffled = reference;
+  std::vector<int> order(reference.triangle_count());
+  for (size_t t = 0; t < order.size(); t++)
+    order[t] = (int) t;
+  std::shuffle(order.begin(), order.end(), std::mt19937(12345));
+  for (size_t t = 0; t < order.size(); t++)
+    for (int k = 0; k < 3; k++)
+      shuffled.indices[3 * t + k] = reference.indices[3 * order[t] + k];
+  ok = bench_optimize("torus shuffled", shuffled) && ok;
+
+  return ok ? 0 : 1;
+}
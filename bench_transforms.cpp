@@ -0,0 +1,120 @@
+// bench_transforms.cpp: microbenchmark de TransformSystem (transforms.h)
+//
+// Calcula las matrices de N objetos de la rejilla de --instances con la
+// version de render() (glm::translate + 2 glm::rotate + inversa traspuesta)
+// y con TransformSystem: escalar, SSE2, SSE2 en todos los nucleos y por
+// lista de ids (la de los objetos visibles tras el culling). Antes de
+// medir comprueba que coinciden con glm; si no, sale con error.
+//
+//   ./bench_transforms [objetos] [repeticiones]
+//////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "instancing.h"
+#include "transforms.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const double TIME = 12.345;
+
+// Igual que compute_model_matrix() en spinningcube_withlight_SKEL.cpp
+static void reference(const std::vector<glm::vec3> &positions, const std::vector<float> &phases,
+                      InstanceAttribs *out) {
+  for (size_t i = 0; i < positions.size(); i++) {
+    float t = (float) (TIME + phases[i]);
+    glm::mat4 model = glm::translate(glm::mat4(1.f), positions[i]);
+    model = glm::rotate(model, glm::radians(t * SPIN_Y_DEG_PER_S), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(t * SPIN_X_DEG_PER_S), glm::vec3(1.0f, 0.0f, 0.0f));
+    glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model)));
+    out[i].model = model;
+    for (int c = 0; c < 3; c++)
+      out[i].normal_matrix[c] = glm::vec4(normal[c], 0.0f);
+  }
+}
+
+static float max_error(const std::vector<InstanceAttribs> &a, const std::vector<InstanceAttribs> &b) {
+  float err = 0.0f;
+  for (size_t i = 0; i < a.size(); i++)
+    for (int c = 0; c < 4; c++)
+      for (int r = 0; r < 4; r++) {
+        err = fmaxf(err, fabsf(a[i].model[c][r] - b[i].model[c][r]));
+        if (c < 3 && r < 3)
+          err = fmaxf(err, fabsf(a[i].normal_matrix[c][r] - b[i].normal_matrix[c][r]));
+      }
+  return err;
+}
+
+static double time_ms(int reps, const std::function<void()> &fn) {
+  fn();  // calentamiento
+  Clock::time_point start = Clock::now();
+  for (int rep = 0; rep < reps; rep++)
+    fn();
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / reps;
+}
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? atoi(argv[1]) : 200000;
+  int reps = argc > 2 ? atoi(argv[2]) : 20;
+
+  // Cubos y tetraedros de la escena instanciada
+  std::vector<glm::vec3> cells = instance_grid((count + 1) / 2, NULL);
+  std::vector<glm::vec3> positions;
+  std::vector<float> phases;
+  TransformSystem system;
+  for (int i = 0; i < count; i++) {
+    glm::vec3 offset(i % 2 == 0 ? .75f : -.75f, 0.0f, 0.0f);
+    positions.push_back(cells[i / 2] + offset);
+    phases.push_back(instance_phase(i / 2));
+    system.add(positions.back(), phases.back());
+  }
+
+  // Todos los objetos en orden, pero por la via de los visibles (ids sueltos)
+  std::vector<int> ids(count);
+  for (int i = 0; i < count; i++)
+    ids[i] = i;
+
+  std::vector<InstanceAttribs> want(count), got(count);
+  reference(positions, phases, want.data());
+
+  printf("Transforms: %d objects x %d reps, %d threads\n", count, reps, system.threads());
+
+  struct Variant {
+    const char *name;
+    std::function<void()> run;
+  } variants[] = {
+    { "glm", [&] { reference(positions, phases, got.data()); } },
+    { "scalar", [&] { system.compute_serial(TIME, got.data(), false); } },
+    { "sse2", [&] { system.compute_serial(TIME, got.data(), true); } },
+    { "threads", [&] { system.compute(TIME, got.data()); } },
+    { "gather", [&] { system.compute(TIME, ids.data(), count, got.data()); } },
+  };
+
+  bool ok = true;
+  double glm_ms = 0.0;
+  for (const Variant &v : variants) {
+    v.run();
+    // Los angulos se suman en float desde cos/sin exactos: algo de error
+    // frente a glm, que gira en float desde el tiempo tambien en float
+    float err = max_error(want, got);
+    bool match = err < 1e-4f;
+    ok = ok && match;
+
+    double ms = time_ms(reps, v.run);
+    if (glm_ms == 0.0)
+      glm_ms = ms;
+    printf("%-8s %8.3f ms  %6.2f ns/object  %6.2fx  max error %.2e%s\n", v.name, ms,
+           ms * 1e6 / count, glm_ms / ms, err, match ? "" : "  MISMATCH");
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,244 @@
+// clusters.cpp: asignacion de luces puntuales a clusters (ver clusters.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "clusters.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "glcalls.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// Indices de buffers[] y textures[], en el orden de las unidades de textura
+enum { LIGHTS_TBO = 0, GRID_TBO = 1, INDICES_TBO = 2 };
+
+static const char *sampler_names[3] = { "point_lights", "cluster_grid", "cluster_indices" };
+
+// Generador pequeno y determinista (xorshift): la escena no cambia entre
+// ejecuciones y los benchmarks son comparables
+static float next_unit(uint32_t &state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return (float) (state >> 8) / (float) (1 << 24);
+}
+
+std::vector<PointLight> scatter_point_lights(int count, glm::vec3 lo, glm::vec3 hi, float radius) {
+  std::vector<PointLight> lights(count);
+  uint32_t state = 0x9e3779b9u;
+  for (PointLight &light : lights) {
+    glm::vec3 t(next_unit(state), next_unit(state), next_unit(state));
+    light.position = lo + t * (hi - lo);
+    light.radius = radius;
+
+    // Tono al azar con saturacion completa
+    float h = next_unit(state) * 6.0f;
+    glm::vec3 hue(fabsf(h - 3.0f) - 1.0f, 2.0f - fabsf(h - 2.0f), 2.0f - fabsf(h - 4.0f));
+    light.color = 0.6f * glm::clamp(hue, 0.0f, 1.0f);
+    light.pad = 0.0f;
+  }
+  return lights;
+}
+
+ClusteredLights::ClusteredLights(const std::vector<PointLight> &lights, int dim_x, int dim_y,
+                                 int dim_z, int threads)
+    : lights(lights), dim_x(dim_x), dim_y(dim_y), dim_z(dim_z), pool(threads) {
+  cell_lights.resize((size_t) dim_x * dim_y * dim_z);
+  view_lights.resize(lights.size());
+
+  glGenBuffers(3, buffers);
+  glGenTextures(3, textures);
+
+  // Las luces no se mueven: se suben una vez
+  std::vector<glm::vec4> texels;
+  texels.reserve(2 * lights.size());
+  for (const PointLight &light : lights) {
+    texels.push_back(glm::vec4(light.position, light.radius));
+    texels.push_back(glm::vec4(light.color, 0.0f));
+  }
+  if (texels.empty())
+    texels.push_back(glm::vec4(0.0f));  // un buffer vacio no es valido
+
+  const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+  for (int b = 0; b < 3; b++) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers[b]);
+    if (b == LIGHTS_TBO)
+      glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4), texels.data(), GL_STATIC_DRAW);
+    else
+      glBufferData(GL_TEXTURE_BUFFER, sizeof(uint32_t) * 2, NULL, GL_STREAM_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, textures[b]);
+    glTexBuffer(GL_TEXTURE_BUFFER, formats[b], buffers[b]);
+  }
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  printf("Lights: %d point lights, %dx%dx%d clusters, %d threads\n", (int) lights.size(),
+         dim_x, dim_y, dim_z, pool.size());
+}
+
+ClusteredLights::~ClusteredLights() {
+  glDeleteTextures(3, textures);
+  glDeleteBuffers(3, buffers);
+}
+
+std::string ClusteredLights::defines() const {
+  char block[128];
+  snprintf(block, sizeof(block), "#define CLUSTERED\n#define CLUSTER_X %d\n#define CLUSTER_Y %d\n"
+           "#define CLUSTER_Z %d\n", dim_x, dim_y, dim_z);
+  return block;
+}
+
+void ClusteredLights::set_samplers(GLuint program) {
+  for (int b = 0; b < 3; b++)
+    glUniform1i(glGetUniformLocation(program, sampler_names[b]), CLUSTER_FIRST_TEXTURE_UNIT + b);
+}
+
+glm::vec4 ClusteredLights::shader_params(int width, int height) const {
+  // slice = log(d / near) / log(far / near) * dim_z = log(d) * scale + bias
+  float scale = (float) dim_z / logf(z_far / z_near);
+  return glm::vec4((float) dim_x / (float) width, (float) dim_y / (float) height,
+                   scale, -logf(z_near) * scale);
+}
+
+// Borde inferior del tile que contiene la pendiente s (puede quedar fuera
+// de [0, dim))
+static int tile_of(float s, const std::vector<float> &slopes) {
+  float first = slopes.front(), last = slopes.back();
+  int dim = (int) slopes.size() - 1;
+  return (int) floorf((s - first) / (last - first) * (float) dim);
+}
+
+// Distancia al cuadrado de c al intervalo [lo, hi]
+static inline float gap2(float c, float lo, float hi) {
+  float d = c < lo ? lo - c : (c > hi ? c - hi : 0.0f);
+  return d * d;
+}
+
+void ClusteredLights::bin_slice(int k) {
+  float dn = slice_depth[k], df = slice_depth[k + 1];
+  std::vector<uint32_t> *cells = &cell_lights[(size_t) k * dim_x * dim_y];
+  for (int c = 0; c < dim_x * dim_y; c++)
+    cells[c].clear();
+
+  for (size_t l = 0; l < view_lights.size(); l++) {
+    const glm::vec4 &v = view_lights[l];
+    float r = v.w;
+    // Parte de la esfera dentro de las profundidades del slice
+    float da = std::max(dn, v.z - r), db = std::min(df, v.z + r);
+    if (da > db)
+      continue;
+
+    // Rango de pendientes x/d e y/d que puede cubrir la esfera en [da, db]
+    float sx0 = (v.x - r) / (v.x - r >= 0.0f ? db : da);
+    float sx1 = (v.x + r) / (v.x + r >= 0.0f ? da : db);
+    float sy0 = (v.y - r) / (v.y - r >= 0.0f ? db : da);
+    float sy1 = (v.y + r) / (v.y + r >= 0.0f ? da : db);
+    int x0 = tile_of(sx0, slope_x), x1 = tile_of(sx1, slope_x);
+    int y0 = tile_of(sy0, slope_y), y1 = tile_of(sy1, slope_y);
+    if (x1 < 0 || x0 >= dim_x || y1 < 0 || y0 >= dim_y)
+      continue;
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, dim_x - 1);
+    y1 = std::min(y1, dim_y - 1);
+
+    // Test esfera - caja de cada cluster del rango
+    float r2 = r * r;
+    float dz2 = gap2(v.z, dn, df);
+    for (int j = y0; j <= y1; j++) {
+      float ylo = std::min(slope_y[j] * dn, slope_y[j] * df);
+      float yhi = std::max(slope_y[j + 1] * dn, slope_y[j + 1] * df);
+      float dyz2 = dz2 + gap2(v.y, ylo, yhi);
+      if (dyz2 > r2)
+        continue;
+      for (int i = x0; i <= x1; i++) {
+        float xlo = std::min(slope_x[i] * dn, slope_x[i] * df);
+        float xhi = std::max(slope_x[i + 1] * dn, slope_x[i + 1] * df);
+        if (dyz2 + gap2(v.x, xlo, xhi) <= r2)
+          cells[j * dim_x + i].push_back((uint32_t) l);
+      }
+    }
+  }
+}
+
+void ClusteredLights::update(const glm::mat4 &view, float fov_y, float aspect, float near_plane,
+                             float far_plane) {
+  bin(view, fov_y, aspect, near_plane, far_plane, bins);
+  upload(bins);
+}
+
+void ClusteredLights::bin(const glm::mat4 &view, float fov_y, float aspect, float near_plane,
+                          float far_plane, ClusterBins &out) {
+  Clock::time_point start = Clock::now();
+  out.z_near = near_plane;
+  out.z_far = far_plane;
+
+  float tan_y = tanf(0.5f * fov_y), tan_x = tan_y * aspect;
+  slope_x.resize(dim_x + 1);
+  slope_y.resize(dim_y + 1);
+  slice_depth.resize(dim_z + 1);
+  for (int i = 0; i <= dim_x; i++)
+    slope_x[i] = (2.0f * i / dim_x - 1.0f) * tan_x;
+  for (int j = 0; j <= dim_y; j++)
+    slope_y[j] = (2.0f * j / dim_y - 1.0f) * tan_y;
+  for (int k = 0; k <= dim_z; k++)
+    slice_depth[k] = near_plane * powf(far_plane / near_plane, (float) k / dim_z);
+
+  for (size_t l = 0; l < lights.size(); l++) {
+    glm::vec4 p = view * glm::vec4(lights[l].position, 1.0f);
+    view_lights[l] = glm::vec4(p.x, p.y, -p.z, lights[l].radius);
+  }
+
+  pool.parallel_for(dim_z, [&](int k) { bin_slice(k); });
+
+  // Todas las listas seguidas, en el orden de los clusters
+  std::vector<uint32_t> &grid = out.grid, &indices = out.indices;
+  grid.resize(2 * cell_lights.size());
+  indices.clear();
+  size_t largest = 0;
+  for (size_t c = 0; c < cell_lights.size(); c++) {
+    grid[2 * c] = (uint32_t) indices.size();
+    grid[2 * c + 1] = (uint32_t) cell_lights[c].size();
+    indices.insert(indices.end(), cell_lights[c].begin(), cell_lights[c].end());
+    largest = std::max(largest, cell_lights[c].size());
+  }
+  if (indices.empty())
+    indices.push_back(0);
+
+  frames++;
+  bin_ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  total_indices += indices.size();
+  max_cluster = std::max(max_cluster, largest);
+}
+
+void ClusteredLights::upload(const ClusterBins &bins) {
+  z_near = bins.z_near;
+  z_far = bins.z_far;
+
+  // Orphaning: el frame anterior puede estar leyendo todavia
+  GL_COUNT(glBindBuffer(GL_TEXTURE_BUFFER, buffers[GRID_TBO]));
+  GL_COUNT(glBufferData(GL_TEXTURE_BUFFER, bins.grid.size() * sizeof(uint32_t), bins.grid.data(),
+                        GL_STREAM_DRAW));
+  GL_COUNT(glBindBuffer(GL_TEXTURE_BUFFER, buffers[INDICES_TBO]));
+  GL_COUNT(glBufferData(GL_TEXTURE_BUFFER, bins.indices.size() * sizeof(uint32_t), bins.indices.data(),
+                        GL_STREAM_DRAW));
+  GL_COUNT(glBindBuffer(GL_TEXTURE_BUFFER, 0));
+}
+
+void ClusteredLights::bind() {
+  for (int b = 0; b < 3; b++) {
+    GL_COUNT(glActiveTexture(GL_TEXTURE0 + CLUSTER_FIRST_TEXTURE_UNIT + b));
+    GL_COUNT(glBindTexture(GL_TEXTURE_BUFFER, textures[b]));
+  }
+}
+
+void ClusteredLights::print_stats() const {
+  if (frames == 0)
+    return;
+  printf("Light binning: %.3f ms/frame, %.1f light refs/cluster, max %zu in one cluster\n",
+         bin_ms / frames, (double) total_indices / frames / cell_lights.size(), max_cluster);
+}
@@ -0,0 +1,113 @@
+// clusters.h: luces puntuales con clustered forward shading
+//
+// El frustum de la camara se divide en una rejilla de clusters: dim_x x dim_y
+// tiles de pantalla y dim_z slices de profundidad (exponenciales entre el
+// near y el far, para que los clusters sean mas o menos cubicos). En cada
+// frame la CPU asigna cada luz a los clusters que toca su esfera (un slice
+// por tarea del pool) y sube el resultado a tres texture buffers:
+//
+//   point_lights     RGBA32F, 2 texels por luz: posicion y radio, color
+//   cluster_grid     RG32UI, por cluster: primer indice y numero de luces
+//   cluster_indices  R32UI, indices de luces de todos los clusters seguidos
+//
+// El fragment shader (compilado con CLUSTERED, ver defines()) calcula su
+// cluster a partir de gl_FragCoord y la profundidad en espacio de vista, y
+// solo recorre las luces de ese cluster. Con una rejilla 1x1x1 es forward
+// clasico: todos los fragmentos recorren todas las luces visibles.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "threadpool.h"
+
+// La intensidad cae como (1 - d / radius)^2 y es 0 a partir de radius
+struct PointLight {
+  glm::vec3 position;
+  float radius;
+  glm::vec3 color;
+  float pad;
+};
+
+// count luces repartidas dentro de la caja [lo, hi], con colores variados.
+// Siempre las mismas para el mismo count
+std::vector<PointLight> scatter_point_lights(int count, glm::vec3 lo, glm::vec3 hi, float radius);
+
+// Unidades de textura de los texture buffers (0 y 1 son las del material)
+const int CLUSTER_FIRST_TEXTURE_UNIT = 2;
+
+// Resultado del reparto de un frame, lo que se sube a la GPU
+struct ClusterBins {
+  std::vector<uint32_t> grid;     // (offset, count) por cluster
+  std::vector<uint32_t> indices;  // indices de luces de todos los clusters
+  float z_near = 0.1f, z_far = 1000.0f;
+};
+
+class ClusteredLights {
+public:
+  // threads == 0: un hilo por nucleo
+  ClusteredLights(const std::vector<PointLight> &lights, int dim_x = 16, int dim_y = 9,
+                  int dim_z = 24, int threads = 0);
+  ~ClusteredLights();
+
+  // Bloque de #define para los shaders (CLUSTERED y la rejilla)
+  std::string defines() const;
+  // Asigna los samplers a sus unidades (una vez, con el programa en uso)
+  static void set_samplers(GLuint program);
+
+  // Asigna las luces a los clusters del frustum (fov_y en radianes) y sube
+  // la rejilla y los indices
+  void update(const glm::mat4 &view, float fov_y, float aspect, float z_near, float z_far);
+  // Las dos mitades de update() por separado: bin() no llama a GL y se
+  // puede hacer en otro hilo (uno solo a la vez); upload() desde el hilo GL
+  void bin(const glm::mat4 &view, float fov_y, float aspect, float z_near, float z_far, ClusterBins &out);
+  void upload(const ClusterBins &bins);
+  // Enlaza los texture buffers a sus unidades
+  void bind();
+
+  // Para FrameData: clusters por pixel en x/y y escala y sesgo de
+  // log(profundidad) para obtener el slice
+  glm::vec4 shader_params(int width, int height) const;
+
+  int light_count() const { return (int) lights.size(); }
+  void print_stats() const;
+
+private:
+  void bin_slice(int k);
+
+  std::vector<PointLight> lights;
+  int dim_x, dim_y, dim_z;
+  ThreadPool pool;
+
+  // Frustum del ultimo bin(): pendientes x/z e y/z de los bordes de los
+  // tiles y profundidades de los bordes de los slices
+  std::vector<float> slope_x, slope_y, slice_depth;
+  // Near y far de lo ultimo subido, para shader_params()
+  float z_near = 0.1f, z_far = 1000.0f;
+
+  // Luces en espacio de vista (x, y, profundidad positiva, radio)
+  std::vector<glm::vec4> view_lights;
+  // Luces de cada cluster; se vacian cada frame pero conservan la memoria
+  std::vector<std::vector<uint32_t>> cell_lights;
+  // Reparto de update()
+  ClusterBins bins;
+
+  GLuint buffers[3] = {};
+  GLuint textures[3] = {};
+
+  // Estadisticas
+  int frames = 0;
+  double bin_ms = 0.0;
+  size_t total_indices = 0, max_cluster = 0;
+};
+
+#endif
@@ -0,0 +1,216 @@
+// cmdlist.cpp: listas de comandos de render (ver cmdlist.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "cmdlist.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "glcalls.h"
+#include "glstate.h"
+#include "profiler.h"
+
+void CommandList::push_float(float value) {
+  uint32_t word;
+  memcpy(&word, &value, sizeof(word));
+  push(word);
+}
+
+void CommandList::push64(uint64_t value) {
+  push((uint32_t) value);
+  push((uint32_t) (value >> 32));
+}
+
+void CommandList::use_program(GLuint program) {
+  push(CMD_USE_PROGRAM);
+  push(program);
+  commands++;
+}
+
+void CommandList::bind_vertex_array(GLuint vao) {
+  push(CMD_BIND_VAO);
+  push(vao);
+  commands++;
+}
+
+void CommandList::bind_texture(int unit, GLenum target, GLuint texture) {
+  push(CMD_BIND_TEXTURE);
+  push((uint32_t) unit);
+  push(target);
+  push(texture);
+  commands++;
+}
+
+void CommandList::uniform_4fv(GLint location, int count, const float *values) {
+  push(CMD_UNIFORM_4FV);
+  push((uint32_t) location);
+  push((uint32_t) count);
+  for (int i = 0; i < 4 * count; i++)
+    push_float(values[i]);
+  commands++;
+}
+
+void CommandList::uniform_matrix_4fv(GLint location, const glm::mat4 &matrix) {
+  push(CMD_UNIFORM_MATRIX_4FV);
+  push((uint32_t) location);
+  for (int i = 0; i < 16; i++)
+    push_float((&matrix[0][0])[i]);
+  commands++;
+}
+
+void CommandList::bind_uniform_range(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+  push(CMD_BIND_UNIFORM_RANGE);
+  push(binding);
+  push(buffer);
+  push64((uint64_t) offset);
+  push64((uint64_t) size);
+  commands++;
+}
+
+void CommandList::draw_elements(GLenum mode, GLsizei count, GLenum type, size_t offset) {
+  push(CMD_DRAW_ELEMENTS);
+  push(mode);
+  push((uint32_t) count);
+  push(type);
+  push64(offset);
+  commands++;
+}
+
+void CommandList::draw_elements_instanced(GLenum mode, GLsizei count, GLenum type, size_t offset,
+                                          GLsizei instances, GLuint base_instance) {
+  push(CMD_DRAW_ELEMENTS_INSTANCED);
+  push(mode);
+  push((uint32_t) count);
+  push(type);
+  push64(offset);
+  push((uint32_t) instances);
+  push(base_instance);
+  commands++;
+}
+
+static inline uint64_t read64(const uint32_t *w) {
+  return (uint64_t) w[0] | ((uint64_t) w[1] << 32);
+}
+
+void CommandList::replay() const {
+  const uint32_t *w = words.data(), *end = w + words.size();
+  std::vector<float> floats;
+  while (w < end) {
+    switch (*w++) {
+    case CMD_USE_PROGRAM:
+      gl_state.use_program(w[0]);
+      w += 1;
+      break;
+    case CMD_BIND_VAO:
+      gl_state.bind_vertex_array(w[0]);
+      w += 1;
+      break;
+    case CMD_BIND_TEXTURE:
+      gl_state.bind_texture((int) w[0], w[1], w[2]);
+      w += 3;
+      break;
+    case CMD_UNIFORM_4FV: {
+      // Los float van como palabras: se copian, sin leerlos por otro tipo
+      int count = (int) w[1];
+      floats.resize(4 * count);
+      memcpy(floats.data(), &w[2], floats.size() * sizeof(float));
+      gl_state.uniform_4fv((GLint) w[0], count, floats.data());
+      w += 2 + 4 * count;
+      break;
+    }
+    case CMD_UNIFORM_MATRIX_4FV: {
+      float matrix[16];
+      memcpy(matrix, &w[1], sizeof(matrix));
+      gl_state.uniform_matrix_4fv((GLint) w[0], matrix);
+      w += 17;
+      break;
+    }
+    case CMD_BIND_UNIFORM_RANGE:
+      GL_COUNT(glBindBufferRange(GL_UNIFORM_BUFFER, w[0], w[1], (GLintptr) read64(&w[2]),
+                                 (GLsizeiptr) read64(&w[4])));
+      w += 6;
+      break;
+    case CMD_DRAW_ELEMENTS:
+      GL_COUNT(glDrawElements(w[0], (GLsizei) w[1], w[2], (const void *) (uintptr_t) read64(&w[3])));
+      w += 5;
+      break;
+    case CMD_DRAW_ELEMENTS_INSTANCED:
+      if (w[6] > 0) {
+        GL_COUNT(glDrawElementsInstancedBaseInstance(w[0], (GLsizei) w[1], w[2],
+                                                     (const void *) (uintptr_t) read64(&w[3]),
+                                                     (GLsizei) w[5], w[6]));
+      } else {
+        GL_COUNT(glDrawElementsInstanced(w[0], (GLsizei) w[1], w[2], (const void *) (uintptr_t) read64(&w[3]),
+                                         (GLsizei) w[5]));
+      }
+      w += 7;
+      break;
+    default:
+      fprintf(stderr, "ERROR: bad command list opcode %u\n", w[-1]);
+      return;
+    }
+  }
+}
+
+CommandRecorder::CommandRecorder(int threads, int partition, bool reuse)
+    : pool(threads), partition_size(partition), reuse(reuse) {}
+
+void CommandRecorder::record(const std::vector<int> &ids, const std::vector<uint32_t> &state,
+                             const RecordFn &record) {
+  PROFILE_SCOPE("record command lists");
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  int count = (int) ids.size();
+  used = (count + partition_size - 1) / partition_size;
+  if ((int) partitions.size() < used)
+    partitions.resize(used);
+  if (!reuse || state != recorded_state) {
+    for (Partition &p : partitions)
+      p.valid = false;
+    recorded_state = state;
+  }
+
+  // Cada hilo compara y, si hace falta, graba sus particiones
+  std::vector<char> kept(used);
+  pool.parallel_for(used, [&](int i) {
+    Partition &p = partitions[i];
+    const int *first = ids.data() + (size_t) i * partition_size;
+    int n = std::min(partition_size, count - i * partition_size);
+    if (p.valid && (int) p.ids.size() == n && std::equal(first, first + n, p.ids.begin())) {
+      kept[i] = 1;
+      return;
+    }
+    p.ids.assign(first, first + n);
+    p.list.clear();
+    record(first, n, p.list);
+    p.valid = true;
+  });
+
+  frames++;
+  lists += used;
+  for (int i = 0; i < used; i++) {
+    reused += kept[i];
+    commands += partitions[i].list.command_count();
+    bytes += partitions[i].list.bytes();
+  }
+  record_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CommandRecorder::replay() {
+  PROFILE_SCOPE("replay command lists");
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < used; i++)
+    partitions[i].list.replay();
+  replay_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void CommandRecorder::print_stats() const {
+  if (frames == 0)
+    return;
+  printf("Command lists: %.1f per frame (%d objects each, %d threads), %.1f%% reused, %.0f commands and "
+         "%.1f KB per frame, record %.3f ms/frame, replay %.3f ms/frame\n", (double) lists / frames,
+         partition_size, pool.size(), lists ? 100.0 * reused / lists : 0.0, (double) commands / frames,
+         bytes / 1024.0 / frames, record_ms / frames, replay_ms / frames);
+}
@@ -0,0 +1,112 @@
+// cmdlist.h: listas de comandos de render grabadas en paralelo
+//
+// Una CommandList es un flujo de palabras de 32 bits: el opcode seguido de
+// sus argumentos (los float con su patron de bits y los offsets de 64 bits
+// en dos palabras). No guarda punteros ni llama a GL, asi que se puede
+// grabar desde cualquier hilo sin contexto, copiar o guardar; solo replay()
+// hace las llamadas, desde el hilo GL y en el orden grabado (los binds y
+// uniforms a traves del cache de estado, glstate.h).
+//
+// CommandRecorder reparte los objetos a dibujar en particiones, graba la
+// lista de cada una en un pool de hilos y las reproduce en orden. Cada lista
+// fija todo el estado que usa (programa, texturas, VAO...) y no depende de
+// las anteriores, asi que se puede reutilizar: si una particion tiene los
+// mismos objetos y el mismo estado que en el frame anterior, su lista no se
+// vuelve a grabar.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CMDLIST_H
+#define CMDLIST_H
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "threadpool.h"
+
+enum CommandOp {
+  CMD_USE_PROGRAM,          // program
+  CMD_BIND_VAO,             // vao
+  CMD_BIND_TEXTURE,         // unit, target, texture
+  CMD_UNIFORM_4FV,          // location, count, 4 * count floats
+  CMD_UNIFORM_MATRIX_4FV,   // location, 16 floats
+  CMD_BIND_UNIFORM_RANGE,   // binding, buffer, offset (64), size (64)
+  CMD_DRAW_ELEMENTS,        // mode, count, type, offset (64)
+  CMD_DRAW_ELEMENTS_INSTANCED,  // mode, count, type, offset (64), instances, base instance
+  CMD_OPS
+};
+
+class CommandList {
+public:
+  void clear() { words.clear(); commands = 0; }
+
+  void use_program(GLuint program);
+  void bind_vertex_array(GLuint vao);
+  void bind_texture(int unit, GLenum target, GLuint texture);
+  void uniform_4fv(GLint location, int count, const float *values);
+  void uniform_matrix_4fv(GLint location, const glm::mat4 &matrix);
+  void bind_uniform_range(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size);
+  void draw_elements(GLenum mode, GLsizei count, GLenum type, size_t offset);
+  // base_instance > 0 necesita GL 4.2 (ARB_base_instance)
+  void draw_elements_instanced(GLenum mode, GLsizei count, GLenum type, size_t offset, GLsizei instances,
+                               GLuint base_instance);
+
+  // Hilo GL
+  void replay() const;
+
+  int command_count() const { return commands; }
+  size_t bytes() const { return words.size() * sizeof(uint32_t); }
+
+private:
+  void push(uint32_t word) { words.push_back(word); }
+  void push_float(float value);
+  void push64(uint64_t value);
+
+  std::vector<uint32_t> words;
+  int commands = 0;
+};
+
+class CommandRecorder {
+public:
+  // Graba en list los draws de ids[0..count), fijando antes el estado que
+  // usen. Se llama desde los hilos del pool
+  typedef std::function<void(const int *ids, int count, CommandList &list)> RecordFn;
+
+  // threads == 0: un hilo por nucleo; partition: objetos por lista;
+  // reuse = false graba todas las listas en cada frame (benchmark)
+  explicit CommandRecorder(int threads = 0, int partition = 1024, bool reuse = true);
+
+  // Listas de los objetos ids, en orden. state es todo lo demas que lee
+  // record (programa, texturas...): si cambia se graban todas de nuevo
+  void record(const std::vector<int> &ids, const std::vector<uint32_t> &state, const RecordFn &record);
+  // Hilo GL: las listas del ultimo record(), en orden
+  void replay();
+
+  // Listas por frame, cuantas se han reutilizado, tiempos de grabar y
+  // reproducir y tamano
+  void print_stats() const;
+
+private:
+  struct Partition {
+    std::vector<int> ids;  // con los que se grabo list
+    bool valid = false;
+    CommandList list;
+  };
+
+  ThreadPool pool;
+  int partition_size;
+  bool reuse;
+  std::vector<Partition> partitions;
+  int used = 0;  // particiones del ultimo record()
+  std::vector<uint32_t> recorded_state;
+
+  unsigned long frames = 0, lists = 0, reused = 0, commands = 0, bytes = 0;
+  double record_ms = 0.0, replay_ms = 0.0;
+};
+
+#endif
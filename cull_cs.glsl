@@ -0,0 +1,135 @@
+#version 430
+
+// Culling en la GPU, un hilo por objeto (ver gpucull.h). MAX_MESHES se
+// inyecta al compilar.
+
+layout(local_size_x = 64) in;
+
+struct Object {
+  vec4 center;  // centro de la caja; w: 1 si gira, 0 si esta quieto
+  vec4 extent;  // semilados de la caja que lo contiene
+  vec4 phase;   // cos/sin del desfase: giro sobre Y (xy) y sobre X (zw)
+  vec4 scale;   // escala de la malla
+  uvec4 mesh;   // x: indice en meshes
+};
+
+// Mismo layout que DrawElementsIndirectCommand (20 bytes en std430)
+struct DrawCommand {
+  uint count;
+  uint instance_count;
+  uint first_index;
+  int base_vertex;
+  uint base_instance;
+};
+
+// Mismo layout que InstanceAttribs (instancing.h)
+struct Instance {
+  mat4 model;
+  vec4 normal_matrix[3];
+};
+
+layout(std430, binding = 0) readonly buffer Objects { Object objects[]; };
+layout(std430, binding = 1) writeonly buffer Commands { DrawCommand commands[]; };
+layout(std430, binding = 2) writeonly buffer Instances { Instance instances[]; };
+layout(std430, binding = 3) buffer DrawCount { uint draw_count[2]; };
+layout(std430, binding = 4) buffer Visibility { uint visible[]; };
+
+uniform vec4 planes[6];          // normal hacia dentro y distancia
+uniform vec4 spin;               // cos/sin del giro del frame, como phase
+uniform uvec4 meshes[MAX_MESHES];  // primer indice, numero de indices y base_vertex
+uniform uint object_count;
+uniform uint cull_pass;          // GpuCulling::Pass
+
+// Solo en OCCLUSION
+uniform mat4 view_proj;
+uniform sampler2D hiz;
+uniform int hiz_levels;
+uniform ivec2 viewport;
+
+bool in_frustum(vec3 center, vec3 extent) {
+  for (int p = 0; p < 6; p++)
+    if (dot(planes[p].xyz, center) + planes[p].w < -dot(abs(planes[p].xyz), extent))
+      return false;
+  return true;
+}
+
+// La caja proyectada ocupa un rectangulo de pixeles; en el nivel en el que
+// cabe en 2x2 texels se miran los 4 que lo cubren
+bool occluded(vec3 center, vec3 extent) {
+  vec3 lo = vec3(1.0), hi = vec3(-1.0);
+  for (int i = 0; i < 8; i++) {
+    vec3 corner = center + extent * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0,
+                                         (i & 4) != 0 ? 1.0 : -1.0);
+    vec4 clip = view_proj * vec4(corner, 1.0);
+    if (clip.w <= 0.0)
+      return false;  // cruza el plano de la camara
+    vec3 ndc = clip.xyz / clip.w;
+    lo = i == 0 ? ndc : min(lo, ndc);
+    hi = i == 0 ? ndc : max(hi, ndc);
+  }
+
+  ivec2 px_lo = clamp(ivec2((lo.xy * 0.5 + 0.5) * vec2(viewport)), ivec2(0), viewport - 1);
+  ivec2 px_hi = clamp(ivec2((hi.xy * 0.5 + 0.5) * vec2(viewport)), ivec2(0), viewport - 1);
+  ivec2 span = px_hi - px_lo;
+  int level = min(findMSB(max(span.x, span.y)) + 1, hiz_levels - 1);
+
+  // Tamano del nivel como en glTexStorage2D (sin textureSize con un lod
+  // distinto en cada hilo)
+  ivec2 last = max(viewport >> level, ivec2(1)) - 1;
+  ivec2 a = min(px_lo >> level, last), b = min(px_hi >> level, last);
+  float farthest = max(max(texelFetch(hiz, a, level).r, texelFetch(hiz, ivec2(b.x, a.y), level).r),
+                       max(texelFetch(hiz, ivec2(a.x, b.y), level).r, texelFetch(hiz, b, level).r));
+  return lo.z * 0.5 + 0.5 > farthest;
+}
+
+// Un draw de una instancia en la region de la fase; baseInstance elige sus
+// matrices
+void emit(Object object, uint region) {
+  uint slot = region * object_count + atomicAdd(draw_count[region], 1u);
+  uvec4 mesh = meshes[object.mesh.x];
+  commands[slot] = DrawCommand(mesh.y, 1u, mesh.x, int(mesh.z), slot);
+
+  // Igual que TransformSystem: suma de angulos y rotate Y * rotate X. Los
+  // objetos quietos tienen phase = (1, 0, 1, 0) y no usan el giro del frame
+  vec4 s = object.center.w != 0.0 ? spin : vec4(1.0, 0.0, 1.0, 0.0);
+  float ca = s.x * object.phase.x - s.y * object.phase.y;
+  float sa = s.y * object.phase.x + s.x * object.phase.y;
+  float cb = s.z * object.phase.z - s.w * object.phase.w;
+  float sb = s.w * object.phase.z + s.z * object.phase.w;
+  vec4 c0 = vec4(ca, 0.0, -sa, 0.0);
+  vec4 c1 = vec4(sa * sb, cb, ca * sb, 0.0);
+  vec4 c2 = vec4(sa * cb, -sb, ca * cb, 0.0);
+
+  // model = T * R * S; la inversa traspuesta de R * S es R * S^-1
+  vec3 k = object.scale.xyz;
+  instances[slot].model = mat4(c0 * k.x, c1 * k.y, c2 * k.z, vec4(object.center.xyz, 1.0));
+  instances[slot].normal_matrix[0] = c0 / k.x;
+  instances[slot].normal_matrix[1] = c1 / k.y;
+  instances[slot].normal_matrix[2] = c2 / k.z;
+}
+
+void main() {
+  uint id = gl_GlobalInvocationID.x;
+  if (id >= object_count)
+    return;
+
+  Object object = objects[id];
+  bool inside = in_frustum(object.center.xyz, object.extent.xyz);
+
+  if (cull_pass == 0u) {
+    if (inside)
+      emit(object, 0u);
+  } else if (cull_pass == 1u) {
+    // Lo que se vio en el frame anterior
+    if (inside && visible[id] != 0u)
+      emit(object, 0u);
+  } else {
+    // Contra la profundidad de la primera fase: lo visible que no se dibujo
+    // en ella se dibuja ahora, y todo queda marcado para el frame siguiente
+    bool drawn = inside && visible[id] != 0u;
+    bool seen = inside && !occluded(object.center.xyz, object.extent.xyz);
+    visible[id] = seen ? 1u : 0u;
+    if (seen && !drawn)
+      emit(object, 1u);
+  }
+}
@@ -0,0 +1,285 @@
+// culling.cpp: BVH de cajas y frustum culling (ver culling.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "culling.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <queue>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+// Objetos como mucho en una hoja: por debajo de esto bajar otro nivel
+// cuesta mas que probar las cajas de los objetos una a una
+static const int LEAF_SIZE = 8;
+
+Frustum frustum_from_matrix(const glm::mat4 &m) {
+  // Gribb y Hartmann: cada plano es la fila 3 mas o menos otra fila
+  glm::vec4 row[4];
+  for (int r = 0; r < 4; r++)
+    row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+
+  Frustum f;
+  for (int axis = 0; axis < 3; axis++) {
+    f.planes[2 * axis] = row[3] + row[axis];
+    f.planes[2 * axis + 1] = row[3] - row[axis];
+  }
+  for (glm::vec4 &plane : f.planes)
+    plane = plane / glm::length(glm::vec3(plane));
+  return f;
+}
+
+static float centroid(const std::vector<glm::vec3> &lo, const std::vector<glm::vec3> &hi, int id,
+                      int axis) {
+  return lo[id][axis] + hi[id][axis];
+}
+
+// Ordena [begin, end) de order por la mediana del eje mas largo de los
+// centros y devuelve el punto de corte
+static int split(std::vector<int> &order, int begin, int end, const std::vector<glm::vec3> &lo,
+                 const std::vector<glm::vec3> &hi) {
+  glm::vec3 cmin(FLT_MAX), cmax(-FLT_MAX);
+  for (int i = begin; i < end; i++) {
+    glm::vec3 c = lo[order[i]] + hi[order[i]];
+    cmin = glm::min(cmin, c);
+    cmax = glm::max(cmax, c);
+  }
+  glm::vec3 extent = cmax - cmin;
+  int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+  int mid = begin + (end - begin) / 2;
+  std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                   [&](int a, int b) { return centroid(lo, hi, a, axis) < centroid(lo, hi, b, axis); });
+  return mid;
+}
+
+void CullingBvh::build(const std::vector<glm::vec3> &lo, const std::vector<glm::vec3> &hi) {
+  int count = (int) lo.size();
+  order.resize(count);
+  for (int i = 0; i < count; i++)
+    order[i] = i;
+  leaf_node.assign(count, -1);
+
+  nodes.clear();
+  dirty.clear();
+  if (count > 0)
+    make_node(0, count, -1, lo, hi);
+  is_dirty.assign(nodes.size(), false);
+
+  position.resize(count);
+  box_lo.resize(count);
+  box_hi.resize(count);
+  for (int i = 0; i < count; i++) {
+    position[order[i]] = i;
+    box_lo[i] = lo[order[i]];
+    box_hi[i] = hi[order[i]];
+  }
+
+  // De las hojas a la raiz
+  for (int n = (int) nodes.size() - 1; n >= 0; n--)
+    refit_node(n);
+}
+
+int CullingBvh::make_node(int begin, int end, int parent, const std::vector<glm::vec3> &lo,
+                          const std::vector<glm::vec3> &hi) {
+  int n = (int) nodes.size();
+  nodes.push_back(Node());
+  nodes[n].begin = begin;
+  nodes[n].end = end;
+  nodes[n].parent = parent;
+
+  // Hasta 4 rangos: mediana y otra vez la mediana de cada mitad
+  int cuts[5] = { begin, begin, begin, end, end };
+  if (end - begin > LEAF_SIZE) {
+    cuts[2] = split(order, begin, end, lo, hi);
+    cuts[1] = split(order, begin, cuts[2], lo, hi);
+    cuts[3] = split(order, cuts[2], end, lo, hi);
+  } else {
+    cuts[1] = cuts[2] = cuts[3] = end;
+  }
+
+  int used = 0;
+  for (int c = 0; c < 4; c++) {
+    int b = cuts[c], e = cuts[c + 1];
+    if (b == e)
+      continue;
+    int slot = used++;
+    if (e - b > LEAF_SIZE) {
+      int child = make_node(b, e, n, lo, hi);
+      nodes[n].child[slot] = child;
+    } else {
+      nodes[n].child[slot] = -1;
+      nodes[n].first[slot] = b;
+      nodes[n].count[slot] = e - b;
+      for (int i = b; i < e; i++)
+        leaf_node[order[i]] = n;
+    }
+  }
+  nodes[n].used = used;
+  return n;
+}
+
+// Recalcula las cajas de los hijos de n (los nodos hijos ya estan al dia)
+void CullingBvh::refit_node(int n) {
+  Node &node = nodes[n];
+  for (int c = 0; c < 4; c++) {
+    glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+    if (c < node.used && node.child[c] >= 0) {
+      const Node &child = nodes[node.child[c]];
+      for (int k = 0; k < child.used; k++) {
+        lo = glm::min(lo, glm::vec3(child.min_x[k], child.min_y[k], child.min_z[k]));
+        hi = glm::max(hi, glm::vec3(child.max_x[k], child.max_y[k], child.max_z[k]));
+      }
+    } else if (c < node.used) {
+      for (int i = node.first[c]; i < node.first[c] + node.count[c]; i++) {
+        lo = glm::min(lo, box_lo[i]);
+        hi = glm::max(hi, box_hi[i]);
+      }
+    }
+    node.min_x[c] = lo.x;
+    node.min_y[c] = lo.y;
+    node.min_z[c] = lo.z;
+    node.max_x[c] = hi.x;
+    node.max_y[c] = hi.y;
+    node.max_z[c] = hi.z;
+  }
+}
+
+void CullingBvh::update(int id, glm::vec3 lo, glm::vec3 hi) {
+  box_lo[position[id]] = lo;
+  box_hi[position[id]] = hi;
+  int n = leaf_node[id];
+  if (!is_dirty[n]) {
+    is_dirty[n] = true;
+    dirty.push_back(n);
+  }
+}
+
+void CullingBvh::refit() {
+  // Los hijos tienen indice mayor que su padre: sacando siempre el mayor,
+  // cada nodo se ajusta despues de todos sus hijos
+  std::priority_queue<int> queue(dirty.begin(), dirty.end());
+  dirty.clear();
+  while (!queue.empty()) {
+    int n = queue.top();
+    queue.pop();
+    is_dirty[n] = false;
+    refit_node(n);
+
+    int parent = nodes[n].parent;
+    if (parent >= 0 && !is_dirty[parent]) {
+      is_dirty[parent] = true;
+      queue.push(parent);
+    }
+  }
+}
+
+// Caja de order[i]
+bool CullingBvh::box_visible(const Frustum &frustum, int i) const {
+  const glm::vec3 &lo = box_lo[i], &hi = box_hi[i];
+  for (const glm::vec4 &plane : frustum.planes) {
+    // Vertice de la caja mas adentro segun la normal del plano
+    glm::vec3 p(plane.x > 0.0f ? hi.x : lo.x, plane.y > 0.0f ? hi.y : lo.y, plane.z > 0.0f ? hi.z : lo.z);
+    if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+      return false;
+  }
+  return true;
+}
+
+// Bits de los hijos fuera de algun plano (outside) y dentro de todos (inside)
+static void test_children(const Frustum &frustum, const float *min_x, const float *min_y,
+                          const float *min_z, const float *max_x, const float *max_y,
+                          const float *max_z, int *outside, int *inside) {
+#ifdef __SSE2__
+  const __m128 zero = _mm_setzero_ps();
+  __m128 out = zero, in = _mm_cmpeq_ps(zero, zero);
+  for (const glm::vec4 &plane : frustum.planes) {
+    // p: vertice mas adentro; q: el mas afuera. El signo de la normal es el
+    // mismo para los 4 hijos, asi que basta con elegir el array
+    __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+    __m128 d = _mm_set1_ps(plane.w);
+    __m128 px = _mm_loadu_ps(plane.x > 0.0f ? max_x : min_x), qx = _mm_loadu_ps(plane.x > 0.0f ? min_x : max_x);
+    __m128 py = _mm_loadu_ps(plane.y > 0.0f ? max_y : min_y), qy = _mm_loadu_ps(plane.y > 0.0f ? min_y : max_y);
+    __m128 pz = _mm_loadu_ps(plane.z > 0.0f ? max_z : min_z), qz = _mm_loadu_ps(plane.z > 0.0f ? min_z : max_z);
+    __m128 dp = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, px), _mm_mul_ps(ny, py)), _mm_add_ps(_mm_mul_ps(nz, pz), d));
+    __m128 dq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, qx), _mm_mul_ps(ny, qy)), _mm_add_ps(_mm_mul_ps(nz, qz), d));
+    out = _mm_or_ps(out, _mm_cmplt_ps(dp, zero));
+    in = _mm_and_ps(in, _mm_cmpge_ps(dq, zero));
+  }
+  *outside = _mm_movemask_ps(out);
+  *inside = _mm_movemask_ps(in);
+#else
+  *outside = 0;
+  *inside = 0;
+  for (int c = 0; c < 4; c++) {
+    bool out = false, in = true;
+    for (const glm::vec4 &plane : frustum.planes) {
+      float dp = plane.w, dq = plane.w;
+      dp += plane.x * (plane.x > 0.0f ? max_x[c] : min_x[c]);
+      dq += plane.x * (plane.x > 0.0f ? min_x[c] : max_x[c]);
+      dp += plane.y * (plane.y > 0.0f ? max_y[c] : min_y[c]);
+      dq += plane.y * (plane.y > 0.0f ? min_y[c] : max_y[c]);
+      dp += plane.z * (plane.z > 0.0f ? max_z[c] : min_z[c]);
+      dq += plane.z * (plane.z > 0.0f ? min_z[c] : max_z[c]);
+      out = out || dp < 0.0f;
+      in = in && dq >= 0.0f;
+    }
+    *outside |= out << c;
+    *inside |= in << c;
+  }
+#endif
+}
+
+void CullingBvh::cull(const glm::mat4 &view_proj, std::vector<int> &visible) {
+  Clock::time_point start = Clock::now();
+  visible.clear();
+  Frustum frustum = frustum_from_matrix(view_proj);
+
+  std::vector<int> stack;
+  if (!nodes.empty())
+    stack.push_back(0);
+  while (!stack.empty()) {
+    const Node &node = nodes[stack.back()];
+    stack.pop_back();
+
+    int outside, inside;
+    test_children(frustum, node.min_x, node.min_y, node.min_z, node.max_x, node.max_y, node.max_z,
+                  &outside, &inside);
+    for (int c = 0; c < node.used; c++) {
+      if (outside & (1 << c))
+        continue;
+      int child = node.child[c];
+      int begin = child >= 0 ? nodes[child].begin : node.first[c];
+      int end = child >= 0 ? nodes[child].end : node.first[c] + node.count[c];
+      if (inside & (1 << c)) {
+        visible.insert(visible.end(), order.begin() + begin, order.begin() + end);
+      } else if (child >= 0) {
+        stack.push_back(child);
+      } else {
+        for (int i = begin; i < end; i++)
+          if (box_visible(frustum, i))
+            visible.push_back(order[i]);
+      }
+    }
+  }
+
+  frames++;
+  cull_ms += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  total_visible += visible.size();
+}
+
+void CullingBvh::print_stats() const {
+  if (frames == 0)
+    return;
+  double shown = (double) total_visible / frames;
+  printf("Culling: %.3f ms/frame, %.1f visible, %.1f culled of %d objects (%zu BVH nodes)\n",
+         cull_ms / frames, shown, size() - shown, size(), nodes.size());
+}
@@ -0,0 +1,76 @@
+// culling.h: frustum culling de objetos con una BVH de cajas (AABB)
+//
+// Cada objeto tiene una caja alineada con los ejes. El arbol tiene 4 hijos
+// por nodo y guarda las cajas de los 4 en SoA, asi que cada nodo se prueba
+// contra los 6 planos del frustum con una instruccion SSE2 por plano y
+// componente. Un hijo que queda entero dentro del frustum no se sigue
+// probando: sus objetos son un rango contiguo de order y se copian tal cual.
+//
+// Si un objeto se mueve, update() cambia su caja y refit() ajusta solo los
+// nodos afectados (de las hojas hacia la raiz); el arbol no se reconstruye.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Planos (n, d) con la normal hacia dentro: p esta dentro si dot(n, p) + d >= 0
+struct Frustum {
+  glm::vec4 planes[6];
+};
+
+// Planos de izquierda, derecha, abajo, arriba, near y far de proj * view
+Frustum frustum_from_matrix(const glm::mat4 &view_proj);
+
+class CullingBvh {
+public:
+  // Construye el arbol con las cajas [lo[i], hi[i]] de los objetos 0..n-1
+  void build(const std::vector<glm::vec3> &lo, const std::vector<glm::vec3> &hi);
+
+  // Nueva caja del objeto id; el arbol se ajusta en el siguiente refit()
+  void update(int id, glm::vec3 lo, glm::vec3 hi);
+  void refit();
+
+  // Deja en visible los ids de los objetos cuya caja toca el frustum (sin
+  // un orden concreto)
+  void cull(const glm::mat4 &view_proj, std::vector<int> &visible);
+
+  int size() const { return (int) order.size(); }
+  void print_stats() const;
+
+private:
+  struct Node {
+    // Cajas de los 4 hijos en SoA; los hijos que no se usan tienen una caja
+    // vacia (min > max) que siempre queda fuera
+    float min_x[4], min_y[4], min_z[4], max_x[4], max_y[4], max_z[4];
+    int child[4];          // >= 0: nodo; -1: hoja con order[first, first + count)
+    int first[4], count[4];
+    int used;
+    int begin, end;        // rango de order de todo el subarbol
+    int parent;
+  };
+
+  int make_node(int begin, int end, int parent, const std::vector<glm::vec3> &lo,
+                const std::vector<glm::vec3> &hi);
+  void refit_node(int n);
+  bool box_visible(const Frustum &frustum, int i) const;
+
+  std::vector<Node> nodes;
+  std::vector<int> order;  // ids de los objetos; cada nodo tiene un rango
+  // Cajas en el orden de order, para que las de una hoja esten seguidas
+  std::vector<glm::vec3> box_lo, box_hi;
+  std::vector<int> position;  // de cada id en order
+  std::vector<int> leaf_node;  // hoja de cada id
+  std::vector<int> dirty;  // nodos pendientes de refit()
+  std::vector<bool> is_dirty;
+
+  // Estadisticas
+  int frames = 0;
+  double cull_ms = 0.0;
+  long long total_visible = 0;
+};
+
+#endif
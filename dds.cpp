@@ -0,0 +1,125 @@
+// dds.cpp: contenedor DDS (ver dds.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "dds.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t DDS_MAGIC = 0x20534444;  // "DDS "
+
+static const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4,
+                      DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000,
+                      DDSD_LINEARSIZE = 0x80000;
+static const uint32_t DDPF_FOURCC = 0x4;
+static const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000,
+                      DDSCAPS_MIPMAP = 0x400000;
+
+static const uint32_t DXGI_FORMAT_BC7_UNORM = 98;
+static const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+static uint32_t fourcc(const char *s) {
+  return (uint32_t) s[0] | ((uint32_t) s[1] << 8) | ((uint32_t) s[2] << 16) | ((uint32_t) s[3] << 24);
+}
+
+// Cabecera tal como esta en disco (little endian, sin padding)
+struct DdsHeader {
+  uint32_t size, flags, height, width, pitch_or_linear_size, depth, mip_map_count;
+  uint32_t reserved1[11];
+  uint32_t pf_size, pf_flags, pf_fourcc, pf_rgb_bit_count, pf_masks[4];
+  uint32_t caps, caps2, caps3, caps4, reserved2;
+};
+
+struct DdsHeaderDx10 {
+  uint32_t dxgi_format, resource_dimension, misc_flag, array_size, misc_flags2;
+};
+
+bool dds_parse(const unsigned char *data, size_t size, DdsImage *image) {
+  DdsHeader header;
+  if (size < 4 + sizeof(header))
+    return false;
+  uint32_t magic;
+  memcpy(&magic, data, 4);
+  memcpy(&header, data + 4, sizeof(header));
+  if (magic != DDS_MAGIC || header.size != sizeof(header) || !(header.pf_flags & DDPF_FOURCC))
+    return false;
+
+  size_t offset = 4 + sizeof(header);
+  image->format = BC_NONE;
+  if (header.pf_fourcc == fourcc("DXT1")) {
+    image->format = BC1;
+  } else if (header.pf_fourcc == fourcc("DXT5")) {
+    image->format = BC3;
+  } else if (header.pf_fourcc == fourcc("DX10")) {
+    DdsHeaderDx10 dx10;
+    if (size < offset + sizeof(dx10))
+      return false;
+    memcpy(&dx10, data + offset, sizeof(dx10));
+    offset += sizeof(dx10);
+    if (dx10.dxgi_format == DXGI_FORMAT_BC7_UNORM &&
+        dx10.resource_dimension == D3D10_RESOURCE_DIMENSION_TEXTURE2D)
+      image->format = BC7;
+  }
+  if (image->format == BC_NONE || header.width == 0 || header.height == 0)
+    return false;
+
+  image->width = (int) header.width;
+  image->height = (int) header.height;
+  int count = (header.flags & DDSD_MIPMAPCOUNT) && header.mip_map_count > 0 ? header.mip_map_count : 1;
+
+  image->levels.clear();
+  int w = image->width, h = image->height;
+  for (int i = 0; i < count; i++) {
+    DdsLevel level;
+    level.width = w;
+    level.height = h;
+    level.offset = offset;
+    level.size = bc_level_bytes(image->format, w, h);
+    if (offset + level.size > size)
+      return false;
+    image->levels.push_back(level);
+    offset += level.size;
+    if (w == 1 && h == 1)
+      break;
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+  return true;
+}
+
+bool dds_write(const char *path, BcFormat format, int width, int height,
+               const std::vector<std::vector<unsigned char> > &levels) {
+  if (format == BC_NONE || levels.empty())
+    return false;
+
+  DdsHeader header;
+  memset(&header, 0, sizeof(header));
+  header.size = sizeof(header);
+  header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT |
+                 DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+  header.height = height;
+  header.width = width;
+  header.pitch_or_linear_size = (uint32_t) levels[0].size();
+  header.mip_map_count = (uint32_t) levels.size();
+  header.pf_size = 32;
+  header.pf_flags = DDPF_FOURCC;
+  header.pf_fourcc = fourcc(format == BC1 ? "DXT1" : (format == BC3 ? "DXT5" : "DX10"));
+  header.caps = DDSCAPS_TEXTURE;
+  if (levels.size() > 1)
+    header.caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL)
+    return false;
+
+  bool ok = fwrite(&DDS_MAGIC, 4, 1, fp) == 1 && fwrite(&header, sizeof(header), 1, fp) == 1;
+  if (ok && format == BC7) {
+    DdsHeaderDx10 dx10 = { DXGI_FORMAT_BC7_UNORM, D3D10_RESOURCE_DIMENSION_TEXTURE2D, 0, 1, 0 };
+    ok = fwrite(&dx10, sizeof(dx10), 1, fp) == 1;
+  }
+  for (size_t i = 0; ok && i < levels.size(); i++)
+    ok = fwrite(levels[i].data(), 1, levels[i].size(), fp) == levels[i].size();
+
+  return fclose(fp) == 0 && ok;
+}
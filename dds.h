@@ -0,0 +1,35 @@
+// dds.h: contenedor DDS para texturas comprimidas con mipmaps
+//
+// BC1 y BC3 se escriben con los FourCC clasicos ("DXT1", "DXT5") y BC7 con
+// la cabecera extendida DX10. Las filas van de arriba a abajo, igual que las
+// imagenes de stb_image, asi que se suben a GL sin voltear.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef DDS_H
+#define DDS_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "bcn.h"
+
+struct DdsLevel {
+  int width, height;
+  size_t offset, size;  // desde el principio del fichero
+};
+
+struct DdsImage {
+  BcFormat format;
+  int width, height;
+  std::vector<DdsLevel> levels;
+};
+
+// Valida la cabecera y que todos los niveles caben en el fichero
+bool dds_parse(const unsigned char *data, size_t size, DdsImage *image);
+
+// levels[i] contiene los bloques del nivel i (ancho y alto >> i, minimo 1)
+bool dds_write(const char *path, BcFormat format, int width, int height,
+               const std::vector<std::vector<unsigned char> > &levels);
+
+#endif
@@ -0,0 +1,7 @@
+// Bloque por frame de los dos shaders, ver FrameUniforms en uniforms.h
+layout(std140) uniform FrameData {
+  mat4 view;
+  mat4 projection;
+  vec3 view_pos;
+  vec4 cluster_params;  // ver ClusteredLights::shader_params()
+};
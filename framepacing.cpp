@@ -0,0 +1,185 @@
+// framepacing.cpp: ritmo de frames y latencia de la entrada (ver framepacing.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "framepacing.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <thread>
+
+// Lo que se hace en espera activa al final de la espera
+static const std::chrono::microseconds SPIN(1500);
+// Holgura sobre el trabajo estimado del frame
+static const std::chrono::microseconds MARGIN(1000);
+// Frames con los que se estima el trabajo (el maximo)
+static const size_t WORK_FRAMES = 32;
+
+static const char *mode_names[] = { "off", "vsync", "adaptive", "fixed" };
+
+bool parse_pacing_mode(const char *name, PacingMode *mode) {
+  for (int i = 0; i < 4; i++) {
+    if (strcmp(name, mode_names[i]) == 0) {
+      *mode = (PacingMode) i;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *pacing_mode_name(PacingMode mode) {
+  return mode_names[mode];
+}
+
+// Tiempo de CPU de todo el proceso (todos los hilos), usuario y sistema
+static double process_cpu_s() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1.0e6;
+}
+
+static double ms(FrameScheduler::Clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+FrameScheduler::FrameScheduler(PacingMode mode, double fps) : pacing(mode), period(Clock::duration::zero()) {
+  if (mode != PACING_OFF && fps > 0.0)
+    period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+}
+
+int FrameScheduler::swap_interval() const {
+  return pacing == PACING_VSYNC ? 1 : pacing == PACING_ADAPTIVE ? -1 : 0;
+}
+
+FrameScheduler::Clock::duration FrameScheduler::work_estimate() const {
+  Clock::duration work = Clock::duration::zero();
+  for (Clock::duration d : recent_work)
+    work = std::max(work, d);
+  return work;
+}
+
+void FrameScheduler::begin_frame() {
+  Clock::time_point now = Clock::now();
+  if (!started) {
+    started = true;
+    start = last_present = deadline = now;
+    start_cpu_s = process_cpu_s();
+  } else if (period > Clock::duration::zero()) {
+    // fixed: el plazo de este frame; vsync: el siguiente vblank, un periodo
+    // despues de presentar el anterior
+    Clock::time_point present;
+    if (pacing == PACING_FIXED) {
+      deadline += period;
+      present = deadline;
+    } else {
+      present = last_present + period;
+    }
+    Clock::time_point wake = present - work_estimate() - MARGIN;
+    if (wake > now) {
+      if (wake - SPIN > now)
+        std::this_thread::sleep_until(wake - SPIN);
+      Clock::time_point spin_start = Clock::now();
+      sleep_ms += ms(spin_start - now);
+      while (Clock::now() < wake)
+        std::this_thread::yield();
+      spin_ms += ms(Clock::now() - spin_start);
+    }
+  }
+  frame_begin = Clock::now();
+}
+
+void FrameScheduler::input_event() {
+  pending_input.push_back(Clock::now());
+}
+
+void FrameScheduler::consume_input() {
+  frame_input.insert(frame_input.end(), pending_input.begin(), pending_input.end());
+  pending_input.clear();
+}
+
+void FrameScheduler::publish_input() {
+  std::lock_guard<std::mutex> lock(published_mutex);
+  published_input.insert(published_input.end(), pending_input.begin(), pending_input.end());
+  pending_input.clear();
+}
+
+void FrameScheduler::take_input(std::vector<Clock::time_point> &events) {
+  std::lock_guard<std::mutex> lock(published_mutex);
+  events.swap(published_input);
+  published_input.clear();
+}
+
+void FrameScheduler::consume_input(const std::vector<Clock::time_point> &events) {
+  frame_input.insert(frame_input.end(), events.begin(), events.end());
+}
+
+void FrameScheduler::presenting() {
+  Clock::duration work = Clock::now() - frame_begin;
+  if (recent_work.size() < WORK_FRAMES)
+    recent_work.push_back(work);
+  else
+    recent_work[recent_next] = work;
+  recent_next = (recent_next + 1) % WORK_FRAMES;
+}
+
+void FrameScheduler::presented() {
+  Clock::time_point now = Clock::now();
+  if (frames > 0)
+    intervals_ms.push_back(ms(now - last_present));
+  for (Clock::time_point t : frame_input)
+    latencies_ms.push_back(ms(now - t));
+  frame_input.clear();
+
+  // Tarde: fixed, pasado el plazo (se toma como nuevo plazo, sin intentar
+  // recuperar frames); vsync, se ha saltado un vblank. El primer frame solo
+  // fija el primer plazo
+  if (pacing == PACING_FIXED && (frames == 0 || now > deadline + MARGIN)) {
+    late_frames += frames > 0;
+    deadline = now;
+  } else if (frames > 0 && period > Clock::duration::zero() && pacing != PACING_FIXED &&
+             now - last_present > period + period / 2) {
+    late_frames++;
+  }
+  last_present = now;
+  frames++;
+}
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty())
+    return 0.0;
+  std::sort(values.begin(), values.end());
+  size_t idx = (size_t) (p * (values.size() - 1) + 0.5);
+  return values[idx];
+}
+
+static void print_summary(const char *name, const std::vector<double> &values) {
+  double sum = 0.0;
+  for (double v : values)
+    sum += v;
+  printf("%s ms: mean %.3f  median %.3f  p95 %.3f  p99 %.3f\n", name,
+         values.empty() ? 0.0 : sum / values.size(),
+         percentile(values, 0.50), percentile(values, 0.95), percentile(values, 0.99));
+}
+
+void FrameScheduler::print_stats() const {
+  if (frames == 0)
+    return;
+  printf("Pacing: %s", pacing_mode_name(pacing));
+  if (period > Clock::duration::zero())
+    printf(" %.1f Hz", 1.0 / std::chrono::duration<double>(period).count());
+  printf(", %d frames, %d late\n", frames, late_frames);
+  print_summary("Frame interval", intervals_ms);
+  if (latencies_ms.empty()) {
+    printf("Input to present: no input events\n");
+  } else {
+    printf("Input events: %zu\n", latencies_ms.size());
+    print_summary("Input to present", latencies_ms);
+  }
+
+  double wall_s = std::chrono::duration<double>(last_present - start).count();
+  double cpu_s = process_cpu_s() - start_cpu_s;
+  printf("CPU: %.1f%% of one core over %.1f s (sleep %.2f ms/frame, spin %.2f ms/frame)\n",
+         wall_s > 0.0 ? 100.0 * cpu_s / wall_s : 0.0, wall_s, sleep_ms / frames, spin_ms / frames);
+}
@@ -0,0 +1,100 @@
+// framepacing.h: ritmo de frames, limitador y latencia de la entrada
+//
+// Modos (--pacing):
+//   off       sin esperas ni glfwSwapInterval (como hasta ahora)
+//   vsync     glfwSwapInterval(1)
+//   adaptive  glfwSwapInterval(-1) (vsync, pero si el frame llega tarde se
+//             presenta sin esperar al siguiente vblank); si no hay
+//             *_EXT_swap_control_tear, vsync
+//   fixed     --fps N sin vsync: cada frame se presenta en su plazo
+//
+// En vsync y adaptive, si se conoce el refresco de la pantalla, y en fixed,
+// begin_frame() no empieza el frame en cuanto puede sino lo mas tarde que
+// permite el trabajo de los ultimos frames (mas un margen): duerme hasta
+// poco antes y los ultimos SPIN_MS los hace en espera activa, porque el
+// sleep del sistema no es tan preciso. Despues se recogen los eventos
+// (glfwPollEvents), con lo que la entrada es lo mas reciente posible al
+// presentar.
+//
+// Cada evento de entrada se marca al llegar (callback de GLFW), se asigna
+// al frame que lo consume en processInput / updateCameraPosition y cuenta
+// como presentado cuando vuelve el glfwSwapBuffers de ese frame.
+//
+// Con el hilo de simulacion el frame que se presenta no es el que ha leido
+// la entrada sino el del paquete que se simula despues: el hilo GL publica
+// los eventos ya aplicados (publish_input()), el de simulacion se los lleva
+// a su paquete (take_input()) y el render los asigna al frame que dibuja ese
+// paquete (consume_input(events)).
+//////////////////////////////////////////////////////////////////////
+
+#ifndef FRAMEPACING_H
+#define FRAMEPACING_H
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+enum PacingMode {
+  PACING_OFF,
+  PACING_VSYNC,
+  PACING_ADAPTIVE,
+  PACING_FIXED
+};
+
+bool parse_pacing_mode(const char *name, PacingMode *mode);
+const char *pacing_mode_name(PacingMode mode);
+
+class FrameScheduler {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  // fps: en fixed el ritmo objetivo; en vsync y adaptive el refresco de la
+  // pantalla (0 si no se conoce: no se espera antes del frame)
+  FrameScheduler(PacingMode mode, double fps);
+
+  PacingMode mode() const { return pacing; }
+  // Para glfwSwapInterval(): 0, 1 o -1 (off: no se llama)
+  int swap_interval() const;
+
+  // Espera hasta el momento de empezar el frame (antes de glfwPollEvents)
+  void begin_frame();
+  // Llega un evento de entrada
+  void input_event();
+  // El frame aplica los eventos recibidos hasta ahora
+  void consume_input();
+  // Con el hilo de simulacion: los eventos recibidos ya estan aplicados (hilo
+  // GL), se los lleva el paquete que se simula (hilo de simulacion) y los
+  // presenta el frame que dibuja ese paquete (hilo GL)
+  void publish_input();
+  void take_input(std::vector<Clock::time_point> &events);
+  void consume_input(const std::vector<Clock::time_point> &events);
+  // Justo antes y justo despues de glfwSwapBuffers (sin ventana, del
+  // glFinish)
+  void presenting();
+  void presented();
+
+  // Ritmo de los frames, latencia de la entrada y uso de CPU
+  void print_stats() const;
+
+private:
+  Clock::duration work_estimate() const;
+
+  PacingMode pacing;
+  Clock::duration period;  // 0: sin esperas
+
+  Clock::time_point start, frame_begin, last_present, deadline;
+  double start_cpu_s = 0.0;
+  bool started = false;
+  std::vector<Clock::duration> recent_work;  // de begin_frame a presenting
+  size_t recent_next = 0;
+
+  std::vector<Clock::time_point> pending_input, frame_input;
+  std::mutex published_mutex;
+  std::vector<Clock::time_point> published_input;  // con published_mutex
+
+  std::vector<double> intervals_ms, latencies_ms;
+  int frames = 0, late_frames = 0;
+  double sleep_ms = 0.0, spin_ms = 0.0;
+};
+
+#endif
@@ -0,0 +1,7 @@
+// glcalls.cpp: contador de llamadas GL (ver glcalls.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "glcalls.h"
+
+unsigned long gl_calls = 0;
+unsigned long gl_calls_elided = 0;
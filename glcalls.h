@@ -0,0 +1,18 @@
+// glcalls.h: contador de llamadas GL
+//
+// GL_COUNT(glFoo(...)) hace la llamada y suma uno a gl_calls; devuelve lo
+// mismo que la llamada. Se usa en el camino de render de cada frame para
+// ver cuantas llamadas cuesta (headless_run lo guarda por frame).
+// gl_calls_elided cuenta las que el cache de estado (glstate.h) no ha hecho
+// porque no cambiaban nada.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef GLCALLS_H
+#define GLCALLS_H
+
+extern unsigned long gl_calls;
+extern unsigned long gl_calls_elided;
+
+#define GL_COUNT(call) (gl_calls++, (call))
+
+#endif
@@ -0,0 +1,104 @@
+// glstate.cpp: cache del estado GL (ver glstate.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "glstate.h"
+
+#include <string.h>
+
+#include "glcalls.h"
+
+GlStateCache gl_state;
+
+void GlStateCache::use_program(GLuint p) {
+  if (enabled && p == program) {
+    gl_calls_elided++;
+    return;
+  }
+  GL_COUNT(glUseProgram(p));
+  program = p;
+  program_uniforms = &uniforms[p];
+}
+
+void GlStateCache::bind_vertex_array(GLuint v) {
+  if (enabled && v == vao) {
+    gl_calls_elided++;
+    return;
+  }
+  GL_COUNT(glBindVertexArray(v));
+  vao = v;
+}
+
+void GlStateCache::bind_texture(int unit, GLenum target, GLuint texture) {
+  bool tracked = unit >= 0 && unit < MAX_UNITS;
+  if (enabled && tracked && unit_target[unit] == target && unit_texture[unit] == texture) {
+    gl_calls_elided += 2;  // ni glActiveTexture ni glBindTexture
+    return;
+  }
+  if (enabled && unit == active_unit) {
+    gl_calls_elided++;
+  } else {
+    GL_COUNT(glActiveTexture(GL_TEXTURE0 + unit));
+    active_unit = unit;
+  }
+  GL_COUNT(glBindTexture(target, texture));
+  if (tracked) {
+    unit_target[unit] = target;
+    unit_texture[unit] = texture;
+  }
+}
+
+bool GlStateCache::same_uniform(GLint location, const float *values, int floats) {
+  if (enabled && program == UNKNOWN) {
+    // Va al programa que este enlazado, sea cual sea: ningun valor guardado
+    // es ya seguro
+    uniforms.clear();
+    return false;
+  }
+  if (!enabled || location < 0 || floats > MAX_UNIFORM_FLOATS)
+    return false;
+  std::vector<UniformValue> &values_of = *program_uniforms;
+  if ((size_t) location >= values_of.size())
+    values_of.resize(location + 1);
+  UniformValue &cached = values_of[location];
+  if (cached.floats == floats && memcmp(cached.values, values, floats * sizeof(float)) == 0)
+    return true;
+  cached.floats = floats;
+  memcpy(cached.values, values, floats * sizeof(float));
+  return false;
+}
+
+void GlStateCache::uniform_4fv(GLint location, int count, const float *values) {
+  if (same_uniform(location, values, 4 * count)) {
+    gl_calls_elided++;
+    return;
+  }
+  GL_COUNT(glUniform4fv(location, count, values));
+}
+
+void GlStateCache::uniform_matrix_4fv(GLint location, const float *values) {
+  if (same_uniform(location, values, 16)) {
+    gl_calls_elided++;
+    return;
+  }
+  GL_COUNT(glUniformMatrix4fv(location, 1, GL_FALSE, values));
+}
+
+void GlStateCache::invalidate() {
+  program = vao = UNKNOWN;
+  program_uniforms = NULL;
+  invalidate_textures();
+}
+
+void GlStateCache::forget_program(GLuint p) {
+  uniforms.erase(p);
+  if (p == program)
+    program_uniforms = &uniforms[p];
+}
+
+void GlStateCache::invalidate_textures() {
+  active_unit = -1;
+  for (int i = 0; i < MAX_UNITS; i++) {
+    unit_target[i] = GL_NONE;
+    unit_texture[i] = UNKNOWN;
+  }
+}
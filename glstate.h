@@ -0,0 +1,81 @@
+// glstate.h: cache del estado GL para no repetir binds ni uniforms
+//
+// Guarda lo que hay enlazado (programa, VAO, unidad de textura activa y la
+// textura de cada unidad) y el ultimo valor de cada uniform de cada
+// programa, y solo llama a GL cuando algo cambia. Las llamadas que se hacen
+// suman en gl_calls (GL_COUNT) y las que se ahorran en gl_calls_elided.
+//
+// No hay sampler objects: el modo de muestreo va en cada textura, asi que
+// el estado de los samplers es la textura de cada unidad (y los uniforms
+// sampler, que se fijan una vez por programa).
+//
+// El codigo que toca ese estado sin pasar por aqui (los compute shaders del
+// culling y la Hi-Z, las texturas de los clusters, la subida de texturas,
+// la recarga en caliente...) tiene que llamar despues a invalidate() o a
+// invalidate_textures(): la siguiente llamada ira siempre a GL. Los valores
+// de los uniforms son del programa y no cambian al enlazar otro; solo hay
+// que olvidarlos (forget_program()) si se fijan sin el cache o si el
+// programa se borra. Un uniform con el programa desconocido (tras
+// invalidate() y antes de use_program()) va a GL y olvida los uniforms de
+// todos los programas, porque no se sabe a cual ha ido.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <GL/glew.h>
+
+#include <unordered_map>
+#include <vector>
+
+class GlStateCache {
+public:
+  GlStateCache() { invalidate(); }
+
+  // false: todas las llamadas van a GL (para comparar)
+  void set_enabled(bool on) { enabled = on; }
+
+  void use_program(GLuint program);
+  void bind_vertex_array(GLuint vao);
+  // glActiveTexture (si hace falta) y glBindTexture
+  void bind_texture(int unit, GLenum target, GLuint texture);
+  // Del programa en uso. Los valores se comparan bit a bit; mas de
+  // MAX_UNIFORM_FLOATS floats no se guardan y van siempre a GL. Con el
+  // programa desconocido se olvidan todos los guardados
+  void uniform_4fv(GLint location, int count, const float *values);
+  void uniform_matrix_4fv(GLint location, const float *values);
+
+  // Programa, VAO y texturas enlazados desconocidos
+  void invalidate();
+  // Solo la unidad activa y las texturas enlazadas
+  void invalidate_textures();
+  // Uniforms guardados del programa desconocidos
+  void forget_program(GLuint program);
+
+private:
+  static const GLuint UNKNOWN = ~0u;
+  static const int MAX_UNITS = 16;
+  static const int MAX_UNIFORM_FLOATS = 16;
+
+  struct UniformValue {
+    int floats = 0;  // 0: desconocido
+    float values[MAX_UNIFORM_FLOATS];
+  };
+
+  // true si el valor es el guardado (y si no, lo guarda)
+  bool same_uniform(GLint location, const float *values, int floats);
+
+  bool enabled = true;
+  GLuint program, vao;
+  int active_unit;
+  GLenum unit_target[MAX_UNITS];
+  GLuint unit_texture[MAX_UNITS];
+  // Uniforms de cada programa por location
+  std::unordered_map<GLuint, std::vector<UniformValue>> uniforms;
+  std::vector<UniformValue> *program_uniforms;
+};
+
+// El del contexto del render (el hilo GL)
+extern GlStateCache gl_state;
+
+#endif
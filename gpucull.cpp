@@ -0,0 +1,187 @@
+// gpucull.cpp: culling y draws indirectos en la GPU (ver gpucull.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "gpucull.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "culling.h"
+#include "glcalls.h"
+#include "hiz.h"
+#include "instancing.h"
+#include "transforms.h"
+
+static const GLuint LOCAL_SIZE = 64;  // local_size_x de cull_cs.glsl
+
+// Igual que DrawElementsIndirectCommand del shader
+struct DrawCommand {
+  GLuint count, instance_count, first_index;
+  GLint base_vertex;
+  GLuint base_instance;
+};
+
+// Las extensiones por separado no bastan: cull_cs.glsl es #version 430 y
+// glClearBufferSubData es de 4.3 (o ARB_clear_buffer_object)
+bool GpuCulling::supported() {
+  return GLEW_VERSION_4_3;
+}
+
+GpuCulling::GpuCulling(GLuint program, const std::vector<GpuMesh> &meshes)
+    : program(program), meshes(meshes) {
+  const char *fallback = getenv("GPU_CULL_FALLBACK");
+  use_count = GLEW_ARB_indirect_parameters && !(fallback && strcmp(fallback, "1") == 0);
+
+  planes_location = glGetUniformLocation(program, "planes");
+  spin_location = glGetUniformLocation(program, "spin");
+  meshes_location = glGetUniformLocation(program, "meshes");
+  count_location = glGetUniformLocation(program, "object_count");
+  pass_location = glGetUniformLocation(program, "cull_pass");
+  view_proj_location = glGetUniformLocation(program, "view_proj");
+  hiz_location = glGetUniformLocation(program, "hiz");
+  hiz_levels_location = glGetUniformLocation(program, "hiz_levels");
+  viewport_location = glGetUniformLocation(program, "viewport");
+
+  glGenBuffers(BUFFER_COUNT, buffers);
+}
+
+GpuCulling::~GpuCulling() {
+  glDeleteBuffers(BUFFER_COUNT, buffers);
+  glDeleteProgram(program);
+}
+
+void GpuCulling::add(glm::vec3 position, float phase, int mesh) {
+  // Gire como gire, la caja de la esfera lo contiene
+  Object object;
+  object.center = glm::vec4(position, 1.0f);
+  object.extent = glm::vec4(glm::vec3(meshes[mesh].radius), 0.0f);
+  object.phase = spin_cos_sin(phase);
+  object.scale = glm::vec4(1.0f);
+  object.mesh[0] = (GLuint) mesh;
+  object.mesh[1] = object.mesh[2] = object.mesh[3] = 0;
+  objects.push_back(object);
+}
+
+void GpuCulling::add_static(glm::vec3 position, glm::vec3 scale, int mesh) {
+  Object object;
+  object.center = glm::vec4(position, 0.0f);
+  object.extent = glm::vec4(meshes[mesh].extent * scale, 0.0f);
+  object.phase = glm::vec4(1.0f, 0.0f, 1.0f, 0.0f);
+  object.scale = glm::vec4(scale, 1.0f);
+  object.mesh[0] = (GLuint) mesh;
+  object.mesh[1] = object.mesh[2] = object.mesh[3] = 0;
+  objects.push_back(object);
+}
+
+void GpuCulling::upload() {
+  size_t count = objects.size() > 0 ? objects.size() : 1;
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[OBJECTS]);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(Object), objects.data(), GL_STATIC_DRAW);
+  // Como mucho un draw y una instancia por objeto en cada region
+  const GLuint zero = 0;
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[COMMANDS]);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * count * sizeof(DrawCommand), NULL, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[INSTANCES]);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * count * sizeof(InstanceAttribs), NULL, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[DRAW_COUNT]);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+  glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+  // Al empezar no se ha visto nada: la primera fase no dibuja nada
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[VISIBILITY]);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+  glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  // Las mallas no cambian: sus uniforms se asignan una vez
+  GLuint ranges[4 * GPU_CULL_MAX_MESHES] = {};
+  for (size_t m = 0; m < meshes.size() && m < (size_t) GPU_CULL_MAX_MESHES; m++) {
+    ranges[4 * m] = meshes[m].first_index;
+    ranges[4 * m + 1] = (GLuint) meshes[m].count;
+    ranges[4 * m + 2] = (GLuint) meshes[m].base_vertex;
+  }
+  glUseProgram(program);
+  glUniform4uiv(meshes_location, GPU_CULL_MAX_MESHES, ranges);
+  glUniform1ui(count_location, (GLuint) objects.size());
+  glUniform1i(hiz_location, HIZ_TEXTURE_UNIT);
+
+  printf("GPU culling: %zu objects, %s\n", objects.size(),
+         use_count ? "glMultiDrawElementsIndirectCount" : "glMultiDrawElementsIndirect (fallback)");
+}
+
+void GpuCulling::cull(const glm::mat4 &view_proj, double time, Pass pass, const HiZBuffer *hiz) {
+  Frustum frustum = frustum_from_matrix(view_proj);
+  glm::vec4 spin = spin_cos_sin(time);
+  const GLuint zero = 0;
+  GLintptr r = region(pass);
+  GLsizeiptr commands_size = (GLsizeiptr) objects.size() * sizeof(DrawCommand);
+
+  // Contador de la fase a cero y, sin el contador en los draws, tambien sus
+  // comandos
+  GL_COUNT(glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[DRAW_COUNT]));
+  GL_COUNT(glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, r * sizeof(GLuint), sizeof(GLuint),
+                                GL_RED_INTEGER, GL_UNSIGNED_INT, &zero));
+  if (!use_count && commands_size > 0) {
+    GL_COUNT(glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[COMMANDS]));
+    GL_COUNT(glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, r * commands_size, commands_size,
+                                  GL_RED_INTEGER, GL_UNSIGNED_INT, &zero));
+  }
+  GL_COUNT(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+
+  GL_COUNT(glUseProgram(program));
+  GL_COUNT(glUniform4fv(planes_location, 6, &frustum.planes[0][0]));
+  GL_COUNT(glUniform4fv(spin_location, 1, &spin[0]));
+  GL_COUNT(glUniform1ui(pass_location, (GLuint) pass));
+  if (pass == OCCLUSION) {
+    GL_COUNT(glUniformMatrix4fv(view_proj_location, 1, GL_FALSE, &view_proj[0][0]));
+    GL_COUNT(glUniform1i(hiz_levels_location, hiz->levels()));
+    GL_COUNT(glUniform2i(viewport_location, hiz->width(), hiz->height()));
+    GL_COUNT(glActiveTexture(GL_TEXTURE0 + HIZ_TEXTURE_UNIT));
+    GL_COUNT(glBindTexture(GL_TEXTURE_2D, hiz->pyramid()));
+    GL_COUNT(glActiveTexture(GL_TEXTURE0));
+    two_pass = true;
+  }
+  for (int b = 0; b < BUFFER_COUNT; b++)
+    GL_COUNT(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, b, buffers[b]));
+
+  GLuint groups = ((GLuint) objects.size() + LOCAL_SIZE - 1) / LOCAL_SIZE;
+  if (groups > 0)
+    GL_COUNT(glDispatchCompute(groups, 1, 1));
+
+  // Los draws leen comandos, contador e instancias escritos por el shader, y
+  // la fase siguiente la visibilidad
+  GL_COUNT(glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+                           GL_SHADER_STORAGE_BARRIER_BIT));
+}
+
+void GpuCulling::draw(Pass pass) {
+  GLintptr r = region(pass);
+  const void *commands = (const void *) (r * objects.size() * sizeof(DrawCommand));
+
+  GL_COUNT(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers[COMMANDS]));
+  if (use_count) {
+    GL_COUNT(glBindBuffer(GL_PARAMETER_BUFFER_ARB, buffers[DRAW_COUNT]));
+    GL_COUNT(glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, commands, r * sizeof(GLuint),
+                                                 (GLsizei) objects.size(), 0));
+    GL_COUNT(glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0));
+  } else {
+    GL_COUNT(glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commands, (GLsizei) objects.size(), 0));
+  }
+  GL_COUNT(glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0));
+}
+
+void GpuCulling::print_stats() const {
+  // Leer el contador espera a la GPU: solo al final, nunca por frame
+  GLuint drawn[2] = {};
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[DRAW_COUNT]);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(drawn), drawn);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  if (two_pass) {
+    printf("GPU culling: %u drawn in phase 1 + %u in phase 2, %u culled of %zu objects in the last frame\n",
+           drawn[0], drawn[1], (GLuint) objects.size() - drawn[0] - drawn[1], objects.size());
+  } else {
+    printf("GPU culling: %u visible, %u culled of %zu objects in the last frame\n", drawn[0],
+           (GLuint) objects.size() - drawn[0], objects.size());
+  }
+}
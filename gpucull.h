@@ -0,0 +1,116 @@
+// gpucull.h: frustum culling y envio de draws desde la GPU
+//
+// Los objetos (caja que los contiene y desfase de giro, como en
+// TransformSystem) se suben una vez a un SSBO. En cada frame un compute
+// shader (cull_cs.glsl), un hilo por objeto, prueba la caja contra los 6
+// planos del frustum y, si es visible, reserva un hueco con atomicAdd sobre
+// el contador de draws y escribe ahi su DrawElementsIndirectCommand (los
+// indices de su malla, una instancia, baseInstance = hueco) y sus matrices en
+// el buffer de instancias. Todo se dibuja con un
+// glMultiDrawElementsIndirectCountARB que lee el numero de draws del propio
+// contador.
+//
+// Sin ARB_indirect_parameters (o con GPU_CULL_FALLBACK=1) los comandos se
+// ponen a cero cada frame y glMultiDrawElementsIndirect los recorre todos:
+// los que no se escriben no dibujan nada.
+//
+// Con una piramide Hi-Z (hiz.h) el culling se hace en dos fases para que
+// no aparezcan objetos de golpe: PREVIOUSLY_VISIBLE dibuja lo que se vio en
+// el frame anterior (que no haya salido del frustum); con esa profundidad se
+// construye la Hi-Z y OCCLUSION prueba contra ella todo lo que esta en el
+// frustum, dibuja lo que es visible y no estaba ya dibujado y guarda la
+// visibilidad de cada objeto para el frame siguiente. Lo que queda tapado no
+// llega a los draws, ni siquiera al vertex shader.
+//
+// La CPU solo sube los planos y el giro del frame, asi que su coste por
+// frame no depende del numero de objetos. Necesita GL 4.3.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef GPUCULL_H
+#define GPUCULL_H
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class HiZBuffer;
+
+// Rango de indices de una malla en el element array buffer comun (count
+// desde first_index, sumando base_vertex a cada uno), radio de la esfera que
+// la contiene y semilados de su caja (las dos centradas en el origen)
+struct GpuMesh {
+  GLuint first_index;
+  GLsizei count;
+  GLint base_vertex;
+  float radius;
+  glm::vec3 extent;
+};
+
+// Tiene que coincidir con MAX_MESHES al compilar cull_cs.glsl
+const int GPU_CULL_MAX_MESHES = 4;
+
+class GpuCulling {
+public:
+  // program: cull_cs.glsl ya enlazado
+  GpuCulling(GLuint program, const std::vector<GpuMesh> &meshes);
+  ~GpuCulling();
+
+  // FRUSTUM: un solo cull() por frame. Con Hi-Z, PREVIOUSLY_VISIBLE y
+  // despues OCCLUSION
+  enum Pass { FRUSTUM, PREVIOUSLY_VISIBLE, OCCLUSION };
+
+  // GL 4.3 (compute shaders, SSBOs, multi draw indirect, GLSL 4.30 y
+  // glClearBufferSubData)
+  static bool supported();
+
+  // Objeto de la malla mesh en position, girando con phase segundos de
+  // adelanto. Despues del ultimo, upload()
+  void add(glm::vec3 position, float phase, int mesh);
+  // Objeto quieto de la malla mesh escalada por scale
+  void add_static(glm::vec3 position, glm::vec3 scale, int mesh);
+  void upload();
+
+  // Buffer de matrices para instance_attrib_pointers() (los draws usan
+  // baseInstance para elegir la suya)
+  GLuint instance_buffer() const { return buffers[INSTANCES]; }
+
+  // Culling en el instante time (antes de dibujar); OCCLUSION necesita la
+  // piramide ya construida
+  void cull(const glm::mat4 &view_proj, double time, Pass pass = FRUSTUM,
+            const HiZBuffer *hiz = NULL);
+  // Draws del cull() de esa fase, con el VAO de los buffers comunes enlazado
+  // (indices GL_UNSIGNED_INT)
+  void draw(Pass pass = FRUSTUM);
+
+  bool draw_count_supported() const { return use_count; }
+  void print_stats() const;
+
+private:
+  enum { OBJECTS, COMMANDS, INSTANCES, DRAW_COUNT, VISIBILITY, BUFFER_COUNT };
+
+  struct Object {
+    glm::vec4 center;  // w: 1 si gira
+    glm::vec4 extent;
+    glm::vec4 phase;
+    glm::vec4 scale;
+    GLuint mesh[4];
+  };
+
+  // Comandos, instancias y contador de cada fase: OCCLUSION escribe detras
+  // de lo que lee el draw de PREVIOUSLY_VISIBLE
+  static int region(Pass pass) { return pass == OCCLUSION ? 1 : 0; }
+
+  GLuint program;
+  std::vector<GpuMesh> meshes;
+  std::vector<Object> objects;
+  GLuint buffers[BUFFER_COUNT] = {};
+  bool use_count;
+  bool two_pass = false;
+
+  GLint planes_location, spin_location, meshes_location, count_location;
+  GLint pass_location, view_proj_location, hiz_location, hiz_levels_location, viewport_location;
+};
+
+#endif
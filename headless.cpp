@@ -0,0 +1,331 @@
+// headless.cpp: contexto GL sin ventana con EGL y bucle de benchmark
+//
+// Se intenta primero la plataforma surfaceless de Mesa (no necesita X ni
+// DRM, funciona con llvmpipe) y si no existe el display EGL por defecto con
+// un pbuffer minimo. En ambos casos se renderiza sobre un FBO propio.
+//////////////////////////////////////////////////////////////////////
+
+#include "headless.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "glcalls.h"
+#include "profiler.h"
+
+static EGLDisplay egl_display = EGL_NO_DISPLAY;
+static EGLContext egl_context = EGL_NO_CONTEXT;
+static EGLSurface egl_surface = EGL_NO_SURFACE;
+static EGLConfig egl_config = NULL;
+
+static GLuint fbo = 0;
+static GLuint color_rb = 0;
+static GLuint depth_rb = 0;
+
+static EGLDisplay open_display() {
+  PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+    (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+  if (get_platform_display) {
+    EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+      return display;
+  }
+
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+    return display;
+
+  return EGL_NO_DISPLAY;
+}
+
+bool headless_init(int width, int height) {
+  egl_display = open_display();
+  if (egl_display == EGL_NO_DISPLAY) {
+    fprintf(stderr, "ERROR: could not open EGL display\n");
+    return false;
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    fprintf(stderr, "ERROR: EGL display does not support desktop OpenGL\n");
+    return false;
+  }
+
+  const EGLint config_attribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_NONE
+  };
+  EGLConfig config = NULL;
+  EGLint num_configs = 0;
+  eglChooseConfig(egl_display, config_attribs, &config, 1, &num_configs);
+  egl_config = num_configs > 0 ? config : NULL;
+
+  // Mismo contexto que crearia GLFW por defecto (perfil de compatibilidad)
+  egl_context = eglCreateContext(egl_display, num_configs > 0 ? config : EGL_NO_CONFIG_KHR,
+                                 EGL_NO_CONTEXT, NULL);
+  if (egl_context == EGL_NO_CONTEXT) {
+    fprintf(stderr, "ERROR: could not create EGL context (0x%x)\n", eglGetError());
+    return false;
+  }
+
+  // Sin surfaceless hace falta alguna superficie para hacer current el contexto
+  if (num_configs > 0) {
+    const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    egl_surface = eglCreatePbufferSurface(egl_display, config, pbuffer_attribs);
+  }
+
+  if (!eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context)) {
+    fprintf(stderr, "ERROR: could not make EGL context current (0x%x)\n", eglGetError());
+    return false;
+  }
+
+  // glewInit() se llama despues, igual que con GLFW. Para crear el FBO
+  // necesitamos ya los punteros, asi que inicializamos GLEW aqui.
+  glewExperimental = GL_TRUE;
+  glewInit();
+
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+  glGenRenderbuffers(1, &color_rb);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_rb);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rb);
+
+  glGenRenderbuffers(1, &depth_rb);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_rb);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_rb);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "ERROR: headless framebuffer is incomplete\n");
+    return false;
+  }
+
+  return true;
+}
+
+void headless_terminate() {
+  if (fbo) {
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &color_rb);
+    glDeleteRenderbuffers(1, &depth_rb);
+    fbo = color_rb = depth_rb = 0;
+  }
+
+  if (egl_display != EGL_NO_DISPLAY) {
+    eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (egl_surface != EGL_NO_SURFACE)
+      eglDestroySurface(egl_display, egl_surface);
+    if (egl_context != EGL_NO_CONTEXT)
+      eglDestroyContext(egl_display, egl_context);
+    eglTerminate(egl_display);
+  }
+  egl_display = EGL_NO_DISPLAY;
+  egl_context = EGL_NO_CONTEXT;
+  egl_surface = EGL_NO_SURFACE;
+}
+
+struct HeadlessContext {
+  EGLContext context;
+  EGLSurface surface;
+};
+
+HeadlessContext *headless_shared_context() {
+  EGLContext context = eglCreateContext(egl_display, egl_config ? egl_config : EGL_NO_CONFIG_KHR,
+                                        egl_context, NULL);
+  if (context == EGL_NO_CONTEXT) {
+    fprintf(stderr, "ERROR: could not create shared EGL context (0x%x)\n", eglGetError());
+    return NULL;
+  }
+  HeadlessContext *shared = new HeadlessContext;
+  shared->context = context;
+  shared->surface = EGL_NO_SURFACE;
+  // Igual que el principal: un pbuffer propio si no hay surfaceless
+  if (egl_surface != EGL_NO_SURFACE) {
+    const EGLint pbuffer_attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    shared->surface = eglCreatePbufferSurface(egl_display, egl_config, pbuffer_attribs);
+  }
+  return shared;
+}
+
+bool headless_make_current(HeadlessContext *context) {
+  if (context == NULL)
+    return eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  return eglMakeCurrent(egl_display, context->surface, context->surface, context->context);
+}
+
+void headless_destroy_context(HeadlessContext *context) {
+  if (context == NULL)
+    return;
+  if (context->surface != EGL_NO_SURFACE)
+    eglDestroySurface(egl_display, context->surface);
+  eglDestroyContext(egl_display, context->context);
+  delete context;
+}
+
+std::vector<FrameTiming> headless_run(int frames, double dt, void (*render_fn)(double), bool use_gl,
+                                      FrameScheduler *pacing) {
+  std::vector<FrameTiming> timings(frames);
+  std::vector<GLuint> queries(2 * frames);
+  if (use_gl)
+    glGenQueries(2 * frames, queries.data());
+  // Vertices que pasan por el vertex shader: lo que ahorran los indices y
+  // la cache de vertices
+  bool count_vs = use_gl && GLEW_ARB_pipeline_statistics_query;
+  std::vector<GLuint> vs_queries(count_vs ? frames : 0);
+  if (count_vs)
+    glGenQueries(frames, vs_queries.data());
+
+  for (int i = 0; i < frames; i++) {
+    double current_time = i * dt;
+    if (pacing)
+      pacing->begin_frame();
+
+    if (use_gl)
+      glQueryCounter(queries[2 * i], GL_TIMESTAMP);
+    if (count_vs)
+      glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB, vs_queries[i]);
+    unsigned long calls = gl_calls, elided = gl_calls_elided;
+    auto start = std::chrono::steady_clock::now();
+    auto submitted = start, end = start;
+    {
+      PROFILE_SCOPE("frame");
+      {
+        PROFILE_SCOPE("render");
+        PROFILE_GPU_SCOPE("render");
+        render_fn(current_time);
+      }
+      submitted = std::chrono::steady_clock::now();
+      timings[i].gl_calls = gl_calls - calls;
+      timings[i].gl_calls_elided = gl_calls_elided - elided;
+
+      // Sin swap no hay nada que marque el final del frame: esperamos a que
+      // termine para que el tiempo total sea comparable entre ejecuciones
+      if (count_vs)
+        glEndQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB);
+      if (use_gl) {
+        PROFILE_SCOPE("glFinish");
+        glQueryCounter(queries[2 * i + 1], GL_TIMESTAMP);
+        glFinish();
+      }
+      end = std::chrono::steady_clock::now();
+    }
+    if (pacing) {
+      pacing->presenting();
+      pacing->presented();
+    }
+    profiler_end_frame();
+
+    timings[i].frame = i;
+    timings[i].sim_time = current_time;
+    timings[i].cpu_ms = std::chrono::duration<double, std::milli>(submitted - start).count();
+    timings[i].frame_ms = std::chrono::duration<double, std::milli>(end - start).count();
+  }
+
+  for (FrameTiming &t : timings) {
+    t.gl_ms = 0.0;
+    t.vs_invocations = 0;
+  }
+  if (!use_gl)
+    return timings;
+
+  for (int i = 0; i < frames; i++) {
+    GLuint64 t0 = 0, t1 = 0;
+    glGetQueryObjectui64v(queries[2 * i], GL_QUERY_RESULT, &t0);
+    glGetQueryObjectui64v(queries[2 * i + 1], GL_QUERY_RESULT, &t1);
+    timings[i].gl_ms = t1 > t0 ? (t1 - t0) / 1.0e6 : 0.0;
+  }
+  glDeleteQueries(2 * frames, queries.data());
+
+  if (count_vs) {
+    for (int i = 0; i < frames; i++) {
+      GLuint64 invocations = 0;
+      glGetQueryObjectui64v(vs_queries[i], GL_QUERY_RESULT, &invocations);
+      timings[i].vs_invocations = (unsigned long) invocations;
+    }
+    glDeleteQueries(frames, vs_queries.data());
+  }
+
+  return timings;
+}
+
+static double percentile(std::vector<double> values, double p) {
+  if (values.empty())
+    return 0.0;
+  std::sort(values.begin(), values.end());
+  size_t idx = (size_t) (p * (values.size() - 1) + 0.5);
+  return values[idx];
+}
+
+static void print_summary(const char *name, const std::vector<double> &values) {
+  double sum = 0.0;
+  for (double v : values)
+    sum += v;
+  printf("%s ms: mean %.3f  median %.3f  p95 %.3f  p99 %.3f\n", name,
+         values.empty() ? 0.0 : sum / values.size(),
+         percentile(values, 0.50), percentile(values, 0.95), percentile(values, 0.99));
+}
+
+bool write_frame_timings(const char *path, const std::vector<FrameTiming> &timings) {
+  std::vector<double> cpu, gl, total;
+  double calls = 0.0, elided = 0.0, invocations = 0.0;
+  for (const FrameTiming &t : timings) {
+    cpu.push_back(t.cpu_ms);
+    gl.push_back(t.gl_ms);
+    total.push_back(t.frame_ms);
+    calls += t.gl_calls;
+    elided += t.gl_calls_elided;
+    invocations += t.vs_invocations;
+  }
+  printf("Frames: %zu\n", timings.size());
+  print_summary("CPU  ", cpu);
+  print_summary("GL   ", gl);
+  print_summary("Frame", total);
+  printf("GL calls per frame: %.1f", timings.empty() ? 0.0 : calls / timings.size());
+  if (elided > 0.0)
+    printf(" (%.1f elided by the state cache)", elided / timings.size());
+  printf("\n");
+  if (invocations > 0.0)
+    printf("Vertex shader invocations per frame: %.0f\n", invocations / timings.size());
+
+  if (path == NULL)
+    return true;
+
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+    fprintf(stderr, "ERROR: could not open %s\n", path);
+    return false;
+  }
+
+  size_t len = strlen(path);
+  bool json = len > 5 && strcmp(path + len - 5, ".json") == 0;
+
+  if (json) {
+    fprintf(fp, "[\n");
+    for (size_t i = 0; i < timings.size(); i++) {
+      const FrameTiming &t = timings[i];
+      fprintf(fp, "  {\"frame\": %d, \"time\": %.6f, \"cpu_ms\": %.6f, \"gl_ms\": %.6f, \"frame_ms\": %.6f, "
+              "\"gl_calls\": %lu, \"gl_calls_elided\": %lu, \"vs_invocations\": %lu}%s\n",
+              t.frame, t.sim_time, t.cpu_ms, t.gl_ms, t.frame_ms, t.gl_calls, t.gl_calls_elided,
+              t.vs_invocations, i + 1 < timings.size() ? "," : "");
+    }
+    fprintf(fp, "]\n");
+  } else {
+    fprintf(fp, "frame,time,cpu_ms,gl_ms,frame_ms,gl_calls,gl_calls_elided,vs_invocations\n");
+    for (const FrameTiming &t : timings)
+      fprintf(fp, "%d,%.6f,%.6f,%.6f,%.6f,%lu,%lu,%lu\n", t.frame, t.sim_time, t.cpu_ms, t.gl_ms, t.frame_ms,
+              t.gl_calls, t.gl_calls_elided, t.vs_invocations);
+  }
+
+  fclose(fp);
+  return true;
+}
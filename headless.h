@@ -0,0 +1,54 @@
+// headless.h: render sin ventana (EGL surfaceless + FBO) y medida de tiempos
+// por frame para poder ejecutar el programa en nodos sin display ni GPU
+// (Mesa llvmpipe).
+//////////////////////////////////////////////////////////////////////
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include "framepacing.h"
+
+struct FrameTiming {
+  int frame;
+  double sim_time;  // currentTime simulado que recibe render()
+  double cpu_ms;    // tiempo de CPU dentro de render() (envio de comandos)
+  double gl_ms;     // tiempo de GPU entre dos GL_TIMESTAMP
+  double frame_ms;  // render() + glFinish(): frame completo
+  unsigned long gl_calls;  // llamadas GL_COUNT dentro de render()
+  unsigned long gl_calls_elided;  // las que se ha ahorrado el cache de estado
+  unsigned long vs_invocations;  // del vertex shader en el frame (0: sin
+                                 // ARB_pipeline_statistics_query)
+};
+
+// Crea un contexto GL sin ventana y un FBO de width x height como destino de
+// render. Devuelve false si no hay EGL disponible.
+bool headless_init(int width, int height);
+void headless_terminate();
+
+// Contexto que comparte objetos (programas, texturas, buffers) con el de
+// headless_init(), para un hilo de trabajo. Se crea en el hilo principal y
+// se hace current (o se suelta, con NULL) desde el hilo que lo use.
+struct HeadlessContext;
+HeadlessContext *headless_shared_context();
+bool headless_make_current(HeadlessContext *context);
+void headless_destroy_context(HeadlessContext *context);
+
+// Renderiza frames frames con un paso fijo dt (currentTime = i * dt) y
+// devuelve los tiempos de cada uno. Las queries de GPU se leen al final,
+// cuando ya estan todas disponibles. Con use_gl = false (backend por
+// software) no se toca GL y gl_ms y vs_invocations quedan a 0. Con pacing
+// cada frame espera su turno antes de empezar (fuera de los tiempos) y se
+// presenta al terminar el glFinish().
+std::vector<FrameTiming> headless_run(int frames, double dt, void (*render_fn)(double), bool use_gl,
+                                      FrameScheduler *pacing = NULL);
+
+// Escribe los tiempos en CSV o JSON (segun la extension de path) y un resumen
+// (media, mediana, p95, p99, llamadas GL hechas y ahorradas e invocaciones del
+// vertex shader por frame) por stdout.
+bool write_frame_timings(const char *path, const std::vector<FrameTiming> &timings);
+
+#endif
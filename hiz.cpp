@@ -0,0 +1,111 @@
+// hiz.cpp: piramide de profundidad para occlusion culling (ver hiz.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "hiz.h"
+
+#include <stdio.h>
+
+#include "glcalls.h"
+
+static const int LOCAL_SIZE = 8;  // local_size_x/y de hiz_cs.glsl
+
+HiZBuffer::HiZBuffer(GLuint program) : program(program) {
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output_fbo);
+  src_location = glGetUniformLocation(program, "src");
+  src_level_location = glGetUniformLocation(program, "src_level");
+
+  glUseProgram(program);
+  glUniform1i(src_location, HIZ_TEXTURE_UNIT);
+}
+
+HiZBuffer::~HiZBuffer() {
+  destroy();
+  glDeleteProgram(program);
+}
+
+void HiZBuffer::create(int width, int height) {
+  fb_width = width;
+  fb_height = height;
+  level_count = 1;
+  while ((width | height) >> level_count)
+    level_count++;
+
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+  glGenRenderbuffers(1, &color_rb);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_rb);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rb);
+
+  // Profundidad en textura para poder leerla desde el compute shader
+  glGenTextures(1, &depth_texture);
+  glBindTexture(GL_TEXTURE_2D, depth_texture);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth_texture, 0);
+
+  glGenTextures(1, &pyramid_texture);
+  glBindTexture(GL_TEXTURE_2D, pyramid_texture);
+  glTexStorage2D(GL_TEXTURE_2D, level_count, GL_R32F, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    fprintf(stderr, "ERROR: Hi-Z framebuffer is incomplete\n");
+
+  printf("Hi-Z: %dx%d, %d levels\n", width, height, level_count);
+}
+
+void HiZBuffer::destroy() {
+  if (!fbo)
+    return;
+  glDeleteFramebuffers(1, &fbo);
+  glDeleteRenderbuffers(1, &color_rb);
+  glDeleteTextures(1, &depth_texture);
+  glDeleteTextures(1, &pyramid_texture);
+  fbo = color_rb = depth_texture = pyramid_texture = 0;
+}
+
+void HiZBuffer::begin_frame(int width, int height) {
+  if (width != fb_width || height != fb_height) {
+    destroy();
+    create(width, height);
+  }
+  GL_COUNT(glBindFramebuffer(GL_FRAMEBUFFER, fbo));
+}
+
+void HiZBuffer::build() {
+  GL_COUNT(glUseProgram(program));
+  GL_COUNT(glActiveTexture(GL_TEXTURE0 + HIZ_TEXTURE_UNIT));
+
+  // Nivel 0: copia de la profundidad; el resto, del nivel anterior
+  for (int level = 0; level < level_count; level++) {
+    if (level == 0) {
+      GL_COUNT(glBindTexture(GL_TEXTURE_2D, depth_texture));
+    } else if (level == 1) {
+      GL_COUNT(glBindTexture(GL_TEXTURE_2D, pyramid_texture));
+    }
+    GL_COUNT(glUniform1i(src_level_location, level - 1));
+    GL_COUNT(glBindImageTexture(0, pyramid_texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F));
+
+    int w = fb_width >> level > 0 ? fb_width >> level : 1;
+    int h = fb_height >> level > 0 ? fb_height >> level : 1;
+    GL_COUNT(glDispatchCompute((w + LOCAL_SIZE - 1) / LOCAL_SIZE, (h + LOCAL_SIZE - 1) / LOCAL_SIZE, 1));
+
+    // El siguiente nivel (y el culling) leen lo escrito con texelFetch
+    GL_COUNT(glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT));
+  }
+  GL_COUNT(glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F));
+  GL_COUNT(glActiveTexture(GL_TEXTURE0));
+}
+
+void HiZBuffer::end_frame() {
+  GL_COUNT(glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo));
+  GL_COUNT(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, (GLuint) output_fbo));
+  GL_COUNT(glBlitFramebuffer(0, 0, fb_width, fb_height, 0, 0, fb_width, fb_height,
+                             GL_COLOR_BUFFER_BIT, GL_NEAREST));
+  GL_COUNT(glBindFramebuffer(GL_FRAMEBUFFER, (GLuint) output_fbo));
+}
@@ -0,0 +1,56 @@
+// hiz.h: piramide de profundidad (Hi-Z) para occlusion culling en la GPU
+//
+// La escena se dibuja en un framebuffer propio con la profundidad en una
+// textura. build() copia esa profundidad al nivel 0 de una textura R32F con
+// todos sus mipmaps y reduce nivel a nivel con un compute shader
+// (hiz_cs.glsl): cada texel guarda la profundidad mas lejana de los 2x2 (o
+// 3x3 en el borde de un lado impar) que cubre. Un objeto cuya caja ocupa un
+// rectangulo de la pantalla se prueba con 4 texels del nivel en el que el
+// rectangulo cabe en 2x2: si su punto mas cercano esta mas lejos que los 4,
+// algo dibujado lo tapa entero.
+//
+// end_frame() copia el color al framebuffer que estaba enlazado al crear el
+// objeto (la ventana o el FBO del modo headless). Necesita GL 4.3, como
+// GpuCulling.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef HIZ_H
+#define HIZ_H
+
+#include <GL/glew.h>
+
+// Unidad de textura de la piramide (y de la profundidad al construirla): no
+// la usa ninguna otra textura de la escena
+const int HIZ_TEXTURE_UNIT = 5;
+
+class HiZBuffer {
+public:
+  // program: hiz_cs.glsl ya enlazado
+  HiZBuffer(GLuint program);
+  ~HiZBuffer();
+
+  // Enlaza el framebuffer propio de width x height (se recrea si cambia el
+  // tamano)
+  void begin_frame(int width, int height);
+  // Piramide a partir de la profundidad dibujada hasta ahora en el frame
+  void build();
+  // Copia el color al framebuffer de salida y lo deja enlazado
+  void end_frame();
+
+  GLuint pyramid() const { return pyramid_texture; }
+  int levels() const { return level_count; }
+  int width() const { return fb_width; }
+  int height() const { return fb_height; }
+
+private:
+  void create(int width, int height);
+  void destroy();
+
+  GLuint program;
+  GLint output_fbo = 0;
+  GLuint fbo = 0, color_rb = 0, depth_texture = 0, pyramid_texture = 0;
+  int fb_width = 0, fb_height = 0, level_count = 0;
+  GLint src_location, src_level_location;
+};
+
+#endif
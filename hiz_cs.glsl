@@ -0,0 +1,32 @@
+#version 430
+
+// Un nivel de la piramide Hi-Z por dispatch (ver hiz.h): cada texel guarda
+// la profundidad mas lejana de los que cubre en el nivel anterior.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r32f) uniform writeonly image2D dst;
+uniform sampler2D src;  // la profundidad (src_level < 0) o la propia piramide
+uniform int src_level;
+
+void main() {
+  ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = imageSize(dst);
+  if (p.x >= size.x || p.y >= size.y)
+    return;
+
+  if (src_level < 0) {
+    imageStore(dst, p, vec4(texelFetch(src, p, 0).r));
+    return;
+  }
+
+  // Con un lado impar el ultimo texel cubre tambien la fila o columna que
+  // sobra, asi cada texel cubre todos los pixeles de p << nivel en adelante
+  ivec2 src_size = textureSize(src, src_level);
+  ivec2 extra = ivec2(equal(p, size - 1)) * (src_size & 1);
+  float depth = 0.0;
+  for (int y = 0; y <= 1 + extra.y; y++)
+    for (int x = 0; x <= 1 + extra.x; x++)
+      depth = max(depth, texelFetch(src, min(2 * p + ivec2(x, y), src_size - 1), src_level).r);
+  imageStore(dst, p, vec4(depth));
+}
@@ -0,0 +1,227 @@
+// hotreload.cpp: recarga en caliente de shaders y texturas (ver hotreload.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "hotreload.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "texloader.h"
+
+// Eventos que siguen al primero de un mismo guardado
+static const int SETTLE_MS = 50;
+
+static double ms_since(HotReloader::Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(HotReloader::Clock::now() - start).count();
+}
+
+HotReloader::HotReloader(std::function<bool()> bind_context, std::function<void()> release_context)
+    : bind_context(bind_context), release_context(release_context) {}
+
+HotReloader::~HotReloader() {
+  if (thread.joinable()) {
+    char stop = 1;
+    if (write(stop_pipe[1], &stop, 1) != 1)
+      perror("hot reload");
+    thread.join();
+  }
+  for (int fd : { notify_fd, stop_pipe[0], stop_pipe[1] })
+    if (fd >= 0)
+      close(fd);
+
+  // Los objetos que nadie llego a recoger
+  for (const Result &result : ready)
+    if (result.program)
+      glDeleteProgram(result.object);
+    else
+      glDeleteTextures(1, &result.object);
+}
+
+static void split_path(const std::string &path, std::string &dir, std::string &name) {
+  size_t slash = path.rfind('/');
+  dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+  name = slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+void HotReloader::watch_program(const std::vector<std::string> &paths, std::function<GLuint()> build) {
+  build_program = build;
+  for (const std::string &path : paths) {
+    bool watched = false;
+    for (const Watched &file : files)
+      watched = watched || (file.program && file.path == path);
+    if (watched)
+      continue;
+    Watched file;
+    file.path = path;
+    split_path(file.path, file.dir, file.name);
+    file.program = true;
+    file.slot = -1;
+    files.push_back(file);
+  }
+}
+
+int HotReloader::watch_texture(const char *path) {
+  Watched file;
+  file.path = path;
+  split_path(file.path, file.dir, file.name);
+  file.program = false;
+  file.slot = texture_slots++;
+  files.push_back(file);
+  return file.slot;
+}
+
+bool HotReloader::start() {
+  notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (notify_fd < 0 || pipe(stop_pipe) != 0) {
+    perror("hot reload");
+    return false;
+  }
+  for (const Watched &file : files) {
+    bool watched = false;
+    for (const std::pair<int, std::string> &w : dir_watches)
+      watched = watched || w.second == file.dir;
+    if (watched)
+      continue;
+    int wd = inotify_add_watch(notify_fd, file.dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+      printf("Hot reload: could not watch %s (%s)\n", file.dir.c_str(), strerror(errno));
+      return false;
+    }
+    dir_watches.push_back(std::make_pair(wd, file.dir));
+  }
+  thread = std::thread(&HotReloader::run, this);
+  printf("Hot reload: watching %zu files\n", files.size());
+  return true;
+}
+
+// Anade a changed los ficheros vigilados que aparecen en los eventos
+// pendientes. false si el descriptor ya no sirve
+bool HotReloader::read_events(std::vector<int> &changed) {
+  alignas(struct inotify_event) char buffer[4096];
+  for (;;) {
+    ssize_t n = read(notify_fd, buffer, sizeof(buffer));
+    if (n < 0)
+      return errno == EAGAIN || errno == EINTR;
+    if (n == 0)
+      return true;
+    for (char *p = buffer; p < buffer + n; p += sizeof(struct inotify_event) + ((struct inotify_event *) p)->len) {
+      const struct inotify_event *event = (const struct inotify_event *) p;
+      if (event->len == 0)
+        continue;
+      for (size_t i = 0; i < files.size(); i++) {
+        bool same_dir = false;
+        for (const std::pair<int, std::string> &w : dir_watches)
+          same_dir = same_dir || (w.first == event->wd && w.second == files[i].dir);
+        if (same_dir && files[i].name == event->name &&
+            std::find(changed.begin(), changed.end(), (int) i) == changed.end())
+          changed.push_back((int) i);
+      }
+    }
+  }
+}
+
+void HotReloader::run() {
+  if (!bind_context()) {
+    printf("Hot reload: could not make the shared context current\n");
+    return;
+  }
+  struct pollfd fds[2] = { { notify_fd, POLLIN, 0 }, { stop_pipe[0], POLLIN, 0 } };
+  for (;;) {
+    if (::poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds[1].revents)
+      break;
+
+    Clock::time_point changed_at = Clock::now();
+    std::vector<int> changed;
+    if (!read_events(changed))
+      break;
+    // Un guardado son varios eventos seguidos: se junta lo que llegue
+    // mientras siga habiendo cambios
+    while (::poll(fds, 1, SETTLE_MS) > 0)
+      if (!read_events(changed))
+        break;
+
+    bool program_done = false;
+    for (int index : changed) {
+      const Watched &file = files[index];
+      if (file.program && program_done)
+        continue;
+      program_done = program_done || file.program;
+      Result result = file.program ? reload_program(file) : reload_texture(file);
+      result.changed_at = changed_at;
+      std::lock_guard<std::mutex> lock(ready_mutex);
+      ready.push_back(result);
+    }
+  }
+  release_context();
+}
+
+HotReloader::Result HotReloader::reload_program(const Watched &file) {
+  Result result = Result();
+  result.program = true;
+  result.slot = -1;
+  result.path = file.path;
+
+  Clock::time_point start = Clock::now();
+  result.object = build_program();
+  // Completo antes de que lo use el otro contexto
+  glFinish();
+  result.work_ms = ms_since(start);
+  return result;
+}
+
+HotReloader::Result HotReloader::reload_texture(const Watched &file) {
+  Result result = Result();
+  result.program = false;
+  result.slot = file.slot;
+  result.path = file.path;
+
+  Clock::time_point start = Clock::now();
+  std::vector<unsigned char> data;
+  FILE *fp = fopen(file.path.c_str(), "rb");
+  if (fp) {
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    data.resize(size > 0 ? size : 0);
+    data.resize(fread(data.data(), 1, data.size(), fp));
+    fclose(fp);
+  }
+
+  // Igual que la primera carga (TextureLoader): un .dds que el driver no
+  // soporta se descomprime
+  bool bc_supported[4];
+  bc_formats_supported(bc_supported);
+  TextureImage image;
+  if (decode_texture(file.path, data, bc_supported, image)) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    upload_texture_image(file.path, image, image.pixels ? image.pixels : image.file.data());
+    glFinish();
+    result.object = texture;
+  }
+  free_texture_image(image);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  result.work_ms = ms_since(start);
+  return result;
+}
+
+std::vector<HotReloader::Result> HotReloader::poll() {
+  std::vector<Result> results;
+  std::unique_lock<std::mutex> lock(ready_mutex, std::try_to_lock);
+  if (lock.owns_lock())
+    results.swap(ready);
+  return results;
+}
@@ -0,0 +1,85 @@
+// hotreload.h: recarga en caliente de shaders y texturas
+//
+// Un hilo propio espera cambios en los ficheros vigilados con inotify (en
+// su directorio, porque los editores suelen guardar escribiendo otro
+// fichero y renombrandolo) y, tras juntar los eventos de un mismo guardado,
+// recompila el programa o decodifica la textura. El trabajo GL se hace en
+// un contexto compartido con el del render: el hilo crea el programa o la
+// textura nuevos, espera con glFinish() a que esten completos y los deja en
+// una cola. El hilo GL llama a poll() cada frame, que no bloquea nunca, y
+// sustituye los objetos; si la compilacion falla sigue el anterior.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef HOTRELOAD_H
+#define HOTRELOAD_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class HotReloader {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Result {
+    bool program;          // programa (si no, textura)
+    int slot;              // textura: lo que devolvio watch_texture()
+    std::string path;      // fichero que cambio
+    GLuint object;         // programa o textura nuevos; 0 si fallo
+    double work_ms;        // compilacion, o decodificacion y subida
+    Clock::time_point changed_at;  // primer evento de inotify
+  };
+
+  // bind_context / release_context se llaman desde el hilo de recarga para
+  // hacer current el contexto compartido y soltarlo al terminar
+  HotReloader(std::function<bool()> bind_context, std::function<void()> release_context);
+  ~HotReloader();
+
+  HotReloader(const HotReloader &) = delete;
+  HotReloader &operator=(const HotReloader &) = delete;
+
+  // Antes de start(). Si cambia alguno de files (los shaders y sus
+  // #include) se llama a build desde el hilo de recarga; 0 si falla
+  void watch_program(const std::vector<std::string> &files, std::function<GLuint()> build);
+  int watch_texture(const char *path);
+
+  bool start();
+
+  // Hilo GL: lo que ya esta listo para sustituir (el hilo GL borra los
+  // objetos viejos). Si la cola esta ocupada devuelve nada y lo deja para
+  // el siguiente frame
+  std::vector<Result> poll();
+
+private:
+  struct Watched {
+    std::string path, dir, name;
+    bool program;
+    int slot;
+  };
+
+  void run();
+  bool read_events(std::vector<int> &changed);
+  Result reload_program(const Watched &file);
+  Result reload_texture(const Watched &file);
+
+  std::function<bool()> bind_context;
+  std::function<void()> release_context;
+
+  std::function<GLuint()> build_program;
+  std::vector<Watched> files;
+  std::vector<std::pair<int, std::string> > dir_watches;  // wd de inotify, directorio
+  int notify_fd = -1;
+  int stop_pipe[2] = { -1, -1 };
+  int texture_slots = 0;
+
+  std::thread thread;
+  std::mutex ready_mutex;
+  std::vector<Result> ready;
+};
+
+#endif
@@ -0,0 +1,60 @@
+// instancing.cpp: escena instanciada (ver instancing.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "instancing.h"
+
+#include <math.h>
+#include <stddef.h>
+
+// Separacion entre celdas: cada una tiene el cubo y el tetraedro a +-0.75
+// en X, y cada objeto mide 0.5 (algo menos de 0.9 girando)
+static const glm::vec3 cell_spacing(2.0f, 1.0f, 1.0f);
+
+std::vector<glm::vec3> instance_grid(int count, int *side) {
+  int n = 1;
+  while (n * n * n < count)
+    n++;
+  if (side)
+    *side = n;
+
+  std::vector<glm::vec3> cells;
+  cells.reserve(count);
+  glm::vec3 origin = -0.5f * (float) (n - 1) * cell_spacing;
+  for (int i = 0; i < count; i++) {
+    glm::vec3 cell((float) (i % n), (float) ((i / n) % n), (float) (i / (n * n)));
+    cells.push_back(origin + cell * cell_spacing);
+  }
+  // Los planos que no se llenan del todo quedan detras, lejos de la camara
+  for (glm::vec3 &c : cells)
+    c.z = -c.z;
+  return cells;
+}
+
+float instance_phase(int i) {
+  // Razon aurea: desfases repartidos sin patron visible. 18 s es una vuelta
+  // completa sobre Y (20 grados/s)
+  return fmodf((float) i * 0.618034f * 18.0f, 18.0f);
+}
+
+void instance_attrib_pointers(GLuint buffer, size_t offset) {
+  GLsizei stride = sizeof(InstanceAttribs);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+  // Una matriz ocupa un atributo por columna
+  for (int c = 0; c < 4; c++) {
+    GLuint location = INSTANCE_MODEL_LOCATION + c;
+    size_t column = offset + offsetof(InstanceAttribs, model) + c * sizeof(glm::vec4);
+    glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (void *) column);
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+  }
+  for (int c = 0; c < 3; c++) {
+    GLuint location = INSTANCE_NORMAL_LOCATION + c;
+    size_t column = offset + offsetof(InstanceAttribs, normal_matrix) + c * sizeof(glm::vec4);
+    glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, stride, (void *) column);
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
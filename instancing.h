@@ -0,0 +1,43 @@
+// instancing.h: escena instanciada (N cubos y N tetraedros)
+//
+// Cada celda de la rejilla tiene un cubo y un tetraedro, colocados como en
+// la escena original, y se dibujan con un glDrawElementsInstanced por malla
+// (o un glMultiDrawElementsIndirect con el culling en la GPU).
+// Las matrices de cada instancia van en un buffer de vertices con divisor 1
+// (atributos 3 a 9 del vertex shader compilado con INSTANCED).
+//////////////////////////////////////////////////////////////////////
+
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Atributos por instancia tal como estan en el buffer. Las columnas de la
+// normal matrix se rellenan a vec4 (la cuarta componente no se lee) para que
+// cada columna sea un store de 16 bytes alineado, ver transforms.h
+struct InstanceAttribs {
+  glm::mat4 model;
+  glm::vec4 normal_matrix[3];
+};
+
+const GLuint INSTANCE_MODEL_LOCATION = 3;   // mat4: 3 a 6
+const GLuint INSTANCE_NORMAL_LOCATION = 7;  // mat3: 7 a 9
+
+// Centros de count celdas en una rejilla casi cubica centrada en el origen;
+// side recibe el numero de celdas por lado. Con count = 1 la unica celda
+// esta en el origen, asi que la escena es la original.
+std::vector<glm::vec3> instance_grid(int count, int *side);
+
+// Desfase de tiempo de la instancia i para que no giren todas a la par (0
+// para la primera)
+float instance_phase(int i);
+
+// Configura los atributos por instancia del VAO enlazado para leer de buffer
+// a partir de offset bytes
+void instance_attrib_pointers(GLuint buffer, size_t offset);
+
+#endif
@@ -0,0 +1,1173 @@
+// meshloader.cpp: carga de mallas OBJ y glTF (ver meshloader.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "meshloader.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+
+#include <glm/glm.hpp>
+
+typedef std::chrono::steady_clock Clock;
+
+static double ms_since(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static bool has_suffix(const std::string &s, const char *suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && strcasecmp(s.c_str() + s.size() - n, suffix) == 0;
+}
+
+// Tamano de cada lectura: cada bloque se parsea en un hilo mientras se lee
+// el siguiente
+static const size_t BLOCK_SIZE = 1 << 20;
+
+static inline bool is_digit(char c) {
+  return (unsigned) (c - '0') < 10u;
+}
+
+static inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char *skip_spaces(const char *p, const char *end) {
+  while (p < end && is_space(*p))
+    p++;
+  return p;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Numeros
+
+static const double POW10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Hasta 19 cifras significativas en un entero de 64 bits y una sola
+// multiplicacion o division por una potencia de 10 exacta en double: sobra
+// para un float y para los enteros del JSON
+static const char *parse_double(const char *p, const char *end, double *out) {
+  const char *s = p;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+'))
+    negative = *s++ == '-';
+
+  uint64_t mantissa = 0;
+  int exponent = 0, digits = 0;
+  bool any = false;
+  for (; s < end && is_digit(*s); s++, any = true) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (uint64_t) (*s - '0');
+      digits += mantissa != 0;
+    } else {
+      exponent++;
+    }
+  }
+  if (s < end && *s == '.') {
+    for (s++; s < end && is_digit(*s); s++, any = true) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (uint64_t) (*s - '0');
+        digits += mantissa != 0;
+        exponent--;
+      }
+    }
+  }
+  if (!any)
+    return p;
+
+  if (s < end && (*s == 'e' || *s == 'E')) {
+    const char *e = s + 1;
+    bool negative_exponent = false;
+    if (e < end && (*e == '-' || *e == '+'))
+      negative_exponent = *e++ == '-';
+    if (e < end && is_digit(*e)) {
+      int value = 0;
+      for (; e < end && is_digit(*e); e++)
+        if (value < 10000)
+          value = value * 10 + (*e - '0');
+      exponent += negative_exponent ? -value : value;
+      s = e;
+    }
+  }
+
+  double value = (double) mantissa;
+  if (mantissa != 0 && exponent != 0) {
+    if (exponent >= -22 && exponent < 0)
+      value /= POW10[-exponent];
+    else if (exponent > 0 && exponent <= 22)
+      value *= POW10[exponent];
+    else
+      value *= pow(10.0, exponent);
+  }
+  *out = negative ? -value : value;
+  return s;
+}
+
+const char *parse_float(const char *p, const char *end, float *out) {
+  double value;
+  const char *s = parse_double(p, end, &value);
+  if (s != p)
+    *out = (float) value;
+  return s;
+}
+
+static const char *parse_int(const char *p, const char *end, int *out) {
+  const char *s = p;
+  bool negative = s < end && *s == '-';
+  if (negative)
+    s++;
+  const char *digits = s;
+  int value = 0;
+  for (; s < end && is_digit(*s); s++)
+    value = value * 10 + (*s - '0');
+  if (s == digits)
+    return p;
+  *out = negative ? -value : value;
+  return s;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Utilidades de la malla
+
+// Normales suavizadas de los vertices marcados en missing (todos si es NULL):
+// suma de las normales de sus caras sin normalizar, que pesan por su area.
+// Los indices van de base a base + vertex_count
+static void smooth_normals(float *vertices, int vertex_count, const uint32_t *indices,
+                           size_t index_count, uint32_t base, const char *missing) {
+  for (int v = 0; v < vertex_count; v++)
+    if (!missing || missing[v])
+      std::fill(vertices + MESH_VERTEX_FLOATS * v + 3, vertices + MESH_VERTEX_FLOATS * v + 6, 0.0f);
+
+  for (size_t t = 0; t + 2 < index_count; t += 3) {
+    uint32_t corner[3] = { indices[t] - base, indices[t + 1] - base, indices[t + 2] - base };
+    glm::vec3 p[3];
+    for (int k = 0; k < 3; k++) {
+      const float *v = vertices + MESH_VERTEX_FLOATS * corner[k];
+      p[k] = glm::vec3(v[0], v[1], v[2]);
+    }
+    glm::vec3 normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+    for (int k = 0; k < 3; k++) {
+      if (missing && !missing[corner[k]])
+        continue;
+      float *n = vertices + MESH_VERTEX_FLOATS * corner[k] + 3;
+      n[0] += normal.x;
+      n[1] += normal.y;
+      n[2] += normal.z;
+    }
+  }
+
+  for (int v = 0; v < vertex_count; v++) {
+    if (missing && !missing[v])
+      continue;
+    float *n = vertices + MESH_VERTEX_FLOATS * v + 3;
+    float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length > 0.0f) {
+      n[0] /= length;
+      n[1] /= length;
+      n[2] /= length;
+    } else {
+      n[0] = n[1] = 0.0f;
+      n[2] = 1.0f;
+    }
+  }
+}
+
+void normalize_mesh(MeshData &mesh, float radius) {
+  int count = mesh.vertex_count();
+  if (count == 0)
+    return;
+  glm::vec3 lo(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]), hi = lo;
+  for (int v = 0; v < count; v++) {
+    const float *p = &mesh.vertices[MESH_VERTEX_FLOATS * v];
+    lo = glm::min(lo, glm::vec3(p[0], p[1], p[2]));
+    hi = glm::max(hi, glm::vec3(p[0], p[1], p[2]));
+  }
+  glm::vec3 center = 0.5f * (lo + hi);
+  float farthest = 0.0f;
+  for (int v = 0; v < count; v++) {
+    const float *p = &mesh.vertices[MESH_VERTEX_FLOATS * v];
+    farthest = fmaxf(farthest, glm::length(glm::vec3(p[0], p[1], p[2]) - center));
+  }
+  float scale = farthest > 0.0f ? radius / farthest : 1.0f;
+  for (int v = 0; v < count; v++) {
+    float *p = &mesh.vertices[MESH_VERTEX_FLOATS * v];
+    for (int k = 0; k < 3; k++)
+      p[k] = (p[k] - center[k]) * scale;
+  }
+}
+
+std::vector<float> mesh_triangles(const MeshData &mesh) {
+  std::vector<float> out(mesh.indices.size() * MESH_VERTEX_FLOATS);
+  for (size_t i = 0; i < mesh.indices.size(); i++)
+    std::copy(&mesh.vertices[MESH_VERTEX_FLOATS * mesh.indices[i]],
+              &mesh.vertices[MESH_VERTEX_FLOATS * mesh.indices[i]] + MESH_VERTEX_FLOATS,
+              &out[MESH_VERTEX_FLOATS * i]);
+  return out;
+}
+
+MeshBuffers upload_mesh(const MeshData &mesh) {
+  MeshBuffers buffers;
+  buffers.index_count = (int) mesh.indices.size();
+
+  glGenBuffers(1, &buffers.vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+  glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+
+  GLsizei stride = MESH_VERTEX_FLOATS * sizeof(float);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)(6 * sizeof(float)));
+  glEnableVertexAttribArray(2);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // El enlace del element array buffer se queda en el VAO
+  glGenBuffers(1, &buffers.ebo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(),
+               GL_STATIC_DRAW);
+  return buffers;
+}
+
+//////////////////////////////////////////////////////////////////////
+// OBJ
+
+// Indice de una esquina en un bloque: los absolutos (1..n) se guardan tal
+// cual y los relativos (-1 es el ultimo leido) como su indice dentro del
+// bloque menos INDEX_BIAS, que se resuelve al saber cuanto habia antes.
+// 0: la esquina no tiene ese atributo
+static const int INDEX_BIAS = 1 << 30;
+
+struct ObjBlock {
+  std::vector<char> text;
+  std::vector<float> positions, normals, uvs;  // 3, 3 y 2 floats
+  std::vector<int> corners;                    // v, vt, vn por esquina
+  std::string error;
+};
+
+static int encode_index(int raw, int local_count) {
+  return raw > 0 ? raw : local_count + raw - INDEX_BIAS;
+}
+
+static const char *parse_floats(const char *p, const char *end, int count, int required,
+                                std::vector<float> &out) {
+  for (int k = 0; k < count; k++) {
+    float value = 0.0f;
+    const char *s = parse_float(skip_spaces(p, end), end, &value);
+    if (s == skip_spaces(p, end) && k < required)
+      return NULL;
+    out.push_back(value);
+    p = s;
+  }
+  return p;
+}
+
+static void parse_obj_block(ObjBlock &block) {
+  const char *p = block.text.data(), *end = p + block.text.size();
+  std::vector<int> polygon;
+
+  while (p < end && block.error.empty()) {
+    p = skip_spaces(p, end);
+    const char *line_end = (const char *) memchr(p, '\n', (size_t) (end - p));
+    if (!line_end)
+      line_end = end;
+    bool ok = true;
+
+    if (line_end - p > 2 && p[0] == 'v' && is_space(p[1])) {
+      ok = parse_floats(p + 2, line_end, 3, 3, block.positions) != NULL;
+    } else if (line_end - p > 3 && p[0] == 'v' && p[1] == 'n' && is_space(p[2])) {
+      ok = parse_floats(p + 3, line_end, 3, 3, block.normals) != NULL;
+    } else if (line_end - p > 3 && p[0] == 'v' && p[1] == 't' && is_space(p[2])) {
+      ok = parse_floats(p + 3, line_end, 2, 1, block.uvs) != NULL;
+    } else if (line_end - p > 2 && p[0] == 'f' && is_space(p[1])) {
+      // v, v/vt, v//vn o v/vt/vn por esquina
+      polygon.clear();
+      const char *q = skip_spaces(p + 2, line_end);
+      while (ok && q < line_end) {
+        int v = 0, vt = 0, vn = 0;
+        const char *s = parse_int(q, line_end, &v);
+        ok = s != q && v != 0;
+        q = s;
+        if (ok && q < line_end && *q == '/') {
+          q++;
+          if (q < line_end && *q != '/') {
+            s = parse_int(q, line_end, &vt);
+            ok = s != q && vt != 0;
+            q = s;
+          }
+          if (ok && q < line_end && *q == '/') {
+            s = parse_int(q + 1, line_end, &vn);
+            ok = s != q + 1 && vn != 0;
+            q = s;
+          }
+        }
+        polygon.push_back(encode_index(v, (int) block.positions.size() / 3));
+        polygon.push_back(vt ? encode_index(vt, (int) block.uvs.size() / 2) : 0);
+        polygon.push_back(vn ? encode_index(vn, (int) block.normals.size() / 3) : 0);
+        q = skip_spaces(q, line_end);
+      }
+      ok = ok && polygon.size() >= 9;
+
+      // Poligonos en abanico desde la primera esquina
+      for (size_t k = 3; ok && k + 3 < polygon.size(); k += 3) {
+        block.corners.insert(block.corners.end(), polygon.begin(), polygon.begin() + 3);
+        block.corners.insert(block.corners.end(), polygon.begin() + k, polygon.begin() + k + 6);
+      }
+    }
+
+    if (!ok)
+      block.error = "malformed line '" + std::string(p, std::min(line_end, p + 40)) + "'";
+    p = line_end + 1;
+  }
+}
+
+// Esquina ya resuelta a indices desde 0 de todo el fichero (-1: no tiene)
+static inline int resolve_index(int index, int offset) {
+  if (index > 0)
+    return index - 1;
+  return index == 0 ? -1 : offset + index + INDEX_BIAS;
+}
+
+static inline uint32_t hash_corner(const int *key) {
+  uint32_t h = (uint32_t) key[0] * 0x9E3779B1u;
+  h ^= (uint32_t) key[1] * 0x85EBCA77u + (h >> 15);
+  h ^= (uint32_t) key[2] * 0xC2B2AE3Du + (h >> 13);
+  return h ^ (h >> 16);
+}
+
+bool MeshLoader::load_obj(FILE *fp, MeshData &mesh, MeshLoadStats &stats) {
+  // Lectura por bloques; cada uno se parsea en el pool en cuanto se lee.
+  // Lo que queda tras el ultimo fin de linea pasa al bloque siguiente
+  std::deque<ObjBlock> blocks;
+  std::vector<char> carry;
+  for (;;) {
+    blocks.emplace_back();
+    ObjBlock &block = blocks.back();
+    block.text.swap(carry);
+    size_t kept = block.text.size();
+    block.text.resize(kept + BLOCK_SIZE);
+
+    Clock::time_point start = Clock::now();
+    size_t n = fread(block.text.data() + kept, 1, BLOCK_SIZE, fp);
+    stats.read_ms += ms_since(start);
+    stats.file_bytes += n;
+    block.text.resize(kept + n);
+
+    bool eof = n < BLOCK_SIZE;
+    carry.clear();
+    if (!eof) {
+      size_t last = block.text.size();
+      while (last > 0 && block.text[last - 1] != '\n')
+        last--;
+      carry.assign(block.text.begin() + last, block.text.end());
+      block.text.resize(last);
+      if (last == 0) {
+        blocks.pop_back();
+        continue;
+      }
+    }
+    ObjBlock *ready = &block;
+    pool.submit([ready] { parse_obj_block(*ready); });
+    if (eof)
+      break;
+  }
+  pool.wait();
+
+  // Donde empieza cada bloque en los atributos y las esquinas de todo el
+  // fichero
+  size_t count = blocks.size();
+  std::vector<int> position_offset(count + 1, 0), normal_offset(count + 1, 0), uv_offset(count + 1, 0);
+  std::vector<size_t> corner_offset(count + 1, 0);
+  for (size_t b = 0; b < count; b++) {
+    if (!blocks[b].error.empty()) {
+      fprintf(stderr, "ERROR: %s: %s\n", stats.path.c_str(), blocks[b].error.c_str());
+      return false;
+    }
+    position_offset[b + 1] = position_offset[b] + (int) blocks[b].positions.size() / 3;
+    normal_offset[b + 1] = normal_offset[b] + (int) blocks[b].normals.size() / 3;
+    uv_offset[b + 1] = uv_offset[b] + (int) blocks[b].uvs.size() / 2;
+    corner_offset[b + 1] = corner_offset[b] + blocks[b].corners.size();
+  }
+  int positions = position_offset[count], normals = normal_offset[count], uvs = uv_offset[count];
+  stats.corners = (int) (corner_offset[count] / 3);
+
+  std::vector<int> corners(corner_offset[count]);
+  std::atomic<bool> out_of_range(false);
+  pool.parallel_for((int) count, [&](int b) {
+    const std::vector<int> &in = blocks[b].corners;
+    int *out = corners.data() + corner_offset[b];
+    for (size_t i = 0; i < in.size(); i += 3) {
+      out[i] = resolve_index(in[i], position_offset[b]);
+      out[i + 1] = resolve_index(in[i + 1], uv_offset[b]);
+      out[i + 2] = resolve_index(in[i + 2], normal_offset[b]);
+      if (out[i] < 0 || out[i] >= positions || out[i + 1] >= uvs || out[i + 2] >= normals ||
+          (in[i + 1] != 0 && out[i + 1] < 0) || (in[i + 2] != 0 && out[i + 2] < 0))
+        out_of_range = true;
+    }
+  });
+  if (out_of_range) {
+    fprintf(stderr, "ERROR: %s: face index out of range\n", stats.path.c_str());
+    return false;
+  }
+
+  // Un vertice por cada v/vt/vn distinto: tabla hash con direccionamiento
+  // abierto que guarda el vertice (su clave es su esquina en corners)
+  size_t corner_count = corners.size() / 3;
+  size_t capacity = 16;
+  while (capacity < 2 * corner_count)
+    capacity *= 2;
+  std::vector<int> table(capacity, -1);
+  std::vector<int> vertex_key;  // posicion de la clave de cada vertice en corners
+  mesh.indices.resize(corner_count);
+  for (size_t c = 0; c < corner_count; c++) {
+    const int *key = &corners[3 * c];
+    size_t slot = hash_corner(key) & (capacity - 1);
+    for (;;) {
+      int vertex = table[slot];
+      if (vertex < 0) {
+        vertex = (int) vertex_key.size();
+        vertex_key.push_back((int) (3 * c));
+        table[slot] = vertex;
+        mesh.indices[c] = (uint32_t) vertex;
+        break;
+      }
+      const int *other = &corners[vertex_key[vertex]];
+      if (other[0] == key[0] && other[1] == key[1] && other[2] == key[2]) {
+        mesh.indices[c] = (uint32_t) vertex;
+        break;
+      }
+      slot = (slot + 1) & (capacity - 1);
+    }
+  }
+
+  // Atributos de cada vertice; los bloques ya no hacen falta salvo por sus
+  // arrays, que se leen en su sitio
+  int vertex_count = (int) vertex_key.size();
+  mesh.vertices.assign((size_t) vertex_count * MESH_VERTEX_FLOATS, 0.0f);
+  std::vector<char> missing_normal(vertex_count, 0);
+  std::atomic<bool> any_missing(false);
+  auto attribute = [&](const std::vector<int> &offset, int index, int block_floats, int which) -> const float * {
+    size_t b = std::upper_bound(offset.begin(), offset.end(), index) - offset.begin() - 1;
+    const ObjBlock &block = blocks[b];
+    const std::vector<float> &data = which == 0 ? block.positions : which == 1 ? block.uvs : block.normals;
+    return &data[(size_t) (index - offset[b]) * block_floats];
+  };
+  const int CHUNK = 4096;
+  pool.parallel_for((vertex_count + CHUNK - 1) / CHUNK, [&](int chunk) {
+    int last = std::min(vertex_count, (chunk + 1) * CHUNK);
+    for (int v = chunk * CHUNK; v < last; v++) {
+      const int *key = &corners[vertex_key[v]];
+      float *out = &mesh.vertices[(size_t) v * MESH_VERTEX_FLOATS];
+      std::copy_n(attribute(position_offset, key[0], 3, 0), 3, out);
+      if (key[1] >= 0)
+        std::copy_n(attribute(uv_offset, key[1], 2, 1), 2, out + 6);
+      if (key[2] >= 0) {
+        std::copy_n(attribute(normal_offset, key[2], 3, 2), 3, out + 3);
+      } else {
+        missing_normal[v] = 1;
+        any_missing = true;
+      }
+    }
+  });
+  if (any_missing)
+    smooth_normals(mesh.vertices.data(), vertex_count, mesh.indices.data(), mesh.indices.size(), 0,
+                   missing_normal.data());
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// JSON (lo justo para glTF)
+
+namespace {
+
+struct Json {
+  enum Type { NONE, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT };
+  Type type = NONE;
+  double number = 0.0;
+  std::string string;
+  std::vector<Json> items;        // elementos del array o valores del objeto
+  std::vector<std::string> keys;  // claves del objeto
+
+  const Json &operator[](const char *key) const {
+    for (size_t i = 0; i < keys.size(); i++)
+      if (keys[i] == key)
+        return items[i];
+    return none();
+  }
+  const Json &operator[](int i) const {
+    return type == ARRAY && i >= 0 && i < (int) items.size() ? items[i] : none();
+  }
+  int size() const { return type == ARRAY ? (int) items.size() : 0; }
+  bool exists() const { return type != NONE; }
+  double real(double fallback) const { return type == NUMBER ? number : fallback; }
+  long long integer(long long fallback) const { return type == NUMBER ? (long long) number : fallback; }
+
+  static const Json &none() {
+    static const Json value;
+    return value;
+  }
+};
+
+class JsonParser {
+public:
+  JsonParser(const char *begin, const char *end) : p(begin), end(end) {}
+
+  // Acepta espacios (y los ceros de relleno del GLB) tras el valor
+  bool parse(Json &out) {
+    if (!value(out, 0))
+      return false;
+    while (p < end && (is_space(*p) || *p == '\n' || *p == '\0'))
+      p++;
+    return p == end;
+  }
+
+private:
+  void skip() {
+    while (p < end && (is_space(*p) || *p == '\n'))
+      p++;
+  }
+
+  bool literal(const char *word) {
+    size_t n = strlen(word);
+    if ((size_t) (end - p) < n || strncmp(p, word, n) != 0)
+      return false;
+    p += n;
+    return true;
+  }
+
+  bool value(Json &out, int depth) {
+    skip();
+    if (p >= end || depth > 64)
+      return false;
+    switch (*p) {
+    case '{':
+      out.type = Json::OBJECT;
+      p++;
+      skip();
+      if (p < end && *p == '}') {
+        p++;
+        return true;
+      }
+      for (;;) {
+        skip();
+        out.keys.emplace_back();
+        out.items.emplace_back();
+        if (p >= end || *p != '"' || !string(out.keys.back()))
+          return false;
+        skip();
+        if (p >= end || *p++ != ':' || !value(out.items.back(), depth + 1))
+          return false;
+        skip();
+        if (p < end && *p == ',') {
+          p++;
+        } else {
+          return p < end && *p++ == '}';
+        }
+      }
+    case '[':
+      out.type = Json::ARRAY;
+      p++;
+      skip();
+      if (p < end && *p == ']') {
+        p++;
+        return true;
+      }
+      for (;;) {
+        out.items.emplace_back();
+        if (!value(out.items.back(), depth + 1))
+          return false;
+        skip();
+        if (p < end && *p == ',') {
+          p++;
+        } else {
+          return p < end && *p++ == ']';
+        }
+      }
+    case '"':
+      out.type = Json::STRING;
+      return string(out.string);
+    case 't':
+      out.type = Json::BOOLEAN;
+      out.number = 1.0;
+      return literal("true");
+    case 'f':
+      out.type = Json::BOOLEAN;
+      return literal("false");
+    case 'n':
+      return literal("null");
+    default: {
+      const char *s = parse_double(p, end, &out.number);
+      out.type = Json::NUMBER;
+      if (s == p)
+        return false;
+      p = s;
+      return true;
+    }
+    }
+  }
+
+  bool string(std::string &out) {
+    p++;  // "
+    while (p < end && *p != '"') {
+      if (*p != '\\') {
+        out += *p++;
+        continue;
+      }
+      if (++p >= end)
+        return false;
+      char c = *p++;
+      switch (c) {
+      case 'b': out += '\b'; break;
+      case 'f': out += '\f'; break;
+      case 'n': out += '\n'; break;
+      case 'r': out += '\r'; break;
+      case 't': out += '\t'; break;
+      case 'u': {
+        if (end - p < 4)
+          return false;
+        unsigned code = (unsigned) strtoul(std::string(p, 4).c_str(), NULL, 16);
+        p += 4;
+        // UTF-8 (sin juntar los pares de surrogates)
+        if (code < 0x80) {
+          out += (char) code;
+        } else if (code < 0x800) {
+          out += (char) (0xC0 | (code >> 6));
+          out += (char) (0x80 | (code & 0x3F));
+        } else {
+          out += (char) (0xE0 | (code >> 12));
+          out += (char) (0x80 | ((code >> 6) & 0x3F));
+          out += (char) (0x80 | (code & 0x3F));
+        }
+        break;
+      }
+      default: out += c; break;
+      }
+    }
+    if (p >= end)
+      return false;
+    p++;
+    return true;
+  }
+
+  const char *p, *end;
+};
+
+}  // namespace
+
+//////////////////////////////////////////////////////////////////////
+// glTF
+
+static bool decode_base64(const char *p, const char *end, std::vector<unsigned char> &out) {
+  unsigned value = 0;
+  int bits = 0;
+  for (; p < end && *p != '='; p++) {
+    char c = *p;
+    int digit = c >= 'A' && c <= 'Z' ? c - 'A' : c >= 'a' && c <= 'z' ? c - 'a' + 26 :
+                c >= '0' && c <= '9' ? c - '0' + 52 : c == '+' ? 62 : c == '/' ? 63 : -1;
+    if (digit < 0)
+      return false;
+    value = (value << 6) | (unsigned) digit;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out.push_back((unsigned char) (value >> bits));
+    }
+  }
+  return true;
+}
+
+static std::string decode_uri(const std::string &uri) {
+  std::string out;
+  for (size_t i = 0; i < uri.size(); i++) {
+    if (uri[i] == '%' && i + 2 < uri.size()) {
+      out += (char) strtoul(uri.substr(i + 1, 2).c_str(), NULL, 16);
+      i += 2;
+    } else {
+      out += uri[i];
+    }
+  }
+  return out;
+}
+
+// Lee el fichero entero por bloques
+static bool read_file(FILE *fp, std::vector<unsigned char> &data, MeshLoadStats &stats) {
+  Clock::time_point start = Clock::now();
+  size_t n;
+  do {
+    size_t size = data.size();
+    data.resize(size + BLOCK_SIZE);
+    n = fread(data.data() + size, 1, BLOCK_SIZE, fp);
+    data.resize(size + n);
+  } while (n == BLOCK_SIZE);
+  stats.read_ms += ms_since(start);
+  stats.file_bytes += data.size();
+  return !ferror(fp);
+}
+
+namespace {
+
+struct Span {
+  const unsigned char *data;
+  size_t size;
+};
+
+struct Accessor {
+  const unsigned char *data;
+  size_t stride;
+  int count, components, component_type;
+  bool normalized;
+};
+
+// Primitiva de triangulos con la matriz de su nodo y su sitio en la malla
+struct Primitive {
+  glm::mat4 matrix;
+  Accessor position, normal, uv, index;
+  bool has_normal, has_uv, has_index;
+  size_t first_vertex, first_index;
+  int index_count;
+};
+
+}  // namespace
+
+static int component_size(int type) {
+  switch (type) {
+  case 5120: case 5121: return 1;  // BYTE, UNSIGNED_BYTE
+  case 5122: case 5123: return 2;  // SHORT, UNSIGNED_SHORT
+  case 5125: case 5126: return 4;  // UNSIGNED_INT, FLOAT
+  default: return 0;
+  }
+}
+
+static bool get_accessor(const Json &doc, const std::vector<Span> &buffers, long long index,
+                         int components, Accessor &out, std::string &error) {
+  const Json &accessor = doc["accessors"][(int) index];
+  const Json &view = doc["bufferViews"][(int) accessor["bufferView"].integer(-1)];
+  if (!accessor.exists() || !view.exists()) {
+    error = "accessor " + std::to_string(index) + " without buffer view";
+    return false;
+  }
+  if (accessor["sparse"].exists()) {
+    error = "sparse accessors are not supported";
+    return false;
+  }
+
+  static const char *TYPES[] = { "SCALAR", "VEC2", "VEC3", "VEC4" };
+  int type_components = 0;
+  for (int k = 0; k < 4; k++)
+    if (accessor["type"].string == TYPES[k])
+      type_components = k + 1;
+
+  out.component_type = (int) accessor["componentType"].integer(0);
+  long long count = accessor["count"].integer(0);
+  if (count < 0 || count > INT_MAX) {
+    error = "accessor " + std::to_string(index) + " with bad count";
+    return false;
+  }
+  out.count = (int) count;
+  out.components = components;
+  out.normalized = accessor["normalized"].type == Json::BOOLEAN && accessor["normalized"].number != 0.0;
+  int element = component_size(out.component_type) * type_components;
+  if (element == 0 || type_components < components) {
+    error = "unsupported accessor " + std::to_string(index);
+    return false;
+  }
+  out.stride = (size_t) view["byteStride"].integer(element);
+
+  long long buffer = view["buffer"].integer(-1);
+  size_t view_offset = (size_t) view["byteOffset"].integer(0);
+  size_t view_length = (size_t) view["byteLength"].integer(0);
+  size_t offset = (size_t) accessor["byteOffset"].integer(0);
+  if (buffer < 0 || buffer >= (long long) buffers.size() || view_offset + view_length > buffers[buffer].size ||
+      (out.count > 0 && offset + out.stride * (out.count - 1) + element > view_length)) {
+    error = "accessor " + std::to_string(index) + " out of its buffer";
+    return false;
+  }
+  out.data = buffers[buffer].data + view_offset + offset;
+  return true;
+}
+
+static inline float read_component(const unsigned char *p, int type, bool normalized) {
+  switch (type) {
+  case 5126: {
+    float f;
+    memcpy(&f, p, 4);
+    return f;
+  }
+  case 5121: return normalized ? *p / 255.0f : *p;
+  case 5120: return normalized ? fmaxf((int8_t) *p / 127.0f, -1.0f) : (int8_t) *p;
+  case 5123: {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return normalized ? v / 65535.0f : v;
+  }
+  case 5122: {
+    int16_t v;
+    memcpy(&v, p, 2);
+    return normalized ? fmaxf(v / 32767.0f, -1.0f) : v;
+  }
+  default: {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return (float) v;
+  }
+  }
+}
+
+static inline uint32_t read_index(const unsigned char *p, int type) {
+  if (type == 5121)
+    return *p;
+  if (type == 5123) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return v;
+  }
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static glm::mat4 node_matrix(const Json &node) {
+  const Json &m = node["matrix"];
+  if (m.size() == 16) {
+    glm::mat4 matrix;
+    for (int i = 0; i < 16; i++)
+      matrix[i / 4][i % 4] = (float) m[i].real(0.0);
+    return matrix;
+  }
+  // T * R * S, con R del cuaternion (x, y, z, w)
+  const Json &t = node["translation"], &r = node["rotation"], &s = node["scale"];
+  float x = (float) r[0].real(0.0), y = (float) r[1].real(0.0), z = (float) r[2].real(0.0);
+  float w = (float) r[3].real(1.0);
+  glm::mat4 matrix(1.0f);
+  matrix[0] = glm::vec4(1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w), 0.0f);
+  matrix[1] = glm::vec4(2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w), 0.0f);
+  matrix[2] = glm::vec4(2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y), 0.0f);
+  matrix[0] *= (float) s[0].real(1.0);
+  matrix[1] *= (float) s[1].real(1.0);
+  matrix[2] *= (float) s[2].real(1.0);
+  matrix[3] = glm::vec4((float) t[0].real(0.0), (float) t[1].real(0.0), (float) t[2].real(0.0), 1.0f);
+  return matrix;
+}
+
+static bool add_primitives(const Json &doc, const std::vector<Span> &buffers, long long mesh_index,
+                           const glm::mat4 &matrix, std::vector<Primitive> &out, int &skipped,
+                           std::string &error) {
+  const Json &primitives = doc["meshes"][(int) mesh_index]["primitives"];
+  for (int p = 0; p < primitives.size(); p++) {
+    const Json &primitive = primitives[p];
+    const Json &attributes = primitive["attributes"];
+    // Solo triangulos (mode 4, el valor por defecto)
+    if (primitive["mode"].integer(4) != 4 || !attributes["POSITION"].exists()) {
+      skipped++;
+      continue;
+    }
+    Primitive prim = Primitive();
+    prim.matrix = matrix;
+    if (!get_accessor(doc, buffers, attributes["POSITION"].integer(-1), 3, prim.position, error))
+      return false;
+    prim.has_normal = attributes["NORMAL"].exists();
+    if (prim.has_normal && !get_accessor(doc, buffers, attributes["NORMAL"].integer(-1), 3, prim.normal, error))
+      return false;
+    prim.has_uv = attributes["TEXCOORD_0"].exists();
+    if (prim.has_uv && !get_accessor(doc, buffers, attributes["TEXCOORD_0"].integer(-1), 2, prim.uv, error))
+      return false;
+    prim.has_index = primitive["indices"].exists();
+    if (prim.has_index && !get_accessor(doc, buffers, primitive["indices"].integer(-1), 1, prim.index, error))
+      return false;
+    prim.index_count = prim.has_index ? prim.index.count : prim.position.count;
+    prim.index_count -= prim.index_count % 3;
+    if ((prim.has_normal && prim.normal.count < prim.position.count) ||
+        (prim.has_uv && prim.uv.count < prim.position.count)) {
+      error = "attribute with fewer elements than POSITION";
+      return false;
+    }
+    out.push_back(prim);
+  }
+  return true;
+}
+
+static bool add_node(const Json &doc, const std::vector<Span> &buffers, long long node_index,
+                     const glm::mat4 &parent, int depth, std::vector<Primitive> &out, int &skipped,
+                     std::string &error) {
+  const Json &node = doc["nodes"][(int) node_index];
+  if (!node.exists() || depth > 64) {
+    error = "invalid node hierarchy";
+    return false;
+  }
+  glm::mat4 matrix = parent * node_matrix(node);
+  if (node["mesh"].exists() && !add_primitives(doc, buffers, node["mesh"].integer(-1), matrix, out, skipped, error))
+    return false;
+  const Json &children = node["children"];
+  for (int c = 0; c < children.size(); c++)
+    if (!add_node(doc, buffers, children[c].integer(-1), matrix, depth + 1, out, skipped, error))
+      return false;
+  return true;
+}
+
+bool MeshLoader::load_gltf(FILE *fp, const std::string &path, bool binary, MeshData &mesh,
+                           MeshLoadStats &stats) {
+  std::vector<unsigned char> file;
+  if (!read_file(fp, file, stats)) {
+    fprintf(stderr, "ERROR: could not read %s\n", path.c_str());
+    return false;
+  }
+
+  // GLB: cabecera de 12 bytes, chunk JSON y chunk BIN opcional
+  const char *json = (const char *) file.data();
+  size_t json_size = file.size();
+  Span bin = { NULL, 0 };
+  if (binary) {
+    uint32_t header[5] = { 0 };  // magic, version, length, chunk JSON: length, tipo
+    if (file.size() >= sizeof(header))
+      memcpy(header, file.data(), sizeof(header));
+    if (header[0] != 0x46546C67u || header[1] != 2 || header[4] != 0x4E4F534Au ||
+        20 + (size_t) header[3] > file.size()) {
+      fprintf(stderr, "ERROR: %s is not a glTF 2.0 binary\n", path.c_str());
+      return false;
+    }
+    json = (const char *) file.data() + 20;
+    json_size = header[3];
+    size_t bin_chunk = 20 + ((json_size + 3) & ~(size_t) 3);
+    uint32_t chunk[2] = { 0, 0 };  // length, tipo
+    if (bin_chunk + 8 <= file.size())
+      memcpy(chunk, file.data() + bin_chunk, 8);
+    if (chunk[1] == 0x004E4942u && bin_chunk + 8 + chunk[0] <= file.size())
+      bin = { file.data() + bin_chunk + 8, chunk[0] };
+  }
+
+  Json doc;
+  JsonParser parser(json, json + json_size);
+  if (!parser.parse(doc) || doc.type != Json::OBJECT) {
+    fprintf(stderr, "ERROR: %s: malformed JSON\n", path.c_str());
+    return false;
+  }
+
+  // Buffers: el chunk BIN, URIs data: en base64 o ficheros junto al .gltf
+  std::string dir = path.substr(0, path.find_last_of('/') + 1);
+  std::deque<std::vector<unsigned char>> storage;
+  std::vector<Span> buffers;
+  const Json &buffer_list = doc["buffers"];
+  for (int b = 0; b < buffer_list.size(); b++) {
+    const std::string &uri = buffer_list[b]["uri"].string;
+    size_t length = (size_t) buffer_list[b]["byteLength"].integer(0);
+    if (!buffer_list[b]["uri"].exists()) {
+      if (b != 0 || !bin.data || bin.size < length) {
+        fprintf(stderr, "ERROR: %s: buffer %d has no data\n", path.c_str(), b);
+        return false;
+      }
+      buffers.push_back(bin);
+      continue;
+    }
+    storage.emplace_back();
+    std::vector<unsigned char> &data = storage.back();
+    if (uri.compare(0, 5, "data:") == 0) {
+      size_t comma = uri.find(',');
+      if (comma == std::string::npos || !decode_base64(uri.c_str() + comma + 1, uri.c_str() + uri.size(), data)) {
+        fprintf(stderr, "ERROR: %s: buffer %d has an invalid data URI\n", path.c_str(), b);
+        return false;
+      }
+    } else {
+      std::string file_path = dir + decode_uri(uri);
+      FILE *bfp = fopen(file_path.c_str(), "rb");
+      bool ok = bfp && read_file(bfp, data, stats);
+      if (bfp)
+        fclose(bfp);
+      if (!ok) {
+        fprintf(stderr, "ERROR: could not read %s\n", file_path.c_str());
+        return false;
+      }
+    }
+    if (data.size() < length) {
+      fprintf(stderr, "ERROR: %s: buffer %d is shorter than its byteLength\n", path.c_str(), b);
+      return false;
+    }
+    buffers.push_back({ data.data(), data.size() });
+  }
+
+  // Primitivas de la escena por defecto con la matriz de su nodo; sin
+  // escenas, todas las mallas tal cual
+  std::vector<Primitive> primitives;
+  std::string error;
+  int skipped = 0;
+  bool ok = true;
+  const Json &scenes = doc["scenes"];
+  if (scenes.size() > 0) {
+    const Json &roots = scenes[(int) doc["scene"].integer(0)]["nodes"];
+    for (int n = 0; ok && n < roots.size(); n++)
+      ok = add_node(doc, buffers, roots[n].integer(-1), glm::mat4(1.0f), 0, primitives, skipped, error);
+  } else {
+    for (int m = 0; ok && m < doc["meshes"].size(); m++)
+      ok = add_primitives(doc, buffers, m, glm::mat4(1.0f), primitives, skipped, error);
+  }
+  if (!ok) {
+    fprintf(stderr, "ERROR: %s: %s\n", path.c_str(), error.c_str());
+    return false;
+  }
+  if (skipped > 0)
+    printf("Mesh %s: %d primitives that are not triangles skipped\n", path.c_str(), skipped);
+
+  size_t vertex_total = 0, index_total = 0;
+  for (Primitive &prim : primitives) {
+    prim.first_vertex = vertex_total;
+    prim.first_index = index_total;
+    vertex_total += prim.position.count;
+    index_total += prim.index_count;
+  }
+  stats.corners = (int) index_total;
+  mesh.vertices.assign(vertex_total * MESH_VERTEX_FLOATS, 0.0f);
+  mesh.indices.resize(index_total);
+
+  // Trabajos de hasta CHUNK vertices o indices de una primitiva, para
+  // repartir tambien una malla de una sola primitiva
+  const int CHUNK = 16384;
+  struct Job {
+    int primitive, first, last;
+    bool indices;
+  };
+  std::vector<Job> jobs;
+  for (int p = 0; p < (int) primitives.size(); p++) {
+    for (int v = 0; v < primitives[p].position.count; v += CHUNK)
+      jobs.push_back({ p, v, std::min(primitives[p].position.count, v + CHUNK), false });
+    for (int i = 0; i < primitives[p].index_count; i += CHUNK)
+      jobs.push_back({ p, i, std::min(primitives[p].index_count, i + CHUNK), true });
+  }
+
+  std::atomic<bool> bad_index(false);
+  pool.parallel_for((int) jobs.size(), [&](int j) {
+    const Job &job = jobs[j];
+    const Primitive &prim = primitives[job.primitive];
+    glm::mat3 linear(prim.matrix);
+    // Con determinante negativo la transformacion invierte el sentido de
+    // giro de los triangulos
+    bool mirrored = glm::dot(glm::cross(linear[0], linear[1]), linear[2]) < 0.0f;
+
+    if (job.indices) {
+      uint32_t *out = &mesh.indices[prim.first_index];
+      for (int i = job.first; i < job.last; i++) {
+        uint32_t index = prim.has_index ? read_index(prim.index.data + prim.index.stride * i, prim.index.component_type)
+                                        : (uint32_t) i;
+        if (index >= (uint32_t) prim.position.count)
+          bad_index = true;
+        int slot = mirrored && i % 3 != 0 ? i + (i % 3 == 1 ? 1 : -1) : i;
+        out[slot] = (uint32_t) prim.first_vertex + std::min(index, (uint32_t) prim.position.count - 1);
+      }
+      return;
+    }
+
+    glm::mat3 normal_matrix = glm::transpose(glm::inverse(linear));
+    int position_size = component_size(prim.position.component_type);
+    for (int v = job.first; v < job.last; v++) {
+      float *out = &mesh.vertices[(prim.first_vertex + v) * MESH_VERTEX_FLOATS];
+      glm::vec3 p;
+      for (int k = 0; k < 3; k++)
+        p[k] = read_component(prim.position.data + prim.position.stride * v + position_size * k,
+                              prim.position.component_type, prim.position.normalized);
+      p = glm::vec3(prim.matrix * glm::vec4(p, 1.0f));
+      out[0] = p.x;
+      out[1] = p.y;
+      out[2] = p.z;
+      if (prim.has_normal) {
+        glm::vec3 n;
+        int size = component_size(prim.normal.component_type);
+        for (int k = 0; k < 3; k++)
+          n[k] = read_component(prim.normal.data + prim.normal.stride * v + size * k, prim.normal.component_type,
+                                prim.normal.normalized);
+        n = normal_matrix * n;
+        float length = glm::length(n);
+        if (length > 0.0f)
+          n /= length;
+        out[3] = n.x;
+        out[4] = n.y;
+        out[5] = n.z;
+      }
+      if (prim.has_uv) {
+        int size = component_size(prim.uv.component_type);
+        for (int k = 0; k < 2; k++)
+          out[6 + k] = read_component(prim.uv.data + prim.uv.stride * v + size * k, prim.uv.component_type,
+                                      prim.uv.normalized);
+      }
+    }
+  });
+  if (bad_index) {
+    fprintf(stderr, "ERROR: %s: vertex index out of range\n", path.c_str());
+    return false;
+  }
+
+  // Primitivas sin normales, cuando ya estan todas las posiciones
+  pool.parallel_for((int) primitives.size(), [&](int p) {
+    const Primitive &prim = primitives[p];
+    if (!prim.has_normal)
+      smooth_normals(&mesh.vertices[prim.first_vertex * MESH_VERTEX_FLOATS], prim.position.count,
+                     &mesh.indices[prim.first_index], prim.index_count, (uint32_t) prim.first_vertex, NULL);
+  });
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+
+MeshLoader::MeshLoader(int threads) : pool(threads) {
+}
+
+bool MeshLoader::load(const char *path, MeshData &mesh) {
+  MeshLoadStats stats = MeshLoadStats();
+  stats.path = path;
+  stats.format = has_suffix(stats.path, ".obj") ? "OBJ" : has_suffix(stats.path, ".glb") ? "GLB" :
+                 has_suffix(stats.path, ".gltf") ? "glTF" : "?";
+  mesh = MeshData();
+
+  Clock::time_point start = Clock::now();
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    fprintf(stderr, "ERROR: could not open %s\n", path);
+  } else if (has_suffix(stats.path, ".obj")) {
+    stats.ok = load_obj(fp, mesh, stats);
+  } else if (has_suffix(stats.path, ".gltf") || has_suffix(stats.path, ".glb")) {
+    stats.ok = load_gltf(fp, stats.path, has_suffix(stats.path, ".glb"), mesh, stats);
+  } else {
+    fprintf(stderr, "ERROR: %s: unknown mesh format (.obj, .gltf or .glb)\n", path);
+  }
+  if (fp)
+    fclose(fp);
+  stats.total_ms = ms_since(start);
+  stats.parse_ms = stats.total_ms - stats.read_ms;
+
+  if (stats.ok && mesh.indices.empty()) {
+    fprintf(stderr, "ERROR: %s has no triangles\n", path);
+    stats.ok = false;
+  }
+  if (!stats.ok)
+    mesh = MeshData();
+  stats.vertices = mesh.vertex_count();
+  stats.triangles = mesh.triangle_count();
+  results.push_back(stats);
+  return stats.ok;
+}
+
+void MeshLoader::print_stats() const {
+  const double MB = 1024.0 * 1024.0;
+  size_t bytes = 0;
+  double total = 0.0;
+  for (const MeshLoadStats &s : results) {
+    printf("Mesh %s: %s %.2f MB, %d triangles, %d vertices (%d corners)  read %.2f ms  parse %.2f ms  "
+           "%.1f MB/s%s\n",
+           s.path.c_str(), s.format, s.file_bytes / MB, s.triangles, s.vertices, s.corners, s.read_ms,
+           s.parse_ms, s.total_ms > 0.0 ? s.file_bytes / MB / (s.total_ms / 1000.0) : 0.0,
+           s.ok ? "" : "  (FAILED)");
+    bytes += s.file_bytes;
+    total += s.total_ms;
+  }
+  if (results.size() > 1)
+    printf("Meshes: %zu on %d threads, %.2f MB in %.2f ms (%.1f MB/s)\n", results.size(), pool.size(),
+           bytes / MB, total, total > 0.0 ? bytes / MB / (total / 1000.0) : 0.0);
+}
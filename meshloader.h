@@ -0,0 +1,91 @@
+// meshloader.h: carga de mallas OBJ y glTF 2.0 (.gltf y .glb)
+//
+// MeshLoader::load() lee el fichero por bloques y los hilos del pool van
+// parseando los bloques ya leidos mientras llega el siguiente. En OBJ cada
+// bloque acaba en un fin de linea y se parsea por separado; los indices
+// (tambien los negativos, relativos al final de lo leido) se resuelven al
+// juntar los bloques. En glTF el JSON es pequeno y lo que se reparte son las
+// primitivas. Los numeros se leen con parse_float(), sin strtod ni locale.
+//
+// El resultado es siempre una malla indexada en el formato de los shaders:
+// 8 floats por vertice (posicion, normal y coordenadas de textura). En OBJ
+// las esquinas con los mismos v/vt/vn se unen en un vertice con una tabla
+// hash. Si no hay normales se calculan suavizadas (media de las caras
+// ponderada por area). De glTF se cogen las primitivas de triangulos de la
+// escena con las transformaciones de sus nodos; los materiales no.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "threadpool.h"
+
+const int MESH_VERTEX_FLOATS = 8;
+
+struct MeshData {
+  std::vector<float> vertices;    // MESH_VERTEX_FLOATS por vertice
+  std::vector<uint32_t> indices;  // 3 por triangulo
+
+  int vertex_count() const { return (int) (vertices.size() / MESH_VERTEX_FLOATS); }
+  int triangle_count() const { return (int) (indices.size() / 3); }
+};
+
+struct MeshLoadStats {
+  std::string path;
+  const char *format;
+  size_t file_bytes;
+  int vertices, triangles;
+  int corners;       // esquinas de triangulo en el fichero antes de unirlas
+  bool ok;
+  double read_ms;    // fread de todos los bloques (se solapa con el parseo)
+  double parse_ms;   // desde el primer bloque hasta la malla indexada
+  double total_ms;
+};
+
+class MeshLoader {
+public:
+  // threads == 0: un hilo por nucleo
+  explicit MeshLoader(int threads = 0);
+
+  // El formato sale de la extension (.obj, .gltf o .glb). No toca GL
+  bool load(const char *path, MeshData &mesh);
+
+  const std::vector<MeshLoadStats> &stats() const { return results; }
+  void print_stats() const;
+
+private:
+  bool load_obj(FILE *fp, MeshData &mesh, MeshLoadStats &stats);
+  bool load_gltf(FILE *fp, const std::string &path, bool binary, MeshData &mesh, MeshLoadStats &stats);
+
+  ThreadPool pool;
+  std::vector<MeshLoadStats> results;
+};
+
+// Lee un numero decimal ([+-]digitos[.digitos][e[+-]digitos]) desde p sin
+// pasar de end. Devuelve donde acaba, o p si no hay numero
+const char *parse_float(const char *p, const char *end, float *out);
+
+// Centra la caja de la malla en el origen y la escala para que el vertice
+// mas lejano quede a distancia radius
+void normalize_mesh(MeshData &mesh, float radius);
+
+// La misma malla sin indices (3 vertices por triangulo), para los caminos
+// que dibujan con glDrawArrays
+std::vector<float> mesh_triangles(const MeshData &mesh);
+
+// Buffers de la malla en el VAO enlazado, con los atributos 0-2 como vao y
+// vao2 de la escena
+struct MeshBuffers {
+  GLuint vbo, ebo;
+  int index_count;
+};
+MeshBuffers upload_mesh(const MeshData &mesh);
+
+#endif
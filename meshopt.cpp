@@ -0,0 +1,299 @@
+// meshopt.cpp: indexado y orden de mallas (ver meshopt.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "meshopt.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+MeshData index_triangles(const float *vertices, int count) {
+  // Tabla hash con direccionamiento abierto sobre los bits de los 8 floats
+  MeshData mesh;
+  size_t capacity = 16;
+  while (capacity < 2 * (size_t) count)
+    capacity *= 2;
+  std::vector<int> table(capacity, -1);
+  mesh.indices.resize(count);
+  for (int c = 0; c < count; c++) {
+    const float *key = &vertices[MESH_VERTEX_FLOATS * c];
+    uint32_t h = 2166136261u;
+    const unsigned char *bytes = (const unsigned char *) key;
+    for (size_t b = 0; b < MESH_VERTEX_FLOATS * sizeof(float); b++)
+      h = (h ^ bytes[b]) * 16777619u;
+    size_t slot = h & (capacity - 1);
+    for (;;) {
+      int vertex = table[slot];
+      if (vertex < 0) {
+        vertex = mesh.vertex_count();
+        mesh.vertices.insert(mesh.vertices.end(), key, key + MESH_VERTEX_FLOATS);
+        table[slot] = vertex;
+        mesh.indices[c] = (uint32_t) vertex;
+        break;
+      }
+      if (memcmp(&mesh.vertices[MESH_VERTEX_FLOATS * vertex], key, MESH_VERTEX_FLOATS * sizeof(float)) == 0) {
+        mesh.indices[c] = (uint32_t) vertex;
+        break;
+      }
+      slot = (slot + 1) & (capacity - 1);
+    }
+  }
+  return mesh;
+}
+
+// Paso 1: orden para la cache de vertices (Tom Forsyth, "Linear-speed vertex
+// cache optimisation"). La cache LRU que se simula es mas grande que la FIFO
+// de vertex_cache_stats(); el orden sirve igual para cualquier tamano
+static const int FORSYTH_CACHE = 32;
+
+static float vertex_score(int cache_position, int remaining) {
+  if (remaining == 0)
+    return -1.0f;
+  float score = 0.0f;
+  if (cache_position >= 0) {
+    // Los 3 del ultimo triangulo puntuan igual: da lo mismo cual se reuse
+    if (cache_position < 3)
+      score = 0.75f;
+    else
+      score = powf(1.0f - (float) (cache_position - 3) / (FORSYTH_CACHE - 3), 1.5f);
+  }
+  // Los vertices con pocos triangulos pendientes, antes: si no, se quedan
+  // sueltos y hay que volver a transformarlos al final
+  return score + 2.0f / sqrtf((float) remaining);
+}
+
+static std::vector<uint32_t> optimize_vertex_cache(const std::vector<uint32_t> &indices, int vertex_count) {
+  int triangle_count = (int) indices.size() / 3;
+
+  // Triangulos de cada vertice, los pendientes al principio de su lista
+  std::vector<int> offsets(vertex_count + 1, 0), remaining(vertex_count, 0);
+  for (uint32_t v : indices)
+    remaining[v]++;
+  for (int v = 0; v < vertex_count; v++)
+    offsets[v + 1] = offsets[v] + remaining[v];
+  std::vector<int> adjacency(indices.size()), filled(offsets.begin(), offsets.end() - 1);
+  for (int t = 0; t < triangle_count; t++)
+    for (int k = 0; k < 3; k++)
+      adjacency[filled[indices[3 * t + k]]++] = t;
+
+  std::vector<int> cache_position(vertex_count, -1);
+  std::vector<float> score(vertex_count);
+  for (int v = 0; v < vertex_count; v++)
+    score[v] = vertex_score(-1, remaining[v]);
+
+  std::vector<char> emitted(triangle_count, 0);
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  std::vector<int> cache, next_cache;
+  int best = -1, cursor = 0;
+  for (int done = 0; done < triangle_count; done++) {
+    if (best < 0) {
+      // Nada en la cache tiene triangulos pendientes: el siguiente sin emitir
+      while (emitted[cursor])
+        cursor++;
+      best = cursor;
+    }
+    const uint32_t *tri = &indices[3 * best];
+    emitted[best] = 1;
+    result.insert(result.end(), tri, tri + 3);
+
+    // El triangulo sale de las listas de pendientes de sus vertices
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = tri[k];
+      int *list = &adjacency[offsets[v]];
+      int n = remaining[v];
+      for (int i = 0; i < n; i++) {
+        if (list[i] == best) {
+          list[i] = list[n - 1];
+          break;
+        }
+      }
+      remaining[v]--;
+    }
+
+    // Los 3 vertices pasan al principio de la cache LRU
+    next_cache.assign(tri, tri + 3);
+    for (int v : cache)
+      if (v != (int) tri[0] && v != (int) tri[1] && v != (int) tri[2])
+        next_cache.push_back(v);
+    cache.swap(next_cache);
+    for (size_t i = 0; i < cache.size(); i++) {
+      int v = cache[i];
+      cache_position[v] = i < (size_t) FORSYTH_CACHE ? (int) i : -1;
+      score[v] = vertex_score(cache_position[v], remaining[v]);
+    }
+
+    // Nuevas puntuaciones de los triangulos que tocan la cache; el mejor es
+    // el siguiente
+    best = -1;
+    float best_score = -1.0f;
+    for (int v : cache) {
+      for (int i = 0; i < remaining[v]; i++) {
+        int t = adjacency[offsets[v] + i];
+        float s = score[indices[3 * t]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+        if (s > best_score) {
+          best_score = s;
+          best = t;
+        }
+      }
+    }
+    if (cache.size() > (size_t) FORSYTH_CACHE)
+      cache.resize(FORSYTH_CACHE);
+  }
+  return result;
+}
+
+// Paso 2: los clusters. Un triangulo con sus 3 vertices fuera de la cache
+// FIFO empieza uno (corte gratis); dentro de cada uno tambien se corta
+// cuando el ACMR de lo que va del trozo no pasa de threshold veces el del
+// cluster entero
+static const int OVERDRAW_CACHE = 16;
+
+static void find_clusters(const std::vector<uint32_t> &indices, int vertex_count, float threshold,
+                          std::vector<int> &clusters) {
+  int triangle_count = (int) indices.size() / 3;
+  std::vector<int> hard;
+  std::vector<int> cache_time(vertex_count, -OVERDRAW_CACHE - 1);
+  int time = 0;
+  for (int t = 0; t < triangle_count; t++) {
+    int misses = 0;
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = indices[3 * t + k];
+      if (time - cache_time[v] >= OVERDRAW_CACHE) {
+        cache_time[v] = time++;
+        misses++;
+      }
+    }
+    if (t == 0 || misses == 3)
+      hard.push_back(t);
+  }
+  hard.push_back(triangle_count);
+
+  std::fill(cache_time.begin(), cache_time.end(), -OVERDRAW_CACHE - 1);
+  time = 0;
+  for (size_t c = 0; c + 1 < hard.size(); c++) {
+    int start = hard[c], end = hard[c + 1];
+    // ACMR del cluster entero con la cache vacia al empezar
+    int misses = 0;
+    time += OVERDRAW_CACHE + 1;
+    for (int t = start; t < end; t++)
+      for (int k = 0; k < 3; k++)
+        if (time - cache_time[indices[3 * t + k]] >= OVERDRAW_CACHE)
+          cache_time[indices[3 * t + k]] = time++, misses++;
+    float cluster_acmr = (float) misses / (end - start);
+
+    clusters.push_back(start);
+    misses = 0;
+    int first = start;
+    time += OVERDRAW_CACHE + 1;
+    for (int t = start; t < end; t++) {
+      for (int k = 0; k < 3; k++)
+        if (time - cache_time[indices[3 * t + k]] >= OVERDRAW_CACHE)
+          cache_time[indices[3 * t + k]] = time++, misses++;
+      if (t + 1 < end && (float) misses / (t + 1 - first) <= cluster_acmr * threshold) {
+        clusters.push_back(t + 1);
+        first = t + 1;
+        misses = 0;
+        time += OVERDRAW_CACHE + 1;
+      }
+    }
+  }
+  clusters.push_back(triangle_count);
+}
+
+static std::vector<uint32_t> optimize_overdraw(const std::vector<uint32_t> &indices, const std::vector<float> &vertices,
+                                               float threshold) {
+  std::vector<int> clusters;
+  find_clusters(indices, (int) (vertices.size() / MESH_VERTEX_FLOATS), threshold, clusters);
+  int cluster_count = (int) clusters.size() - 1;
+
+  // Centro y normal (sumas ponderadas por area) de cada cluster y de la malla
+  std::vector<glm::vec3> centroid(cluster_count, glm::vec3(0.0f)), normal(cluster_count, glm::vec3(0.0f));
+  std::vector<float> area(cluster_count, 0.0f);
+  glm::vec3 mesh_centroid(0.0f);
+  float mesh_area = 0.0f;
+  for (int c = 0; c < cluster_count; c++) {
+    for (int t = clusters[c]; t < clusters[c + 1]; t++) {
+      glm::vec3 p[3];
+      for (int k = 0; k < 3; k++) {
+        const float *v = &vertices[MESH_VERTEX_FLOATS * indices[3 * t + k]];
+        p[k] = glm::vec3(v[0], v[1], v[2]);
+      }
+      glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+      float a = glm::length(n);
+      centroid[c] += (p[0] + p[1] + p[2]) * (a / 3.0f);
+      normal[c] += n;
+      area[c] += a;
+    }
+    mesh_centroid += centroid[c];
+    mesh_area += area[c];
+    if (area[c] > 0.0f)
+      centroid[c] /= area[c];
+  }
+  if (mesh_area > 0.0f)
+    mesh_centroid /= mesh_area;
+
+  // Los que miran hacia fuera desde mas lejos del centro, primero: son los
+  // que suelen tapar a los demas
+  std::vector<float> sort_key(cluster_count, 0.0f);
+  for (int c = 0; c < cluster_count; c++) {
+    float length = glm::length(normal[c]);
+    if (length > 0.0f)
+      sort_key[c] = glm::dot(centroid[c] - mesh_centroid, normal[c] / length);
+  }
+  std::vector<int> order(cluster_count);
+  for (int c = 0; c < cluster_count; c++)
+    order[c] = c;
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return sort_key[a] > sort_key[b]; });
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (int c : order)
+    result.insert(result.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * clusters[c + 1]);
+  return result;
+}
+
+// Paso 3: vertices en orden de primer uso (los que no usa nadie se quitan)
+static void optimize_vertex_fetch(MeshData &mesh) {
+  std::vector<int> remap(mesh.vertex_count(), -1);
+  std::vector<float> vertices;
+  vertices.reserve(mesh.vertices.size());
+  for (uint32_t &index : mesh.indices) {
+    if (remap[index] < 0) {
+      remap[index] = (int) (vertices.size() / MESH_VERTEX_FLOATS);
+      const float *v = &mesh.vertices[MESH_VERTEX_FLOATS * index];
+      vertices.insert(vertices.end(), v, v + MESH_VERTEX_FLOATS);
+    }
+    index = (uint32_t) remap[index];
+  }
+  mesh.vertices.swap(vertices);
+}
+
+void optimize_mesh(MeshData &mesh, float overdraw_threshold) {
+  if (mesh.indices.empty())
+    return;
+  mesh.indices = optimize_vertex_cache(mesh.indices, mesh.vertex_count());
+  mesh.indices = optimize_overdraw(mesh.indices, mesh.vertices, overdraw_threshold);
+  optimize_vertex_fetch(mesh);
+}
+
+VertexCacheStats vertex_cache_stats(const MeshData &mesh, int cache_size) {
+  // FIFO: un vertice sigue en la cache mientras no hayan entrado cache_size
+  // vertices despues de el
+  std::vector<int> cache_time(mesh.vertex_count(), -1);
+  int time = 0, unique = 0;
+  for (uint32_t v : mesh.indices) {
+    if (cache_time[v] < 0)
+      unique++;
+    if (cache_time[v] < 0 || time - cache_time[v] >= cache_size)
+      cache_time[v] = time++;
+  }
+  VertexCacheStats stats;
+  stats.transformed = time;
+  stats.acmr = mesh.triangle_count() > 0 ? (float) time / mesh.triangle_count() : 0.0f;
+  stats.atvr = unique > 0 ? (float) time / unique : 0.0f;
+  return stats;
+}
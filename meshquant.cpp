@@ -0,0 +1,193 @@
+// meshquant.cpp: formato de vertice compacto (ver meshquant.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "meshquant.h"
+
+#include <math.h>
+#include <stddef.h>
+
+#include <algorithm>
+
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex tiene que ocupar 12 bytes");
+
+static const float POSITION_STEPS = 32767.0f;
+static const float UV_STEPS = 65535.0f;
+static const float NORMAL_STEPS = 127.0f;
+
+QuantRange quant_range(const MeshData &mesh) {
+  glm::vec3 lo(0.0f), hi(0.0f);
+  glm::vec2 uv_lo(0.0f), uv_hi(0.0f);
+  for (int v = 0; v < mesh.vertex_count(); v++) {
+    const float *p = &mesh.vertices[MESH_VERTEX_FLOATS * v];
+    glm::vec3 position(p[0], p[1], p[2]);
+    glm::vec2 uv(p[6], p[7]);
+    lo = v == 0 ? position : glm::min(lo, position);
+    hi = v == 0 ? position : glm::max(hi, position);
+    uv_lo = v == 0 ? uv : glm::min(uv_lo, uv);
+    uv_hi = v == 0 ? uv : glm::max(uv_hi, uv);
+  }
+
+  // Un eje sin extension (malla plana) se queda con cualquier escala
+  QuantRange range;
+  glm::vec3 half = 0.5f * (hi - lo);
+  glm::vec2 uv_size = uv_hi - uv_lo;
+  for (int k = 0; k < 3; k++)
+    half[k] = half[k] > 0.0f ? half[k] : 1.0f;
+  for (int k = 0; k < 2; k++)
+    uv_size[k] = uv_size[k] > 0.0f ? uv_size[k] : 1.0f;
+  range.position_offset = glm::vec4(0.5f * (lo + hi), 0.0f);
+  range.position_scale = glm::vec4(half / POSITION_STEPS, 0.0f);
+  range.uv = glm::vec4(uv_lo, uv_size / UV_STEPS);
+  return range;
+}
+
+QuantRange merge_ranges(const QuantRange &a, const QuantRange &b) {
+  glm::vec3 lo = glm::min(glm::vec3(a.position_offset - a.position_scale * POSITION_STEPS),
+                          glm::vec3(b.position_offset - b.position_scale * POSITION_STEPS));
+  glm::vec3 hi = glm::max(glm::vec3(a.position_offset + a.position_scale * POSITION_STEPS),
+                          glm::vec3(b.position_offset + b.position_scale * POSITION_STEPS));
+  glm::vec2 uv_lo = glm::min(glm::vec2(a.uv), glm::vec2(b.uv));
+  glm::vec2 uv_hi = glm::max(glm::vec2(a.uv) + glm::vec2(a.uv.z, a.uv.w) * UV_STEPS,
+                             glm::vec2(b.uv) + glm::vec2(b.uv.z, b.uv.w) * UV_STEPS);
+
+  QuantRange range;
+  range.position_offset = glm::vec4(0.5f * (lo + hi), 0.0f);
+  range.position_scale = glm::vec4(0.5f * (hi - lo) / POSITION_STEPS, 0.0f);
+  range.uv = glm::vec4(uv_lo, (uv_hi - uv_lo) / UV_STEPS);
+  return range;
+}
+
+// Igual que oct_decode() en spinningcube_withlight_vs_SKEL.glsl
+static glm::vec3 decode_normal(int x, int y) {
+  glm::vec3 n(x / NORMAL_STEPS, y / NORMAL_STEPS, 0.0f);
+  n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+  float t = fmaxf(-n.z, 0.0f);
+  n.x += n.x >= 0.0f ? -t : t;
+  n.y += n.y >= 0.0f ? -t : t;
+  return glm::normalize(n);
+}
+
+// Proyeccion octaedrica y, de los 4 redondeos posibles, el que decodifica
+// mas cerca de la normal original
+static void encode_normal(glm::vec3 n, int8_t *out) {
+  float length = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+  if (length == 0.0f) {
+    out[0] = out[1] = 0;
+    return;
+  }
+  n /= length;
+  glm::vec2 e(n.x, n.y);
+  if (n.z < 0.0f) {
+    e.x = (1.0f - fabsf(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+    e.y = (1.0f - fabsf(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  glm::vec3 target = glm::normalize(n);
+  float best = -2.0f;
+  for (int c = 0; c < 4; c++) {
+    int x = (int) (c & 1 ? ceilf(e.x * NORMAL_STEPS) : floorf(e.x * NORMAL_STEPS));
+    int y = (int) (c & 2 ? ceilf(e.y * NORMAL_STEPS) : floorf(e.y * NORMAL_STEPS));
+    x = std::max(-127, std::min(127, x));
+    y = std::max(-127, std::min(127, y));
+    float d = glm::dot(decode_normal(x, y), target);
+    if (d > best) {
+      best = d;
+      out[0] = (int8_t) x;
+      out[1] = (int8_t) y;
+    }
+  }
+}
+
+PackedMesh pack_mesh(const MeshData &mesh, const QuantRange &range) {
+  PackedMesh packed;
+  packed.range = range;
+  packed.indices = mesh.indices;
+  packed.vertices.resize(mesh.vertex_count());
+  for (int v = 0; v < mesh.vertex_count(); v++) {
+    const float *p = &mesh.vertices[MESH_VERTEX_FLOATS * v];
+    PackedVertex &out = packed.vertices[v];
+    for (int k = 0; k < 3; k++) {
+      float q = roundf((p[k] - range.position_offset[k]) / range.position_scale[k]);
+      out.position[k] = (int16_t) std::max(-POSITION_STEPS, std::min(POSITION_STEPS, q));
+    }
+    encode_normal(glm::vec3(p[3], p[4], p[5]), out.normal);
+    for (int k = 0; k < 2; k++) {
+      float q = roundf((p[6 + k] - range.uv[k]) / range.uv[2 + k]);
+      out.uv[k] = (uint16_t) std::max(0.0f, std::min(UV_STEPS, q));
+    }
+  }
+  return packed;
+}
+
+PackedMesh pack_mesh(const MeshData &mesh) {
+  return pack_mesh(mesh, quant_range(mesh));
+}
+
+QuantizationError quantization_error(const MeshData &mesh, const PackedMesh &packed) {
+  QuantizationError error = {};
+  const QuantRange &r = packed.range;
+  int count = mesh.vertex_count();
+  if (count == 0)
+    return error;
+
+  glm::vec3 lo(mesh.vertices[0], mesh.vertices[1], mesh.vertices[2]), hi = lo;
+  double position_sum = 0.0, normal_sum = 0.0;
+  for (int v = 0; v < count; v++) {
+    const float *p = &mesh.vertices[MESH_VERTEX_FLOATS * v];
+    const PackedVertex &q = packed.vertices[v];
+    glm::vec3 position(p[0], p[1], p[2]);
+    lo = glm::min(lo, position);
+    hi = glm::max(hi, position);
+
+    glm::vec3 decoded = glm::vec3(r.position_offset) +
+                        glm::vec3(r.position_scale) * glm::vec3(q.position[0], q.position[1], q.position[2]);
+    float distance = glm::length(decoded - position);
+    error.position_max = fmaxf(error.position_max, distance);
+    position_sum += distance;
+
+    glm::vec3 normal(p[3], p[4], p[5]);
+    if (glm::length(normal) > 0.0f) {
+      float d = glm::dot(decode_normal(q.normal[0], q.normal[1]), glm::normalize(normal));
+      float degrees = acosf(fmaxf(-1.0f, fminf(1.0f, d))) * 57.29578f;
+      error.normal_max_deg = fmaxf(error.normal_max_deg, degrees);
+      normal_sum += degrees;
+    }
+
+    for (int k = 0; k < 2; k++)
+      error.uv_max = fmaxf(error.uv_max, fabsf(r.uv[k] + r.uv[2 + k] * q.uv[k] - p[6 + k]));
+  }
+  float diagonal = glm::length(hi - lo);
+  if (diagonal > 0.0f) {
+    error.position_max /= diagonal;
+    error.position_mean = (float) (position_sum / count) / diagonal;
+  }
+  error.normal_mean_deg = (float) (normal_sum / count);
+  return error;
+}
+
+void packed_attrib_pointers() {
+  GLsizei stride = sizeof(PackedVertex);
+  glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, stride, (void *) offsetof(PackedVertex, position));
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(1, 2, GL_BYTE, GL_FALSE, stride, (void *) offsetof(PackedVertex, normal));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_FALSE, stride, (void *) offsetof(PackedVertex, uv));
+  glEnableVertexAttribArray(2);
+}
+
+MeshBuffers upload_packed_mesh(const PackedMesh &mesh) {
+  MeshBuffers buffers;
+  buffers.index_count = (int) mesh.indices.size();
+
+  glGenBuffers(1, &buffers.vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.vbo);
+  glBufferData(GL_ARRAY_BUFFER, mesh.vertex_bytes(), mesh.vertices.data(), GL_STATIC_DRAW);
+  packed_attrib_pointers();
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // El enlace del element array buffer se queda en el VAO
+  glGenBuffers(1, &buffers.ebo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ebo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(),
+               GL_STATIC_DRAW);
+  return buffers;
+}
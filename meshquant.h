@@ -0,0 +1,79 @@
+// meshquant.h: formato de vertice compacto (12 bytes en lugar de 32)
+//
+// Cada vertice de MeshData (8 floats) se guarda como:
+//   - posicion: 3 x int16, la caja de la malla llevada a [-32767, 32767]
+//   - normal: 2 x int8, codificacion octaedrica (la esfera se proyecta en el
+//     octaedro |x| + |y| + |z| = 1 y este se despliega en el cuadrado)
+//   - coordenadas de textura: 2 x uint16 en el rectangulo que ocupan
+// Los atributos se suben sin normalizar (GL los convierte a float tal cual)
+// y el vertex shader, compilado con PACKED_VERTICES, los pasa a su rango con
+// la transformacion de la malla (QuantRange, uniform mesh_dequant). Asi no
+// depende de como convierte cada version de GL los snorm.
+//
+// pack_mesh() elige el redondeo de cada normal que menos se desvia, y
+// quantization_error() decodifica como el shader para medir lo que se
+// pierde: error de posicion (relativo al tamano de la malla), angulo de la
+// normal y error de las coordenadas de textura.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef MESHQUANT_H
+#define MESHQUANT_H
+
+#include <GL/glew.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "meshloader.h"
+
+struct PackedVertex {
+  int16_t position[3];
+  int8_t normal[2];
+  uint16_t uv[2];
+};
+
+// Lo que el shader hace con los enteros: posicion = offset + scale * p y
+// coord. de textura = uv.xy + uv.zw * t (normal = oct / 127). Tres vec4
+// seguidos, como el uniform vec4 mesh_dequant[3]
+struct QuantRange {
+  glm::vec4 position_offset;
+  glm::vec4 position_scale;
+  glm::vec4 uv;
+};
+
+struct PackedMesh {
+  std::vector<PackedVertex> vertices;
+  std::vector<uint32_t> indices;
+  QuantRange range;
+
+  size_t vertex_bytes() const { return vertices.size() * sizeof(PackedVertex); }
+};
+
+struct QuantizationError {
+  float position_max;    // respecto a la diagonal de la caja de la malla
+  float position_mean;
+  float normal_max_deg;
+  float normal_mean_deg;
+  float uv_max;          // en unidades de coordenada de textura
+};
+
+// Caja y rectangulo de coordenadas de textura de la malla
+QuantRange quant_range(const MeshData &mesh);
+// El que contiene a los dos, para mallas que comparten buffer y uniform
+QuantRange merge_ranges(const QuantRange &a, const QuantRange &b);
+
+PackedMesh pack_mesh(const MeshData &mesh, const QuantRange &range);
+PackedMesh pack_mesh(const MeshData &mesh);
+
+QuantizationError quantization_error(const MeshData &mesh, const PackedMesh &packed);
+
+// Vertices en el VAO enlazado (atributos 0-2 como upload_mesh(), con los
+// tipos enteros) y los indices en su element array buffer
+MeshBuffers upload_packed_mesh(const PackedMesh &mesh);
+
+// Atributos 0-2 del formato compacto desde el GL_ARRAY_BUFFER enlazado
+void packed_attrib_pointers();
+
+#endif
@@ -0,0 +1,428 @@
+// occlusion.cpp: occlusion culling por software (ver occlusion.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "occlusion.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double ms_since(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Mascara de un tile: sus 4 filas de 32 bits en un registro SSE2
+#ifdef __SSE2__
+typedef __m128i TileMask;
+
+static inline TileMask load_mask(const uint32_t *rows) {
+  return _mm_loadu_si128((const __m128i *) rows);
+}
+static inline void store_mask(uint32_t *rows, TileMask m) {
+  _mm_storeu_si128((__m128i *) rows, m);
+}
+static inline TileMask empty_mask() { return _mm_setzero_si128(); }
+static inline TileMask mask_or(TileMask a, TileMask b) { return _mm_or_si128(a, b); }
+static inline TileMask mask_and(TileMask a, TileMask b) { return _mm_and_si128(a, b); }
+// ~a & b
+static inline TileMask mask_andnot(TileMask a, TileMask b) { return _mm_andnot_si128(a, b); }
+
+static bool any_bit(TileMask v) {
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) != 0xFFFF;
+}
+static bool all_bits(TileMask v) {
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(-1))) == 0xFFFF;
+}
+#else
+struct TileMask {
+  uint32_t rows[4];
+};
+
+static inline TileMask load_mask(const uint32_t *rows) {
+  TileMask m;
+  for (int r = 0; r < 4; r++)
+    m.rows[r] = rows[r];
+  return m;
+}
+static inline void store_mask(uint32_t *rows, TileMask m) {
+  for (int r = 0; r < 4; r++)
+    rows[r] = m.rows[r];
+}
+static inline TileMask empty_mask() { return TileMask{ { 0u, 0u, 0u, 0u } }; }
+static inline TileMask mask_or(TileMask a, TileMask b) {
+  for (int r = 0; r < 4; r++)
+    a.rows[r] |= b.rows[r];
+  return a;
+}
+static inline TileMask mask_and(TileMask a, TileMask b) {
+  for (int r = 0; r < 4; r++)
+    a.rows[r] &= b.rows[r];
+  return a;
+}
+// ~a & b
+static inline TileMask mask_andnot(TileMask a, TileMask b) {
+  for (int r = 0; r < 4; r++)
+    a.rows[r] = ~a.rows[r] & b.rows[r];
+  return a;
+}
+
+static bool any_bit(TileMask v) {
+  return (v.rows[0] | v.rows[1] | v.rows[2] | v.rows[3]) != 0u;
+}
+static bool all_bits(TileMask v) {
+  return (v.rows[0] & v.rows[1] & v.rows[2] & v.rows[3]) == ~0u;
+}
+#endif
+
+MaskedOcclusion::MaskedOcclusion(int width, int threads) : pool(threads) {
+  tiles_x = std::max(1, (width + TILE_W - 1) / TILE_W);
+}
+
+// Une dos triangulos coplanarios (antihorarios vistos desde fuera) que
+// comparten un lado si el cuadrilatero resultante es convexo
+static bool merge_faces(const glm::vec3 *prev, const glm::vec3 *tri, glm::vec3 *quad) {
+  glm::vec3 n0 = glm::normalize(glm::cross(prev[1] - prev[0], prev[2] - prev[0]));
+  glm::vec3 n1 = glm::normalize(glm::cross(tri[1] - tri[0], tri[2] - tri[0]));
+  if (glm::dot(n0, n1) < 0.9999f)
+    return false;
+
+  // El lado comun va en sentido contrario en cada triangulo; el vertice que
+  // sobra del segundo se mete entre sus dos extremos
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      if (prev[i] != tri[(j + 1) % 3] || prev[(i + 1) % 3] != tri[j])
+        continue;
+      quad[0] = prev[i];
+      quad[1] = tri[(j + 2) % 3];
+      quad[2] = prev[(i + 1) % 3];
+      quad[3] = prev[(i + 2) % 3];
+      for (int k = 0; k < 4; k++) {
+        glm::vec3 turn = glm::cross(quad[(k + 1) % 4] - quad[k], quad[(k + 2) % 4] - quad[(k + 1) % 4]);
+        if (glm::dot(turn, n0) <= 0.0f)
+          return false;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+int MaskedOcclusion::add_mesh(const float *vertices, int count, int stride) {
+  glm::vec3 center(0.0f);
+  for (int i = 0; i < count; i++)
+    center += glm::vec3(vertices[stride * i], vertices[stride * i + 1], vertices[stride * i + 2]);
+  center /= (float) std::max(count, 1);
+
+  Mesh mesh;
+  for (int t = 0; t + 2 < count; t += 3) {
+    Face face;
+    face.count = 3;
+    for (int k = 0; k < 3; k++) {
+      const float *v = vertices + stride * (t + k);
+      face.v[k] = glm::vec3(v[0], v[1], v[2]);
+    }
+    // Antihorario visto desde fuera: la normal se aleja del centro
+    glm::vec3 normal = glm::cross(face.v[1] - face.v[0], face.v[2] - face.v[0]);
+    if (glm::dot(normal, face.v[0] - center) < 0.0f)
+      std::swap(face.v[1], face.v[2]);
+
+    // La pareja puede estar en cualquier sitio: el orden de optimize_mesh()
+    // no deja juntos los dos triangulos de cada cara
+    glm::vec3 quad[4];
+    bool merged = false;
+    for (size_t f = mesh.faces.size(); f-- > 0 && !merged;) {
+      if (mesh.faces[f].count == 3 && merge_faces(mesh.faces[f].v, face.v, quad)) {
+        mesh.faces[f].count = 4;
+        std::copy(quad, quad + 4, mesh.faces[f].v);
+        merged = true;
+      }
+    }
+    if (!merged)
+      mesh.faces.push_back(face);
+  }
+  meshes.push_back(mesh);
+  return (int) meshes.size() - 1;
+}
+
+void MaskedOcclusion::begin_frame(const glm::mat4 &vp, float aspect) {
+  int rows = std::max(1, (int) lroundf((float) width() / aspect / (float) TILE_H));
+  if (rows != tiles_y) {
+    tiles_y = rows;
+    masks.resize((size_t) tiles_x * tiles_y * 4);
+    z0.resize((size_t) tiles_x * tiles_y);
+    z1.resize((size_t) tiles_x * tiles_y);
+  }
+  // Nada dibujado: el fondo de todos los tiles esta en el plano far
+  std::fill(masks.begin(), masks.end(), 0u);
+  std::fill(z0.begin(), z0.end(), 1.0f);
+  std::fill(z1.begin(), z1.end(), 0.0f);
+
+  view_proj = vp;
+  occluders.clear();
+}
+
+void MaskedOcclusion::add_occluder(int mesh, const glm::mat4 &model) {
+  occluders.push_back({ mesh, model });
+}
+
+void MaskedOcclusion::setup_face(const Face &face, const glm::mat4 &mvp, std::vector<ScreenFace> &out) const {
+  float w = (float) width(), h = (float) height();
+  glm::vec3 s[4];
+  for (int k = 0; k < face.count; k++) {
+    glm::vec4 clip = mvp * glm::vec4(face.v[k], 1.0f);
+    // Cruza el plano near (o esta detras de la camara): no se dibuja
+    if (clip.w <= 0.0f || clip.z < -clip.w)
+      return;
+    s[k] = glm::vec3(clip) / clip.w;
+    s[k] = glm::vec3((s[k].x * 0.5f + 0.5f) * w, (s[k].y * 0.5f + 0.5f) * h, s[k].z * 0.5f + 0.5f);
+  }
+
+  // Area con signo: las caras traseras (y las de canto) quedan en <= 0
+  float area = 0.0f;
+  for (int k = 0; k < face.count; k++) {
+    const glm::vec3 &p = s[k], &q = s[(k + 1) % face.count];
+    area += p.x * q.y - q.x * p.y;
+  }
+  if (area <= 0.0f)
+    return;
+
+  ScreenFace f;
+  f.edges = face.count;
+  float min_x = s[0].x, max_x = s[0].x, min_y = s[0].y, max_y = s[0].y;
+  f.zmax = s[0].z;
+  for (int k = 0; k < face.count; k++) {
+    const glm::vec3 &p = s[k], &q = s[(k + 1) % face.count];
+    f.a[k] = p.y - q.y;
+    f.b[k] = q.x - p.x;
+    // Cobertura del pixel entero: el lado se mete medio pixel en cada eje
+    f.c[k] = -(f.a[k] * p.x + f.b[k] * p.y) - 0.5f * (fabsf(f.a[k]) + fabsf(f.b[k]));
+    min_x = std::min(min_x, p.x);
+    max_x = std::max(max_x, p.x);
+    min_y = std::min(min_y, p.y);
+    max_y = std::max(max_y, p.y);
+    f.zmax = std::max(f.zmax, p.z);
+  }
+
+  // Plano de profundidad por los 3 primeros vertices (la z de la ventana es
+  // lineal en pantalla en una cara plana)
+  float dx1 = s[1].x - s[0].x, dy1 = s[1].y - s[0].y, dz1 = s[1].z - s[0].z;
+  float dx2 = s[2].x - s[0].x, dy2 = s[2].y - s[0].y, dz2 = s[2].z - s[0].z;
+  float det = dx1 * dy2 - dx2 * dy1;
+  if (det > 1e-6f) {
+    f.zx = (dz1 * dy2 - dz2 * dy1) / det;
+    f.zy = (dx1 * dz2 - dx2 * dz1) / det;
+    f.z0 = s[0].z - f.zx * s[0].x - f.zy * s[0].y;
+  } else {
+    f.zx = f.zy = 0.0f;
+    f.z0 = f.zmax;
+  }
+
+  f.x0 = std::max(0, (int) floorf(min_x));
+  f.y0 = std::max(0, (int) floorf(min_y));
+  f.x1 = std::min(width() - 1, (int) floorf(max_x));
+  f.y1 = std::min(height() - 1, (int) floorf(max_y));
+  if (f.x0 > f.x1 || f.y0 > f.y1)
+    return;
+  out.push_back(f);
+}
+
+void MaskedOcclusion::raster_tile(const ScreenFace &f, int tx, int ty) {
+  float px0 = (float) (tx * TILE_W), py0 = (float) (ty * TILE_H);
+
+  // Descarte rapido: un lado deja fuera hasta el pixel mas favorable
+  for (int e = 0; e < f.edges; e++) {
+    float x = f.a[e] > 0.0f ? px0 + TILE_W - 0.5f : px0 + 0.5f;
+    float y = f.b[e] > 0.0f ? py0 + TILE_H - 0.5f : py0 + 0.5f;
+    if (f.a[e] * x + f.b[e] * y + f.c[e] < 0.0f)
+      return;
+  }
+
+  // Cobertura: 4 pixeles por instruccion, 8 grupos por fila
+  uint32_t rows[4];
+#ifdef __SSE2__
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  for (int r = 0; r < TILE_H; r++) {
+    float y = py0 + (float) r + 0.5f;
+    __m128 a[4], row_c[4];
+    for (int e = 0; e < f.edges; e++) {
+      a[e] = _mm_set1_ps(f.a[e]);
+      row_c[e] = _mm_set1_ps(f.b[e] * y + f.c[e]);
+    }
+    uint32_t bits = 0;
+    for (int g = 0; g < TILE_W / 4; g++) {
+      __m128 x = _mm_add_ps(lane, _mm_set1_ps(px0 + (float) (4 * g)));
+      __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[0], x), row_c[0]), zero);
+      for (int e = 1; e < f.edges; e++)
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[e], x), row_c[e]), zero));
+      bits |= (uint32_t) _mm_movemask_ps(inside) << (4 * g);
+    }
+    rows[r] = bits;
+  }
+#else
+  for (int r = 0; r < TILE_H; r++) {
+    float y = py0 + (float) r + 0.5f;
+    float row_c[4];
+    for (int e = 0; e < f.edges; e++)
+      row_c[e] = f.b[e] * y + f.c[e];
+    uint32_t bits = 0;
+    for (int i = 0; i < TILE_W; i++) {
+      float x = px0 + (float) i + 0.5f;
+      bool inside = true;
+      for (int e = 0; e < f.edges; e++)
+        inside = inside && f.a[e] * x + row_c[e] >= 0.0f;
+      bits |= (uint32_t) inside << i;
+    }
+    rows[r] = bits;
+  }
+#endif
+  TileMask coverage = load_mask(rows);
+  if (!any_bit(coverage))
+    return;
+
+  // Profundidad mas lejana de la cara en el tile: el plano en las esquinas de
+  // la parte del tile dentro de su caja, sin pasar del vertice mas lejano
+  float cx0 = std::max(px0, (float) f.x0), cx1 = std::min(px0 + TILE_W, (float) (f.x1 + 1));
+  float cy0 = std::max(py0, (float) f.y0), cy1 = std::min(py0 + TILE_H, (float) (f.y1 + 1));
+  float far_z = f.z0 + std::max(f.zx * cx0, f.zx * cx1) + std::max(f.zy * cy0, f.zy * cy1);
+  far_z = std::min(far_z, f.zmax);
+
+  int t = ty * tiles_x + tx;
+  if (far_z >= z0[t])
+    return;  // no tapa mas que lo que ya hay
+
+  uint32_t *mask_ptr = &masks[4 * (size_t) t];
+  TileMask mask = load_mask(mask_ptr);
+  // Si la cara esta mas cerca del fondo que de la capa de trabajo, mezclarla
+  // alejaria toda la capa: se empieza una capa nueva con la cara
+  if (any_bit(mask) && far_z - z1[t] > z0[t] - far_z) {
+    mask = empty_mask();
+    z1[t] = 0.0f;
+  }
+  mask = mask_or(mask, coverage);
+  z1[t] = std::max(z1[t], far_z);
+
+  // Tile lleno: la capa de trabajo pasa a ser el fondo
+  if (all_bits(mask)) {
+    z0[t] = std::min(z0[t], z1[t]);
+    z1[t] = 0.0f;
+    mask = empty_mask();
+  }
+  store_mask(mask_ptr, mask);
+}
+
+void MaskedOcclusion::raster_band(int ty) {
+  int y0 = ty * TILE_H, y1 = y0 + TILE_H - 1;
+  for (const std::vector<ScreenFace> &faces : screen_faces) {
+    for (const ScreenFace &f : faces) {
+      if (f.y1 < y0 || f.y0 > y1)
+        continue;
+      for (int tx = f.x0 / TILE_W; tx <= f.x1 / TILE_W; tx++)
+        raster_tile(f, tx, ty);
+    }
+  }
+}
+
+void MaskedOcclusion::rasterize() {
+  Clock::time_point start = Clock::now();
+
+  // Caras de cada oclusor a pixeles, y despues una franja de tiles por tarea
+  screen_faces.resize(occluders.size());
+  pool.parallel_for((int) occluders.size(), [&](int i) {
+    glm::mat4 mvp = view_proj * occluders[i].model;
+    screen_faces[i].clear();
+    for (const Face &face : meshes[occluders[i].mesh].faces)
+      setup_face(face, mvp, screen_faces[i]);
+  });
+  pool.parallel_for(tiles_y, [&](int ty) { raster_band(ty); });
+
+  frames++;
+  total_occluders += occluders.size();
+  raster_ms += ms_since(start);
+}
+
+bool MaskedOcclusion::visible(glm::vec3 lo, glm::vec3 hi) const {
+  glm::vec3 ndc_lo(0.0f), ndc_hi(0.0f);
+  for (int i = 0; i < 8; i++) {
+    glm::vec3 corner((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z);
+    glm::vec4 clip = view_proj * glm::vec4(corner, 1.0f);
+    if (clip.w <= 0.0f || clip.z < -clip.w)
+      return true;  // cruza el plano near
+    glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    ndc_lo = i == 0 ? ndc : glm::min(ndc_lo, ndc);
+    ndc_hi = i == 0 ? ndc : glm::max(ndc_hi, ndc);
+  }
+
+  // Todos los pixeles que toca el rectangulo
+  int x0 = std::max(0, (int) floorf((ndc_lo.x * 0.5f + 0.5f) * width()));
+  int y0 = std::max(0, (int) floorf((ndc_lo.y * 0.5f + 0.5f) * height()));
+  int x1 = std::min(width() - 1, (int) floorf((ndc_hi.x * 0.5f + 0.5f) * width()));
+  int y1 = std::min(height() - 1, (int) floorf((ndc_hi.y * 0.5f + 0.5f) * height()));
+  if (x0 > x1 || y0 > y1)
+    return true;  // fuera del buffer: decide el frustum
+  float nearest = ndc_lo.z * 0.5f + 0.5f;
+
+  for (int ty = y0 / TILE_H; ty <= y1 / TILE_H; ty++) {
+    for (int tx = x0 / TILE_W; tx <= x1 / TILE_W; tx++) {
+      int t = ty * tiles_x + tx;
+      // Pixeles del rectangulo dentro del tile
+      int b0 = std::max(x0 - tx * TILE_W, 0), b1 = std::min(x1 - tx * TILE_W, TILE_W - 1);
+      uint32_t span = ((2u << b1) - 1u) & ~((1u << b0) - 1u);
+      uint32_t rows[4];
+      for (int r = 0; r < TILE_H; r++) {
+        int y = ty * TILE_H + r;
+        rows[r] = y >= y0 && y <= y1 ? span : 0u;
+      }
+      TileMask rect = load_mask(rows);
+      TileMask mask = load_mask(&masks[4 * (size_t) t]);
+
+      // Fuera de la mascara solo vale el fondo; dentro, la capa de trabajo
+      if (any_bit(mask_andnot(mask, rect)) && nearest <= z0[t])
+        return true;
+      if (any_bit(mask_and(mask, rect)) && nearest <= std::min(z0[t], z1[t]))
+        return true;
+    }
+  }
+  return false;
+}
+
+void MaskedOcclusion::cull(std::vector<int> &ids, const std::vector<glm::vec3> &lo,
+                           const std::vector<glm::vec3> &hi) {
+  Clock::time_point start = Clock::now();
+
+  const int CHUNK = 256;
+  std::vector<char> keep(ids.size());
+  int chunks = (int) ((ids.size() + CHUNK - 1) / CHUNK);
+  pool.parallel_for(chunks, [&](int c) {
+    size_t end = std::min(ids.size(), (size_t) (c + 1) * CHUNK);
+    for (size_t i = (size_t) c * CHUNK; i < end; i++)
+      keep[i] = visible(lo[ids[i]], hi[ids[i]]);
+  });
+
+  size_t kept = 0;
+  for (size_t i = 0; i < ids.size(); i++)
+    if (keep[i])
+      ids[kept++] = ids[i];
+  total_tested += ids.size();
+  total_hidden += ids.size() - kept;
+  ids.resize(kept);
+
+  test_ms += ms_since(start);
+}
+
+void MaskedOcclusion::print_stats() const {
+  if (frames == 0)
+    return;
+  printf("Occlusion: %dx%d buffer, %.1f occluders/frame, raster %.3f ms, test %.3f ms/frame\n", width(),
+         height(), (double) total_occluders / frames, raster_ms / frames, test_ms / frames);
+  printf("Occlusion: %.1f of %.1f objects in the frustum hidden per frame\n", (double) total_hidden / frames,
+         (double) total_tested / frames);
+}
@@ -0,0 +1,109 @@
+// occlusion.h: occlusion culling por software (masked occlusion culling)
+//
+// Los oclusores grandes se rasterizan en la CPU a baja resolucion en un
+// buffer de tiles de 32x4 pixeles. Cada tile guarda una mascara de cobertura
+// (un bit por pixel, 4 filas de 32 bits: un registro SSE2) y dos
+// profundidades: z0, la mas lejana de todo el tile, y z1, la mas lejana de
+// los pixeles marcados en la mascara. Cada cara nueva se mezcla con el tile
+// sin guardar una profundidad por pixel; cuando la mascara se llena, z1 pasa
+// a ser el fondo del tile y la mascara se vacia.
+//
+// Las caras se rasterizan de forma conservadora hacia dentro: solo se marca
+// un pixel si la cara lo cubre entero, y la profundidad de la cara en el
+// tile es la mas lejana de su plano. Los triangulos coplanarios que comparten
+// un lado (las caras del cubo) se unen al anadir la malla en un poligono
+// convexo, para que la diagonal no deje pixeles sin marcar. Las caras
+// traseras y las que cruzan el plano near no se dibujan.
+//
+// rasterize() reparte las filas de tiles entre los hilos del pool (cada
+// hilo dibuja todas las caras en su franja) y cull() prueba las cajas (AABB)
+// de los objetos en paralelo: un objeto esta tapado si en todos los pixeles
+// que toca su rectangulo en pantalla el oclusor esta mas cerca que su punto
+// mas cercano. No necesita GPU.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "threadpool.h"
+
+class MaskedOcclusion {
+public:
+  // Ancho del buffer en pixeles (se redondea a tiles); el alto sale de la
+  // proporcion del viewport. threads == 0: un hilo por nucleo
+  explicit MaskedOcclusion(int width = 256, int threads = 0);
+
+  // Malla convexa de triangulos (la posicion son los 3 primeros floats de
+  // cada vertice, stride floats por vertice). Devuelve su indice
+  int add_mesh(const float *vertices, int count, int stride);
+
+  // Vacia el buffer para la camara view_proj y un viewport de esa proporcion
+  void begin_frame(const glm::mat4 &view_proj, float aspect);
+  // Oclusor de la malla mesh con esa matriz de modelo; se dibuja en rasterize()
+  void add_occluder(int mesh, const glm::mat4 &model);
+  void rasterize();
+
+  // Caja [lo, hi] de algun objeto visible tras los oclusores
+  bool visible(glm::vec3 lo, glm::vec3 hi) const;
+  // Quita de ids los objetos tapados (cajas lo[id], hi[id]); mantiene el orden
+  void cull(std::vector<int> &ids, const std::vector<glm::vec3> &lo, const std::vector<glm::vec3> &hi);
+
+  int width() const { return tiles_x * TILE_W; }
+  int height() const { return tiles_y * TILE_H; }
+  void print_stats() const;
+
+  static const int TILE_W = 32, TILE_H = 4;
+
+private:
+  // Poligono convexo de 3 o 4 vertices en el sentido antihorario visto desde
+  // fuera de la malla
+  struct Face {
+    int count;
+    glm::vec3 v[4];
+  };
+  struct Mesh {
+    std::vector<Face> faces;
+  };
+  // Cara ya en pixeles del buffer: lados (a, b, c) con a*x + b*y + c >= 0
+  // dentro (c ya desplazado para que cubra el pixel entero), plano de
+  // profundidad y caja en pixeles
+  struct ScreenFace {
+    int edges;
+    float a[4], b[4], c[4];
+    float zx, zy, z0, zmax;
+    int x0, y0, x1, y1;
+  };
+  struct Occluder {
+    int mesh;
+    glm::mat4 model;
+  };
+
+  void setup_face(const Face &face, const glm::mat4 &mvp, std::vector<ScreenFace> &out) const;
+  void raster_band(int band);
+  void raster_tile(const ScreenFace &face, int tx, int ty);
+
+  int tiles_x, tiles_y = 0;
+  glm::mat4 view_proj;
+  std::vector<Mesh> meshes;
+  std::vector<Occluder> occluders;
+  std::vector<std::vector<ScreenFace>> screen_faces;  // de cada oclusor
+
+  // Tiles: mascara (4 filas de 32 bits, 16 bytes alineados) y z0, z1
+  std::vector<uint32_t> masks;
+  std::vector<float> z0, z1;
+
+  ThreadPool pool;
+
+  // Estadisticas
+  int frames = 0;
+  long long total_occluders = 0, total_tested = 0, total_hidden = 0;
+  double raster_ms = 0.0, test_ms = 0.0;
+};
+
+#endif
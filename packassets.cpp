@@ -0,0 +1,179 @@
+// packassets.cpp: genera el paquete de recursos que carga --pack
+//
+// El tipo de cada fichero sale de la extension:
+//   - .glsl: shader, el texto tal cual
+//   - .png, .jpg, .tga, .bmp: textura decodificada a RGBA8 con la cadena
+//     completa de mipmaps (filtro de caja, como glGenerateMipmap)
+//   - .dds: textura BCn con sus niveles (ver texcompress)
+//   - .obj, .gltf, .glb: malla indexada y optimizada (meshopt.h)
+// Cada recurso se guarda con la ruta que se le pasa, que es el nombre con
+// el que lo pide el programa.
+//
+//   ./packassets [--no-mesh-opt] salida.pak fichero...
+//////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <chrono>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "assetpack.h"
+#include "bcn.h"
+#include "dds.h"
+#include "meshloader.h"
+#include "meshopt.h"
+#include "textfile_ALT.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static void usage(const char *prog) {
+  printf("Uso: %s [--no-mesh-opt] salida.pak fichero...\n", prog);
+}
+
+static bool has_suffix(const char *s, const char *suffix) {
+  size_t n = strlen(s), m = strlen(suffix);
+  return n >= m && strcasecmp(s + n - m, suffix) == 0;
+}
+
+static bool read_file(const char *path, std::vector<unsigned char> &data) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp)
+    return false;
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  rewind(fp);
+  data.resize(size > 0 ? size : 0);
+  bool ok = size > 0 && fread(data.data(), 1, size, fp) == (size_t) size;
+  fclose(fp);
+  return ok;
+}
+
+static bool pack_shader(AssetPackWriter &pack, const char *path) {
+  char *source = textFileRead(path);
+  if (!source)
+    return false;
+  printf("%s: shader, %zu bytes\n", path, strlen(source));
+  bool ok = pack.add_shader(path, source);
+  free(source);
+  return ok;
+}
+
+// Igual que glTexImage2D con GL_RED / GL_RG / GL_RGB / GL_RGBA
+static bool pack_image(AssetPackWriter &pack, const char *path) {
+  int width, height, comp;
+  unsigned char *pixels = stbi_load(path, &width, &height, &comp, 0);
+  if (!pixels) {
+    printf("Error: no se pudo leer %s (%s)\n", path, stbi_failure_reason());
+    return false;
+  }
+  std::vector<unsigned char> level((size_t) width * height * 4), next;
+  for (size_t i = 0; i < (size_t) width * height; i++) {
+    const unsigned char *src = pixels + i * comp;
+    unsigned char *dst = &level[i * 4];
+    dst[0] = src[0];
+    dst[1] = comp >= 2 ? src[1] : 0;
+    dst[2] = comp >= 3 ? src[2] : 0;
+    dst[3] = comp == 4 ? src[3] : 255;
+  }
+  stbi_image_free(pixels);
+
+  std::vector<std::vector<unsigned char> > levels;
+  size_t bytes = 0;
+  int w = width, h = height;
+  for (;;) {
+    levels.push_back(level);
+    bytes += level.size();
+    if (w == 1 && h == 1)
+      break;
+    bc_downsample(level.data(), w, h, next);
+    level.swap(next);
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+  printf("%s: texture %dx%d RGBA8, %zu levels, %zu KB\n", path, width, height, levels.size(), bytes / 1024);
+  return pack.add_texture(path, BC_NONE, width, height, levels);
+}
+
+static bool pack_dds(AssetPackWriter &pack, const char *path) {
+  std::vector<unsigned char> file;
+  DdsImage dds;
+  if (!read_file(path, file) || !dds_parse(file.data(), file.size(), &dds)) {
+    printf("Error: no se pudo leer %s\n", path);
+    return false;
+  }
+  std::vector<std::vector<unsigned char> > levels;
+  size_t bytes = 0;
+  for (const DdsLevel &level : dds.levels) {
+    levels.push_back(std::vector<unsigned char>(file.begin() + level.offset,
+                                                file.begin() + level.offset + level.size));
+    bytes += level.size;
+  }
+  printf("%s: texture %dx%d %s, %zu levels, %zu KB\n", path, dds.width, dds.height,
+         bc_format_name(dds.format), levels.size(), bytes / 1024);
+  return pack.add_texture(path, dds.format, dds.width, dds.height, levels);
+}
+
+static bool pack_mesh(AssetPackWriter &pack, const char *path, bool optimize) {
+  MeshData mesh;
+  MeshLoader loader;
+  if (!loader.load(path, mesh))
+    return false;
+
+  Clock::time_point start = Clock::now();
+  VertexCacheStats before = vertex_cache_stats(mesh);
+  if (optimize)
+    optimize_mesh(mesh);
+  VertexCacheStats after = vertex_cache_stats(mesh);
+  double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  printf("%s: mesh, %d triangles, %d vertices, ACMR %.3f -> %.3f (%.1f ms)\n", path, mesh.triangle_count(),
+         mesh.vertex_count(), before.acmr, after.acmr, ms);
+  return pack.add_mesh(path, mesh, optimize);
+}
+
+int main(int argc, char **argv) {
+  bool optimize = true;
+  int arg = 1;
+  if (arg < argc && strcmp(argv[arg], "--no-mesh-opt") == 0) {
+    optimize = false;
+    arg++;
+  }
+  if (argc - arg < 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  const char *output = argv[arg++];
+
+  AssetPackWriter pack;
+  for (; arg < argc; arg++) {
+    const char *path = argv[arg];
+    bool ok;
+    if (has_suffix(path, ".glsl"))
+      ok = pack_shader(pack, path);
+    else if (has_suffix(path, ".dds"))
+      ok = pack_dds(pack, path);
+    else if (has_suffix(path, ".obj") || has_suffix(path, ".gltf") || has_suffix(path, ".glb"))
+      ok = pack_mesh(pack, path, optimize);
+    else if (has_suffix(path, ".png") || has_suffix(path, ".jpg") || has_suffix(path, ".tga") ||
+             has_suffix(path, ".bmp"))
+      ok = pack_image(pack, path);
+    else {
+      printf("Error: tipo de fichero desconocido: %s\n", path);
+      ok = false;
+    }
+    if (!ok)
+      return 1;
+  }
+
+  if (!pack.write(output)) {
+    printf("Error: no se pudo escribir %s\n", output);
+    return 1;
+  }
+  printf("-> %s\n", output);
+  return 0;
+}
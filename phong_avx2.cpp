@@ -0,0 +1,62 @@
+// phong_avx2.cpp: kernel Phong con AVX2 + FMA (8 fragmentos por instruccion)
+//
+// Se compila con -mavx2 -mfma (ver makefile); solo se llama si la CPU lo
+// soporta.
+//////////////////////////////////////////////////////////////////////
+
+#include "phong_simd.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct AVX2 {
+  typedef __m256 F;
+  typedef __m256i I;
+  enum { W = 8 };
+
+  static F set1(float v) { return _mm256_set1_ps(v); }
+  static F load(const float *p) { return _mm256_load_ps(p); }
+  static void store(float *p, F v) { _mm256_store_ps(p, v); }
+  static F add(F a, F b) { return _mm256_add_ps(a, b); }
+  static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+  static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+  static F max(F a, F b) { return _mm256_max_ps(a, b); }
+
+  static F rsqrt(F x) {
+    F y = _mm256_rsqrt_ps(x);
+    F half_xyy = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), x), _mm256_mul_ps(y, y));
+    return _mm256_mul_ps(y, _mm256_sub_ps(_mm256_set1_ps(1.5f), half_xyy));
+  }
+
+  static I floor_int(F x, F *fx) {
+    *fx = _mm256_floor_ps(x);
+    return _mm256_cvttps_epi32(*fx);
+  }
+
+  static F exponent(F x) {
+    I e = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+    return _mm256_cvtepi32_ps(_mm256_sub_epi32(e, _mm256_set1_epi32(127)));
+  }
+
+  static F mantissa(F x) {
+    I m = _mm256_and_si256(_mm256_castps_si256(x), _mm256_set1_epi32(0x007fffff));
+    return _mm256_castsi256_ps(_mm256_or_si256(m, _mm256_set1_epi32(0x3f800000)));
+  }
+
+  static F pow2i(I i) {
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(i, _mm256_set1_epi32(127)), 23));
+  }
+
+  static F positive(F x, F r) {
+    return _mm256_and_ps(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_GT_OQ), r);
+  }
+};
+
+#include "phong_simd_kernel.inl"
+
+}
+
+void phong_shade_avx2(const PhongParams &params, PhongFragments &frags) {
+  phong_kernel<AVX2>(params, frags);
+}
@@ -0,0 +1,63 @@
+// phong_avx512.cpp: kernel Phong con AVX-512F (16 fragmentos, un lote
+// completo por instruccion)
+//
+// Se compila con -mavx512f (ver makefile); solo se llama si la CPU lo
+// soporta.
+//////////////////////////////////////////////////////////////////////
+
+#include "phong_simd.h"
+
+#include <immintrin.h>
+
+namespace {
+
+struct AVX512 {
+  typedef __m512 F;
+  typedef __m512i I;
+  enum { W = 16 };
+
+  static F set1(float v) { return _mm512_set1_ps(v); }
+  static F load(const float *p) { return _mm512_load_ps(p); }
+  static void store(float *p, F v) { _mm512_store_ps(p, v); }
+  static F add(F a, F b) { return _mm512_add_ps(a, b); }
+  static F sub(F a, F b) { return _mm512_sub_ps(a, b); }
+  static F mul(F a, F b) { return _mm512_mul_ps(a, b); }
+  static F max(F a, F b) { return _mm512_max_ps(a, b); }
+
+  static F rsqrt(F x) {
+    F y = _mm512_rsqrt14_ps(x);
+    F half_xyy = _mm512_mul_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), x), _mm512_mul_ps(y, y));
+    return _mm512_mul_ps(y, _mm512_sub_ps(_mm512_set1_ps(1.5f), half_xyy));
+  }
+
+  static I floor_int(F x, F *fx) {
+    *fx = _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    return _mm512_cvttps_epi32(*fx);
+  }
+
+  static F exponent(F x) {
+    I e = _mm512_srli_epi32(_mm512_castps_si512(x), 23);
+    return _mm512_cvtepi32_ps(_mm512_sub_epi32(e, _mm512_set1_epi32(127)));
+  }
+
+  static F mantissa(F x) {
+    I m = _mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(0x007fffff));
+    return _mm512_castsi512_ps(_mm512_or_si512(m, _mm512_set1_epi32(0x3f800000)));
+  }
+
+  static F pow2i(I i) {
+    return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(i, _mm512_set1_epi32(127)), 23));
+  }
+
+  static F positive(F x, F r) {
+    return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, _mm512_setzero_ps(), _CMP_GT_OQ), r);
+  }
+};
+
+#include "phong_simd_kernel.inl"
+
+}
+
+void phong_shade_avx512(const PhongParams &params, PhongFragments &frags) {
+  phong_kernel<AVX512>(params, frags);
+}
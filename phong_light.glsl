@@ -0,0 +1,20 @@
+// Una luz de Phong, ver LightStd140 en uniforms.h
+struct Light {
+  vec3 position;
+  vec3 ambient;
+  vec3 diffuse;
+  vec3 specular;
+};
+
+// Suma a result la contribucion de l (ambiente, difusa y especular) en el
+// punto position con normal normal
+void phong_light(Light l, vec3 position, vec3 normal, vec3 view_dir, float shininess,
+                 vec3 diffuse_tex, vec3 specular_tex, inout vec3 result) {
+  vec3 light_dir = normalize(l.position - position);
+  float diff = max(dot(normal, light_dir), 0.0);
+  float spec = pow(max(dot(view_dir, reflect(-light_dir, normal)), 0.0), shininess);
+
+  result += l.ambient * diffuse_tex;
+  result += l.diffuse * diff * diffuse_tex;
+  result += l.specular * spec * specular_tex;
+}
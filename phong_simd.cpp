@@ -0,0 +1,92 @@
+// phong_simd.cpp: referencia escalar y seleccion del kernel (ver phong_simd.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "phong_simd.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Traduccion directa del fragment shader, fragmento a fragmento
+void phong_shade_scalar(const PhongParams &p, PhongFragments &f) {
+  for (int i = 0; i < PHONG_BATCH; i++) {
+    float pos[3] = { f.pos_x[i], f.pos_y[i], f.pos_z[i] };
+    float normal[3] = { f.normal_x[i], f.normal_y[i], f.normal_z[i] };
+    float diffuse_tex[3] = { f.diffuse_r[i], f.diffuse_g[i], f.diffuse_b[i] };
+    float specular_tex[3] = { f.specular_r[i], f.specular_g[i], f.specular_b[i] };
+
+    float view_dir[3];
+    for (int c = 0; c < 3; c++)
+      view_dir[c] = p.view_pos[c] - pos[c];
+    float len = sqrtf(view_dir[0] * view_dir[0] + view_dir[1] * view_dir[1] + view_dir[2] * view_dir[2]);
+    for (int c = 0; c < 3; c++)
+      view_dir[c] /= len;
+
+    float result[3] = { 0.0f, 0.0f, 0.0f };
+    for (int l = 0; l < 2; l++) {
+      const PhongLightParams &light = p.lights[l];
+
+      float light_dir[3];
+      for (int c = 0; c < 3; c++)
+        light_dir[c] = light.position[c] - pos[c];
+      len = sqrtf(light_dir[0] * light_dir[0] + light_dir[1] * light_dir[1] + light_dir[2] * light_dir[2]);
+      for (int c = 0; c < 3; c++)
+        light_dir[c] /= len;
+
+      float n_dot_l = normal[0] * light_dir[0] + normal[1] * light_dir[1] + normal[2] * light_dir[2];
+      float diff = n_dot_l > 0.0f ? n_dot_l : 0.0f;
+
+      float r_dot_v = 0.0f;
+      for (int c = 0; c < 3; c++)
+        r_dot_v += (2.0f * n_dot_l * normal[c] - light_dir[c]) * view_dir[c];
+      float spec = powf(r_dot_v > 0.0f ? r_dot_v : 0.0f, p.shininess);
+
+      for (int c = 0; c < 3; c++)
+        result[c] += light.ambient[c] * diffuse_tex[c] +
+                     light.diffuse[c] * diff * diffuse_tex[c] +
+                     light.specular[c] * spec * specular_tex[c];
+    }
+
+    f.out_r[i] = result[0];
+    f.out_g[i] = result[1];
+    f.out_b[i] = result[2];
+  }
+}
+
+PhongKernel phong_kernel_for(const char *isa) {
+  if (strcmp(isa, "scalar") == 0)
+    return phong_shade_scalar;
+
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (strcmp(isa, "sse2") == 0 && __builtin_cpu_supports("sse2"))
+    return phong_shade_sse2;
+  if (strcmp(isa, "avx2") == 0 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return phong_shade_avx2;
+  if (strcmp(isa, "avx512") == 0 && __builtin_cpu_supports("avx512f"))
+    return phong_shade_avx512;
+#endif
+
+  return NULL;
+}
+
+PhongKernel phong_best_kernel(const char **name) {
+  static const char *isas[] = { "avx512", "avx2", "sse2", "scalar" };
+
+  const char *forced = getenv("PHONG_ISA");
+  if (forced != NULL && phong_kernel_for(forced) != NULL) {
+    if (name)
+      *name = forced;
+    return phong_kernel_for(forced);
+  }
+
+  for (const char *isa : isas) {
+    PhongKernel kernel = phong_kernel_for(isa);
+    if (kernel != NULL) {
+      if (name)
+        *name = isa;
+      return kernel;
+    }
+  }
+  return phong_shade_scalar;
+}
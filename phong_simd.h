@@ -0,0 +1,56 @@
+// phong_simd.h: kernel de sombreado Phong en CPU por lotes de fragmentos
+//
+// Mismo calculo que spinningcube_withlight_fs_SKEL.glsl, pero sobre
+// PHONG_BATCH fragmentos a la vez en formato SoA (un array por componente).
+// Los texels difuso y especular se muestrean una sola vez por fragmento
+// antes de llamar al kernel (el shader hace texture() tres veces por luz).
+//
+// Hay una version escalar de referencia (powf) y versiones SSE2, AVX2 y
+// AVX-512 con pow aproximado (exp2(s * log2(x)) polinomico). La mejor se
+// elige en tiempo de ejecucion segun la CPU; PHONG_ISA=scalar|sse2|avx2|
+// avx512 en el entorno fuerza una concreta.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef PHONG_SIMD_H
+#define PHONG_SIMD_H
+
+#define PHONG_BATCH 16
+
+struct PhongLightParams {
+  float position[3];
+  float ambient[3];
+  float diffuse[3];
+  float specular[3];
+};
+
+struct PhongParams {
+  float view_pos[3];
+  PhongLightParams lights[2];
+  float shininess;
+};
+
+// Entradas y salida de un lote. Se procesan siempre los PHONG_BATCH
+// carriles; los que no se usen solo tienen que contener valores finitos.
+struct alignas(64) PhongFragments {
+  float pos_x[PHONG_BATCH], pos_y[PHONG_BATCH], pos_z[PHONG_BATCH];
+  float normal_x[PHONG_BATCH], normal_y[PHONG_BATCH], normal_z[PHONG_BATCH];
+  float diffuse_r[PHONG_BATCH], diffuse_g[PHONG_BATCH], diffuse_b[PHONG_BATCH];
+  float specular_r[PHONG_BATCH], specular_g[PHONG_BATCH], specular_b[PHONG_BATCH];
+  float out_r[PHONG_BATCH], out_g[PHONG_BATCH], out_b[PHONG_BATCH];
+};
+
+typedef void (*PhongKernel)(const PhongParams &params, PhongFragments &frags);
+
+void phong_shade_scalar(const PhongParams &params, PhongFragments &frags);
+void phong_shade_sse2(const PhongParams &params, PhongFragments &frags);
+void phong_shade_avx2(const PhongParams &params, PhongFragments &frags);
+void phong_shade_avx512(const PhongParams &params, PhongFragments &frags);
+
+// Kernel de un ISA concreto ("scalar", "sse2", "avx2", "avx512") o NULL si
+// la CPU no lo soporta
+PhongKernel phong_kernel_for(const char *isa);
+
+// Mejor kernel disponible (o el de PHONG_ISA); name recibe su nombre
+PhongKernel phong_best_kernel(const char **name);
+
+#endif
@@ -0,0 +1,124 @@
+// phong_simd_kernel.inl: cuerpo comun de los kernels SIMD de Phong
+//
+// Se incluye desde phong_sse2.cpp, phong_avx2.cpp y phong_avx512.cpp, cada
+// uno compilado con sus flags (-mavx2, ...) y con una clase V que envuelve
+// las intrinsics de ese ISA:
+//   V::F, V::W                         tipo vector y numero de carriles
+//   set1, load, store, add, sub, mul, max
+//   rsqrt(x)                           1/sqrt(x) con un paso de Newton
+//   floor_int(x, &fi)                  suelo como entero (y como float)
+//   exponent(x), mantissa(x)           x = mantissa * 2^exponent, [1, 2)
+//   pow2i(i)                           2^i a partir de un entero
+//   positive(x, r)                     r donde x > 0, 0 en otro caso
+// Tiene que incluirse dentro de un namespace anonimo.
+//////////////////////////////////////////////////////////////////////
+
+template <class V>
+static inline typename V::F poly_log2(typename V::F x) {
+  typedef typename V::F F;
+  // log2(1 + t), t en [0, 1): error absoluto < 3e-6
+  F t = V::sub(V::mantissa(x), V::set1(1.0f));
+  F p = V::set1(-0.025792343f);
+  p = V::add(V::mul(p, t), V::set1(0.12147294f));
+  p = V::add(V::mul(p, t), V::set1(-0.27734164f));
+  p = V::add(V::mul(p, t), V::set1(0.45715812f));
+  p = V::add(V::mul(p, t), V::set1(-0.71803359f));
+  p = V::add(V::mul(p, t), V::set1(1.4425348f));
+  return V::add(V::exponent(x), V::mul(p, t));
+}
+
+template <class V>
+static inline typename V::F poly_exp2(typename V::F y) {
+  typedef typename V::F F;
+  // 2^-64 ya es 0 a efectos de un color de 8 bits; cortar ahi evita
+  // resultados denormales, que son muy lentos en x86
+  y = V::max(y, V::set1(-64.0f));
+  F fi;
+  typename V::I i = V::floor_int(y, &fi);
+  // 2^f, f en [0, 1): error relativo < 2e-7
+  F f = V::sub(y, fi);
+  F p = V::set1(0.0018951057f);
+  p = V::add(V::mul(p, f), V::set1(0.0089462187f));
+  p = V::add(V::mul(p, f), V::set1(0.055863279f));
+  p = V::add(V::mul(p, f), V::set1(0.24014077f));
+  p = V::add(V::mul(p, f), V::set1(0.69315462f));
+  p = V::add(V::mul(p, f), V::set1(0.99999990f));
+  return V::mul(p, V::pow2i(i));
+}
+
+// pow(x, s) para x >= 0
+template <class V>
+static inline typename V::F pow_approx(typename V::F x, typename V::F s) {
+  return V::positive(x, poly_exp2<V>(V::mul(s, poly_log2<V>(x))));
+}
+
+template <class V>
+static inline void normalize3(typename V::F &x, typename V::F &y, typename V::F &z) {
+  typename V::F inv = V::rsqrt(V::add(V::add(V::mul(x, x), V::mul(y, y)), V::mul(z, z)));
+  x = V::mul(x, inv);
+  y = V::mul(y, inv);
+  z = V::mul(z, inv);
+}
+
+template <class V>
+static void phong_kernel(const PhongParams &p, PhongFragments &f) {
+  typedef typename V::F F;
+
+  const F zero = V::set1(0.0f);
+  const F two = V::set1(2.0f);
+  const F shininess = V::set1(p.shininess);
+
+  // El termino ambiente de las dos luces usa el mismo texel: se suma antes
+  const F ambient_r = V::set1(p.lights[0].ambient[0] + p.lights[1].ambient[0]);
+  const F ambient_g = V::set1(p.lights[0].ambient[1] + p.lights[1].ambient[1]);
+  const F ambient_b = V::set1(p.lights[0].ambient[2] + p.lights[1].ambient[2]);
+
+  for (int i = 0; i < PHONG_BATCH; i += V::W) {
+    F px = V::load(f.pos_x + i), py = V::load(f.pos_y + i), pz = V::load(f.pos_z + i);
+    F nx = V::load(f.normal_x + i), ny = V::load(f.normal_y + i), nz = V::load(f.normal_z + i);
+    F dr = V::load(f.diffuse_r + i), dg = V::load(f.diffuse_g + i), db = V::load(f.diffuse_b + i);
+    F sr = V::load(f.specular_r + i), sg = V::load(f.specular_g + i), sb = V::load(f.specular_b + i);
+
+    F vx = V::sub(V::set1(p.view_pos[0]), px);
+    F vy = V::sub(V::set1(p.view_pos[1]), py);
+    F vz = V::sub(V::set1(p.view_pos[2]), pz);
+    normalize3<V>(vx, vy, vz);
+
+    F r = V::mul(ambient_r, dr);
+    F g = V::mul(ambient_g, dg);
+    F b = V::mul(ambient_b, db);
+
+    for (int l = 0; l < 2; l++) {
+      const PhongLightParams &light = p.lights[l];
+
+      F lx = V::sub(V::set1(light.position[0]), px);
+      F ly = V::sub(V::set1(light.position[1]), py);
+      F lz = V::sub(V::set1(light.position[2]), pz);
+      normalize3<V>(lx, ly, lz);
+
+      // Diffuse
+      F n_dot_l = V::add(V::add(V::mul(nx, lx), V::mul(ny, ly)), V::mul(nz, lz));
+      F diff = V::max(n_dot_l, zero);
+
+      // Specular: reflect(-l, n) = 2 * dot(n, l) * n - l
+      F k = V::mul(two, n_dot_l);
+      F rx = V::sub(V::mul(k, nx), lx);
+      F ry = V::sub(V::mul(k, ny), ly);
+      F rz = V::sub(V::mul(k, nz), lz);
+      F r_dot_v = V::add(V::add(V::mul(rx, vx), V::mul(ry, vy)), V::mul(rz, vz));
+      F spec = pow_approx<V>(V::max(r_dot_v, zero), shininess);
+
+      F kd_r = V::mul(V::set1(light.diffuse[0]), diff), ks_r = V::mul(V::set1(light.specular[0]), spec);
+      F kd_g = V::mul(V::set1(light.diffuse[1]), diff), ks_g = V::mul(V::set1(light.specular[1]), spec);
+      F kd_b = V::mul(V::set1(light.diffuse[2]), diff), ks_b = V::mul(V::set1(light.specular[2]), spec);
+
+      r = V::add(r, V::add(V::mul(kd_r, dr), V::mul(ks_r, sr)));
+      g = V::add(g, V::add(V::mul(kd_g, dg), V::mul(ks_g, sg)));
+      b = V::add(b, V::add(V::mul(kd_b, db), V::mul(ks_b, sb)));
+    }
+
+    V::store(f.out_r + i, r);
+    V::store(f.out_g + i, g);
+    V::store(f.out_b + i, b);
+  }
+}
@@ -0,0 +1,62 @@
+// phong_sse2.cpp: kernel Phong con SSE2 (4 fragmentos por instruccion)
+//////////////////////////////////////////////////////////////////////
+
+#include "phong_simd.h"
+
+#include <emmintrin.h>
+
+namespace {
+
+struct SSE2 {
+  typedef __m128 F;
+  typedef __m128i I;
+  enum { W = 4 };
+
+  static F set1(float v) { return _mm_set1_ps(v); }
+  static F load(const float *p) { return _mm_load_ps(p); }
+  static void store(float *p, F v) { _mm_store_ps(p, v); }
+  static F add(F a, F b) { return _mm_add_ps(a, b); }
+  static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+  static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+  static F max(F a, F b) { return _mm_max_ps(a, b); }
+
+  static F rsqrt(F x) {
+    F y = _mm_rsqrt_ps(x);
+    F half_xyy = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), x), _mm_mul_ps(y, y));
+    return _mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), half_xyy));
+  }
+
+  // SSE2 no tiene floor: se trunca y se resta 1 donde el truncado quedo por
+  // encima (la mascara de la comparacion vale -1)
+  static I floor_int(F x, F *fx) {
+    I i = _mm_cvttps_epi32(x);
+    F above = _mm_cmpgt_ps(_mm_cvtepi32_ps(i), x);
+    i = _mm_add_epi32(i, _mm_castps_si128(above));
+    *fx = _mm_cvtepi32_ps(i);
+    return i;
+  }
+
+  static F exponent(F x) {
+    I e = _mm_srli_epi32(_mm_castps_si128(x), 23);
+    return _mm_cvtepi32_ps(_mm_sub_epi32(e, _mm_set1_epi32(127)));
+  }
+
+  static F mantissa(F x) {
+    I m = _mm_and_si128(_mm_castps_si128(x), _mm_set1_epi32(0x007fffff));
+    return _mm_castsi128_ps(_mm_or_si128(m, _mm_set1_epi32(0x3f800000)));
+  }
+
+  static F pow2i(I i) {
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23));
+  }
+
+  static F positive(F x, F r) { return _mm_and_ps(_mm_cmpgt_ps(x, _mm_setzero_ps()), r); }
+};
+
+#include "phong_simd_kernel.inl"
+
+}
+
+void phong_shade_sse2(const PhongParams &params, PhongFragments &frags) {
+  phong_kernel<SSE2>(params, frags);
+}
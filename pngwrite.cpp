@@ -0,0 +1,107 @@
+// pngwrite.cpp: escritura minima de PNG (ver pngwrite.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "pngwrite.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+static uint32_t crc_table[256];
+
+static void init_crc_table() {
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++)
+      c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+    crc_table[n] = c;
+  }
+}
+
+static uint32_t crc32(uint32_t crc, const unsigned char *data, size_t len) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++)
+    crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void put_u32(std::vector<unsigned char> &out, uint32_t v) {
+  out.push_back((v >> 24) & 0xff);
+  out.push_back((v >> 16) & 0xff);
+  out.push_back((v >> 8) & 0xff);
+  out.push_back(v & 0xff);
+}
+
+static void write_chunk(FILE *fp, const char *type, const std::vector<unsigned char> &data) {
+  std::vector<unsigned char> chunk;
+  put_u32(chunk, (uint32_t) data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  put_u32(chunk, crc32(0, chunk.data() + 4, chunk.size() - 4));
+  fwrite(chunk.data(), 1, chunk.size(), fp);
+}
+
+bool write_png(const char *path, int width, int height, const unsigned char *rgba) {
+  FILE *fp = fopen(path, "wb");
+  if (fp == NULL) {
+    fprintf(stderr, "ERROR: could not open %s\n", path);
+    return false;
+  }
+
+  if (crc_table[1] == 0)
+    init_crc_table();
+
+  static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+  fwrite(signature, 1, 8, fp);
+
+  std::vector<unsigned char> ihdr;
+  put_u32(ihdr, width);
+  put_u32(ihdr, height);
+  ihdr.push_back(8);  // bits por canal
+  ihdr.push_back(6);  // RGBA
+  ihdr.push_back(0);
+  ihdr.push_back(0);
+  ihdr.push_back(0);
+  write_chunk(fp, "IHDR", ihdr);
+
+  // Filas con filtro 0 delante
+  size_t row = (size_t) width * 4 + 1;
+  std::vector<unsigned char> raw(row * height);
+  for (int y = 0; y < height; y++) {
+    raw[y * row] = 0;
+    for (size_t x = 0; x < row - 1; x++)
+      raw[y * row + 1 + x] = rgba[(size_t) y * width * 4 + x];
+  }
+
+  // zlib con bloques deflate sin comprimir (maximo 65535 bytes cada uno)
+  std::vector<unsigned char> idat;
+  idat.push_back(0x78);
+  idat.push_back(0x01);
+  uint32_t a = 1, b = 0;
+  for (size_t pos = 0; pos < raw.size(); ) {
+    size_t len = raw.size() - pos;
+    if (len > 65535)
+      len = 65535;
+    idat.push_back(pos + len == raw.size() ? 1 : 0);
+    idat.push_back(len & 0xff);
+    idat.push_back((len >> 8) & 0xff);
+    idat.push_back(~len & 0xff);
+    idat.push_back((~len >> 8) & 0xff);
+    for (size_t i = 0; i < len; i++) {
+      unsigned char c = raw[pos + i];
+      idat.push_back(c);
+      a = (a + c) % 65521;
+      b = (b + a) % 65521;
+    }
+    pos += len;
+  }
+  put_u32(idat, (b << 16) | a);
+  write_chunk(fp, "IDAT", idat);
+
+  write_chunk(fp, "IEND", std::vector<unsigned char>());
+
+  bool ok = !ferror(fp);
+  fclose(fp);
+  return ok;
+}
@@ -0,0 +1,14 @@
+// pngwrite.h: escritura minima de PNG (RGBA8, sin compresion)
+//
+// stb_image.h solo lee imagenes; para volcar framebuffers basta con un PNG
+// valido usando bloques deflate "stored", sin dependencias externas.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef PNGWRITE_H
+#define PNGWRITE_H
+
+// rgba: width * height * 4 bytes, fila 0 arriba. Devuelve false si no se
+// puede escribir el fichero.
+bool write_png(const char *path, int width, int height, const unsigned char *rgba);
+
+#endif
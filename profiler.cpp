@@ -0,0 +1,320 @@
+// profiler.cpp: perfilador por zonas (ver profiler.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "profiler.h"
+
+#if ENABLE_PROFILER
+
+#include <GL/glew.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+bool profiler_active = false;
+bool profiler_gpu_active = false;
+
+namespace {
+
+// Zonas de un hilo entre dos profiler_end_frame() (potencia de 2)
+const uint64_t RING_SIZE = 1 << 14;
+// Limite del trace en memoria (unos 50 MB); las estadisticas siguen
+const size_t MAX_TRACE_EVENTS = 1 << 21;
+// tid de la pista de GPU en el trace
+const int GPU_TID = 0;
+
+struct Event {
+  const char *name;
+  uint64_t begin_ns, end_ns;
+};
+
+// Un productor (su hilo) y un consumidor (el hilo principal). Si el hilo
+// da la vuelta al buffer antes de que se vacie se pierden las mas viejas
+struct ThreadRing {
+  Event events[RING_SIZE];
+  std::atomic<uint64_t> head{0};  // siguiente a escribir, solo el hilo
+  uint64_t tail = 0;              // siguiente a leer, solo el principal
+  int tid = 0;
+  const char *name = NULL;
+};
+
+struct TraceEvent {
+  const char *name;
+  int tid;
+  uint64_t begin_ns, end_ns;
+};
+
+struct ScopeStats {
+  unsigned long calls = 0;
+  double total_ms = 0.0, max_ms = 0.0;
+};
+
+struct GpuScope {
+  const char *name;
+  int begin_query, end_query;
+};
+
+// Queries de un frame; se leen PROFILER_GPU_FRAMES frames despues y se
+// reutilizan en el siguiente
+struct GpuFrame {
+  std::vector<GLuint> queries;
+  size_t used = 0;
+  std::vector<GpuScope> scopes;
+};
+
+// Los buffers no se liberan nunca: un hilo puede seguir teniendo el suyo
+std::mutex rings_mutex;
+std::vector<ThreadRing *> rings;
+thread_local ThreadRing *thread_ring = NULL;
+thread_local const char *thread_name = NULL;
+
+std::vector<TraceEvent> trace;
+std::map<std::pair<bool, std::string>, ScopeStats> stats;  // (gpu, nombre)
+uint64_t start_ns = 0;
+unsigned long lost_events = 0, untraced_events = 0;
+int frames = 0;
+
+// Uno mas que el margen: el que se lee al empezar un frame se escribio
+// PROFILER_GPU_FRAMES frames antes
+const int GPU_FRAME_SLOTS = PROFILER_GPU_FRAMES + 1;
+GpuFrame gpu_frames[GPU_FRAME_SLOTS];
+int gpu_frame = 0;
+int64_t gpu_offset_ns = 0;  // reloj de la CPU - reloj de la GPU
+
+}  // namespace
+
+static ThreadRing *register_thread() {
+  ThreadRing *ring = new ThreadRing();
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  ring->tid = (int) rings.size() + 1;
+  ring->name = thread_name;
+  rings.push_back(ring);
+  thread_ring = ring;
+  return ring;
+}
+
+void profiler_set_thread_name(const char *name) {
+  thread_name = name;
+  if (thread_ring) {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    thread_ring->name = name;
+  }
+}
+
+void profiler_record(const char *name, uint64_t begin_ns, uint64_t end_ns) {
+  ThreadRing *ring = thread_ring ? thread_ring : register_thread();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  ring->events[head & (RING_SIZE - 1)] = { name, begin_ns, end_ns };
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+static void add_event(const char *name, int tid, uint64_t begin_ns, uint64_t end_ns) {
+  double ms = end_ns > begin_ns ? (end_ns - begin_ns) / 1.0e6 : 0.0;
+  ScopeStats &s = stats[std::make_pair(tid == GPU_TID, std::string(name))];
+  s.calls++;
+  s.total_ms += ms;
+  s.max_ms = std::max(s.max_ms, ms);
+
+  if (trace.size() < MAX_TRACE_EVENTS)
+    trace.push_back({ name, tid, begin_ns, end_ns });
+  else
+    untraced_events++;
+}
+
+static void drain(ThreadRing *ring) {
+  uint64_t head = ring->head.load(std::memory_order_acquire);
+  uint64_t tail = ring->tail;
+  if (head - tail > RING_SIZE) {
+    lost_events += head - tail - RING_SIZE;
+    tail = head - RING_SIZE;
+  }
+  std::vector<Event> events;
+  events.reserve(head - tail);
+  for (uint64_t i = tail; i < head; i++)
+    events.push_back(ring->events[i & (RING_SIZE - 1)]);
+
+  // Lo que el hilo haya podido sobrescribir mientras se copiaba (incluida la
+  // posicion que puede estar escribiendo ahora)
+  uint64_t now = ring->head.load(std::memory_order_acquire) + 1;
+  size_t skip = now > tail + RING_SIZE ? (size_t) std::min<uint64_t>(now - RING_SIZE - tail, events.size()) : 0;
+  lost_events += skip;
+  for (size_t i = skip; i < events.size(); i++)
+    add_event(events[i].name, ring->tid, events[i].begin_ns, events[i].end_ns);
+  ring->tail = head;
+}
+
+static void drain_all() {
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  for (ThreadRing *ring : rings)
+    drain(ring);
+}
+
+static int gpu_query(GpuFrame &frame) {
+  if (frame.used == frame.queries.size()) {
+    GLuint query;
+    glGenQueries(1, &query);
+    frame.queries.push_back(query);
+  }
+  return (int) frame.used++;
+}
+
+int profiler_gpu_begin(const char *name) {
+  GpuFrame &frame = gpu_frames[gpu_frame];
+  int query = gpu_query(frame);
+  glQueryCounter(frame.queries[query], GL_TIMESTAMP);
+  frame.scopes.push_back({ name, query, -1 });
+  return (int) frame.scopes.size() - 1;
+}
+
+void profiler_gpu_end(int scope) {
+  GpuFrame &frame = gpu_frames[gpu_frame];
+  int query = gpu_query(frame);
+  glQueryCounter(frame.queries[query], GL_TIMESTAMP);
+  frame.scopes[scope].end_query = query;
+}
+
+// Con PROFILER_GPU_FRAMES frames de margen ya estan listas y no se espera
+static void read_gpu_frame(GpuFrame &frame) {
+  for (const GpuScope &scope : frame.scopes) {
+    if (scope.end_query < 0)
+      continue;
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(frame.queries[scope.begin_query], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame.queries[scope.end_query], GL_QUERY_RESULT, &end);
+    add_event(scope.name, GPU_TID, begin + gpu_offset_ns, end + gpu_offset_ns);
+  }
+  frame.scopes.clear();
+  frame.used = 0;
+}
+
+void profiler_start(bool gpu) {
+  trace.clear();
+  stats.clear();
+  lost_events = untraced_events = 0;
+  frames = 0;
+  {
+    // Lo que quedara de una captura anterior
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (ThreadRing *ring : rings)
+      ring->tail = ring->head.load(std::memory_order_acquire);
+  }
+  start_ns = profiler_now();
+
+  if (gpu && GLEW_ARB_timer_query) {
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    gpu_offset_ns = (int64_t) profiler_now() - gpu_now;
+    gpu_frame = 0;
+    profiler_gpu_active = true;
+  } else if (gpu) {
+    printf("Profiler: no GL_TIMESTAMP queries, CPU scopes only\n");
+  }
+  profiler_active = true;
+}
+
+void profiler_end_frame() {
+  if (!profiler_active)
+    return;
+  frames++;
+  drain_all();
+  if (profiler_gpu_active) {
+    gpu_frame = (gpu_frame + 1) % GPU_FRAME_SLOTS;
+    read_gpu_frame(gpu_frames[gpu_frame]);
+  }
+}
+
+static void print_stats() {
+  std::vector<std::pair<std::pair<bool, std::string>, ScopeStats> > sorted(stats.begin(), stats.end());
+  std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::pair<bool, std::string>, ScopeStats> &a,
+                                             const std::pair<std::pair<bool, std::string>, ScopeStats> &b) {
+    return a.first.first != b.first.first ? !a.first.first : a.second.total_ms > b.second.total_ms;
+  });
+
+  printf("Profile: %d frames, %zu scopes traced", frames, trace.size());
+  if (lost_events || untraced_events)
+    printf(" (%lu lost in full buffers, %lu not traced)", lost_events, untraced_events);
+  printf("\n");
+  for (const std::pair<std::pair<bool, std::string>, ScopeStats> &entry : sorted) {
+    const ScopeStats &s = entry.second;
+    printf("  %s %-26s %8lu calls  mean %8.3f ms  max %8.3f ms  %8.3f ms/frame\n",
+           entry.first.first ? "GPU" : "CPU", entry.first.second.c_str(), s.calls, s.total_ms / s.calls,
+           s.max_ms, s.total_ms / std::max(frames, 1));
+  }
+}
+
+static void write_json_string(FILE *fp, const char *s) {
+  fputc('"', fp);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      fputc('\\', fp);
+    fputc(*s, fp);
+  }
+  fputc('"', fp);
+}
+
+static bool write_trace(const char *path) {
+  FILE *fp = fopen(path, "w");
+  if (!fp) {
+    perror(path);
+    return false;
+  }
+  fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"spinningcube\"}},\n");
+  fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}}", GPU_TID);
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (const ThreadRing *ring : rings) {
+      fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", ring->tid);
+      if (ring->name) {
+        write_json_string(fp, ring->name);
+      } else {
+        fprintf(fp, "\"thread %d\"", ring->tid);
+      }
+      fprintf(fp, "}}");
+    }
+  }
+  // Chrome trace usa microsegundos
+  for (const TraceEvent &e : trace) {
+    fprintf(fp, ",\n{\"name\":");
+    write_json_string(fp, e.name);
+    fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            e.tid == GPU_TID ? "gpu" : "cpu", e.tid, ((int64_t) e.begin_ns - (int64_t) start_ns) / 1.0e3,
+            (e.end_ns > e.begin_ns ? e.end_ns - e.begin_ns : 0) / 1.0e3);
+  }
+  fprintf(fp, "\n]}\n");
+  bool ok = fclose(fp) == 0;
+  if (ok)
+    printf("Trace: %zu events -> %s\n", trace.size(), path);
+  return ok;
+}
+
+bool profiler_stop(const char *trace_path) {
+  if (!profiler_active)
+    return true;
+  profiler_active = false;
+  drain_all();
+  if (profiler_gpu_active) {
+    // Los frames que quedan, del mas viejo al actual
+    for (int i = 1; i <= GPU_FRAME_SLOTS; i++)
+      read_gpu_frame(gpu_frames[(gpu_frame + i) % GPU_FRAME_SLOTS]);
+    for (GpuFrame &frame : gpu_frames) {
+      if (!frame.queries.empty())
+        glDeleteQueries((GLsizei) frame.queries.size(), frame.queries.data());
+      frame.queries.clear();
+    }
+    profiler_gpu_active = false;
+  }
+
+  print_stats();
+  bool ok = !trace_path || write_trace(trace_path);
+  trace.clear();
+  stats.clear();
+  return ok;
+}
+
+#endif
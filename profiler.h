@@ -0,0 +1,110 @@
+// profiler.h: perfilador por zonas de CPU y GPU con salida a Chrome trace
+//
+// PROFILE_SCOPE("nombre") mide en la CPU desde ese punto hasta el final del
+// bloque. Cada hilo escribe sus zonas en su propio buffer circular, sin
+// locks: solo avanza su indice de escritura, y el hilo principal los vacia
+// en profiler_end_frame(). PROFILE_GPU_SCOPE("nombre") mide lo mismo en la
+// GPU con dos GL_TIMESTAMP (a diferencia de GL_TIME_ELAPSED se pueden
+// anidar); las queries salen de un pool por frame y se leen
+// PROFILER_GPU_FRAMES frames despues, cuando ya estan listas, sin parar
+// la GPU. El nombre tiene que ser un literal (se guarda el puntero).
+//
+// Sin profiler_start() las zonas solo cuestan una comprobacion. Con
+// ENABLE_PROFILER=0 (make PROFILER=0) las macros no generan codigo y el
+// resto de funciones no hacen nada.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 1
+#endif
+
+#if ENABLE_PROFILER
+
+#include <stdint.h>
+
+#include <chrono>
+
+// Frames entre la emision de las queries de GPU y su lectura
+const int PROFILER_GPU_FRAMES = 4;
+
+extern bool profiler_active;
+extern bool profiler_gpu_active;
+
+inline uint64_t profiler_now() {
+  return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void profiler_record(const char *name, uint64_t begin_ns, uint64_t end_ns);
+int profiler_gpu_begin(const char *name);
+void profiler_gpu_end(int scope);
+
+class ProfileScope {
+public:
+  explicit ProfileScope(const char *name) : name(profiler_active ? name : NULL), begin(this->name ? profiler_now() : 0) {}
+  ~ProfileScope() {
+    if (name)
+      profiler_record(name, begin, profiler_now());
+  }
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+  const char *name;
+  uint64_t begin;
+};
+
+// Solo en el hilo con el contexto GL
+class GpuProfileScope {
+public:
+  explicit GpuProfileScope(const char *name) : scope(profiler_gpu_active ? profiler_gpu_begin(name) : -1) {}
+  ~GpuProfileScope() {
+    if (scope >= 0)
+      profiler_gpu_end(scope);
+  }
+
+  GpuProfileScope(const GpuProfileScope &) = delete;
+  GpuProfileScope &operator=(const GpuProfileScope &) = delete;
+
+private:
+  int scope;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(profile_gpu_scope_, __LINE__)(name)
+
+// Empieza a capturar; gpu: ademas las zonas de GPU (hilo con el contexto
+// GL current, necesita GL 3.3 o ARB_timer_query)
+void profiler_start(bool gpu);
+
+// Nombre del hilo que llama en el trace (literal); si no, "thread N"
+void profiler_set_thread_name(const char *name);
+
+// Hilo principal, una vez por frame: vacia los buffers de los hilos y lee
+// las queries de GPU del frame de hace PROFILER_GPU_FRAMES
+void profiler_end_frame();
+
+// Termina la captura, imprime por zona las llamadas y los tiempos medio,
+// maximo y por frame y, si trace_path no es NULL, escribe el trace en el
+// formato JSON de Chrome (chrome://tracing, Perfetto)
+bool profiler_stop(const char *trace_path);
+
+#else
+
+#define PROFILE_SCOPE(name) ((void) 0)
+#define PROFILE_GPU_SCOPE(name) ((void) 0)
+
+inline void profiler_start(bool) {}
+inline void profiler_set_thread_name(const char *) {}
+inline void profiler_end_frame() {}
+inline bool profiler_stop(const char *) { return true; }
+
+#endif
+
+#endif
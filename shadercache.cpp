@@ -0,0 +1,279 @@
+// shadercache.cpp: cache persistente de programas GLSL (ver shadercache.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "shadercache.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint32_t CACHE_MAGIC = 0x31435350;  // "PSC1"
+
+static std::string cache_dir = "shader_cache";
+static bool cache_enabled = true;
+
+void shader_cache_set_dir(const char *dir) {
+  cache_enabled = dir != NULL;
+  if (dir)
+    cache_dir = dir;
+}
+
+static double ms_since(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static uint64_t fnv1a(uint64_t hash, const char *s, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char) s[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+static uint64_t fnv1a(uint64_t hash, const char *s) {
+  if (s == NULL)
+    s = "";
+  // Incluye el terminador para que "ab" + "c" y "a" + "bc" no coincidan
+  return fnv1a(hash, s, strlen(s) + 1);
+}
+
+// Un shader del programa: el fuente en trozos que van a glShaderSource tal
+// cual, sin copiarlo (puede venir de un AssetPack proyectado en memoria)
+struct Stage {
+  GLenum type;
+  const char *parts[4];
+  GLint lengths[4];
+  int part_count;
+  const char *name;
+};
+
+// "#version ..." tiene que ser la primera linea: los defines van detras
+static Stage make_stage(GLenum type, const char *source, const char *defines, const char *name) {
+  Stage stage;
+  stage.type = type;
+  stage.name = name;
+  stage.part_count = 0;
+
+  size_t length = strlen(source);
+  size_t head = 0;
+  if (defines != NULL && defines[0] != '\0' && strncmp(source, "#version", 8) == 0) {
+    const char *eol = strchr(source, '\n');
+    head = eol ? (size_t) (eol - source) + 1 : length;
+  }
+  if (head > 0) {
+    stage.parts[stage.part_count] = source;
+    stage.lengths[stage.part_count++] = (GLint) head;
+  }
+  if (defines != NULL && defines[0] != '\0') {
+    size_t define_length = strlen(defines);
+    stage.parts[stage.part_count] = defines;
+    stage.lengths[stage.part_count++] = (GLint) define_length;
+    if (defines[define_length - 1] != '\n') {
+      stage.parts[stage.part_count] = "\n";
+      stage.lengths[stage.part_count++] = 1;
+    }
+  }
+  stage.parts[stage.part_count] = source + head;
+  stage.lengths[stage.part_count++] = (GLint) (length - head);
+  return stage;
+}
+
+static GLuint compile_shader(const Stage &stage) {
+  GLuint shader = glCreateShader(stage.type);
+  glShaderSource(shader, stage.part_count, stage.parts, stage.lengths);
+  glCompileShader(shader);
+
+  int  success;
+  char infoLog[512];
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (!success) {
+    glGetShaderInfoLog(shader, 512, NULL, infoLog);
+    printf("ERROR: %s Shader compilation failed!\n%s\n", stage.name, infoLog);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+static GLuint compile_program(const std::vector<Stage> &stages) {
+  std::vector<GLuint> shaders;
+  for (const Stage &stage : stages) {
+    GLuint shader = compile_shader(stage);
+    if (!shader) {
+      for (GLuint s : shaders)
+        glDeleteShader(s);
+      return 0;
+    }
+    shaders.push_back(shader);
+  }
+
+  // Create program, attach shaders to it and link it
+  GLuint program = glCreateProgram();
+  for (GLuint shader : shaders)
+    glAttachShader(program, shader);
+  if (cache_enabled)
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glLinkProgram(program);
+
+  // Release shader objects
+  for (GLuint shader : shaders)
+    glDeleteShader(shader);
+
+  int  success;
+  char infoLog[512];
+  glValidateProgram(program);
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    glGetProgramInfoLog(program, 512, NULL, infoLog);
+    printf("ERROR: Shader Program linking failed!\n%s\n", infoLog);
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+static bool binaries_supported() {
+  GLint formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  return formats > 0;
+}
+
+static GLuint load_binary(const std::string &path) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == NULL)
+    return 0;
+
+  uint32_t header[3];  // magic, formato, longitud
+  std::vector<unsigned char> binary;
+  // La longitud tiene que ser justo lo que queda del fichero: uno corrupto
+  // o a medias es un fallo del cache, no una reserva de gigas
+  struct stat st;
+  if (fread(header, sizeof(header), 1, fp) == 1 && header[0] == CACHE_MAGIC &&
+      fstat(fileno(fp), &st) == 0 && (uint64_t) st.st_size == sizeof(header) + (uint64_t) header[2]) {
+    binary.resize(header[2]);
+    if (fread(binary.data(), 1, binary.size(), fp) != binary.size())
+      binary.clear();
+  }
+  fclose(fp);
+  if (binary.empty())
+    return 0;
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, header[1], binary.data(), (GLsizei) binary.size());
+
+  GLint success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+static bool store_binary(const std::string &path, GLuint program) {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return false;
+
+  std::vector<unsigned char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+
+  mkdir(cache_dir.c_str(), 0755);
+
+  // Se escribe a un temporal y se renombra para que otra instancia nunca
+  // lea una entrada a medias
+  std::string tmp = path + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "wb");
+  if (fp == NULL)
+    return false;
+  uint32_t header[3] = { CACHE_MAGIC, format, (uint32_t) length };
+  bool ok = fwrite(header, sizeof(header), 1, fp) == 1 &&
+            fwrite(binary.data(), 1, length, fp) == (size_t) length;
+  fclose(fp);
+
+  return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+static GLuint cached_program(const std::vector<Stage> &stages, ShaderCacheStats *stats) {
+  ShaderCacheStats local;
+  if (stats == NULL)
+    stats = &local;
+  memset(stats, 0, sizeof(*stats));
+
+  std::string path;
+  bool use_cache = cache_enabled && binaries_supported();
+  if (use_cache) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    // El texto que ve el compilador, con el terminador por cada shader
+    for (const Stage &stage : stages) {
+      for (int i = 0; i < stage.part_count; i++)
+        hash = fnv1a(hash, stage.parts[i], (size_t) stage.lengths[i]);
+      hash = fnv1a(hash, "");
+    }
+    hash = fnv1a(hash, (const char *) glGetString(GL_VENDOR));
+    hash = fnv1a(hash, (const char *) glGetString(GL_RENDERER));
+    hash = fnv1a(hash, (const char *) glGetString(GL_VERSION));
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long) hash);
+    path = cache_dir + name;
+
+    Clock::time_point start = Clock::now();
+    FILE *fp = fopen(path.c_str(), "rb");
+    bool exists = fp != NULL;
+    if (fp)
+      fclose(fp);
+
+    GLuint program = exists ? load_binary(path) : 0;
+    stats->load_ms = ms_since(start);
+    if (program) {
+      stats->hit = true;
+      return program;
+    }
+    stats->rejected = exists;
+  }
+
+  Clock::time_point start = Clock::now();
+  GLuint program = compile_program(stages);
+  stats->compile_ms = ms_since(start);
+
+  if (program && use_cache)
+    stats->stored = store_binary(path, program);
+
+  return program;
+}
+
+GLuint shader_cache_program(const char *vs_source, const char *fs_source,
+                            const char *defines, ShaderCacheStats *stats) {
+  std::vector<Stage> stages = {
+    make_stage(GL_VERTEX_SHADER, vs_source, defines, "Vertex"),
+    make_stage(GL_FRAGMENT_SHADER, fs_source, defines, "Fragment"),
+  };
+  return cached_program(stages, stats);
+}
+
+GLuint shader_cache_compute_program(const char *cs_source, const char *defines,
+                                    ShaderCacheStats *stats) {
+  std::vector<Stage> stages = {
+    make_stage(GL_COMPUTE_SHADER, cs_source, defines, "Compute"),
+  };
+  return cached_program(stages, stats);
+}
+
+void shader_cache_print_stats(const ShaderCacheStats &stats, const char *name) {
+  if (stats.hit)
+    printf("%s: cache hit, loaded in %.2f ms\n", name, stats.load_ms);
+  else
+    printf("%s: cache %s, compiled in %.2f ms%s\n", name,
+           stats.rejected ? "entry rejected" : "miss", stats.compile_ms,
+           stats.stored ? " (stored)" : "");
+}
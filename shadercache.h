@@ -0,0 +1,37 @@
+// shadercache.h: cache persistente de programas GLSL enlazados
+//
+// La clave es un hash (FNV-1a de 64 bits) de los fuentes, los #define
+// inyectados y las cadenas GL_VENDOR / GL_RENDERER / GL_VERSION, asi que un
+// cambio de driver invalida la entrada. En un acierto el programa se carga
+// con glProgramBinary; si el driver rechaza el binario se compila desde los
+// fuentes y se reescribe la entrada.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <GL/glew.h>
+
+struct ShaderCacheStats {
+  bool hit;          // programa cargado del cache
+  bool rejected;     // habia entrada pero el driver no la acepto
+  bool stored;       // se guardo una entrada nueva
+  double load_ms;    // lectura + glProgramBinary
+  double compile_ms; // compilacion + enlazado (en un fallo)
+};
+
+// Directorio del cache ("shader_cache" por defecto). NULL lo desactiva.
+void shader_cache_set_dir(const char *dir);
+
+// Devuelve el programa enlazado con vs y fs, o 0 si falla la compilacion
+// (el log se imprime por stdout). defines (puede ser NULL o "") se inserta
+// tras la linea #version de ambos shaders.
+GLuint shader_cache_program(const char *vs_source, const char *fs_source,
+                            const char *defines, ShaderCacheStats *stats);
+// Igual con un compute shader (GL 4.3)
+GLuint shader_cache_compute_program(const char *cs_source, const char *defines,
+                                    ShaderCacheStats *stats);
+
+void shader_cache_print_stats(const ShaderCacheStats &stats, const char *name = "Shader program");
+
+#endif
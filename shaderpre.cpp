@@ -0,0 +1,281 @@
+// shaderpre.cpp: preprocesado de los shaders (ver shaderpre.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "shaderpre.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utility>
+
+#include "textfile_ALT.h"
+
+const char *shader_read_file(const char *path, char **owned) {
+  *owned = textFileRead(path);
+  return *owned;
+}
+
+static std::string trim(const std::string &s) {
+  size_t begin = s.find_first_not_of(" \t\r");
+  if (begin == std::string::npos)
+    return "";
+  size_t end = s.find_last_not_of(" \t\r");
+  return s.substr(begin, end - begin + 1);
+}
+
+static bool is_integer(const std::string &s) {
+  if (s.empty())
+    return false;
+  for (char c : s)
+    if (!isdigit((unsigned char) c))
+      return false;
+  return true;
+}
+
+static bool is_ident_char(char c) {
+  return isalnum((unsigned char) c) || c == '_';
+}
+
+// Sustituye las apariciones de name como identificador completo
+static std::string replace_word(const std::string &line, const std::string &name, const std::string &value) {
+  std::string out;
+  size_t i = 0;
+  while (i < line.size()) {
+    if (line.compare(i, name.size(), name) == 0 && (i == 0 || !is_ident_char(line[i - 1])) &&
+        (i + name.size() == line.size() || !is_ident_char(line[i + name.size()]))) {
+      out += value;
+      i += name.size();
+    } else {
+      out += line[i++];
+    }
+  }
+  return out;
+}
+
+static std::vector<std::pair<std::string, std::string> > parse_defines(const char *defines) {
+  std::vector<std::pair<std::string, std::string> > result;
+  const char *p = defines ? defines : "";
+  while (*p) {
+    const char *eol = strchr(p, '\n');
+    std::string line = trim(std::string(p, eol ? eol - p : strlen(p)));
+    p = eol ? eol + 1 : p + strlen(p);
+    if (line.compare(0, 7, "#define") != 0)
+      continue;
+    std::string rest = trim(line.substr(7));
+    size_t space = rest.find_first_of(" \t");
+    std::string name = rest.substr(0, space);
+    std::string value = space == std::string::npos ? "" : trim(rest.substr(space));
+    if (!name.empty())
+      result.push_back(std::make_pair(name, value));
+  }
+  return result;
+}
+
+std::string shader_variant_name(const char *defines) {
+  std::string name;
+  for (const std::pair<std::string, std::string> &d : parse_defines(defines)) {
+    if (!name.empty())
+      name += ' ';
+    name += d.second.empty() ? d.first : d.first + "=" + d.second;
+  }
+  return name.empty() ? "(default)" : name;
+}
+
+namespace {
+
+struct Preprocessor {
+  const ShaderReader &read;
+  std::vector<std::pair<std::string, std::string> > defines;
+  std::vector<std::string> files;
+  std::string out;
+
+  Preprocessor(const ShaderReader &read, const char *defines) : read(read), defines(parse_defines(defines)) {}
+
+  bool include(const std::string &path);
+  bool process(const std::vector<std::string> &lines, int first_line, int file, const std::string &path);
+  bool unroll(const std::string &header, const std::vector<std::string> &body, int body_line, int file,
+              const std::string &path);
+
+  void line_directive(int line, int file) { out += "#line " + std::to_string(line) + " " + std::to_string(file) + "\n"; }
+};
+
+bool Preprocessor::include(const std::string &path) {
+  char *owned = NULL;
+  const char *text = read(path.c_str(), &owned);
+  if (!text) {
+    printf("ERROR: could not read shader %s\n", path.c_str());
+    return false;
+  }
+  std::vector<std::string> lines;
+  for (const char *p = text; *p;) {
+    const char *eol = strchr(p, '\n');
+    lines.push_back(std::string(p, eol ? eol - p : strlen(p)));
+    p = eol ? eol + 1 : p + strlen(p);
+  }
+  free(owned);
+
+  int file = (int) files.size();
+  files.push_back(path);
+  return process(lines, 1, file, path);
+}
+
+bool Preprocessor::process(const std::vector<std::string> &lines, int first_line, int file,
+                           const std::string &path) {
+  for (size_t i = 0; i < lines.size(); i++) {
+    int line = first_line + (int) i;
+    std::string directive = trim(lines[i]);
+
+    if (directive.compare(0, 8, "#include") == 0) {
+      size_t open = directive.find('"'), close = directive.rfind('"');
+      if (open == std::string::npos || close <= open) {
+        printf("ERROR: %s:%d: expected #include \"file\"\n", path.c_str(), line);
+        return false;
+      }
+      std::string name = directive.substr(open + 1, close - open - 1);
+      size_t slash = path.rfind('/');
+      std::string resolved = slash == std::string::npos ? name : path.substr(0, slash + 1) + name;
+
+      bool seen = false;
+      for (const std::string &f : files)
+        seen = seen || f == resolved;
+      if (seen) {
+        out += "\n";
+        continue;
+      }
+      line_directive(1, (int) files.size());
+      if (!include(resolved))
+        return false;
+      line_directive(line + 1, file);
+    } else if (directive.compare(0, 7, "#unroll") == 0) {
+      // Hasta el #endunroll que le corresponde
+      int depth = 1;
+      size_t end = i + 1;
+      for (; end < lines.size(); end++) {
+        std::string d = trim(lines[end]);
+        if (d.compare(0, 7, "#unroll") == 0)
+          depth++;
+        else if (d.compare(0, 10, "#endunroll") == 0 && --depth == 0)
+          break;
+      }
+      if (end == lines.size()) {
+        printf("ERROR: %s:%d: #unroll without #endunroll\n", path.c_str(), line);
+        return false;
+      }
+      std::vector<std::string> body(lines.begin() + i + 1, lines.begin() + end);
+      if (!unroll(directive, body, line + 1, file, path))
+        return false;
+      line_directive(first_line + (int) end + 1, file);
+      i = end;
+    } else if (directive.compare(0, 10, "#endunroll") == 0) {
+      printf("ERROR: %s:%d: #endunroll without #unroll\n", path.c_str(), line);
+      return false;
+    } else {
+      out += lines[i];
+      out += '\n';
+      // El cache inserta los defines de la variante tras #version
+      if (file == 0 && line == 1 && directive.compare(0, 8, "#version") == 0)
+        line_directive(2, 0);
+    }
+  }
+  return true;
+}
+
+bool Preprocessor::unroll(const std::string &header, const std::vector<std::string> &body, int body_line,
+                          int file, const std::string &path) {
+  char var[64], count[64];
+  if (sscanf(header.c_str(), "#unroll %63s %63s", var, count) != 2) {
+    printf("ERROR: %s:%d: expected #unroll VAR COUNT\n", path.c_str(), body_line - 1);
+    return false;
+  }
+  std::string value = count;
+  if (!is_integer(value)) {
+    bool found = false;
+    for (const std::pair<std::string, std::string> &d : defines)
+      if (d.first == value) {
+        value = d.second;
+        found = true;
+      }
+    if (!found || value.empty()) {
+      printf("ERROR: %s:%d: #unroll: %s is not defined by the variant\n", path.c_str(), body_line - 1, count);
+      return false;
+    }
+  }
+
+  if (!is_integer(value)) {
+    // Sin valor en tiempo de compilacion: un bucle normal
+    out += std::string("for (int ") + var + " = 0; " + var + " < " + value + "; " + var + "++) {\n";
+    line_directive(body_line, file);
+    if (!process(body, body_line, file, path))
+      return false;
+    out += "}\n";
+    return true;
+  }
+
+  int n = atoi(value.c_str());
+  for (int k = 0; k < n; k++) {
+    std::vector<std::string> copy;
+    for (const std::string &line : body)
+      copy.push_back(replace_word(line, var, std::to_string(k)));
+    line_directive(body_line, file);
+    if (!process(copy, body_line, file, path))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool shader_preprocess(const char *path, const ShaderReader &read, const char *defines,
+                       std::string &out, std::vector<std::string> *files) {
+  Preprocessor pre(read, defines);
+  bool ok = pre.include(path);
+  out.swap(pre.out);
+  if (files)
+    files->insert(files->end(), pre.files.begin(), pre.files.end());
+  return ok;
+}
+
+static void print_source_strings(const char *stage, const std::vector<std::string> &files) {
+  printf("  %s source strings:", stage);
+  for (size_t i = 0; i < files.size(); i++)
+    printf(" %zu = %s", i, files[i].c_str());
+  printf("\n");
+}
+
+GLuint shader_build_program(const char *vs_path, const char *fs_path, const char *defines,
+                            const ShaderReader &read, ShaderCacheStats *stats,
+                            std::vector<std::string> *files) {
+  std::string vs, fs;
+  std::vector<std::string> vs_files, fs_files;
+  if (!shader_preprocess(vs_path, read, defines, vs, &vs_files) ||
+      !shader_preprocess(fs_path, read, defines, fs, &fs_files))
+    return 0;
+  if (files) {
+    files->insert(files->end(), vs_files.begin(), vs_files.end());
+    files->insert(files->end(), fs_files.begin(), fs_files.end());
+  }
+
+  GLuint program = shader_cache_program(vs.c_str(), fs.c_str(), defines, stats);
+  if (!program) {
+    print_source_strings("Vertex", vs_files);
+    print_source_strings("Fragment", fs_files);
+  }
+  return program;
+}
+
+GLuint shader_build_compute_program(const char *cs_path, const char *defines, const ShaderReader &read,
+                                    ShaderCacheStats *stats, std::vector<std::string> *files) {
+  std::string cs;
+  std::vector<std::string> cs_files;
+  if (!shader_preprocess(cs_path, read, defines, cs, &cs_files))
+    return 0;
+  if (files)
+    files->insert(files->end(), cs_files.begin(), cs_files.end());
+
+  GLuint program = shader_cache_compute_program(cs.c_str(), defines, stats);
+  if (!program)
+    print_source_strings("Compute", cs_files);
+  return program;
+}
@@ -0,0 +1,62 @@
+// shaderpre.h: preprocesado de los shaders y variantes especializadas
+//
+// Antes de compilar, los fuentes pasan por un preprocesado propio que
+// resuelve dos directivas que GLSL no tiene:
+//
+//   #include "fichero"   el fichero, relativo al que lo incluye (cada uno
+//                        una sola vez); se anaden #line para que los
+//                        errores del compilador sigan apuntando a la linea
+//                        y fichero (numero de source string) correctos
+//   #unroll I N          el bloque hasta #endunroll se repite N veces con I
+//   ...                  sustituido por 0, 1, ... Si N es el nombre de un
+//   #endunroll           #define de la variante con valor entero se usa ese
+//                        valor; si su valor no es un entero (p. ej. un
+//                        uniform) se genera un for normal
+//
+// Una variante es el bloque de #define que se inserta tras #version (el
+// formato de vertice, el numero de luces, que texturas hay...). Las
+// especializadas fijan esos valores en tiempo de compilacion, con lo que
+// los bucles se desenrollan y las ramas que no se usan desaparecen; el
+// uber-shader los lee de uniforms. Cada variante se compila a traves del
+// cache de shadercache.h, que la guarda con el hash del texto ya
+// preprocesado.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef SHADERPRE_H
+#define SHADERPRE_H
+
+#include <GL/glew.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "shadercache.h"
+
+// Devuelve el contenido de path (NULL si no existe). Si hay que liberarlo
+// con free() lo deja tambien en *owned (si no, NULL)
+typedef std::function<const char *(const char *path, char **owned)> ShaderReader;
+
+// Lector de disco (textFileRead)
+const char *shader_read_file(const char *path, char **owned);
+
+// Expande #include y #unroll de path con los valores de defines. files
+// (puede ser NULL) recibe los ficheros leidos, en el orden de su numero de
+// source string. Imprime el motivo si falla.
+bool shader_preprocess(const char *path, const ShaderReader &read, const char *defines,
+                       std::string &out, std::vector<std::string> *files);
+
+// Preprocesa vs y fs y los compila como la variante defines (o la carga
+// del cache). Si falla la compilacion imprime que fichero es cada source
+// string.
+GLuint shader_build_program(const char *vs_path, const char *fs_path, const char *defines,
+                            const ShaderReader &read, ShaderCacheStats *stats,
+                            std::vector<std::string> *files);
+GLuint shader_build_compute_program(const char *cs_path, const char *defines, const ShaderReader &read,
+                                    ShaderCacheStats *stats, std::vector<std::string> *files);
+
+// "NUM_LIGHTS=2 HAS_DIFFUSE_MAP=1 INSTANCED" a partir del bloque de
+// #define, para los mensajes
+std::string shader_variant_name(const char *defines);
+
+#endif
@@ -0,0 +1,107 @@
+// simthread.cpp: hilo de simulacion y cola de paquetes (ver simthread.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "simthread.h"
+
+#include <stdio.h>
+
+#include <chrono>
+
+#include "profiler.h"
+
+// Vueltas de espera activa antes de pasar a dormir, y cuanto se duerme
+static const int SPINS = 256;
+static const std::chrono::microseconds NAP(50);
+
+// Espera a que ready() sea cierto; devuelve lo que se ha esperado en ms
+template <typename Ready>
+static double wait_until(Ready ready) {
+  if (ready())
+    return 0.0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; !ready(); i++) {
+    if (i < SPINS)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(NAP);
+  }
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+FramePacketQueue::FramePacketQueue(int depth) : packets(depth) {}
+
+FramePacket *FramePacketQueue::begin_write() {
+  uint64_t w = written.load(std::memory_order_relaxed);
+  uint64_t size = packets.size();
+  write_wait += wait_until([&] {
+    return w - read.load(std::memory_order_acquire) < size || closed.load(std::memory_order_acquire);
+  });
+  if (closed.load(std::memory_order_acquire))
+    return NULL;
+  return &packets[w % size];
+}
+
+void FramePacketQueue::end_write() {
+  written.store(written.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+const FramePacket *FramePacketQueue::begin_read() {
+  uint64_t r = read.load(std::memory_order_relaxed);
+  read_wait += wait_until([&] {
+    return written.load(std::memory_order_acquire) != r || closed.load(std::memory_order_acquire);
+  });
+  if (written.load(std::memory_order_acquire) == r)
+    return NULL;
+  return &packets[r % packets.size()];
+}
+
+void FramePacketQueue::end_read() {
+  read.store(read.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void FramePacketQueue::close() {
+  closed.store(true, std::memory_order_release);
+}
+
+SimulationThread::SimulationThread(int depth, SimulateFn simulate) : queue(depth), simulate(simulate) {}
+
+SimulationThread::~SimulationThread() {
+  stop();
+}
+
+void SimulationThread::start() {
+  thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+  queue.close();
+  if (thread.joinable())
+    thread.join();
+}
+
+void SimulationThread::run() {
+  profiler_set_thread_name("simulation");
+  for (;;) {
+    FramePacket *packet = queue.begin_write();
+    if (!packet)
+      return;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+      PROFILE_SCOPE("simulate");
+      packet->frame = frames;
+      simulate(frames, *packet);
+    }
+    simulate_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    queue.end_write();
+    frames++;
+  }
+}
+
+// Tras stop()
+void SimulationThread::print_stats() const {
+  if (frames == 0)
+    return;
+  printf("Simulation thread: %llu packets, depth %d, simulate %.3f ms/frame, waited for the renderer %.3f "
+         "ms/frame, renderer waited %.3f ms/frame\n", (unsigned long long) frames, queue.depth(),
+         simulate_ms / frames, queue.write_wait_ms() / frames, queue.read_wait_ms() / frames);
+}
@@ -0,0 +1,121 @@
+// simthread.h: hilo de simulacion y paquetes de frame para el hilo de render
+//
+// El hilo de simulacion calcula cada frame (camara, culling, matrices de las
+// instancias, luces y su reparto en clusters) y lo deja en un FramePacket;
+// el hilo GL solo sube el paquete y dibuja. Asi el trabajo de CPU de la
+// escena del frame N + 1 se solapa con el envio de comandos y el driver del
+// frame N.
+//
+// Los paquetes van por una cola de un productor y un consumidor con depth
+// paquetes (2: doble buffer, 3: triple) y dos contadores atomicos, sin
+// locks: el productor solo escribe en un paquete libre y el consumidor solo
+// lee uno ya publicado, que no cambia hasta que lo suelta. Si la cola esta
+// llena (render mas lento) espera el productor; si esta vacia (simulacion
+// mas lenta), el consumidor. Las esperas son activas unos instantes y
+// despues a base de sleeps cortos.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef SIMTHREAD_H
+#define SIMTHREAD_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "clusters.h"
+#include "instancing.h"
+#include "uniforms.h"
+
+// Lo que necesita el render de un frame, ya calculado
+struct FramePacket {
+  uint64_t frame;
+  double time;  // currentTime de la simulacion
+  glm::mat4 view, projection;
+  glm::vec3 view_pos;
+  LightUniforms lights;
+  // Reparto de las luces puntuales en clusters (con --lights): el render
+  // solo lo sube
+  ClusterBins clusters;
+  // Instancias visibles de cada malla (cubo y tetraedro): count[m] a partir
+  // de instances[first[m]], con el mismo orden que el buffer de instancias
+  std::vector<InstanceAttribs> instances;
+  int first[2], count[2];
+  // Eventos de entrada ya aplicados en este frame, que cuentan como
+  // presentados con el (FrameScheduler::take_input())
+  std::vector<std::chrono::steady_clock::time_point> input;
+};
+
+class FramePacketQueue {
+public:
+  explicit FramePacketQueue(int depth);
+
+  FramePacketQueue(const FramePacketQueue &) = delete;
+  FramePacketQueue &operator=(const FramePacketQueue &) = delete;
+
+  int depth() const { return (int) packets.size(); }
+
+  // Productor: espera un paquete libre (NULL si se ha cerrado la cola), lo
+  // rellena y lo publica
+  FramePacket *begin_write();
+  void end_write();
+  // Consumidor: espera el siguiente paquete publicado (NULL si se ha
+  // cerrado y no quedan) y lo suelta cuando ya no lo necesita
+  const FramePacket *begin_read();
+  void end_read();
+
+  // Despierta a los dos lados para terminar
+  void close();
+
+  // Tiempo que ha esperado cada lado
+  double write_wait_ms() const { return write_wait; }
+  double read_wait_ms() const { return read_wait; }
+
+private:
+  std::vector<FramePacket> packets;
+  std::atomic<uint64_t> written{0};  // paquetes publicados, solo el productor
+  std::atomic<uint64_t> read{0};     // paquetes soltados, solo el consumidor
+  std::atomic<bool> closed{false};
+  double write_wait = 0.0, read_wait = 0.0;
+};
+
+class SimulationThread {
+public:
+  // simulate rellena el paquete del frame frame (0, 1, ...) desde el hilo
+  // de simulacion
+  typedef std::function<void(uint64_t frame, FramePacket &packet)> SimulateFn;
+
+  SimulationThread(int depth, SimulateFn simulate);
+  ~SimulationThread();
+
+  SimulationThread(const SimulationThread &) = delete;
+  SimulationThread &operator=(const SimulationThread &) = delete;
+
+  void start();
+  // Para el hilo; los paquetes que queden sin leer se descartan
+  void stop();
+
+  // Hilo de render: el paquete del siguiente frame, en orden, y soltarlo en
+  // cuanto ya se ha subido
+  const FramePacket *acquire() { return queue.begin_read(); }
+  void release() { queue.end_read(); }
+
+  // Paquetes, tiempo de simulacion por frame y esperas de cada hilo
+  void print_stats() const;
+
+private:
+  void run();
+
+  FramePacketQueue queue;
+  SimulateFn simulate;
+  std::thread thread;
+  uint64_t frames = 0;
+  double simulate_ms = 0.0;
+};
+
+#endif
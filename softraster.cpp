@@ -0,0 +1,371 @@
+// softraster.cpp: backend de render por software (ver softraster.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "softraster.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "stb_image.h"
+
+// Triangulos por bloque en la etapa de vertices
+#define SETUP_CHUNK 256
+
+bool SoftTexture::load(const char *path) {
+  int comp;
+  unsigned char *data = stbi_load(path, &width, &height, &comp, 0);
+  if (!data) {
+    printf("Texture failed to load");
+    return false;
+  }
+
+  // Mismo resultado que glTexImage2D con GL_RED / GL_RGB / GL_RGBA
+  texels.resize((size_t) width * height * 4);
+  for (size_t i = 0; i < (size_t) width * height; i++) {
+    const unsigned char *src = data + i * comp;
+    unsigned char *dst = &texels[i * 4];
+    dst[0] = src[0];
+    dst[1] = comp >= 3 ? src[1] : 0;
+    dst[2] = comp >= 3 ? src[2] : 0;
+    dst[3] = comp == 4 ? src[3] : 255;
+  }
+
+  stbi_image_free(data);
+  return true;
+}
+
+glm::vec3 SoftTexture::sample(float s, float t) const {
+  // Filtrado bilineal con GL_REPEAT (centros de texel en +0.5)
+  float u = s * width - 0.5f;
+  float v = t * height - 0.5f;
+  float fu = floorf(u), fv = floorf(v);
+  float du = u - fu, dv = v - fv;
+
+  int x0 = (int) fu % width, y0 = (int) fv % height;
+  if (x0 < 0) x0 += width;
+  if (y0 < 0) y0 += height;
+  int x1 = x0 + 1 == width ? 0 : x0 + 1;
+  int y1 = y0 + 1 == height ? 0 : y0 + 1;
+
+  const unsigned char *t00 = &texels[((size_t) y0 * width + x0) * 4];
+  const unsigned char *t10 = &texels[((size_t) y0 * width + x1) * 4];
+  const unsigned char *t01 = &texels[((size_t) y1 * width + x0) * 4];
+  const unsigned char *t11 = &texels[((size_t) y1 * width + x1) * 4];
+
+  glm::vec3 result;
+  for (int c = 0; c < 3; c++) {
+    float top = t00[c] + (t10[c] - t00[c]) * du;
+    float bottom = t01[c] + (t11[c] - t01[c]) * du;
+    result[c] = (top + (bottom - top) * dv) * (1.0f / 255.0f);
+  }
+  return result;
+}
+
+SoftRenderer::SoftRenderer(int width, int height, int threads)
+  : fb_width(0), fb_height(0), tiles_x(0), tiles_y(0), pool(threads) {
+  phong = phong_best_kernel(&phong_name);
+  resize(width, height);
+}
+
+void SoftRenderer::resize(int width, int height) {
+  if (width == fb_width && height == fb_height)
+    return;
+
+  fb_width = width;
+  fb_height = height;
+  tiles_x = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+  tiles_y = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+
+  color.assign((size_t) width * height * 4, 0);
+  depth.assign((size_t) width * height, 1.0f);
+  bins.assign(tiles_x * tiles_y, std::vector<int>());
+}
+
+void SoftRenderer::clear() {
+  // glClearColor por defecto (0, 0, 0, 0) y glClearDepth 1.0
+  pool.parallel_for(tiles_y, [this](int ty) {
+    int y0 = ty * SOFT_TILE_SIZE;
+    int y1 = std::min(y0 + SOFT_TILE_SIZE, fb_height);
+    memset(&color[(size_t) y0 * fb_width * 4], 0, (size_t) (y1 - y0) * fb_width * 4);
+    std::fill(depth.begin() + (size_t) y0 * fb_width, depth.begin() + (size_t) y1 * fb_width, 1.0f);
+  });
+}
+
+SoftRenderer::ClipVertex SoftRenderer::clip_lerp(const ClipVertex &a, const ClipVertex &b, float t) {
+  ClipVertex r;
+  r.pos = a.pos + (b.pos - a.pos) * t;
+  for (int i = 0; i < 8; i++)
+    r.attr[i] = a.attr[i] + (b.attr[i] - a.attr[i]) * t;
+  return r;
+}
+
+// Vertex shader de los vertices [first, last) del draw
+void SoftRenderer::shade_vertices(const float *vertices, int first, int last, int draw) {
+  const SoftDrawParams &p = draws[draw];
+  glm::mat4 mvp = p.projection * p.view * p.model;
+
+  for (int v = first; v < last; v++) {
+    const float *src = vertices + (size_t) v * 8;
+    glm::vec4 v_pos(src[0], src[1], src[2], 1.0f);
+    glm::vec3 frag_3Dpos = glm::vec3(p.model * v_pos);
+    glm::vec3 normal = glm::normalize(p.normal_matrix * glm::vec3(src[3], src[4], src[5]));
+
+    ClipVertex &out = clip_vertices[v];
+    out.pos = mvp * v_pos;
+    out.attr[0] = frag_3Dpos.x;
+    out.attr[1] = frag_3Dpos.y;
+    out.attr[2] = frag_3Dpos.z;
+    out.attr[3] = normal.x;
+    out.attr[4] = normal.y;
+    out.attr[5] = normal.z;
+    out.attr[6] = src[6];
+    out.attr[7] = src[7];
+  }
+}
+
+void SoftRenderer::setup_triangles(const uint32_t *indices, int first, int last, int draw,
+                                   std::vector<Triangle> &out) const {
+  for (int t = first; t < last; t++) {
+    const ClipVertex *in[3] = { &clip_vertices[indices[3 * t]], &clip_vertices[indices[3 * t + 1]],
+                                &clip_vertices[indices[3 * t + 2]] };
+
+    // Recorte contra el plano near (z >= -w). El resto de planos se
+    // resuelven limitando la caja del triangulo a la pantalla y
+    // descartando profundidades fuera de [0, 1].
+    ClipVertex poly[4];
+    int n = 0;
+    for (int k = 0; k < 3; k++) {
+      const ClipVertex &a = *in[k];
+      const ClipVertex &b = *in[(k + 1) % 3];
+      float da = a.pos.z + a.pos.w;
+      float db = b.pos.z + b.pos.w;
+      if (da >= 0.0f)
+        poly[n++] = a;
+      if ((da >= 0.0f) != (db >= 0.0f))
+        poly[n++] = clip_lerp(a, b, da / (da - db));
+    }
+    if (n < 3)
+      continue;
+
+    // Division de perspectiva y viewport (fila 0 arriba)
+    ScreenVertex sv[4];
+    for (int k = 0; k < n; k++) {
+      float inv_w = 1.0f / poly[k].pos.w;
+      sv[k].x = (poly[k].pos.x * inv_w * 0.5f + 0.5f) * fb_width;
+      sv[k].y = (0.5f - poly[k].pos.y * inv_w * 0.5f) * fb_height;
+      sv[k].z = poly[k].pos.z * inv_w * 0.5f + 0.5f;
+      sv[k].inv_w = inv_w;
+      for (int i = 0; i < 8; i++)
+        sv[k].attr[i] = poly[k].attr[i] * inv_w;
+    }
+
+    for (int k = 1; k + 1 < n; k++) {
+      Triangle tri;
+      tri.v[0] = sv[0];
+      tri.v[1] = sv[k];
+      tri.v[2] = sv[k + 1];
+      tri.draw = draw;
+
+      // Sin face culling (como en la version GL): se orientan todos igual
+      float area = (tri.v[1].x - tri.v[0].x) * (tri.v[2].y - tri.v[0].y) -
+                   (tri.v[1].y - tri.v[0].y) * (tri.v[2].x - tri.v[0].x);
+      if (area == 0.0f)
+        continue;
+      if (area < 0.0f)
+        std::swap(tri.v[1], tri.v[2]);
+
+      float min_x = std::min(tri.v[0].x, std::min(tri.v[1].x, tri.v[2].x));
+      float max_x = std::max(tri.v[0].x, std::max(tri.v[1].x, tri.v[2].x));
+      float min_y = std::min(tri.v[0].y, std::min(tri.v[1].y, tri.v[2].y));
+      float max_y = std::max(tri.v[0].y, std::max(tri.v[1].y, tri.v[2].y));
+
+      tri.min_x = std::max(0, (int) floorf(min_x));
+      tri.min_y = std::max(0, (int) floorf(min_y));
+      tri.max_x = std::min(fb_width - 1, (int) ceilf(max_x));
+      tri.max_y = std::min(fb_height - 1, (int) ceilf(max_y));
+      if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+        continue;
+
+      out.push_back(tri);
+    }
+  }
+}
+
+void SoftRenderer::draw(const float *vertices, int vertex_count, const uint32_t *indices, int index_count,
+                        const SoftDrawParams &params) {
+  int draw = (int) draws.size();
+  draws.push_back(params);
+
+  // Vertex shader una vez por vertice y montaje de triangulos, los dos en
+  // paralelo por bloques; el binning es secuencial para conservar el orden
+  // de envio dentro de cada tile
+  clip_vertices.resize(vertex_count);
+  int vertex_chunks = (vertex_count + SETUP_CHUNK - 1) / SETUP_CHUNK;
+  pool.parallel_for(vertex_chunks, [&](int c) {
+    int first = c * SETUP_CHUNK;
+    shade_vertices(vertices, first, std::min(first + SETUP_CHUNK, vertex_count), draw);
+  });
+
+  int num_triangles = index_count / 3;
+  int chunks = (num_triangles + SETUP_CHUNK - 1) / SETUP_CHUNK;
+  std::vector<std::vector<Triangle>> setup(chunks);
+
+  pool.parallel_for(chunks, [&](int c) {
+    int first = c * SETUP_CHUNK;
+    int last = std::min(first + SETUP_CHUNK, num_triangles);
+    setup[c].reserve(last - first);
+    setup_triangles(indices, first, last, draw, setup[c]);
+  });
+
+  for (const std::vector<Triangle> &chunk : setup) {
+    for (const Triangle &tri : chunk) {
+      int idx = (int) triangles.size();
+      triangles.push_back(tri);
+
+      for (int ty = tri.min_y / SOFT_TILE_SIZE; ty <= tri.max_y / SOFT_TILE_SIZE; ty++)
+        for (int tx = tri.min_x / SOFT_TILE_SIZE; tx <= tri.max_x / SOFT_TILE_SIZE; tx++)
+          bins[ty * tiles_x + tx].push_back(idx);
+    }
+  }
+}
+
+void SoftRenderer::finish() {
+  pool.parallel_for(tiles_x * tiles_y, [this](int tile) { raster_tile(tile); });
+
+  for (std::vector<int> &bin : bins)
+    bin.clear();
+  triangles.clear();
+  draws.clear();
+}
+
+static PhongParams phong_params(const SoftDrawParams &p) {
+  PhongParams params;
+  const SoftLight *lights[2] = { &p.light, &p.light2 };
+  for (int c = 0; c < 3; c++) {
+    params.view_pos[c] = p.view_pos[c];
+    for (int l = 0; l < 2; l++) {
+      params.lights[l].position[c] = lights[l]->position[c];
+      params.lights[l].ambient[c] = lights[l]->ambient[c];
+      params.lights[l].diffuse[c] = lights[l]->diffuse[c];
+      params.lights[l].specular[c] = lights[l]->specular[c];
+    }
+  }
+  params.shininess = p.shininess;
+  return params;
+}
+
+void SoftRenderer::shade_batch(const PhongParams &params, PhongFragments &frags,
+                               const size_t *pixels, int count) {
+  phong(params, frags);
+
+  for (int i = 0; i < count; i++) {
+    unsigned char *dst = &color[pixels[i] * 4];
+    dst[0] = (unsigned char) (glm::clamp(frags.out_r[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+    dst[1] = (unsigned char) (glm::clamp(frags.out_g[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+    dst[2] = (unsigned char) (glm::clamp(frags.out_b[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+    dst[3] = 255;
+  }
+}
+
+static inline float edge(const float ax, const float ay, const float bx, const float by,
+                         const float px, const float py) {
+  return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+void SoftRenderer::raster_tile(int tile) {
+  int tile_x0 = (tile % tiles_x) * SOFT_TILE_SIZE;
+  int tile_y0 = (tile / tiles_x) * SOFT_TILE_SIZE;
+  int tile_x1 = std::min(tile_x0 + SOFT_TILE_SIZE, fb_width) - 1;
+  int tile_y1 = std::min(tile_y0 + SOFT_TILE_SIZE, fb_height) - 1;
+
+  // Lote de fragmentos pendientes de sombrear; los carriles sin usar
+  // conservan valores anteriores (finitos)
+  PhongFragments frags;
+  memset(&frags, 0, sizeof(frags));
+  size_t batch_pixels[PHONG_BATCH];
+  int batch = 0;
+  int current_draw = -1;
+  PhongParams params;
+
+  for (int idx : bins[tile]) {
+    const Triangle &tri = triangles[idx];
+    const SoftDrawParams &p = draws[tri.draw];
+    const ScreenVertex &v0 = tri.v[0], &v1 = tri.v[1], &v2 = tri.v[2];
+
+    // Los uniforms solo cambian entre draws: ahi se vacia el lote. Dentro
+    // de un draw un pixel puede repetirse en el lote, pero los carriles se
+    // escriben en orden y gana el ultimo, igual que sin lotes.
+    if (tri.draw != current_draw) {
+      if (batch > 0)
+        shade_batch(params, frags, batch_pixels, batch);
+      batch = 0;
+      current_draw = tri.draw;
+      params = phong_params(p);
+    }
+
+    int x0 = std::max(tri.min_x, tile_x0), x1 = std::min(tri.max_x, tile_x1);
+    int y0 = std::max(tri.min_y, tile_y0), y1 = std::min(tri.max_y, tile_y1);
+
+    float inv_area = 1.0f / edge(v0.x, v0.y, v1.x, v1.y, v2.x, v2.y);
+
+    // Funciones de arista evaluadas en el centro del pixel; avanzan en x con
+    // un incremento constante
+    float step0 = -(v2.y - v1.y), step1 = -(v0.y - v2.y), step2 = -(v1.y - v0.y);
+
+    for (int y = y0; y <= y1; y++) {
+      float py = y + 0.5f, px = x0 + 0.5f;
+      float e0 = edge(v1.x, v1.y, v2.x, v2.y, px, py);
+      float e1 = edge(v2.x, v2.y, v0.x, v0.y, px, py);
+      float e2 = edge(v0.x, v0.y, v1.x, v1.y, px, py);
+
+      for (int x = x0; x <= x1; x++, e0 += step0, e1 += step1, e2 += step2) {
+        if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f)
+          continue;
+
+        float b0 = e0 * inv_area, b1 = e1 * inv_area, b2 = e2 * inv_area;
+
+        float z = b0 * v0.z + b1 * v1.z + b2 * v2.z;
+        size_t pixel = (size_t) y * fb_width + x;
+        if (z < 0.0f || z > 1.0f || !(z < depth[pixel]))  // GL_LESS
+          continue;
+
+        // Interpolacion con correccion de perspectiva
+        float w = 1.0f / (b0 * v0.inv_w + b1 * v1.inv_w + b2 * v2.inv_w);
+        float a[8];
+        for (int i = 0; i < 8; i++)
+          a[i] = (b0 * v0.attr[i] + b1 * v1.attr[i] + b2 * v2.attr[i]) * w;
+
+        depth[pixel] = z;
+
+        // Un unico muestreo de cada textura por fragmento
+        glm::vec3 diffuse_tex = p.diffuse->sample(a[6], a[7]);
+        glm::vec3 specular_tex = p.specular->sample(a[6], a[7]);
+
+        frags.pos_x[batch] = a[0];
+        frags.pos_y[batch] = a[1];
+        frags.pos_z[batch] = a[2];
+        frags.normal_x[batch] = a[3];
+        frags.normal_y[batch] = a[4];
+        frags.normal_z[batch] = a[5];
+        frags.diffuse_r[batch] = diffuse_tex.x;
+        frags.diffuse_g[batch] = diffuse_tex.y;
+        frags.diffuse_b[batch] = diffuse_tex.z;
+        frags.specular_r[batch] = specular_tex.x;
+        frags.specular_g[batch] = specular_tex.y;
+        frags.specular_b[batch] = specular_tex.z;
+        batch_pixels[batch] = pixel;
+
+        if (++batch == PHONG_BATCH) {
+          shade_batch(params, frags, batch_pixels, batch);
+          batch = 0;
+        }
+      }
+    }
+  }
+
+  if (batch > 0)
+    shade_batch(params, frags, batch_pixels, batch);
+}
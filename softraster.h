@@ -0,0 +1,133 @@
+// softraster.h: backend de render por software (CPU)
+//
+// Reproduce el pipeline de spinningcube_withlight_vs_SKEL.glsl y
+// spinningcube_withlight_fs_SKEL.glsl: transformacion con model/view/
+// projection/normal_matrix, recorte contra el plano near, rasterizado de
+// triangulos con test de profundidad GL_LESS y Phong con dos luces y mapas
+// difuso y especular.
+//
+// El framebuffer se divide en tiles de SOFT_TILE_SIZE pixeles. draw() solo
+// transforma los vertices (una vez cada uno, aunque los compartan varios
+// triangulos) y reparte (bin) los triangulos en los tiles que tocan; finish()
+// rasteriza los tiles en paralelo, cada uno en el orden de envio, asi que el
+// resultado no depende del numero de hilos.
+//
+// Los fragmentos que pasan el test de profundidad se acumulan en lotes SoA
+// y se sombrean con el kernel de phong_simd.h elegido para la CPU.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef SOFTRASTER_H
+#define SOFTRASTER_H
+
+#include <glm/glm.hpp>
+#include <stdint.h>
+
+#include <vector>
+
+#include "phong_simd.h"
+#include "threadpool.h"
+
+#define SOFT_TILE_SIZE 64
+
+// Textura RGBA8 en memoria. Se muestrea con filtrado bilineal y GL_REPEAT
+// sobre el nivel 0 (sin mipmaps).
+struct SoftTexture {
+  int width = 0;
+  int height = 0;
+  std::vector<unsigned char> texels;
+
+  bool load(const char *path);
+  glm::vec3 sample(float s, float t) const;
+};
+
+struct SoftLight {
+  glm::vec3 position;
+  glm::vec3 ambient;
+  glm::vec3 diffuse;
+  glm::vec3 specular;
+};
+
+// Equivalente a los uniforms del programa GLSL
+struct SoftDrawParams {
+  glm::mat4 model;
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::mat3 normal_matrix;
+  glm::vec3 view_pos;
+  SoftLight light;
+  SoftLight light2;
+  float shininess;
+  const SoftTexture *diffuse;
+  const SoftTexture *specular;
+};
+
+class SoftRenderer {
+public:
+  // threads == 0: todos los nucleos
+  SoftRenderer(int width, int height, int threads = 0);
+
+  void resize(int width, int height);
+  void clear();
+
+  // vertices: vertex_count vertices de 8 floats (posicion, normal, coord.
+  // textura) e indices: 3 por triangulo, igual que los buffers de la version
+  // GL.
+  void draw(const float *vertices, int vertex_count, const uint32_t *indices, int index_count,
+            const SoftDrawParams &params);
+
+  // Rasteriza todo lo enviado desde el ultimo finish()
+  void finish();
+
+  int width() const { return fb_width; }
+  int height() const { return fb_height; }
+  int threads() const { return pool.size(); }
+  const char *kernel_name() const { return phong_name; }
+
+  // RGBA8, fila 0 arriba
+  const unsigned char *pixels() const { return color.data(); }
+
+private:
+  // Salida del vertex shader: coordenadas de recorte y atributos
+  struct ClipVertex {
+    glm::vec4 pos;
+    float attr[8];  // frag_3Dpos, normal, vs_tex_coord
+  };
+
+  // Vertice ya proyectado: posicion en pantalla, profundidad [0,1], 1/w y
+  // atributos divididos por w para interpolar con correccion de perspectiva
+  struct ScreenVertex {
+    float x, y, z, inv_w;
+    float attr[8];  // frag_3Dpos, normal, vs_tex_coord
+  };
+
+  struct Triangle {
+    ScreenVertex v[3];
+    int draw;
+    int min_x, min_y, max_x, max_y;
+  };
+
+  static ClipVertex clip_lerp(const ClipVertex &a, const ClipVertex &b, float t);
+  void shade_vertices(const float *vertices, int first, int last, int draw);
+  void setup_triangles(const uint32_t *indices, int first, int last, int draw,
+                       std::vector<Triangle> &out) const;
+  void raster_tile(int tile);
+  void shade_batch(const PhongParams &params, PhongFragments &frags,
+                   const size_t *pixels, int count);
+
+  int fb_width, fb_height;
+  int tiles_x, tiles_y;
+  std::vector<unsigned char> color;
+  std::vector<float> depth;
+
+  std::vector<SoftDrawParams> draws;
+  std::vector<ClipVertex> clip_vertices;  // los del draw en curso
+  std::vector<Triangle> triangles;
+  std::vector<std::vector<int>> bins;
+
+  PhongKernel phong;
+  const char *phong_name;
+
+  ThreadPool pool;
+};
+
+#endif
@@ -3,12 +3,19 @@
 // https://spdx.org/licenses/X11.html
 
 //Ejecucion:
-//gcc spinningcube_withlight_SKEL.cpp textfile.c -lGL -lGLEW -lglfw -lm -o spinningcube_withlight_SKEL
+//make && ./spinningcube_withlight_SKEL
+//Sin ventana (benchmark): ./spinningcube_withlight_SKEL --headless 600 --out frames.csv
 
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 // El siguiente fichero es necesario y se obtiene https://github.com/nothings/stb/blob/master/stb_image.h
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -20,41 +27,86 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "textfile_ALT.h"
+#include "assetpack.h"
+#include "clusters.h"
+#include "cmdlist.h"
+#include "culling.h"
+#include "framepacing.h"
+#include "glcalls.h"
+#include "glstate.h"
+#include "gpucull.h"
+#include "hiz.h"
+#include "hotreload.h"
+#include "headless.h"
+#include "instancing.h"
+#include "meshloader.h"
+#include "meshopt.h"
+#include "meshquant.h"
+#include "occlusion.h"
+#include "pngwrite.h"
+#include "profiler.h"
+#include "shadercache.h"
+#include "shaderpre.h"
+#include "simthread.h"
+#include "softraster.h"
+#include "texloader.h"
+#include "transforms.h"
+#include "uniforms.h"
 
 int gl_width = 640;
 int gl_height = 480;
+// gl_width / gl_height para la proyeccion; la lee tambien el hilo de
+// simulacion
+std::atomic<float> view_aspect(640.0f / 480.0f);
 
 void glfw_window_size_callback(GLFWwindow* window, int width, int height);
+void glfw_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow *window);
 void updateCameraPosition(GLFWwindow *window);
+void updateViewMatrix();
 void render(double);
-
-// Metodo para cargar la textura
-unsigned int load_textura(const char* path);
+void render_instanced(double);
+void render_gpu_driven(double);
+void render_packet(double);
+void render_recorded(double);
+void simulate_frame(uint64_t frame, FramePacket &packet);
+void render_soft(double);
+glm::mat4 compute_model_matrix(glm::vec3 position, double currentTime);
 
 GLuint shader_program = 0; // shader program to set render pipeline
 GLuint vao = 0; // Vertext Array Object to set input data
 GLuint vao2 = 0; 
-GLint model_location, view_location, proj_location; // Uniforms for transformation matrices
+GLint model_location; // Uniforms for transformation matrices
 GLint normal_location;
-GLint light_position_location, light_ambient_location, light_diffuse_location, light_specular_location;
-GLint light_position_location2, light_ambient_location2, light_diffuse_location2, light_specular_location2;
-
-GLint material_ambient_location, material_diffuse_location, material_specular_location, material_shininess_location;  
-GLint camera_position_location;
+GLint material_specular_location;
+GLint mesh_dequant_location;  // solo con --packed-vertices
+// Camara, luces y material van en uniform buffers (FrameData, LightData,
+// MaterialData) que se escriben una vez por frame
+UniformRing *uniform_ring = NULL;
 
 // Shader names
 const char *vertexFileName = "spinningcube_withlight_vs_SKEL.glsl";
 const char *fragmentFileName = "spinningcube_withlight_fs_SKEL.glsl";
+const char *cullFileName = "cull_cs.glsl";
+const char *hizFileName = "hiz_cs.glsl";
+// Variante del programa (shaderpre.h): especializada para la escena o, con
+// --uber-shader, una sola que lo decide todo con uniforms
+bool use_uber_shader = false;
 
 glm::mat4 view_matrix;
 //updateCameraPosition vars
-bool useFirstCamera = true;
+std::atomic<bool> useFirstCamera(true);  // la lee el hilo de simulacion
 bool teclaPulsada = false;
 
 // Camera
 glm::vec3 camera_pos(0.0f, 0.0f, 3.0f);
 glm::vec3 camera_pos2(0.0f, 0.0f, -2.0f);
+const float camera_fov = 50.0f;  // grados, vertical
+const float camera_near = 0.1f;
+const float camera_far = 1000.0f;
+// --camera: sustituye a camera_pos
+bool has_camera_override = false;
+glm::vec3 camera_override;
 
 // Lighting
 glm::vec3 light_pos(10.0f, 1.0f, 0.5f);
@@ -65,6 +117,13 @@ glm::vec3 light_specular(1.0f, 1.0f, 1.0f);
 // Lighting Tetraedro
 glm::vec3 light_pos2(-10.0f, 1.0f, 0.5f);
 
+// Luces puntuales ademas de las dos anteriores (--lights), asignadas a
+// clusters del frustum en cada frame
+int light_count = 0;
+int cluster_dims[3] = { 16, 9, 24 };
+const float point_light_radius = 1.5f;
+ClusteredLights *clustered_lights = NULL;
+
 // Material
 glm::vec3 material_specular(0.5f, 0.5f, 0.5f);
 const GLfloat material_shininess = 32.0f;
@@ -72,31 +131,936 @@ const GLfloat material_shininess = 32.0f;
 // Textura
 unsigned int diffuse_map;
 unsigned int specular_map;
+// Las texturas se decodifican en segundo plano y se suben en el render loop
+TextureLoader *texture_loader = NULL;
+const char *preload_list = NULL;
+// Extension de las texturas del cubo: ".png" o ".dds" (ver texcompress)
+const char *texture_ext = ".png";
+
+// Paquete de recursos (--pack, ver packassets): los shaders, texturas y
+// mallas que esten en el se toman del fichero proyectado en memoria en
+// lugar de leer los ficheros sueltos
+const char *pack_path = NULL;
+AssetPack *asset_pack = NULL;
+// --cold: saca los recursos de la cache de paginas antes de cargarlos
+bool cold_start = false;
+std::chrono::steady_clock::time_point startup_begin;
+
+// --watch: recarga los shaders y las texturas cuando cambian (hotreload.h),
+// con un contexto compartido para el hilo de recarga
+bool use_hot_reload = false;
+HotReloader *hot_reloader = NULL;
+GLFWwindow *reload_window = NULL;
+HeadlessContext *reload_context = NULL;
+std::vector<std::string> program_files;  // con sus #include
+int diffuse_slot = -1;
+void (*frame_render_fn)(double) = NULL;
+
+// Cube to be rendered
+//
+//          0        3
+//       7        4 <-- top-right-near
+// bottom
+// left
+// far ---> 1        2
+//       6        5
+//
+
+const GLfloat vertex_positions[] = {
+
+  //positions                   //Normals       // Texture
+  -0.25f, -0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  0.0f, 0.0f,  // 1
+  -0.25f,  0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  0.0f, 1.0f,  // 0
+   0.25f, -0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  1.0f, 0.0f,  // 2
+
+   0.25f,  0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  1.0f, 1.0f,  // 3
+   0.25f, -0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  1.0f, 0.0f,  // 2
+  -0.25f,  0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  0.0f, 1.0f,  // 0
+
+   0.25f, -0.25f, -0.25f,  1.0f, 0.0f, 0.0f,   0.0f, 0.0f,  // 2
+   0.25f,  0.25f, -0.25f,  1.0f, 0.0f, 0.0f,   1.0f, 0.0f,  // 3
+   0.25f, -0.25f,  0.25f,  1.0f, 0.0f, 0.0f,   0.0f, 1.0f,  // 5
+
+   0.25f,  0.25f,  0.25f,  1.0f, 0.0f, 0.0f,   1.0f, 1.0f,  // 4
+   0.25f, -0.25f,  0.25f,  1.0f, 0.0f, 0.0f,   0.0f, 1.0f,  // 5
+   0.25f,  0.25f, -0.25f,  1.0f, 0.0f, 0.0f,   1.0f, 0.0f,  // 3
+
+   0.25f, -0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   0.0f, 0.0f,  // 5
+   0.25f,  0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   0.0f, 1.0f,  // 4
+  -0.25f, -0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   1.0f, 0.0f,  // 6
+
+  -0.25f,  0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   1.0f, 1.0f,  // 7
+  -0.25f, -0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   1.0f, 0.0f,  // 6
+   0.25f,  0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   0.0f, 1.0f,  // 4
+
+  -0.25f, -0.25f,  0.25f,  -1.0f, 0.0f, 0.0f,  0.0f, 0.0f,  // 6
+  -0.25f,  0.25f,  0.25f,  -1.0f, 0.0f, 0.0f,  1.0f, 0.0f,  // 7
+  -0.25f, -0.25f, -0.25f,  -1.0f, 0.0f, 0.0f,  0.0f, 1.0f,  // 1
+
+  -0.25f,  0.25f, -0.25f,  -1.0f, 0.0f, 0.0f,  1.0f, 1.0f,  // 0
+  -0.25f, -0.25f, -0.25f,  -1.0f, 0.0f, 0.0f,  0.0f, 1.0f,  // 1
+  -0.25f,  0.25f,  0.25f,  -1.0f, 0.0f, 0.0f,  1.0f, 0.0f,  // 7
+
+   0.25f, -0.25f, -0.25f,  0.0f, -1.0f, 0.0f,  0.0f, 0.0f,  // 2
+   0.25f, -0.25f,  0.25f,  0.0f, -1.0f, 0.0f,  1.0f, 0.0f,  // 5
+  -0.25f, -0.25f, -0.25f,  0.0f, -1.0f, 0.0f,  0.0f, 1.0f,  // 1
+
+  -0.25f, -0.25f,  0.25f,  0.0f, -1.0f, 0.0f,  1.0f, 1.0f,  // 6
+  -0.25f, -0.25f, -0.25f,  0.0f, -1.0f, 0.0f,  0.0f, 1.0f,  // 1
+   0.25f, -0.25f,  0.25f,  0.0f, -1.0f, 0.0f,  1.0f, 0.0f,  // 5
+
+   0.25f,  0.25f,  0.25f,  0.0f, 1.0f, 0.0f,   0.0f, 0.0f,  // 4
+   0.25f,  0.25f, -0.25f,  0.0f, 1.0f, 0.0f,   1.0f, 0.0f,  // 3
+  -0.25f,  0.25f,  0.25f,  0.0f, 1.0f, 0.0f,   0.0f, 1.0f,  // 7
+
+  -0.25f,  0.25f, -0.25f,  0.0f, 1.0f, 0.0f,   1.0f, 1.0f,  // 0
+  -0.25f,  0.25f,  0.25f,  0.0f, 1.0f, 0.0f,   0.0f, 1.0f,  // 7
+   0.25f,  0.25f, -0.25f,  0.0f, 1.0f, 0.0f,   1.0f, 0.0f,  // 3
+};
+
+//TETRAEDRO
+//
+//           3
+//
+//           1   
+//     
+//        6       5
+//
+const GLfloat vertex_positions_tetraedro[] = {
+
+  //positions                   //Normals             // Texture
+  0.0f,  0.25f, -0.15f,        -1.0f, 0.0f, 0.0f,     0.5f,  1.0f,   // 3
+  0.0f,  -0.25f,  0.30f,       -1.0f, 0.0f, 0.0f,     1.0f,  0.0f,   // 6
+  -0.25f, -0.25f, -0.15f,      -1.0f, 0.0f, 0.0f,     0.0f,  0.0f,   // 1
+
+  0.0f,  0.25f, -0.15f,        1.0f, 0.0f, 0.0f,      0.5f,  1.0f,    // 3
+  -0.25f, -0.25f, -0.15f,      1.0f, 0.0f, 0.0f,      1.0f,  0.0f,    // 1
+  0.25f, -0.25f,  -0.15f,      1.0f, 0.0f, 0.0f,      0.0f,  0.0f,    // 5
+  
 
-int main() {
-  // start GL context and O/S window using the GLFW helper library
-  if (!glfwInit()) {
-    fprintf(stderr, "ERROR: could not start GLFW3\n");
-    return 1;
+  0.0f,  -0.25f,  0.30f,       0.0f, 0.0f, -1.0f,     0.0f,  0.0f,    // 6
+  0.25f, -0.25f,  -0.15f,      0.0f, 0.0f, -1.0f,     1.0f,  0.0f,    // 5
+  0.0f,  0.25f, -0.15f,        0.0f, 0.0f, -1.0f,     0.5f,  1.0f,    // 3
+
+  0.0f,  -0.25f,  0.30f,       0.0f, -1.0f, 0.0f,     0.0f,  0.0f,    // 6
+  -0.25f, -0.25f, -0.15f,      0.0f, -1.0f, 0.0f,     1.0f,  0.0f,    // 1
+  0.25f, -0.25f,  -0.15f,      0.0f, -1.0f, 0.0f,     0.5f,  1.0f,    // 5
+};
+
+// Mallas indexadas de la escena: [0] el cubo (o el modelo de --mesh) y [1]
+// el tetraedro, en vao y vao2. Se reordenan con optimize_mesh() para la
+// cache de vertices y el overdraw salvo con --no-mesh-opt
+const char *mesh_path = NULL;
+bool optimize_meshes = true;
+MeshData scene_meshes[2];
+// Con --packed-vertices los VBOs llevan el formato compacto de meshquant.h
+// (12 bytes por vertice) y cada draw sube la transformacion de su malla
+bool use_packed = false;
+PackedMesh packed_meshes[2];
+QuantRange gpu_packed_range;  // el de las dos mallas juntas (--gpu-cull)
+
+// Modo headless (sin ventana): numero de frames, paso de tiempo fijo y
+// fichero de salida con los tiempos (CSV o JSON segun extension)
+int headless_frames = 0;
+double headless_dt = 1.0 / 60.0;
+const char *headless_out = NULL;
+const char *dump_path = NULL;
+
+// Backend por software (CPU) en lugar de GL
+bool use_soft = false;
+int soft_threads = 0;
+SoftRenderer *soft_renderer = NULL;
+SoftTexture soft_diffuse_map;
+SoftTexture soft_specular_map;
+
+// Escena instanciada: instance_count cubos y tetraedros con un
+// glDrawElementsInstanced por malla (0: escena original)
+int instance_count = 0;
+int instance_side = 1;
+std::vector<glm::vec3> instance_cells;
+GLuint instance_vbo = 0;
+TransformSystem *transforms = NULL;
+
+// Frustum culling de cubos (ids 0..n-1) y tetraedros (n..2n-1), con n
+// celdas de la rejilla: el mismo orden que TransformSystem
+bool use_culling = true;
+CullingBvh *culling = NULL;
+std::vector<int> visible_ids, visible_cubes, visible_tetras;
+std::vector<glm::vec3> object_lo, object_hi;  // cajas por id
+
+// Occlusion culling en la CPU (--occlusion): tras el frustum, los objetos
+// visibles mas grandes en pantalla tapan a los demas
+const int MAX_OCCLUDERS = 64;
+const float MIN_OCCLUDER_SIZE = 0.02f;  // radio / distancia
+const int MAX_OCCLUDER_TRIANGLES = 256;  // un modelo de --mesh mas grande no tapa
+bool use_occlusion = false;
+MaskedOcclusion *occlusion = NULL;
+int occlusion_meshes[2];  // -1: la malla no se usa como oclusor
+
+// Culling y draws en la GPU (--gpu-cull): un VAO con las dos mallas seguidas
+// y las instancias que escribe el compute shader
+bool use_gpu_cull = false;
+GpuCulling *gpu_culling = NULL;
+GLuint gpu_vao = 0;
+
+// Occlusion culling con la piramide de profundidad (--hiz) y escena de la
+// ciudad de cubos (--city N), las dos sobre el culling en la GPU
+bool use_hiz = false;
+HiZBuffer *hiz_buffer = NULL;
+int city_blocks = 0;
+
+// --pacing / --fps: ritmo de los frames (framepacing.h); tambien mide la
+// latencia de la entrada y el uso de CPU
+PacingMode pacing_mode = PACING_OFF;
+bool has_pacing = false;  // sin ventana solo se mide con --pacing
+double pacing_fps = 0.0;
+FrameScheduler *frame_scheduler = NULL;
+
+// --profile / --trace: zonas de CPU y GPU del frame (profiler.h)
+bool use_profiler = false;
+const char *trace_path = NULL;
+
+// --sim-thread: camara, culling, matrices de las instancias y luces en un
+// hilo propio que pasa al de render paquetes de frame (simthread.h)
+bool use_sim_thread = false;
+int packet_depth = 3;
+SimulationThread *sim_thread = NULL;
+
+// --command-lists: un draw por objeto visible, grabados por particiones en
+// listas de comandos en paralelo y reproducidos en orden (cmdlist.h); las
+// listas que no cambian de un frame a otro se reutilizan
+bool use_command_lists = false;
+bool reuse_command_lists = true;  // --no-list-cache
+CommandRecorder *command_recorder = NULL;
+std::vector<int> draw_ids;
+
+// --no-state-cache: todos los binds y uniforms van a GL, aunque no cambien
+// nada (glstate.h)
+bool use_state_cache = true;
+
+static void usage(const char *prog) {
+  printf("Uso: %s [opciones]\n", prog);
+  printf("  --headless N     renderiza N frames sin ventana (EGL) y sale\n");
+  printf("  --dt S           paso de tiempo simulado por frame (def. 1/60 s)\n");
+  printf("  --out FICHERO    tiempos por frame en .csv o .json\n");
+  printf("  --size WxH       tamano del viewport (def. 640x480)\n");
+  printf("  --dump FICHERO   guarda el ultimo frame en PNG\n");
+  printf("  --soft           render por software en CPU (no necesita GPU)\n");
+  printf("  --threads N      hilos del render por software y de las matrices\n");
+  printf("                   de las instancias (def. todos)\n");
+  printf("  --instances N    dibuja N cubos y N tetraedros instanciados\n");
+  printf("  --lights N       anade N luces puntuales (clustered forward, solo GL)\n");
+  printf("  --clusters XxYxZ rejilla de clusters de las luces (def. 16x9x24;\n");
+  printf("                   1x1x1 es forward sin clusters)\n");
+  printf("  --no-cull        dibuja todos los objetos, sin frustum culling\n");
+  printf("  --gpu-cull       culling en un compute shader y un multi draw indirect\n");
+  printf("                   (GL 4.3)\n");
+  printf("  --hiz            ademas occlusion culling con una piramide Hi-Z\n");
+  printf("                   (implica --gpu-cull)\n");
+  printf("  --city N         ciudad de N x N manzanas de edificios en lugar de\n");
+  printf("                   los cubos (implica --gpu-cull)\n");
+  printf("  --occlusion      ademas occlusion culling por software (CPU)\n");
+  printf("  --mesh FICHERO   modelo .obj, .gltf o .glb en lugar del cubo\n");
+  printf("  --packed-vertices vertices de 12 bytes (posicion y coordenadas de\n");
+  printf("                   textura de 16 bits y normal octaedrica de 8), solo GL\n");
+  printf("  --no-mesh-opt    deja las mallas en su orden (sin optimizar los\n");
+  printf("                   indices para la cache de vertices)\n");
+  printf("  --camera X,Y,Z   posicion de la camara (mirando al origen)\n");
+  printf("  --preload LISTA  carga ademas las texturas de LISTA (una por linea)\n");
+  printf("  --dds            usa diffuse.dds y specular.dds (comprimidas)\n");
+  printf("  --pack FICHERO   toma shaders, texturas y mallas del paquete (packassets)\n");
+  printf("  --watch          recarga shaders y texturas al cambiar los ficheros\n");
+  printf("  --uber-shader    un solo fragment shader generico en lugar de la\n");
+  printf("                   variante especializada para la escena\n");
+  printf("  --cold           saca los recursos de la cache de paginas del sistema\n");
+  printf("                   antes de cargarlos (arranque en frio)\n");
+  printf("  --pacing MODO    off (def.), vsync, adaptive o fixed (limitador a --fps)\n");
+  printf("  --fps N          frames por segundo de fixed (def. 60); con vsync y\n");
+  printf("                   adaptive, el refresco de la pantalla (def. el del monitor)\n");
+  printf("  --sim-thread     simulacion (camara, culling, matrices, luces) en un hilo\n");
+  printf("                   aparte del render, con paquetes de frame\n");
+  printf("  --packets N      paquetes en vuelo de --sim-thread: 2 (doble buffer) o\n");
+  printf("                   3 (triple, def.)\n");
+  printf("  --command-lists  un draw por objeto (con --instances) grabado en listas de\n");
+  printf("                   comandos en paralelo y reproducido en orden (GL 4.2)\n");
+  printf("  --no-list-cache  graba todas las listas de comandos en cada frame\n");
+  printf("  --no-state-cache repite binds y uniforms aunque no cambien (sin el cache\n");
+  printf("                   de estado de GL)\n");
+  printf("  --profile        tiempos por zona de CPU y GPU al terminar\n");
+  printf("  --trace FICHERO  ademas el trace de las zonas en JSON (chrome://tracing,\n");
+  printf("                   Perfetto)\n");
+  printf("  --shader-cache D directorio del cache de shaders (def. shader_cache)\n");
+  printf("  --no-shader-cache compila siempre los shaders\n");
+}
+
+static bool parse_args(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+
+    if (strcmp(argv[i], "--headless") == 0 && has_value) {
+      headless_frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--dt") == 0 && has_value) {
+      headless_dt = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--out") == 0 && has_value) {
+      headless_out = argv[++i];
+    } else if (strcmp(argv[i], "--size") == 0 && has_value) {
+      if (sscanf(argv[++i], "%dx%d", &gl_width, &gl_height) != 2)
+        return false;
+    } else if (strcmp(argv[i], "--dump") == 0 && has_value) {
+      dump_path = argv[++i];
+    } else if (strcmp(argv[i], "--soft") == 0) {
+      use_soft = true;
+    } else if (strcmp(argv[i], "--threads") == 0 && has_value) {
+      soft_threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--instances") == 0 && has_value) {
+      instance_count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--lights") == 0 && has_value) {
+      light_count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--clusters") == 0 && has_value) {
+      if (sscanf(argv[++i], "%dx%dx%d", &cluster_dims[0], &cluster_dims[1], &cluster_dims[2]) != 3)
+        return false;
+    } else if (strcmp(argv[i], "--no-cull") == 0) {
+      use_culling = false;
+    } else if (strcmp(argv[i], "--gpu-cull") == 0) {
+      use_gpu_cull = true;
+    } else if (strcmp(argv[i], "--occlusion") == 0) {
+      use_occlusion = true;
+    } else if (strcmp(argv[i], "--hiz") == 0) {
+      use_hiz = use_gpu_cull = true;
+    } else if (strcmp(argv[i], "--city") == 0 && has_value) {
+      city_blocks = atoi(argv[++i]);
+      use_gpu_cull = true;
+    } else if (strcmp(argv[i], "--mesh") == 0 && has_value) {
+      mesh_path = argv[++i];
+    } else if (strcmp(argv[i], "--packed-vertices") == 0) {
+      use_packed = true;
+    } else if (strcmp(argv[i], "--no-mesh-opt") == 0) {
+      optimize_meshes = false;
+    } else if (strcmp(argv[i], "--camera") == 0 && has_value) {
+      if (sscanf(argv[++i], "%f,%f,%f", &camera_override.x, &camera_override.y, &camera_override.z) != 3)
+        return false;
+      has_camera_override = true;
+    } else if (strcmp(argv[i], "--preload") == 0 && has_value) {
+      preload_list = argv[++i];
+    } else if (strcmp(argv[i], "--dds") == 0) {
+      texture_ext = ".dds";
+    } else if (strcmp(argv[i], "--pack") == 0 && has_value) {
+      pack_path = argv[++i];
+    } else if (strcmp(argv[i], "--watch") == 0) {
+      use_hot_reload = true;
+    } else if (strcmp(argv[i], "--uber-shader") == 0) {
+      use_uber_shader = true;
+    } else if (strcmp(argv[i], "--cold") == 0) {
+      cold_start = true;
+    } else if (strcmp(argv[i], "--pacing") == 0 && has_value) {
+      if (!parse_pacing_mode(argv[++i], &pacing_mode))
+        return false;
+      has_pacing = true;
+    } else if (strcmp(argv[i], "--fps") == 0 && has_value) {
+      pacing_fps = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--sim-thread") == 0) {
+      use_sim_thread = true;
+    } else if (strcmp(argv[i], "--packets") == 0 && has_value) {
+      packet_depth = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--command-lists") == 0) {
+      use_command_lists = true;
+    } else if (strcmp(argv[i], "--no-list-cache") == 0) {
+      reuse_command_lists = false;
+    } else if (strcmp(argv[i], "--no-state-cache") == 0) {
+      use_state_cache = false;
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      use_profiler = true;
+    } else if (strcmp(argv[i], "--trace") == 0 && has_value) {
+      use_profiler = true;
+      trace_path = argv[++i];
+    } else if (strcmp(argv[i], "--shader-cache") == 0 && has_value) {
+      shader_cache_set_dir(argv[++i]);
+    } else if (strcmp(argv[i], "--no-shader-cache") == 0) {
+      shader_cache_set_dir(NULL);
+    } else {
+      return false;
+    }
+  }
+  return headless_frames >= 0 && gl_width > 0 && gl_height > 0 && instance_count >= 0 &&
+         light_count >= 0 && cluster_dims[0] > 0 && cluster_dims[1] > 0 && cluster_dims[2] > 0 &&
+         city_blocks >= 0 && pacing_fps >= 0.0 && packet_depth >= 2 && packet_depth <= 3;
+}
+
+// Rejilla de celdas de la escena; las camaras se alejan para que quepa
+static void init_instances() {
+  instance_cells = instance_grid(instance_count > 0 ? instance_count : 1, &instance_side);
+  float back = 2.0f * (float) (instance_side - 1);
+  camera_pos.z += back;
+  camera_pos2.z -= back;
+  // En la ciudad, a pie de calle al final de la avenida x = 0
+  if (city_blocks > 0)
+    camera_pos = glm::vec3(0.0f, 1.0f, 3.0f * (float) (city_blocks - city_blocks / 2) + 2.0f);
+  if (has_camera_override)
+    camera_pos = camera_override;
+  if (instance_count > 0)
+    printf("Instances: %d cubes + %d tetrahedra (%d per side)\n",
+           instance_count, instance_count, instance_side);
+}
+
+// Luces puntuales repartidas por la caja de la escena, con algo de margen
+static void init_lights() {
+  glm::vec3 lo = instance_cells[0], hi = instance_cells[0];
+  for (const glm::vec3 &cell : instance_cells) {
+    lo = glm::min(lo, cell);
+    hi = glm::max(hi, cell);
+  }
+  glm::vec3 margin(2.0f, 1.0f, 1.0f);
+  std::vector<PointLight> lights = scatter_point_lights(light_count, lo - margin, hi + margin,
+                                                        point_light_radius);
+  clustered_lights = new ClusteredLights(lights, cluster_dims[0], cluster_dims[1], cluster_dims[2],
+                                         soft_threads);
+}
+
+// Radio de la esfera centrada en el origen que contiene la malla: la caja de
+// lado 2 * radio la contiene gire como gire
+static float mesh_radius(const MeshData &mesh) {
+  const std::vector<float> &v = mesh.vertices;
+  float radius = 0.0f;
+  for (size_t i = 0; i < v.size(); i += MESH_VERTEX_FLOATS)
+    radius = fmaxf(radius, glm::length(glm::vec3(v[i], v[i + 1], v[i + 2])));
+  return radius;
+}
+
+// Semilados de la caja centrada en el origen que contiene la malla
+static glm::vec3 mesh_extent(const MeshData &mesh) {
+  const std::vector<float> &v = mesh.vertices;
+  glm::vec3 extent(0.0f);
+  for (size_t i = 0; i < v.size(); i += MESH_VERTEX_FLOATS)
+    extent = glm::max(extent, glm::abs(glm::vec3(v[i], v[i + 1], v[i + 2])));
+  return extent;
+}
+
+// Formato compacto y lo que se pierde: error de posicion respecto a la
+// diagonal de la caja, angulo de las normales y coordenadas de textura
+static void pack_scene_meshes(const char *const *names) {
+  for (int mesh = 0; mesh < 2; mesh++) {
+    const MeshData &m = scene_meshes[mesh];
+    packed_meshes[mesh] = pack_mesh(m);
+    QuantizationError error = quantization_error(m, packed_meshes[mesh]);
+    printf("Packed %s: %zu -> %zu bytes (%d -> %d per vertex)  position error max %.5f%% mean %.5f%%  "
+           "normal error max %.2f mean %.2f deg  uv error max %.2g\n",
+           names[mesh], m.vertices.size() * sizeof(float), packed_meshes[mesh].vertex_bytes(),
+           (int) (MESH_VERTEX_FLOATS * sizeof(float)), (int) sizeof(PackedVertex), 100.0f * error.position_max,
+           100.0f * error.position_mean, error.normal_max_deg, error.normal_mean_deg, error.uv_max);
+  }
+}
+
+// Cubo (o modelo de --mesh, centrado y escalado para que ocupe lo mismo que
+// el cubo) y tetraedro con indices, ordenados para la cache de vertices
+static bool init_scene_meshes() {
+  scene_meshes[0] = index_triangles(vertex_positions, 36);
+  scene_meshes[1] = index_triangles(vertex_positions_tetraedro, 12);
+  // Del paquete ya viene indexada y normalmente optimizada
+  const AssetPackEntry *packed = asset_pack && mesh_path ? asset_pack->find(mesh_path, ASSET_MESH) : NULL;
+  if (mesh_path) {
+    float radius = mesh_radius(scene_meshes[0]);
+    if (packed) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      asset_pack->read_mesh(*packed, scene_meshes[0]);
+      printf("Mesh %s: read from the asset pack in %.2f ms\n", mesh_path,
+             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    } else {
+      MeshLoader loader(soft_threads);
+      if (!loader.load(mesh_path, scene_meshes[0]))
+        return false;
+      loader.print_stats();
+    }
+    normalize_mesh(scene_meshes[0], radius);
+  }
+
+  const char *names[2] = { mesh_path ? mesh_path : "cube", "tetrahedron" };
+  for (int mesh = 0; mesh < 2; mesh++) {
+    MeshData &m = scene_meshes[mesh];
+    VertexCacheStats before = vertex_cache_stats(m);
+    if (!optimize_meshes || (mesh == 0 && packed && packed->mesh.optimized)) {
+      printf("Mesh %s: %d triangles, %d vertices, ACMR %.3f, ATVR %.3f (%s)\n",
+             names[mesh], m.triangle_count(), m.vertex_count(), before.acmr, before.atvr,
+             optimize_meshes ? "optimized in the asset pack" : "not optimized");
+      continue;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    optimize_mesh(m);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    VertexCacheStats after = vertex_cache_stats(m);
+    printf("Mesh %s: %d triangles, %d vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%.1f ms)\n",
+           names[mesh], m.triangle_count(), m.vertex_count(), before.acmr, after.acmr, before.atvr,
+           after.atvr, ms);
+  }
+  if (use_packed)
+    pack_scene_meshes(names);
+  return true;
+}
+
+// Fuente de un shader: del paquete si esta (sin copiarlo; *owned queda a
+// NULL) o leido del fichero (hay que liberar *owned)
+static const char *shader_source(const char *name, char **owned) {
+  *owned = NULL;
+  const char *source = asset_pack ? asset_pack->shader(name) : NULL;
+  if (!source)
+    source = *owned = textFileRead(name);
+  return source;
+}
+
+static void init_culling() {
+  float radius[2] = { mesh_radius(scene_meshes[0]), mesh_radius(scene_meshes[1]) };
+  glm::vec3 offset[2] = { glm::vec3(.75f, 0.0f, 0.0f), glm::vec3(-.75f, 0.0f, 0.0f) };
+
+  for (int mesh = 0; mesh < 2; mesh++) {
+    for (const glm::vec3 &cell : instance_cells) {
+      object_lo.push_back(cell + offset[mesh] - glm::vec3(radius[mesh]));
+      object_hi.push_back(cell + offset[mesh] + glm::vec3(radius[mesh]));
+    }
+  }
+  culling = new CullingBvh();
+  culling->build(object_lo, object_hi);
+
+  if (use_occlusion) {
+    occlusion = new MaskedOcclusion(256, soft_threads);
+    for (int mesh = 0; mesh < 2; mesh++) {
+      std::vector<float> triangles = mesh_triangles(scene_meshes[mesh]);
+      int count = 3 * scene_meshes[mesh].triangle_count();
+      occlusion_meshes[mesh] = count <= 3 * MAX_OCCLUDER_TRIANGLES
+                               ? occlusion->add_mesh(triangles.data(), count, MESH_VERTEX_FLOATS) : -1;
+    }
+  }
+}
+
+// Ciudad de cubos: N x N manzanas de 2 x 2 edificios (cubos escalados) de
+// altura al azar, separadas por calles de una unidad. Desde la calle los
+// edificios de las primeras manzanas tapan casi todos los demas
+static void add_city_buildings() {
+  const float footprint = 0.9f, cube_side = 0.5f;
+  unsigned seed = 12345;
+  for (int bz = 0; bz < city_blocks; bz++) {
+    for (int bx = 0; bx < city_blocks; bx++) {
+      glm::vec3 block(3.0f * (float) (bx - city_blocks / 2) + 1.5f, 0.0f,
+                      3.0f * (float) (bz - city_blocks / 2) + 1.5f);
+      for (int k = 0; k < 4; k++) {
+        seed = seed * 1103515245u + 12345u;
+        float height = 1.0f + (float) ((seed >> 16) % 12);
+        glm::vec3 position = block + glm::vec3(k % 2 == 0 ? -0.5f : 0.5f, 0.5f * height,
+                                               k / 2 == 0 ? -0.5f : 0.5f);
+        glm::vec3 scale = glm::vec3(footprint, height, footprint) / cube_side;
+        gpu_culling->add_static(position, scale, 0);
+      }
+    }
+  }
+  printf("City: %d x %d blocks, %d buildings\n", city_blocks, city_blocks, 4 * city_blocks * city_blocks);
+}
+
+// Mismos objetos que TransformSystem (cubos y luego tetraedros), con las
+// dos mallas en unos buffers comunes para dibujarlas en el mismo multi draw
+static bool init_gpu_culling() {
+  char defines[64];
+  snprintf(defines, sizeof(defines), "#define MAX_MESHES %d", GPU_CULL_MAX_MESHES);
+  ShaderCacheStats stats;
+  GLuint program = shader_build_compute_program(cullFileName, defines, shader_source, &stats, NULL);
+  if (!program)
+    return false;
+  shader_cache_print_stats(stats, "Culling program");
+
+  // Las dos mallas seguidas en un VBO y un element array buffer comunes
+  const MeshData &cube = scene_meshes[0], &tetra = scene_meshes[1];
+  std::vector<GpuMesh> meshes = {
+    { 0, (GLsizei) cube.indices.size(), 0, mesh_radius(cube), mesh_extent(cube) },
+    { (GLuint) cube.indices.size(), (GLsizei) tetra.indices.size(), cube.vertex_count(), mesh_radius(tetra),
+      mesh_extent(tetra) },
+  };
+  gpu_culling = new GpuCulling(program, meshes);
+  if (city_blocks > 0) {
+    add_city_buildings();
+  } else {
+    for (int mesh = 0; mesh < 2; mesh++) {
+      glm::vec3 offset(mesh == 0 ? .75f : -.75f, 0.0f, 0.0f);
+      for (size_t i = 0; i < instance_cells.size(); i++)
+        gpu_culling->add(instance_cells[i] + offset, instance_phase((int) i), mesh);
+    }
+  }
+  gpu_culling->upload();
+
+  glGenVertexArrays(1, &gpu_vao);
+  glBindVertexArray(gpu_vao);
+
+  GLuint buffers[2] = { 0, 0 };
+  glGenBuffers(2, buffers);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+  if (use_packed) {
+    // Las dos mallas con la misma transformacion: un solo uniform por frame
+    gpu_packed_range = merge_ranges(packed_meshes[0].range, packed_meshes[1].range);
+    PackedMesh packed[2] = { pack_mesh(cube, gpu_packed_range), pack_mesh(tetra, gpu_packed_range) };
+    GLsizeiptr cube_size = (GLsizeiptr) packed[0].vertex_bytes();
+    GLsizeiptr tetra_size = (GLsizeiptr) packed[1].vertex_bytes();
+    glBufferData(GL_ARRAY_BUFFER, cube_size + tetra_size, NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, cube_size, packed[0].vertices.data());
+    glBufferSubData(GL_ARRAY_BUFFER, cube_size, tetra_size, packed[1].vertices.data());
+    packed_attrib_pointers();
+  } else {
+    GLsizeiptr cube_size = (GLsizeiptr) cube.vertices.size() * sizeof(GLfloat);
+    GLsizeiptr tetra_size = (GLsizeiptr) tetra.vertices.size() * sizeof(GLfloat);
+    glBufferData(GL_ARRAY_BUFFER, cube_size + tetra_size, NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, cube_size, cube.vertices.data());
+    glBufferSubData(GL_ARRAY_BUFFER, cube_size, tetra_size, tetra.vertices.data());
+
+    // Mismos atributos que vao y vao2
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+  }
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+  GLsizeiptr cube_indices = (GLsizeiptr) cube.indices.size() * sizeof(GLuint);
+  GLsizeiptr tetra_indices = (GLsizeiptr) tetra.indices.size() * sizeof(GLuint);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, cube_indices + tetra_indices, NULL, GL_STATIC_DRAW);
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, cube_indices, cube.indices.data());
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, cube_indices, tetra_indices, tetra.indices.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  instance_attrib_pointers(gpu_culling->instance_buffer(), 0);
+  glBindVertexArray(0);
+
+  if (use_hiz) {
+    GLuint hiz_program = shader_build_compute_program(hizFileName, "", shader_source, &stats, NULL);
+    if (!hiz_program)
+      return false;
+    shader_cache_print_stats(stats, "Hi-Z program");
+    hiz_buffer = new HiZBuffer(hiz_program);
+  }
+  return true;
+}
+
+static bool init_soft() {
+  soft_renderer = new SoftRenderer(gl_width, gl_height, soft_threads);
+  printf("Renderer: software (%d threads, %s)\n", soft_renderer->threads(), soft_renderer->kernel_name());
+  printf("Starting viewport: (width: %d, height: %d)\n", gl_width, gl_height);
+
+  return soft_diffuse_map.load("diffuse.png") && soft_specular_map.load("specular.png");
+}
+
+// Si la textura del cubo esta en el paquete o en disco
+static bool scene_has_texture(const char *name) {
+  std::string path = std::string(name) + texture_ext;
+  return (asset_pack && asset_pack->find(path.c_str(), ASSET_TEXTURE)) || access(path.c_str(), R_OK) == 0;
+}
+
+// Defines de la variante del programa de la escena
+static std::string program_variant() {
+  std::string defines;
+  if (instance_count > 0 || use_gpu_cull)
+    defines += "#define INSTANCED\n";
+  if (use_packed)
+    defines += "#define PACKED_VERTICES\n";
+  if (clustered_lights)
+    defines += clustered_lights->defines();
+  defines += "#define MAX_LIGHTS " + std::to_string(SCENE_LIGHTS) + "\n";
+  if (use_uber_shader) {
+    defines += "#define UBER_SHADER\n#define NUM_LIGHTS light_count\n";
+  } else {
+    defines += "#define NUM_LIGHTS " + std::to_string(SCENE_LIGHTS) + "\n";
+    defines += std::string("#define HAS_DIFFUSE_MAP ") + (scene_has_texture("diffuse") ? "1" : "0") + "\n";
+    defines += std::string("#define HAS_SPECULAR_MAP ") + (scene_has_texture("specular") ? "1" : "0") + "\n";
+  }
+  return defines;
+}
+
+// Uniforms del programa: se repite al recargarlo
+// - Model matrix
+// - Normal matrix: normal vectors from local to world coordinates
+// - Material textures (unidades fijas, se asignan una vez)
+// - Camera, light and material data: uniform buffers
+static void init_program_uniforms() {
+  model_location = glGetUniformLocation(shader_program, "model");
+  mesh_dequant_location = glGetUniformLocation(shader_program, "mesh_dequant");
+  normal_location = glGetUniformLocation(shader_program, "normal_matrix");
+
+  material_specular_location = glGetUniformLocation(shader_program, "material.specular");
+  glUseProgram(shader_program);
+  glUniform1i(material_specular_location, 1);
+  if (clustered_lights)
+    ClusteredLights::set_samplers(shader_program);
+
+  if (use_uber_shader) {
+    glUniform1i(glGetUniformLocation(shader_program, "light_count"), SCENE_LIGHTS);
+    glUniform1i(glGetUniformLocation(shader_program, "has_diffuse_map"), scene_has_texture("diffuse"));
+    glUniform1i(glGetUniformLocation(shader_program, "has_specular_map"), scene_has_texture("specular"));
   }
 
-  //  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  //  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  //  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-  //  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  UniformRing::bind_blocks(shader_program);
 
-  GLFWwindow* window = glfwCreateWindow(gl_width, gl_height, "My spinning cube", NULL, NULL);
-  if (!window) {
-    fprintf(stderr, "ERROR: could not open window with GLFW3\n");
-    glfwTerminate();
+  // Programa nuevo (o recargado) y uniforms fijados sin el cache
+  gl_state.forget_program(shader_program);
+  gl_state.invalidate();
+}
+
+// El hilo de recarga usa un contexto que comparte objetos con el del render:
+// una ventana oculta con GLFW o un segundo contexto EGL sin ventana
+static bool init_hot_reload(GLFWwindow *window) {
+  std::function<bool()> bind;
+  std::function<void()> release;
+  if (window) {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    reload_window = glfwCreateWindow(1, 1, "", NULL, window);
+    glfwDefaultWindowHints();
+    if (!reload_window) {
+      fprintf(stderr, "ERROR: could not create the shared context for --watch\n");
+      return false;
+    }
+    GLFWwindow *shared = reload_window;
+    bind = [shared] { glfwMakeContextCurrent(shared); return true; };
+    release = [] { glfwMakeContextCurrent(NULL); };
+  } else {
+    reload_context = headless_shared_context();
+    if (!reload_context)
+      return false;
+    HeadlessContext *shared = reload_context;
+    bind = [shared] { return headless_make_current(shared); };
+    release = [] { headless_make_current(NULL); };
+  }
+
+  hot_reloader = new HotReloader(bind, release);
+  // Al recargar se leen siempre los ficheros sueltos, no el paquete
+  std::string defines = program_variant();
+  hot_reloader->watch_program(program_files, [defines] {
+    ShaderCacheStats stats;
+    return shader_build_program(vertexFileName, fragmentFileName, defines.c_str(), shader_read_file, &stats, NULL);
+  });
+  diffuse_slot = hot_reloader->watch_texture((std::string("diffuse") + texture_ext).c_str());
+  hot_reloader->watch_texture((std::string("specular") + texture_ext).c_str());
+  return hot_reloader->start();
+}
+
+// Sustituye lo que el hilo de recarga ya tiene listo; no bloquea nunca. La
+// latencia va desde que inotify avisa hasta que el frame usa el objeto nuevo
+static void apply_hot_reloads() {
+  // Mientras el TextureLoader no termine las texturas son suyas
+  if (!hot_reloader || texture_loader)
+    return;
+  for (const HotReloader::Result &result : hot_reloader->poll()) {
+    double live_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                               result.changed_at).count();
+    if (!result.object) {
+      printf("Hot reload %s: failed after %.1f ms, keeping the previous %s\n", result.path.c_str(),
+             result.work_ms, result.program ? "program" : "texture");
+      continue;
+    }
+    if (result.program) {
+      glDeleteProgram(shader_program);
+      shader_program = result.object;
+      init_program_uniforms();
+    } else {
+      unsigned int &map = result.slot == diffuse_slot ? diffuse_map : specular_map;
+      glDeleteTextures(1, &map);
+      map = result.object;
+      gl_state.invalidate_textures();
+    }
+    printf("Hot reload %s: %s in %.1f ms, live %.1f ms after the change\n", result.path.c_str(),
+           result.program ? "compiled" : "decoded and uploaded", result.work_ms, live_ms);
+  }
+}
+
+static void render_and_reload(double currentTime) {
+  apply_hot_reloads();
+  frame_render_fn(currentTime);
+}
+
+// Copia el framebuffer de GL a PNG (glReadPixels deja la fila 0 abajo)
+static bool dump_gl_framebuffer(const char *path) {
+  std::vector<unsigned char> pixels((size_t) gl_width * gl_height * 4);
+  std::vector<unsigned char> flipped(pixels.size());
+  size_t row = (size_t) gl_width * 4;
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, gl_width, gl_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  for (int y = 0; y < gl_height; y++)
+    memcpy(&flipped[y * row], &pixels[(gl_height - 1 - y) * row], row);
+
+  return write_png(path, gl_width, gl_height, flipped.data());
+}
+
+// Todo lo que lee el arranque, para --cold
+static void evict_startup_files() {
+  const char *files[] = { pack_path, mesh_path, vertexFileName, fragmentFileName, "frame_data.glsl",
+                          "phong_light.glsl", cullFileName, hizFileName, "diffuse.png", "specular.png" };
+  for (const char *file : files)
+    if (file)
+      evict_file_cache(file);
+  evict_file_cache((std::string("diffuse") + texture_ext).c_str());
+  evict_file_cache((std::string("specular") + texture_ext).c_str());
+}
+
+static bool open_asset_pack() {
+  asset_pack = new AssetPack();
+  if (!asset_pack->open(pack_path))
+    return false;
+  printf("Asset pack %s: %d entries, %.2f MB mapped in %.2f ms\n", pack_path, asset_pack->entry_count(),
+         asset_pack->size() / (1024.0 * 1024.0), asset_pack->open_ms());
+  return true;
+}
+
+// Desde el inicio de main() hasta el primer frame, con todo cargado (en
+// modo ventana las texturas sueltas aun pueden estar decodificandose)
+static void print_startup() {
+  double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_begin).count();
+  printf("Startup: %.1f ms (%s%s%s)\n", ms, asset_pack ? "asset pack " : "loose files",
+         asset_pack ? pack_path : "", cold_start ? ", cold" : "");
+}
+
+// Refresco del monitor principal para vsync y adaptive (0 si no se sabe)
+static double monitor_refresh_rate() {
+  GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+  const GLFWvidmode *mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+  return mode ? mode->refreshRate : 0.0;
+}
+
+// Con la ventana current; adaptive necesita *_EXT_swap_control_tear
+static void init_swap_interval() {
+  if (pacing_mode == PACING_ADAPTIVE && !glfwExtensionSupported("GLX_EXT_swap_control_tear") &&
+      !glfwExtensionSupported("WGL_EXT_swap_control_tear")) {
+    printf("Pacing: no swap_control_tear, adaptive falls back to vsync\n");
+    delete frame_scheduler;
+    frame_scheduler = new FrameScheduler(PACING_VSYNC, pacing_fps > 0.0 ? pacing_fps : monitor_refresh_rate());
+  }
+  if (frame_scheduler->mode() != PACING_OFF)
+    glfwSwapInterval(frame_scheduler->swap_interval());
+}
+
+// Justo antes del primer frame, para no medir la carga
+static void start_profiler(bool gpu) {
+  if (!use_profiler)
+    return;
+#if ENABLE_PROFILER
+  profiler_set_thread_name("main");
+  profiler_start(gpu);
+#else
+  printf("Profiler: compiled out (ENABLE_PROFILER=0)\n");
+#endif
+}
+
+int main(int argc, char **argv) {
+  startup_begin = std::chrono::steady_clock::now();
+  if (!parse_args(argc, argv)) {
+    usage(argv[0]);
+    return 1;
+  }
+  view_aspect = (float) gl_width / (float) gl_height;
+  init_instances();
+  if (use_soft && use_hot_reload) {
+    fprintf(stderr, "ERROR: --watch no esta soportado con --soft\n");
+    return 1;
+  }
+  if (use_soft && use_packed) {
+    fprintf(stderr, "ERROR: --packed-vertices no esta soportado con --soft\n");
+    return 1;
+  }
+  if (use_soft && light_count > 0) {
+    fprintf(stderr, "ERROR: --lights no esta soportado con --soft\n");
+    return 1;
+  }
+  if (use_occlusion && (use_gpu_cull || !use_culling)) {
+    fprintf(stderr, "ERROR: --occlusion va tras el frustum culling en la CPU (sin --gpu-cull ni --no-cull)\n");
+    return 1;
+  }
+  if (use_soft && use_gpu_cull) {
+    fprintf(stderr, "ERROR: --gpu-cull, --hiz y --city no estan soportados con --soft\n");
     return 1;
   }
-  glfwSetWindowSizeCallback(window, glfw_window_size_callback);
-  glfwMakeContextCurrent(window);
+  if (use_sim_thread && (use_soft || use_gpu_cull)) {
+    fprintf(stderr, "ERROR: --sim-thread no esta soportado con --soft, --gpu-cull, --hiz ni --city\n");
+    return 1;
+  }
+  if (use_command_lists && (instance_count == 0 || use_soft || use_gpu_cull || use_sim_thread)) {
+    fprintf(stderr, "ERROR: --command-lists necesita --instances y no esta soportado con --soft, --gpu-cull ni "
+            "--sim-thread\n");
+    return 1;
+  }
+  if (city_blocks > 0 && instance_count > 0) {
+    fprintf(stderr, "ERROR: --city y --instances son escenas distintas\n");
+    return 1;
+  }
+  if (headless_frames > 0 && (pacing_mode == PACING_VSYNC || pacing_mode == PACING_ADAPTIVE)) {
+    fprintf(stderr, "ERROR: --pacing vsync y adaptive necesitan ventana\n");
+    return 1;
+  }
+  if (pacing_mode == PACING_FIXED && pacing_fps == 0.0)
+    pacing_fps = 60.0;
+  if (cold_start)
+    evict_startup_files();
+  if (pack_path && !open_asset_pack())
+    return 1;
+  if (!init_scene_meshes())
+    return 1;
 
-  // start GLEW extension handler
-  // glewExperimental = GL_TRUE;
-  glewInit();
+  // Backend por software sin ventana: no hace falta ningun contexto GL
+  if (use_soft && headless_frames > 0) {
+    if (!init_soft())
+      return 1;
+    if (use_culling)
+      init_culling();
+    updateViewMatrix();
+    print_startup();
+
+    start_profiler(false);
+    frame_scheduler = has_pacing ? new FrameScheduler(pacing_mode, pacing_fps) : NULL;
+    std::vector<FrameTiming> timings = headless_run(headless_frames, headless_dt, render_soft, false,
+                                                    frame_scheduler);
+    bool ok = profiler_stop(trace_path);
+    if (frame_scheduler)
+      frame_scheduler->print_stats();
+    ok = write_frame_timings(headless_out, timings) && ok;
+    if (dump_path)
+      ok = write_png(dump_path, gl_width, gl_height, soft_renderer->pixels()) && ok;
+    if (culling)
+      culling->print_stats();
+    if (occlusion)
+      occlusion->print_stats();
+
+    delete occlusion;
+    delete culling;
+    delete soft_renderer;
+    delete frame_scheduler;
+    delete asset_pack;
+    return ok ? 0 : 1;
+  }
+
+  GLFWwindow* window = NULL;
+
+  if (headless_frames > 0) {
+    // Sin display: contexto EGL y FBO propio (inicializa tambien GLEW)
+    if (!headless_init(gl_width, gl_height))
+      return 1;
+  } else {
+    // start GL context and O/S window using the GLFW helper library
+    if (!glfwInit()) {
+      fprintf(stderr, "ERROR: could not start GLFW3\n");
+      return 1;
+    }
+
+    //  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    //  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    //  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    //  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    window = glfwCreateWindow(gl_width, gl_height, "My spinning cube", NULL, NULL);
+    if (!window) {
+      fprintf(stderr, "ERROR: could not open window with GLFW3\n");
+      glfwTerminate();
+      return 1;
+    }
+    glfwSetWindowSizeCallback(window, glfw_window_size_callback);
+    glfwSetKeyCallback(window, glfw_key_callback);
+    glfwMakeContextCurrent(window);
+
+    // start GLEW extension handler
+    // glewExperimental = GL_TRUE;
+    glewInit();
+  }
 
   // get version info
   const GLubyte* vendor = glGetString(GL_VENDOR); // get vendor string
@@ -109,384 +1073,844 @@ int main() {
   printf("GLSL version supported %s\n", glslversion);
   printf("Starting viewport: (width: %d, height: %d)\n", gl_width, gl_height);
 
+  gl_state.set_enabled(use_state_cache);
+
   // Enable Depth test: only draw onto a pixel if fragment closer to viewer
   glEnable(GL_DEPTH_TEST);
   glDepthFunc(GL_LESS); // set a smaller value as "closer"
 
-  // Vertex Shader
-  char* vertex_shader = textFileRead(vertexFileName);
-
-  // Fragment Shader
-  char* fragment_shader = textFileRead(fragmentFileName);
-
-  // Shaders compilation
-  GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vs, 1, &vertex_shader, NULL);
-  free(vertex_shader);
-  glCompileShader(vs);
-
-  int  success;
-  char infoLog[512];
-  glGetShaderiv(vs, GL_COMPILE_STATUS, &success);
-  if (!success) {
-    glGetShaderInfoLog(vs, 512, NULL, infoLog);
-    printf("ERROR: Vertex Shader compilation failed!\n%s\n", infoLog);
-
-    return(1);
+  if (use_gpu_cull && !GpuCulling::supported()) {
+    if (use_hiz || city_blocks > 0) {
+      fprintf(stderr, "ERROR: --hiz y --city necesitan GL 4.3\n");
+      return 1;
+    }
+    printf("GPU culling: not supported (needs GL 4.3), culling on the CPU\n");
+    use_gpu_cull = false;
   }
 
-  GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fs, 1, &fragment_shader, NULL);
-  free(fragment_shader);
-  glCompileShader(fs);
-
-  glGetShaderiv(fs, GL_COMPILE_STATUS, &success);
-  if (!success) {
-    glGetShaderInfoLog(fs, 512, NULL, infoLog);
-    printf("ERROR: Fragment Shader compilation failed!\n%s\n", infoLog);
-
-    return(1);
+  if (use_command_lists && !GLEW_VERSION_4_2 && !GLEW_ARB_base_instance) {
+    fprintf(stderr, "ERROR: --command-lists necesita GL 4.2 (ARB_base_instance)\n");
+    return 1;
   }
 
-  // Create program, attach shaders to it and link it
-  shader_program = glCreateProgram();
-  glAttachShader(shader_program, fs);
-  glAttachShader(shader_program, vs);
-  glLinkProgram(shader_program);
+  if (light_count > 0)
+    init_lights();
 
-  glValidateProgram(shader_program);
-  glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
-  if(!success) {
-    glGetProgramInfoLog(shader_program, 512, NULL, infoLog);
-    printf("ERROR: Shader Program linking failed!\n%s\n", infoLog);
+  // Shaders compilation (tras el preprocesado de shaderpre.h), o carga del
+  // binario ya enlazado si la variante esta en el cache
+  std::string defines = program_variant();
+  printf("Shader variant: %s\n", shader_variant_name(defines.c_str()).c_str());
+  ShaderCacheStats shader_stats;
+  shader_program = shader_build_program(vertexFileName, fragmentFileName, defines.c_str(), shader_source,
+                                        &shader_stats, &program_files);
 
+  if (!shader_program)
     return(1);
-  }
-
-  // Release shader objects
-  glDeleteShader(vs);
-  glDeleteShader(fs);
+  shader_cache_print_stats(shader_stats);
 
   // Vertex Array Object
   glGenVertexArrays(1, &vao);
   glBindVertexArray(vao);
 
-  // Cube to be rendered
-  //
-  //          0        3
-  //       7        4 <-- top-right-near
-  // bottom
-  // left
-  // far ---> 1        2
-  //       6        5
-  //
+
+  // CUBE (o el modelo de --mesh)
+  // Vertex Buffer Object con los vertices y element array buffer con los
+  // indices. Vertex attributes:
+  // 0: vertex position (x, y, z)
+  // 1: vertex normals (x, y, z)
+  // 2: text coord (s, t)
+  if (use_packed)
+    upload_packed_mesh(packed_meshes[0]);
+  else
+    upload_mesh(scene_meshes[0]);
+
+  // Unbind vao
+  glBindVertexArray(0);
   
-  const GLfloat vertex_positions[] = {
+  //TETRAEDRO
 
-    //positions                   //Normals       // Texture
-    -0.25f, -0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  0.0f, 0.0f,  // 1
-    -0.25f,  0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  0.0f, 1.0f,  // 0
-     0.25f, -0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  1.0f, 0.0f,  // 2
 
-     0.25f,  0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  1.0f, 1.0f,  // 3
-     0.25f, -0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  1.0f, 0.0f,  // 2
-    -0.25f,  0.25f, -0.25f,  0.0f, 0.0f, -1.0f,  0.0f, 1.0f,  // 0
+  // Crear y vincular el Vertex Array Object (VAO) para el tetraedro, con
+  // sus buffers de vertices e indices y los mismos atributos
+  glGenVertexArrays(1, &vao2);
+  glBindVertexArray(vao2);
+  if (use_packed)
+    upload_packed_mesh(packed_meshes[1]);
+  else
+    upload_mesh(scene_meshes[1]);
+  glBindVertexArray(0);
 
-     0.25f, -0.25f, -0.25f,  1.0f, 0.0f, 0.0f,   0.0f, 0.0f,  // 2
-     0.25f,  0.25f, -0.25f,  1.0f, 0.0f, 0.0f,   1.0f, 0.0f,  // 3
-     0.25f, -0.25f,  0.25f,  1.0f, 0.0f, 0.0f,   0.0f, 1.0f,  // 5
+  // INSTANCIAS: un unico buffer, primero los cubos y luego los tetraedros
+  if (instance_count > 0 && !use_gpu_cull) {
+    glGenBuffers(1, &instance_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    glBufferData(GL_ARRAY_BUFFER, 2 * (GLsizeiptr) instance_count * sizeof(InstanceAttribs),
+                 NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindVertexArray(vao);
+    instance_attrib_pointers(instance_vbo, 0);
+    glBindVertexArray(vao2);
+    instance_attrib_pointers(instance_vbo, (size_t) instance_count * sizeof(InstanceAttribs));
+    glBindVertexArray(0);
+
+    // Mismo orden que el buffer
+    transforms = new TransformSystem(soft_threads);
+    for (int i = 0; i < instance_count; i++)
+      transforms->add(instance_cells[i] + glm::vec3(.75f, 0.0f, 0.0f), instance_phase(i));
+    for (int i = 0; i < instance_count; i++)
+      transforms->add(instance_cells[i] + glm::vec3(-.75f, 0.0f, 0.0f), instance_phase(i));
+  }
+  void (*render_fn)(double) = instance_count > 0 ? render_instanced : render;
+  if (use_gpu_cull) {
+    if (!init_gpu_culling())
+      return 1;
+    render_fn = render_gpu_driven;
+  } else if (use_culling) {
+    init_culling();
+  }
+  if (use_sim_thread) {
+    sim_thread = new SimulationThread(packet_depth, simulate_frame);
+    render_fn = render_packet;
+  }
+  if (use_command_lists) {
+    command_recorder = new CommandRecorder(soft_threads, 1024, reuse_command_lists);
+    render_fn = render_recorded;
+  }
 
-     0.25f,  0.25f,  0.25f,  1.0f, 0.0f, 0.0f,   1.0f, 1.0f,  // 4
-     0.25f, -0.25f,  0.25f,  1.0f, 0.0f, 0.0f,   0.0f, 1.0f,  // 5
-     0.25f,  0.25f, -0.25f,  1.0f, 0.0f, 0.0f,   1.0f, 0.0f,  // 3
 
-     0.25f, -0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   0.0f, 0.0f,  // 5
-     0.25f,  0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   0.0f, 1.0f,  // 4
-    -0.25f, -0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   1.0f, 0.0f,  // 6
+  // CUBE
 
-    -0.25f,  0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   1.0f, 1.0f,  // 7
-    -0.25f, -0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   1.0f, 0.0f,  // 6
-     0.25f,  0.25f,  0.25f,  0.0f, 0.0f, 1.0f,   0.0f, 1.0f,  // 4
+  init_program_uniforms();
+  uniform_ring = new UniformRing();
+
+  // Cargamos las texturas: se decodifican en paralelo mientras seguimos
+  // con la inicializacion
+  texture_loader = new TextureLoader();
+  texture_loader->set_pack(asset_pack);
+  diffuse_map = texture_loader->request((std::string("diffuse") + texture_ext).c_str());
+  specular_map = texture_loader->request((std::string("specular") + texture_ext).c_str());
+
+  if (preload_list) {
+    FILE *fp = fopen(preload_list, "r");
+    char line[1024];
+    while (fp && fgets(line, sizeof(line), fp)) {
+      line[strcspn(line, "\r\n")] = '\0';
+      if (line[0] != '\0')
+        texture_loader->request(line);
+    }
+    if (fp)
+      fclose(fp);
+  }
 
-    -0.25f, -0.25f,  0.25f,  -1.0f, 0.0f, 0.0f,  0.0f, 0.0f,  // 6
-    -0.25f,  0.25f,  0.25f,  -1.0f, 0.0f, 0.0f,  1.0f, 0.0f,  // 7
-    -0.25f, -0.25f, -0.25f,  -1.0f, 0.0f, 0.0f,  0.0f, 1.0f,  // 1
+  if (use_hot_reload && !init_hot_reload(window))
+    return 1;
+  frame_render_fn = render_fn;
+  if (hot_reloader)
+    render_fn = render_and_reload;
+
+  if (headless_frames > 0) {
+    updateViewMatrix();
+
+    // Para medir frames comparables las texturas tienen que estar ya subidas
+    texture_loader->finish();
+    texture_loader->print_stats();
+    delete texture_loader;
+    texture_loader = NULL;
+    print_startup();
+
+    start_profiler(true);
+    frame_scheduler = has_pacing ? new FrameScheduler(pacing_mode, pacing_fps) : NULL;
+    if (sim_thread)
+      sim_thread->start();
+    std::vector<FrameTiming> timings = headless_run(headless_frames, headless_dt, render_fn, true,
+                                                    frame_scheduler);
+    if (sim_thread)
+      sim_thread->stop();
+    bool ok = profiler_stop(trace_path);
+    if (frame_scheduler)
+      frame_scheduler->print_stats();
+    if (sim_thread)
+      sim_thread->print_stats();
+    ok = write_frame_timings(headless_out, timings) && ok;
+    if (dump_path)
+      ok = dump_gl_framebuffer(dump_path) && ok;
+    if (clustered_lights)
+      clustered_lights->print_stats();
+    if (command_recorder)
+      command_recorder->print_stats();
+    if (culling)
+      culling->print_stats();
+    if (occlusion)
+      occlusion->print_stats();
+    if (gpu_culling)
+      gpu_culling->print_stats();
+
+    delete sim_thread;
+    delete command_recorder;
+    delete hiz_buffer;
+    delete gpu_culling;
+    delete occlusion;
+    delete culling;
+    delete clustered_lights;
+    delete transforms;
+    delete uniform_ring;
+    delete asset_pack;
+    delete hot_reloader;
+    delete frame_scheduler;
+    headless_destroy_context(reload_context);
+    headless_terminate();
+    return ok ? 0 : 1;
+  }
 
-    -0.25f,  0.25f, -0.25f,  -1.0f, 0.0f, 0.0f,  1.0f, 1.0f,  // 0
-    -0.25f, -0.25f, -0.25f,  -1.0f, 0.0f, 0.0f,  0.0f, 1.0f,  // 1
-    -0.25f,  0.25f,  0.25f,  -1.0f, 0.0f, 0.0f,  1.0f, 0.0f,  // 7
+  if (use_soft && !init_soft())
+    return 1;
+  print_startup();
 
-     0.25f, -0.25f, -0.25f,  0.0f, -1.0f, 0.0f,  0.0f, 0.0f,  // 2
-     0.25f, -0.25f,  0.25f,  0.0f, -1.0f, 0.0f,  1.0f, 0.0f,  // 5
-    -0.25f, -0.25f, -0.25f,  0.0f, -1.0f, 0.0f,  0.0f, 1.0f,  // 1
+  frame_scheduler = new FrameScheduler(pacing_mode, pacing_fps > 0.0 ? pacing_fps : monitor_refresh_rate());
+  init_swap_interval();
+  start_profiler(true);
+  if (sim_thread)
+    sim_thread->start();
 
-    -0.25f, -0.25f,  0.25f,  0.0f, -1.0f, 0.0f,  1.0f, 1.0f,  // 6
-    -0.25f, -0.25f, -0.25f,  0.0f, -1.0f, 0.0f,  0.0f, 1.0f,  // 1
-     0.25f, -0.25f,  0.25f,  0.0f, -1.0f, 0.0f,  1.0f, 0.0f,  // 5
+  // Render loop
+  while(!glfwWindowShouldClose(window)) {
+    {
+      PROFILE_SCOPE("pacing");
+      frame_scheduler->begin_frame();
+    }
+    {
+      PROFILE_SCOPE("frame");
+
+      // Los eventos lo mas tarde posible, justo antes de usarlos
+      {
+        PROFILE_SCOPE("glfwPollEvents");
+        glfwPollEvents();
+      }
+
+      // Una subida por frame como mucho para no dar tirones
+      if (texture_loader) {
+        PROFILE_SCOPE("texture upload");
+        int pending = texture_loader->poll(1);
+        // La subida enlaza texturas sin el cache
+        gl_state.invalidate_textures();
+        if (pending == 0) {
+          texture_loader->print_stats();
+          delete texture_loader;
+          texture_loader = NULL;
+        }
+      }
+
+      {
+        PROFILE_SCOPE("processInput");
+        processInput(window);
+      }
+
+      {
+        PROFILE_SCOPE("updateCameraPosition");
+        updateCameraPosition(window);
+      }
+
+      if (use_soft) {
+        PROFILE_SCOPE("render");
+        render_soft(glfwGetTime());
+
+        // Se copia la imagen de la CPU a la ventana tal cual
+        glDisable(GL_DEPTH_TEST);
+        gl_state.use_program(0);
+        glWindowPos2i(0, gl_height);
+        glPixelZoom(1.0f, -1.0f);
+        glDrawPixels(gl_width, gl_height, GL_RGBA, GL_UNSIGNED_BYTE, soft_renderer->pixels());
+        glEnable(GL_DEPTH_TEST);
+      } else {
+        PROFILE_SCOPE("render");
+        PROFILE_GPU_SCOPE("render");
+        render_fn(glfwGetTime());
+      }
+
+      {
+        PROFILE_SCOPE("glfwSwapBuffers");
+        frame_scheduler->presenting();
+        glfwSwapBuffers(window);
+        frame_scheduler->presented();
+      }
+    }
+    profiler_end_frame();
+  }
+  if (sim_thread)
+    sim_thread->stop();
+  profiler_stop(trace_path);
+  frame_scheduler->print_stats();
+  if (sim_thread)
+    sim_thread->print_stats();
+
+  if (command_recorder)
+    command_recorder->print_stats();
+  if (culling)
+    culling->print_stats();
+  if (occlusion)
+    occlusion->print_stats();
+  if (gpu_culling)
+    gpu_culling->print_stats();
+
+  delete sim_thread;
+  delete command_recorder;
+  delete texture_loader;
+  delete hiz_buffer;
+  delete gpu_culling;
+  delete occlusion;
+  delete culling;
+  delete clustered_lights;
+  delete transforms;
+  delete uniform_ring;
+  delete asset_pack;
+  delete hot_reloader;
+  delete frame_scheduler;
+  if (reload_window)
+    glfwDestroyWindow(reload_window);
+  glfwTerminate();
 
-     0.25f,  0.25f,  0.25f,  0.0f, 1.0f, 0.0f,   0.0f, 0.0f,  // 4
-     0.25f,  0.25f, -0.25f,  0.0f, 1.0f, 0.0f,   1.0f, 0.0f,  // 3
-    -0.25f,  0.25f,  0.25f,  0.0f, 1.0f, 0.0f,   0.0f, 1.0f,  // 7
+  return 0;
+}
 
-    -0.25f,  0.25f, -0.25f,  0.0f, 1.0f, 0.0f,   1.0f, 1.0f,  // 0
-    -0.25f,  0.25f,  0.25f,  0.0f, 1.0f, 0.0f,   0.0f, 1.0f,  // 7
-     0.25f,  0.25f, -0.25f,  0.0f, 1.0f, 0.0f,   1.0f, 0.0f,  // 3
-  };
+static glm::mat4 projection_matrix() {
+  return glm::perspective(glm::radians(camera_fov), view_aspect.load(), camera_near, camera_far);
+}
 
-  // CUBE
+// Oclusores: los visibles mas grandes en pantalla, con su giro en el
+// instante currentTime; despues se quitan de visible_ids los tapados
+static void occlusion_cull(double currentTime) {
+  PROFILE_SCOPE("occlusion_cull");
+  int cells = (int) instance_cells.size();
+  glm::vec3 eye = glm::vec3(glm::inverse(view_matrix)[3]);
+  occlusion->begin_frame(projection_matrix() * view_matrix, view_aspect.load());
+
+  std::vector<std::pair<float, int>> sizes;
+  for (int id : visible_ids) {
+    if (occlusion_meshes[id / cells] < 0)
+      continue;
+    glm::vec3 center = 0.5f * (object_lo[id] + object_hi[id]);
+    float radius = 0.5f * (object_hi[id].x - object_lo[id].x);
+    float size = radius / std::max(glm::length(center - eye), 1e-3f);
+    if (size >= MIN_OCCLUDER_SIZE)
+      sizes.push_back(std::make_pair(-size, id));
+  }
+  if (sizes.size() > (size_t) MAX_OCCLUDERS) {
+    std::nth_element(sizes.begin(), sizes.begin() + MAX_OCCLUDERS, sizes.end());
+    sizes.resize(MAX_OCCLUDERS);
+  }
+  for (const std::pair<float, int> &occluder : sizes) {
+    int id = occluder.second, cell = id % cells, mesh = id / cells;
+    glm::vec3 offset(mesh == 0 ? .75f : -.75f, 0.0f, 0.0f);
+    glm::mat4 model = compute_model_matrix(instance_cells[cell] + offset, currentTime + instance_phase(cell));
+    occlusion->add_occluder(occlusion_meshes[mesh], model);
+  }
+  occlusion->rasterize();
+  occlusion->cull(visible_ids, object_lo, object_hi);
+}
 
-  // Vertex Buffer Object (for vertex coordinates)
-  GLuint vbo = 0;
-  glGenBuffers(3, &vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_positions), vertex_positions, GL_STATIC_DRAW);
+// Ids visibles desde la camara actual, separados por malla
+static void cull_scene(double currentTime) {
+  PROFILE_SCOPE("cull_scene");
+  int cells = (int) instance_cells.size();
+  culling->cull(projection_matrix() * view_matrix, visible_ids);
+  if (occlusion)
+    occlusion_cull(currentTime);
+  visible_cubes.clear();
+  visible_tetras.clear();
+  for (int id : visible_ids)
+    (id < cells ? visible_cubes : visible_tetras).push_back(id);
+}
 
-  // Vertex attributes
-  // 0: vertex position (x, y, z)
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8*sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
+// Luces de Phong de la escena tal como van en el bloque LightData
+static LightUniforms scene_lights() {
+  LightUniforms lights;
+  glm::vec3 positions[SCENE_LIGHTS] = { light_pos, light_pos2 };
+  for (int i = 0; i < SCENE_LIGHTS; i++) {
+    lights.lights[i].position = glm::vec4(positions[i], 1.0f);
+    lights.lights[i].ambient = glm::vec4(light_ambient, 0.0f);
+    lights.lights[i].diffuse = glm::vec4(light_diffuse, 0.0f);
+    lights.lights[i].specular = glm::vec4(light_specular, 0.0f);
+  }
+  return lights;
+}
 
-  // 1: vertex normals (x, y, z)
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8*sizeof(float), (void*)(3*sizeof(float)));
-  glEnableVertexAttribArray(1);
+// Camara, luces y material: un bloque std140 de cada, escritos una vez por
+// frame en el ring de uniform buffers. Con clusters, el reparto de las luces
+// puntuales de este frame ya hecho (--sim-thread) o NULL para hacerlo aqui
+static void update_frame_uniforms(const glm::mat4 &view, const glm::mat4 &projection, glm::vec3 view_pos,
+                                  const LightUniforms &lights, const ClusterBins *bins) {
+  PROFILE_SCOPE("update_frame_uniforms");
+  FrameUniforms frame;
+  frame.view = view;
+  frame.projection = projection;
+  frame.view_pos = glm::vec4(view_pos, 1.0f);
+  frame.cluster_params = glm::vec4(0.0f);
+
+  // Las luces puntuales se reparten de nuevo cada frame (la camara se mueve)
+  if (clustered_lights) {
+    if (bins) {
+      PROFILE_SCOPE("light upload");
+      clustered_lights->upload(*bins);
+    } else {
+      PROFILE_SCOPE("light binning");
+      clustered_lights->update(view, glm::radians(camera_fov), (float) gl_width / (float) gl_height,
+                               camera_near, camera_far);
+    }
+    clustered_lights->bind();
+    gl_state.invalidate_textures();
+    frame.cluster_params = clustered_lights->shader_params(gl_width, gl_height);
+  }
 
-  // 2: text coord (s, t)
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
+  MaterialUniforms material = { material_shininess, { 0.0f, 0.0f, 0.0f }, glm::vec4(material_specular, 0.0f) };
 
-  // Unbind vbo (it was conveniently registered by VertexAttribPointer)
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  uniform_ring->update(frame, lights, material);
+}
 
-  // Unbind vao
-  glBindVertexArray(0);
-  
-  //TETRAEDRO
-  //
-  //           3
-  //
-  //           1   
-  //     
-  //        6       5
-  //
-  const GLfloat vertex_positions_tetraedro[] = {
-
-    //positions                   //Normals             // Texture
-    0.0f,  0.25f, -0.15f,        -1.0f, 0.0f, 0.0f,     0.5f,  1.0f,   // 3
-    0.0f,  -0.25f,  0.30f,       -1.0f, 0.0f, 0.0f,     1.0f,  0.0f,   // 6
-    -0.25f, -0.25f, -0.15f,      -1.0f, 0.0f, 0.0f,     0.0f,  0.0f,   // 1
-
-    0.0f,  0.25f, -0.15f,        1.0f, 0.0f, 0.0f,      0.5f,  1.0f,    // 3
-    -0.25f, -0.25f, -0.15f,      1.0f, 0.0f, 0.0f,      1.0f,  0.0f,    // 1
-    0.25f, -0.25f,  -0.15f,      1.0f, 0.0f, 0.0f,      0.0f,  0.0f,    // 5
-    
-
-    0.0f,  -0.25f,  0.30f,       0.0f, 0.0f, -1.0f,     0.0f,  0.0f,    // 6
-    0.25f, -0.25f,  -0.15f,      0.0f, 0.0f, -1.0f,     1.0f,  0.0f,    // 5
-    0.0f,  0.25f, -0.15f,        0.0f, 0.0f, -1.0f,     0.5f,  1.0f,    // 3
-
-    0.0f,  -0.25f,  0.30f,       0.0f, -1.0f, 0.0f,     0.0f,  0.0f,    // 6
-    -0.25f, -0.25f, -0.15f,      0.0f, -1.0f, 0.0f,     1.0f,  0.0f,    // 1
-    0.25f, -0.25f,  -0.15f,      0.0f, -1.0f, 0.0f,     0.5f,  1.0f,    // 5
-  };
+static void update_frame_uniforms() {
+  update_frame_uniforms(view_matrix, projection_matrix(), camera_pos, scene_lights(), NULL);
+}
 
+// Transformacion del formato compacto para la malla del siguiente draw
+static void set_mesh_dequant(const QuantRange &range) {
+  if (use_packed)
+    gl_state.uniform_4fv(mesh_dequant_location, 3, &range.position_offset[0]);
+}
 
-  // Crear y vincular el Vertex Array Object (VAO) para el tetraedro
-  GLuint vao2 = 0;
-  glGenVertexArrays(1, &vao2);
+void render(double currentTime) {
+  float f = (float)currentTime * 0.3f;
 
-  // Crear y vincular el Vertex Buffer Object (VBO) para el tetraedro
-  GLuint vbo2 = 0;
-  glGenBuffers(3, &vbo2);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo2);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_positions_tetraedro), vertex_positions_tetraedro, GL_STATIC_DRAW);
+  GL_COUNT(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
-  // Especificar los atributos de vértice para el tetraedro
-  // 0: posición del vértice (x, y, z)
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-  glEnableVertexAttribArray(0);
+  GL_COUNT(glViewport(0, 0, gl_width, gl_height));
 
-  // 1: normales de vértice (x, y, z)
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-  glEnableVertexAttribArray(1);
+  gl_state.use_program(shader_program);
+  gl_state.bind_vertex_array(vao);
 
-  // 2: text coord (s, t)
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *)(6 * sizeof(float)));
-  glEnableVertexAttribArray(2);
+  update_frame_uniforms();
 
-  // Desvincular el VBO y el VAO
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  // Objetos fuera del frustum: no se dibujan
+  bool cube_visible = true, tetra_visible = true;
+  if (culling) {
+    cull_scene(currentTime);
+    cube_visible = !visible_cubes.empty();
+    tetra_visible = !visible_tetras.empty();
+  }
 
+  glm::mat4 model_matrix;
+  glm::mat4 normal_matrix;
 
-  // CUBE
+  // MOVING CUBE
+  if (cube_visible) {
+    // Model matrix - rotación
+    model_matrix = compute_model_matrix(glm::vec3(.75f, 0.0f, 0.0f), currentTime);
 
-  // Uniforms
-  // - Model matrix
-  // - View matrix
-  // - Projection matrix
-  // - Normal matrix: normal vectors from local to world coordinates
-  // - Camera position
-  // - Light data
-  // - Material data
-  model_location = glGetUniformLocation(shader_program, "model");
-  view_location = glGetUniformLocation(shader_program, "view");
-  proj_location = glGetUniformLocation(shader_program, "projection");
-  normal_location = glGetUniformLocation(shader_program, "normal_matrix");
+    // Normal matrix: normal vectors to world coordinates
+    // (el uniform es un mat4, asi que se sube como mat4)
+    normal_matrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(model_matrix))));
 
+    gl_state.uniform_matrix_4fv(model_location, &model_matrix[0][0]);
+    gl_state.uniform_matrix_4fv(normal_location, &normal_matrix[0][0]);
 
-  light_position_location = glGetUniformLocation(shader_program, "light.position");
-  light_ambient_location = glGetUniformLocation(shader_program, "light.ambient");
-  light_diffuse_location = glGetUniformLocation(shader_program, "light.diffuse");
-  light_specular_location = glGetUniformLocation(shader_program, "light.specular");
+    // Texture binding
+    gl_state.bind_texture(0, GL_TEXTURE_2D, diffuse_map);
 
+    // Activar unidad de textura specular
+    gl_state.bind_texture(1, GL_TEXTURE_2D, specular_map);
 
-  material_shininess_location = glGetUniformLocation(shader_program, "material.shininess");
-  material_specular_location = glGetUniformLocation(shader_program, "material.specular");
+    // Dibujar cubo
+    set_mesh_dequant(packed_meshes[0].range);
+    GL_COUNT(glDrawElements(GL_TRIANGLES, (GLsizei) scene_meshes[0].indices.size(), GL_UNSIGNED_INT, 0));
+  }
 
-  // Cargamos la textura
-  diffuse_map = load_textura("diffuse.png");
-  specular_map = load_textura("specular.png");
-  
-  
+  // tetraedro
+  if (tetra_visible) {
+    model_matrix = compute_model_matrix(glm::vec3(-.75f, 0.0f, 0.0f), currentTime);
 
-  // Tetraedro:
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_positions_tetraedro), vertex_positions_tetraedro, GL_STATIC_DRAW);
+    // Normal matrix: normal vectors to world coordinates
+    normal_matrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(model_matrix))));
 
-  light_position_location2 = glGetUniformLocation(shader_program, "light2.position");
-  light_ambient_location2 = glGetUniformLocation(shader_program, "light2.ambient");
-  light_diffuse_location2 = glGetUniformLocation(shader_program, "light2.diffuse");
-  light_specular_location2 = glGetUniformLocation(shader_program, "light2.specular");
+    gl_state.uniform_matrix_4fv(model_location, &model_matrix[0][0]);
+    gl_state.uniform_matrix_4fv(normal_location, &normal_matrix[0][0]);
 
-  camera_position_location = glGetUniformLocation(shader_program, "view_pos");
+    gl_state.bind_texture(0, GL_TEXTURE_2D, diffuse_map);
 
-  // Render loop
-  while(!glfwWindowShouldClose(window)) {
+    // Activar unidad de textura specular
+    gl_state.bind_texture(1, GL_TEXTURE_2D, specular_map);
+
+    gl_state.bind_vertex_array(vao2);
+
+    // Dibujar tetraedros
+    set_mesh_dequant(packed_meshes[1].range);
+    GL_COUNT(glDrawElements(GL_TRIANGLES, (GLsizei) scene_meshes[1].indices.size(), GL_UNSIGNED_INT, 0));
+  }
 
-    processInput(window);
+  uniform_ring->end_frame();
+}
 
-    updateCameraPosition(window);
+// Todas las instancias con un glDrawElementsInstanced por malla: las matrices
+// van en instance_vbo y el resto en los uniform buffers
+void render_instanced(double currentTime) {
+  GL_COUNT(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
-    render(glfwGetTime());
+  GL_COUNT(glViewport(0, 0, gl_width, gl_height));
 
-    glfwSwapBuffers(window);
+  gl_state.use_program(shader_program);
 
-    glfwPollEvents();
+  // Con culling solo se suben y dibujan las instancias visibles, seguidas
+  // al principio de la zona de cada malla
+  int cubes = instance_count, tetras = instance_count;
+  if (culling) {
+    cull_scene(currentTime);
+    cubes = (int) visible_cubes.size();
+    tetras = (int) visible_tetras.size();
   }
 
-  glfwTerminate();
+  // Orphaning: el driver puede seguir leyendo las matrices del frame anterior
+  GLsizeiptr size = 2 * (GLsizeiptr) instance_count * sizeof(InstanceAttribs);
+  GL_COUNT(glBindBuffer(GL_ARRAY_BUFFER, instance_vbo));
+  GL_COUNT(glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW));
+  InstanceAttribs *attribs = (InstanceAttribs *) GL_COUNT(glMapBufferRange(
+      GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  if (attribs) {
+    PROFILE_SCOPE("instance transforms");
+    // Las matrices se escriben directamente en el buffer mapeado, en paralelo
+    if (culling) {
+      transforms->compute(currentTime, visible_cubes.data(), cubes, attribs);
+      transforms->compute(currentTime, visible_tetras.data(), tetras, attribs + instance_count);
+    } else {
+      transforms->compute(currentTime, attribs);
+    }
+    GL_COUNT(glUnmapBuffer(GL_ARRAY_BUFFER));
+  }
+  GL_COUNT(glBindBuffer(GL_ARRAY_BUFFER, 0));
 
-  return 0;
+  update_frame_uniforms();
+
+  gl_state.bind_texture(0, GL_TEXTURE_2D, diffuse_map);
+  gl_state.bind_texture(1, GL_TEXTURE_2D, specular_map);
+
+  gl_state.bind_vertex_array(vao);
+  set_mesh_dequant(packed_meshes[0].range);
+  if (cubes > 0)
+    GL_COUNT(glDrawElementsInstanced(GL_TRIANGLES, (GLsizei) scene_meshes[0].indices.size(), GL_UNSIGNED_INT,
+                                     0, cubes));
+  gl_state.bind_vertex_array(vao2);
+  set_mesh_dequant(packed_meshes[1].range);
+  if (tetras > 0)
+    GL_COUNT(glDrawElementsInstanced(GL_TRIANGLES, (GLsizei) scene_meshes[1].indices.size(), GL_UNSIGNED_INT,
+                                     0, tetras));
+
+  uniform_ring->end_frame();
 }
 
-void render(double currentTime) {
-  float f = (float)currentTime * 0.3f;
+// Culling y draws desde la GPU: el trabajo de la CPU no depende del numero
+// de objetos. Con la Hi-Z, en dos fases (ver gpucull.h)
+void render_gpu_driven(double currentTime) {
+  glm::mat4 view_proj = projection_matrix() * view_matrix;
+  GpuCulling::Pass pass = hiz_buffer ? GpuCulling::PREVIOUSLY_VISIBLE : GpuCulling::FRUSTUM;
 
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  if (hiz_buffer)
+    hiz_buffer->begin_frame(gl_width, gl_height);
 
-  glViewport(0, 0, gl_width, gl_height);
+  GL_COUNT(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
-  glUseProgram(shader_program);
-  glBindVertexArray(vao);
+  GL_COUNT(glViewport(0, 0, gl_width, gl_height));
 
-  glm::mat4 model_matrix, proj_matrix;
-  glm::mat3 normal_matrix;
+  {
+    PROFILE_GPU_SCOPE("gpu cull");
+    gpu_culling->cull(view_proj, currentTime, pass);
+  }
+  // El culling usa su programa y su unidad de textura sin el cache
+  gl_state.invalidate();
 
-  // MOVING CUBE
-  
-  // Model matrix - rotación
-  model_matrix = glm::mat4(1.f);
-  model_matrix = glm::translate(model_matrix, glm::vec3(.75f, 0.0f, 0.0f));
-  model_matrix = glm::rotate(model_matrix,
-                      glm::radians((float)currentTime * 20.0f),
-                      glm::vec3(0.0f, 1.0f, 0.0f));
-  model_matrix = glm::rotate(model_matrix,
-                      glm::radians((float)currentTime * 40.0f),
-                      glm::vec3(1.0f, 0.0f, 0.0f));
+  gl_state.use_program(shader_program);
+  update_frame_uniforms();
+  set_mesh_dequant(gpu_packed_range);
 
-  // Projection matrix - perspective
-  proj_matrix = glm::perspective(glm::radians(50.0f),
-                                 (float) gl_width / (float) gl_height,
-                                 0.1f, 1000.0f);
+  gl_state.bind_texture(0, GL_TEXTURE_2D, diffuse_map);
+  gl_state.bind_texture(1, GL_TEXTURE_2D, specular_map);
 
-  // Normal matrix: normal vectors to world coordinates
-  normal_matrix = glm::transpose(glm::inverse(glm::mat3(model_matrix)));
+  gl_state.bind_vertex_array(gpu_vao);
+  {
+    PROFILE_GPU_SCOPE("draw");
+    gpu_culling->draw(pass);
+  }
 
-  // Load lighting
-  glUniform3f(light_ambient_location, light_ambient.x, light_ambient.y, light_ambient.z);
-  glUniform3f(light_position_location, light_pos.x, light_pos.y, light_pos.z);
-  glUniform3f(light_diffuse_location, light_diffuse.x, light_diffuse.y, light_diffuse.z);
-  glUniform3f(light_specular_location, light_specular.x, light_specular.y, light_specular.z);
+  if (hiz_buffer) {
+    // Lo que tapa lo ya dibujado no llega a los draws de la segunda fase
+    {
+      PROFILE_GPU_SCOPE("hiz build");
+      hiz_buffer->build();
+    }
+    {
+      PROFILE_GPU_SCOPE("occlusion cull");
+      gpu_culling->cull(view_proj, currentTime, GpuCulling::OCCLUSION, hiz_buffer);
+    }
+    gl_state.invalidate();
+    PROFILE_GPU_SCOPE("occlusion draw");
+    gl_state.use_program(shader_program);
+    gpu_culling->draw(GpuCulling::OCCLUSION);
+    hiz_buffer->end_frame();
+  }
 
-  glUniform3f(light_ambient_location2, light_ambient.x, light_ambient.y, light_ambient.z);
-  glUniform3f(light_position_location2, light_pos2.x, light_pos2.y, light_pos2.z);
-  glUniform3f(light_diffuse_location2, light_diffuse.x, light_diffuse.y, light_diffuse.z);
-  glUniform3f(light_specular_location2, light_specular.x, light_specular.y, light_specular.z);
+  uniform_ring->end_frame();
+}
 
-  // Material
-  glUniform1f(material_shininess_location, material_shininess);
-  glUniform1i(material_specular_location, 1);
+// Draws de los objetos ids[0..count) (cubos: 0..n-1, tetraedros: n..2n-1)
+// con su propio estado; se llama desde los hilos del CommandRecorder. Cada
+// draw es de una instancia: base instance es su posicion en instance_vbo
+static void record_objects(const int *ids, int count, CommandList &list) {
+  int cells = (int) instance_cells.size();
+  GLuint vaos[2] = { vao, vao2 };
+  list.use_program(shader_program);
+  list.bind_texture(0, GL_TEXTURE_2D, diffuse_map);
+  list.bind_texture(1, GL_TEXTURE_2D, specular_map);
+  int bound = -1;
+  for (int i = 0; i < count; i++) {
+    int mesh = ids[i] < cells ? 0 : 1;
+    if (mesh != bound) {
+      list.bind_vertex_array(vaos[mesh]);
+      if (use_packed)
+        list.uniform_4fv(mesh_dequant_location, 3, &packed_meshes[mesh].range.position_offset[0]);
+      bound = mesh;
+    }
+    list.draw_elements_instanced(GL_TRIANGLES, (GLsizei) scene_meshes[mesh].indices.size(), GL_UNSIGNED_INT, 0,
+                                 1, (GLuint) (ids[i] - mesh * cells));
+  }
+}
 
-  // Camera position
-  glUniform3f(camera_position_location, camera_pos.x, camera_pos.y, camera_pos.z);
+// Como render_instanced(), pero con las matrices de todos los objetos en
+// instance_vbo (en su sitio, no solo las visibles) y un draw por objeto
+// visible en las listas de comandos
+void render_recorded(double currentTime) {
+  GL_COUNT(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+
+  GL_COUNT(glViewport(0, 0, gl_width, gl_height));
+
+  // Cubos y luego tetraedros, para que cada lista cambie de VAO una vez
+  // como mucho
+  if (culling) {
+    cull_scene(currentTime);
+    draw_ids = visible_cubes;
+    draw_ids.insert(draw_ids.end(), visible_tetras.begin(), visible_tetras.end());
+  } else if (draw_ids.empty()) {
+    for (int id = 0; id < 2 * instance_count; id++)
+      draw_ids.push_back(id);
+  }
 
+  GLsizeiptr size = 2 * (GLsizeiptr) instance_count * sizeof(InstanceAttribs);
+  GL_COUNT(glBindBuffer(GL_ARRAY_BUFFER, instance_vbo));
+  GL_COUNT(glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW));
+  InstanceAttribs *attribs = (InstanceAttribs *) GL_COUNT(glMapBufferRange(
+      GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  if (attribs) {
+    PROFILE_SCOPE("instance transforms");
+    transforms->compute(currentTime, attribs);
+    GL_COUNT(glUnmapBuffer(GL_ARRAY_BUFFER));
+  }
+  GL_COUNT(glBindBuffer(GL_ARRAY_BUFFER, 0));
 
-  glUniformMatrix4fv(model_location, 1, GL_FALSE, &model_matrix[0][0]);
-  glUniformMatrix4fv(view_location, 1, GL_FALSE, &view_matrix[0][0]);
-  glUniformMatrix4fv(proj_location, 1, GL_FALSE, &proj_matrix[0][0]);
+  update_frame_uniforms();
 
-  glUniformMatrix4fv(normal_location, 1, GL_FALSE, &normal_matrix[0][0]);
+  // Lo que lee record_objects() aparte de los ids; cambia con --watch
+  std::vector<uint32_t> state = { shader_program, diffuse_map, specular_map };
+  command_recorder->record(draw_ids, state, record_objects);
+  command_recorder->replay();
 
-  // Texture binding
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, diffuse_map);
+  uniform_ring->end_frame();
+}
 
-  // Activar unidad de textura specular
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, specular_map);
+// Hilo de simulacion (--sim-thread): lo que render() y render_instanced()
+// calculan en la CPU antes de dibujar. Sin ventana el frame i es el
+// instante i * dt, como en headless_run()
+void simulate_frame(uint64_t frame, FramePacket &packet) {
+  double currentTime = headless_frames > 0 ? frame * headless_dt : glfwGetTime();
+  // La entrada antes que la camara: todo evento que se lleve el paquete ya
+  // esta aplicado en la vista
+  packet.input.clear();
+  if (frame_scheduler)
+    frame_scheduler->take_input(packet.input);
+  updateViewMatrix();
+  packet.time = currentTime;
+  packet.view = view_matrix;
+  packet.projection = projection_matrix();
+  packet.view_pos = camera_pos;
+  packet.lights = scene_lights();
+  if (clustered_lights) {
+    PROFILE_SCOPE("light binning");
+    clustered_lights->bin(packet.view, glm::radians(camera_fov), view_aspect.load(), camera_near, camera_far,
+                          packet.clusters);
+  }
 
-  // Dibujar cubo
-  glDrawArrays(GL_TRIANGLES, 0, 36);
+  // Mismo orden que instance_vbo: los cubos y luego los tetraedros
+  int cells = (int) instance_cells.size();
+  packet.instances.resize(2 * cells);
+  packet.first[0] = 0;
+  packet.first[1] = cells;
+  packet.count[0] = packet.count[1] = cells;
+  if (culling) {
+    cull_scene(currentTime);
+    packet.count[0] = (int) visible_cubes.size();
+    packet.count[1] = (int) visible_tetras.size();
+  }
 
-  // tetraedro
+  InstanceAttribs *attribs = packet.instances.data();
+  if (transforms) {
+    PROFILE_SCOPE("instance transforms");
+    if (culling) {
+      transforms->compute(currentTime, visible_cubes.data(), packet.count[0], attribs);
+      transforms->compute(currentTime, visible_tetras.data(), packet.count[1], attribs + cells);
+    } else {
+      transforms->compute(currentTime, attribs);
+    }
+  } else {
+    // Escena original: el cubo y el tetraedro de render()
+    for (int mesh = 0; mesh < 2; mesh++) {
+      attribs[mesh].model = compute_model_matrix(glm::vec3(mesh == 0 ? .75f : -.75f, 0.0f, 0.0f), currentTime);
+      glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(attribs[mesh].model)));
+      for (int c = 0; c < 3; c++)
+        attribs[mesh].normal_matrix[c] = glm::vec4(normal_matrix[c], 0.0f);
+    }
+  }
+}
+
+// Hilo de render con --sim-thread: sube el paquete del siguiente frame y
+// dibuja. El tiempo es el del paquete, no el que se recibe
+void render_packet(double) {
+  const FramePacket *packet;
+  {
+    PROFILE_SCOPE("wait packet");
+    packet = sim_thread->acquire();
+  }
+  if (!packet)
+    return;
+  if (frame_scheduler)
+    frame_scheduler->consume_input(packet->input);
+
+  GL_COUNT(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+
+  GL_COUNT(glViewport(0, 0, gl_width, gl_height));
+
+  gl_state.use_program(shader_program);
+
+  bool instanced = instance_count > 0;
+  if (instanced) {
+    GLsizeiptr size = 2 * (GLsizeiptr) instance_count * sizeof(InstanceAttribs);
+    GL_COUNT(glBindBuffer(GL_ARRAY_BUFFER, instance_vbo));
+    GL_COUNT(glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW));
+    InstanceAttribs *attribs = (InstanceAttribs *) GL_COUNT(glMapBufferRange(
+        GL_ARRAY_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (attribs) {
+      PROFILE_SCOPE("upload instances");
+      for (int mesh = 0; mesh < 2; mesh++)
+        memcpy(attribs + packet->first[mesh], &packet->instances[packet->first[mesh]],
+               packet->count[mesh] * sizeof(InstanceAttribs));
+      GL_COUNT(glUnmapBuffer(GL_ARRAY_BUFFER));
+    }
+    GL_COUNT(glBindBuffer(GL_ARRAY_BUFFER, 0));
+  }
+
+  update_frame_uniforms(packet->view, packet->projection, packet->view_pos, packet->lights, &packet->clusters);
+
+  gl_state.bind_texture(0, GL_TEXTURE_2D, diffuse_map);
+  gl_state.bind_texture(1, GL_TEXTURE_2D, specular_map);
+
+  GLuint vaos[2] = { vao, vao2 };
+  for (int mesh = 0; mesh < 2; mesh++) {
+    int count = packet->count[mesh];
+    if (count == 0)
+      continue;
+    gl_state.bind_vertex_array(vaos[mesh]);
+    set_mesh_dequant(packed_meshes[mesh].range);
+    GLsizei indices = (GLsizei) scene_meshes[mesh].indices.size();
+    if (instanced) {
+      GL_COUNT(glDrawElementsInstanced(GL_TRIANGLES, indices, GL_UNSIGNED_INT, 0, count));
+    } else {
+      const InstanceAttribs &attribs = packet->instances[packet->first[mesh]];
+      glm::mat4 normal_matrix = glm::mat4(glm::mat3(glm::vec3(attribs.normal_matrix[0]),
+                                                    glm::vec3(attribs.normal_matrix[1]),
+                                                    glm::vec3(attribs.normal_matrix[2])));
+      gl_state.uniform_matrix_4fv(model_location, &attribs.model[0][0]);
+      gl_state.uniform_matrix_4fv(normal_location, &normal_matrix[0][0]);
+      GL_COUNT(glDrawElements(GL_TRIANGLES, indices, GL_UNSIGNED_INT, 0));
+    }
+  }
+  sim_thread->release();
 
-  model_matrix = glm::mat4(1.f);
-  model_matrix = glm::translate(model_matrix, glm::vec3(-.75f, 0.0f, 0.0f));
+  uniform_ring->end_frame();
+}
+
+// Model matrix: traslacion a position y giro sobre Y y X segun el tiempo
+glm::mat4 compute_model_matrix(glm::vec3 position, double currentTime) {
+  glm::mat4 model_matrix = glm::mat4(1.f);
+  model_matrix = glm::translate(model_matrix, position);
   model_matrix = glm::rotate(model_matrix,
-                      glm::radians((float)currentTime * 20.0f),
+                      glm::radians((float)currentTime * SPIN_Y_DEG_PER_S),
                       glm::vec3(0.0f, 1.0f, 0.0f));
   model_matrix = glm::rotate(model_matrix,
-                      glm::radians((float)currentTime * 40.0f),
+                      glm::radians((float)currentTime * SPIN_X_DEG_PER_S),
                       glm::vec3(1.0f, 0.0f, 0.0f));
-                      
-  proj_matrix = glm::perspective(glm::radians(50.0f),
-                                 (float) gl_width / (float) gl_height,
-                                 0.1f, 1000.0f);
-                      
-  // Normal matrix: normal vectors to world coordinates
-  normal_matrix = glm::transpose(glm::inverse(glm::mat3(model_matrix)));
-
-  glUniform1f(material_shininess_location, material_shininess);
-  glUniform1i(material_specular_location, 1);
+  return model_matrix;
+}
 
-  glUniformMatrix4fv(model_location, 1, GL_FALSE, &model_matrix[0][0]);
-  glUniformMatrix4fv(view_location, 1, GL_FALSE, &view_matrix[0][0]);
-  glUniformMatrix4fv(proj_location, 1, GL_FALSE, &proj_matrix[0][0]);
-  glUniformMatrix4fv(normal_location, 1, GL_FALSE, &normal_matrix[0][0]);
+static void draw_soft_mesh(const MeshData &mesh, const SoftDrawParams &params) {
+  soft_renderer->draw(mesh.vertices.data(), mesh.vertex_count(), mesh.indices.data(), (int) mesh.indices.size(),
+                      params);
+}
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, diffuse_map);
+// Misma escena que render() pero con el backend por software
+void render_soft(double currentTime) {
+  soft_renderer->resize(gl_width, gl_height);
+  soft_renderer->clear();
+
+  SoftDrawParams params;
+  params.view = view_matrix;
+  params.projection = projection_matrix();
+  params.view_pos = camera_pos;
+  params.light = { light_pos, light_ambient, light_diffuse, light_specular };
+  params.light2 = { light_pos2, light_ambient, light_diffuse, light_specular };
+  params.shininess = material_shininess;
+  params.diffuse = &soft_diffuse_map;
+  params.specular = &soft_specular_map;
+
+  // Sin instancias hay una unica celda en el origen. Con culling solo se
+  // dibujan los visibles (ids: cubos y luego tetraedros, como en GL)
+  int cells = (int) instance_cells.size();
+  if (culling) {
+    cull_scene(currentTime);
+  } else {
+    visible_ids.resize(2 * cells);
+    for (int id = 0; id < 2 * cells; id++)
+      visible_ids[id] = id;
+  }
 
-  // Activar unidad de textura specular
-  glActiveTexture(GL_TEXTURE1);
-  glBindTexture(GL_TEXTURE_2D, specular_map);
+  for (int id : visible_ids) {
+    int i = id % cells;
+    double t = currentTime + instance_phase(i);
+
+    if (id < cells) {
+      // Cubo
+      params.model = compute_model_matrix(instance_cells[i] + glm::vec3(.75f, 0.0f, 0.0f), t);
+      params.normal_matrix = glm::transpose(glm::inverse(glm::mat3(params.model)));
+      draw_soft_mesh(scene_meshes[0], params);
+    } else {
+      // Tetraedro
+      params.model = compute_model_matrix(instance_cells[i] + glm::vec3(-.75f, 0.0f, 0.0f), t);
+      params.normal_matrix = glm::transpose(glm::inverse(glm::mat3(params.model)));
+      draw_soft_mesh(scene_meshes[1], params);
+    }
+  }
 
-  glBindVertexArray(vao2);
-  
-  // Dibujar tetraedros
-  glDrawArrays(GL_TRIANGLES, 0, 36);
+  soft_renderer->finish();
 }
 
+// Los eventos que han llegado desde el frame anterior se aplican en este
+// (con --sim-thread, en el paquete que se simule despues de
+// updateCameraPosition)
 void processInput(GLFWwindow *window) {
+  if (!sim_thread)
+    frame_scheduler->consume_input();
   if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
     glfwSetWindowShouldClose(window, 1);
 }
@@ -501,6 +1925,15 @@ void updateCameraPosition(GLFWwindow *window) {
     teclaPulsada = false;
   }
 
+  // Con --sim-thread la vista la calcula el hilo de simulacion, que se lleva
+  // los eventos una vez aplicados
+  if (sim_thread)
+    frame_scheduler->publish_input();
+  else
+    updateViewMatrix();
+}
+
+void updateViewMatrix() {
   if (useFirstCamera) {
       // Configurar la primera cámara
       view_matrix = glm::lookAt(                 camera_pos,  // pos
@@ -514,51 +1947,17 @@ void updateCameraPosition(GLFWwindow *window) {
     }
 }
 
+// Marca la llegada de cada tecla para medir la latencia hasta el frame que
+// la presenta
+void glfw_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+  if (action != GLFW_RELEASE && frame_scheduler)
+    frame_scheduler->input_event();
+}
+
 // Callback function to track window size and update viewport
 void glfw_window_size_callback(GLFWwindow* window, int width, int height) {
   gl_width = width;
   gl_height = height;
+  view_aspect = (float) width / (float) height;
   printf("New viewport: (width: %d, height: %d)\n", width, height);
 }
-
-// Funcion para cargar la textura mediante un path (https://learnopengl.com/Getting-started/Textures)
-unsigned int load_textura(char const *path){
-
-  unsigned int texture;
-  glGenTextures(1, &texture);
-
-  int width, height, comp;
-
-  // Indicamos en el path la imagen que queremos cargar como textura
-  unsigned char *data = stbi_load(path, &width, &height, &comp, 0);
-
-  if (data) {
-    
-    GLenum format;
-    
-    // Se comprueba si es una textura está en un canal de color u otro ya que 
-    // para OpenGL se escribe "rojo" para uno, "rojo/verde" para dos y así sucesivamente.
-    if (comp == 1)
-      format = GL_RED;
-    else if (comp == 3)
-      format = GL_RGB;
-    else if (comp == 4)
-      format = GL_RGBA;
-
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_image_free(data);
-  } else {
-
-    printf("Texture failed to load");
-    stbi_image_free(data);
-  }
-  return texture;
-}
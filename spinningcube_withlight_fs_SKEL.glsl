@@ -1,18 +1,14 @@
 #version 330
 
+// Variantes (shaderpre.h): MAX_LIGHTS y NUM_LIGHTS, HAS_DIFFUSE_MAP y
+// HAS_SPECULAR_MAP, o UBER_SHADER para decidirlo todo con uniforms
+#include "phong_light.glsl"
+
 struct Material {
   sampler2D diffuse;
   sampler2D specular;
-  float     shininess;
 }; 
 
-struct Light {
-  vec3 position;
-  vec3 ambient;
-  vec3 diffuse;
-  vec3 specular;
-};
-
 out vec4 frag_col;
 
 in vec3 frag_3Dpos;
@@ -20,37 +16,75 @@ in vec3 normal;
 in vec2 vs_tex_coord;
 
 uniform Material material;
-uniform Light light;  
-uniform Light light2;  
-uniform vec3 view_pos;
 
-void main() {
+// Bloques std140, ver uniforms.h
+#include "frame_data.glsl"
 
-  // Ambient
-  vec3 ambient = light.ambient * texture(material.diffuse, vs_tex_coord).rgb;
-  vec3 light_dir = normalize(light.position - frag_3Dpos);
+layout(std140) uniform LightData {
+  Light lights[MAX_LIGHTS];
+};
 
-  vec3 ambient2 = light2.ambient * texture(material.diffuse, vs_tex_coord).rgb;
-  vec3 light_dir2 = normalize(light2.position - frag_3Dpos);
+layout(std140) uniform MaterialData {
+  float material_shininess;
+  vec3 material_specular;
+};
 
-  // Diffuse
-  float diff = max(dot(normal, light_dir), 0.0);
-  vec3 diffuse = light.diffuse * diff * texture(material.diffuse, vs_tex_coord).rgb;
+#ifdef CLUSTERED
+// Luces puntuales asignadas a clusters del frustum, ver clusters.h
+uniform samplerBuffer point_lights;      // 2 texels por luz: posicion y radio, color
+uniform usamplerBuffer cluster_grid;     // por cluster: primer indice y numero de luces
+uniform usamplerBuffer cluster_indices;  // indices de luces
 
-  float diff2 = max(dot(normal, light_dir2), 0.0);
-  vec3 diffuse2 = light2.diffuse * diff2 * texture(material.diffuse, vs_tex_coord).rgb;
-  
-  // Specular
-  vec3 view_dir = normalize(view_pos - frag_3Dpos);
+vec3 point_lighting(vec3 view_dir, vec3 diffuse_tex, vec3 specular_tex) {
+  float depth = -(view * vec4(frag_3Dpos, 1.0)).z;
+  ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy * cluster_params.xy),
+                        int(log(depth) * cluster_params.z + cluster_params.w));
+  cluster = clamp(cluster, ivec3(0), ivec3(CLUSTER_X - 1, CLUSTER_Y - 1, CLUSTER_Z - 1));
+  uvec2 cell = texelFetch(cluster_grid, (cluster.z * CLUSTER_Y + cluster.y) * CLUSTER_X + cluster.x).xy;
 
-  vec3 reflect_dir = reflect(-light_dir, normal);
-  float spec = pow(max(dot(view_dir, reflect_dir), 0.0), material.shininess);
-  vec3 specular = light.specular * spec * texture(material.specular, vs_tex_coord).rgb;
+  vec3 result = vec3(0.0);
+  for (uint i = 0u; i < cell.y; i++) {
+    int index = int(texelFetch(cluster_indices, int(cell.x + i)).r);
+    vec4 position_radius = texelFetch(point_lights, 2 * index);
+    vec3 color = texelFetch(point_lights, 2 * index + 1).rgb;
 
-  vec3 reflect_dir2 = reflect(-light_dir2, normal);
-  float spec2 = pow(max(dot(view_dir, reflect_dir2), 0.0), material.shininess);
-  vec3 specular2 = light2.specular * spec2 * texture(material.specular, vs_tex_coord).rgb;
+    vec3 to_light = position_radius.xyz - frag_3Dpos;
+    float dist = length(to_light);
+    if (dist >= position_radius.w)
+      continue;
+    float attenuation = 1.0 - dist / position_radius.w;
+    attenuation *= attenuation;
+
+    vec3 light_dir = to_light / dist;
+    float diff = max(dot(normal, light_dir), 0.0);
+    float spec = pow(max(dot(view_dir, reflect(-light_dir, normal)), 0.0), material_shininess);
+    result += attenuation * color * (diff * diffuse_tex + spec * specular_tex);
+  }
+  return result;
+}
+#endif
+
+#ifdef UBER_SHADER
+uniform int light_count;
+uniform bool has_diffuse_map;
+uniform bool has_specular_map;
+#else
+const bool has_diffuse_map = HAS_DIFFUSE_MAP != 0;
+const bool has_specular_map = HAS_SPECULAR_MAP != 0;
+#endif
+
+void main() {
+  // Sin textura: blanco para la difusa y material_specular para la especular
+  vec3 diffuse_tex = has_diffuse_map ? texture(material.diffuse, vs_tex_coord).rgb : vec3(1.0);
+  vec3 specular_tex = has_specular_map ? texture(material.specular, vs_tex_coord).rgb : material_specular;
+  vec3 view_dir = normalize(view_pos - frag_3Dpos);
 
-  vec3 result = ambient + diffuse + specular + ambient2 + diffuse2 + specular2;
+  vec3 result = vec3(0.0);
+#unroll L NUM_LIGHTS
+  phong_light(lights[L], frag_3Dpos, normal, view_dir, material_shininess, diffuse_tex, specular_tex, result);
+#endunroll
+#ifdef CLUSTERED
+  result += point_lighting(view_dir, diffuse_tex, specular_tex);
+#endif
   frag_col = vec4(result, 1.0);
 }
@@ -1,19 +1,49 @@
 #version 330
 
-in vec3 v_pos;
-in vec3 v_normal;
-in vec2 v_textura;
+#ifdef PACKED_VERTICES
+// Formato compacto (meshquant.h): enteros sin normalizar, la normal en
+// codificacion octaedrica
+layout(location = 0) in vec3 v_pos_q;
+layout(location = 1) in vec2 v_normal_oct;
+layout(location = 2) in vec2 v_textura_q;
+// Offset y escala de la posicion (xyz) y offset y escala de las coordenadas
+// de textura (xy, zw)
+uniform vec4 mesh_dequant[3];
+
+vec3 oct_decode(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+#else
+layout(location = 0) in vec3 v_pos;
+layout(location = 1) in vec3 v_normal;
+layout(location = 2) in vec2 v_textura;
+#endif
 
 out vec3 frag_3Dpos;
 out vec3 normal;
 out vec2 vs_tex_coord;
 
+#ifdef INSTANCED
+// Por instancia (glVertexAttribDivisor 1), ver instancing.h
+layout(location = 3) in mat4 model;
+layout(location = 7) in mat3 normal_matrix;
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat4 normal_matrix;
+#endif
+// Por frame, ver uniforms.h (igual en el fragment shader)
+#include "frame_data.glsl"
 
 void main() {
+#ifdef PACKED_VERTICES
+  vec3 v_pos = mesh_dequant[0].xyz + mesh_dequant[1].xyz * v_pos_q;
+  vec3 v_normal = oct_decode(v_normal_oct * (1.0 / 127.0));
+  vec2 v_textura = mesh_dequant[2].xy + mesh_dequant[2].zw * v_textura_q;
+#endif
   gl_Position = projection * view * model * vec4(v_pos,1.0f);
   frag_3Dpos = vec3(model * vec4(v_pos,1.0));
   normal = normalize(mat3(normal_matrix) * v_normal);
@@ -0,0 +1,114 @@
+// texcompress.cpp: conversor offline de imagenes a texturas BCn en DDS
+//
+// Decodifica con stb_image, genera la cadena completa de mipmaps (filtro de
+// caja, igual que glGenerateMipmap), comprime cada nivel y escribe un DDS
+// que TextureLoader sube con glCompressedTexImage2D. Imprime el tamano frente
+// a RGBA8 y el PSNR del nivel 0.
+//
+//   ./texcompress [-f bc1|bc3|bc7] entrada.png salida.dds
+//
+// Sin -f se usa bc1 si la imagen es opaca y bc7 si tiene alfa.
+//////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "bcn.h"
+#include "dds.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static void usage(const char *prog) {
+  printf("Uso: %s [-f bc1|bc3|bc7] entrada.png salida.dds\n", prog);
+}
+
+static double psnr(const unsigned char *a, const unsigned char *b, size_t texels, int channels) {
+  double sum = 0.0;
+  for (size_t i = 0; i < texels; i++)
+    for (int c = 0; c < channels; c++) {
+      double d = (double) a[i * 4 + c] - b[i * 4 + c];
+      sum += d * d;
+    }
+  double mse = sum / ((double) texels * channels);
+  return mse > 0.0 ? 10.0 * log10(255.0 * 255.0 / mse) : INFINITY;
+}
+
+int main(int argc, char **argv) {
+  BcFormat format = BC_NONE;
+  int arg = 1;
+  if (arg + 1 < argc && strcmp(argv[arg], "-f") == 0) {
+    format = bc_format_from_name(argv[arg + 1]);
+    if (format == BC_NONE) {
+      usage(argv[0]);
+      return 1;
+    }
+    arg += 2;
+  }
+  if (argc - arg != 2) {
+    usage(argv[0]);
+    return 1;
+  }
+  const char *input = argv[arg], *output = argv[arg + 1];
+
+  int width, height, comp;
+  unsigned char *pixels = stbi_load(input, &width, &height, &comp, 4);
+  if (pixels == NULL) {
+    printf("Error: no se pudo leer %s (%s)\n", input, stbi_failure_reason());
+    return 1;
+  }
+
+  bool opaque = true;
+  for (size_t i = 0; i < (size_t) width * height; i++)
+    opaque = opaque && pixels[i * 4 + 3] == 255;
+  if (format == BC_NONE)
+    format = opaque ? BC1 : BC7;
+
+  Clock::time_point start = Clock::now();
+
+  std::vector<std::vector<unsigned char> > levels;
+  std::vector<unsigned char> level(pixels, pixels + (size_t) width * height * 4), next;
+  size_t rgba_bytes = 0;
+  int w = width, h = height;
+  for (;;) {
+    levels.push_back(std::vector<unsigned char>(bc_level_bytes(format, w, h)));
+    bc_compress(format, level.data(), w, h, levels.back().data());
+    rgba_bytes += (size_t) w * h * 4;
+    if (w == 1 && h == 1)
+      break;
+    bc_downsample(level.data(), w, h, next);
+    level.swap(next);
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+  double encode_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  size_t bc_bytes = 0;
+  for (const std::vector<unsigned char> &l : levels)
+    bc_bytes += l.size();
+
+  std::vector<unsigned char> decoded((size_t) width * height * 4);
+  bc_decompress(format, levels[0].data(), width, height, decoded.data());
+  // En BC1 el alfa no se guarda: solo cuentan los canales de color
+  double quality = psnr(pixels, decoded.data(), (size_t) width * height, format == BC1 ? 3 : 4);
+  stbi_image_free(pixels);
+
+  if (!dds_write(output, format, width, height, levels)) {
+    printf("Error: no se pudo escribir %s\n", output);
+    return 1;
+  }
+
+  printf("%s -> %s: %dx%d %s, %zu niveles, %.1f ms\n", input, output, width, height,
+         bc_format_name(format), levels.size(), encode_ms);
+  printf("  %zu KB (RGBA8 con mipmaps: %zu KB, %.1f:1)  PSNR nivel 0: %.2f dB\n",
+         bc_bytes / 1024, rgba_bytes / 1024, (double) rgba_bytes / bc_bytes, quality);
+  if (format == BC1 && !opaque)
+    printf("  Aviso: la imagen tiene alfa y BC1 lo descarta\n");
+  return 0;
+}
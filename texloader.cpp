@@ -0,0 +1,307 @@
+// texloader.cpp: carga asincrona de texturas (ver texloader.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "texloader.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <iterator>
+
+#include "stb_image.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double ms_since(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static bool has_suffix(const std::string &s, const char *suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && strcasecmp(s.c_str() + s.size() - n, suffix) == 0;
+}
+
+GLenum gl_compressed_format(BcFormat format) {
+  switch (format) {
+  case BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  default:  return GL_COMPRESSED_RGBA_BPTC_UNORM;
+  }
+}
+
+void bc_formats_supported(bool supported[4]) {
+  supported[BC_NONE] = true;
+  supported[BC1] = supported[BC3] = GLEW_EXT_texture_compression_s3tc;
+  supported[BC7] = GLEW_ARB_texture_compression_bptc;
+}
+
+TextureLoader::TextureLoader(int threads) : pool(threads) {
+  glGenBuffers(2, pbos);
+
+  // Se consulta aqui, en el hilo GL, para que los hilos de trabajo sepan si
+  // tienen que descomprimir
+  bc_formats_supported(bc_supported);
+}
+
+TextureLoader::~TextureLoader() {
+  pool.wait();
+  for (Decoded &decoded : ready)
+    free_texture_image(decoded.image);
+  glDeleteBuffers(2, pbos);
+}
+
+// Sin lectura ni decodificacion: los niveles van del fichero proyectado a
+// glTexImage2D. Si el driver no soporta el formato se carga como siempre
+bool TextureLoader::upload_from_pack(TextureLoadStats &entry) {
+  const AssetPackEntry *asset = pack ? pack->find(entry.path.c_str(), ASSET_TEXTURE) : NULL;
+  if (!asset || !bc_supported[asset->texture.format])
+    return false;
+
+  Clock::time_point start = Clock::now();
+  entry.texture = pack->upload_texture(*asset, &entry.gpu_bytes);
+  entry.upload_ms = ms_since(start);
+  entry.width = (int) asset->texture.width;
+  entry.height = (int) asset->texture.height;
+  entry.comp = 4;
+  entry.format = (BcFormat) asset->texture.format;
+  entry.ok = true;
+  entry.from_pack = true;
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  return true;
+}
+
+GLuint TextureLoader::request(const char *path) {
+  TextureLoadStats entry = TextureLoadStats();
+  entry.path = path;
+  if (upload_from_pack(entry)) {
+    results.push_back(entry);
+    return entry.texture;
+  }
+  glGenTextures(1, &entry.texture);
+
+  int index = (int) results.size();
+  results.push_back(entry);
+  pending++;
+
+  std::string file(path);
+  pool.submit([this, index, file] { decode(index, file); });
+
+  return entry.texture;
+}
+
+// Sustituye los bloques por los niveles descomprimidos a RGBA8
+static void expand_dds(std::vector<unsigned char> &file, DdsImage &dds) {
+  std::vector<unsigned char> rgba;
+  for (DdsLevel &level : dds.levels) {
+    size_t offset = rgba.size();
+    rgba.resize(offset + (size_t) level.width * level.height * 4);
+    bc_decompress(dds.format, file.data() + level.offset, level.width, level.height,
+                  rgba.data() + offset);
+    level.offset = offset;
+    level.size = rgba.size() - offset;
+  }
+  file.swap(rgba);
+}
+
+bool decode_texture(const std::string &path, std::vector<unsigned char> &data, const bool bc_supported[4],
+                    TextureImage &image) {
+  if (data.empty())
+    return false;
+  if (has_suffix(path, ".dds")) {
+    if (!dds_parse(data.data(), data.size(), &image.dds))
+      return false;
+    image.width = image.dds.width;
+    image.height = image.dds.height;
+    image.comp = 4;
+    image.expanded = !bc_supported[image.dds.format];
+    if (image.expanded)
+      expand_dds(data, image.dds);
+    image.file.swap(data);
+    return true;
+  }
+  image.pixels = stbi_load_from_memory(data.data(), (int) data.size(),
+                                       &image.width, &image.height, &image.comp, 0);
+  return image.pixels != NULL;
+}
+
+void free_texture_image(TextureImage &image) {
+  stbi_image_free(image.pixels);
+  image.pixels = NULL;
+}
+
+size_t upload_texture_image(const std::string &path, const TextureImage &image, const unsigned char *src) {
+  size_t gpu_bytes = 0;
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  if (!image.file.empty()) {
+    const DdsImage &dds = image.dds;
+    for (size_t i = 0; i < dds.levels.size(); i++) {
+      const DdsLevel &level = dds.levels[i];
+      if (image.expanded)
+        glTexImage2D(GL_TEXTURE_2D, (GLint) i, GL_RGBA, level.width, level.height, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, src + level.offset);
+      else
+        glCompressedTexImage2D(GL_TEXTURE_2D, (GLint) i, gl_compressed_format(dds.format),
+                               level.width, level.height, 0, (GLsizei) level.size, src + level.offset);
+      gpu_bytes += level.size;
+    }
+    if (image.expanded)
+      printf("Texture %s: %s not supported by the driver, uploaded uncompressed\n",
+             path.c_str(), bc_format_name(dds.format));
+    // Por si el fichero no trae la cadena completa hasta 1x1
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) dds.levels.size() - 1);
+  } else {
+    // Se comprueba si es una textura está en un canal de color u otro ya que
+    // para OpenGL se escribe "rojo" para uno, "rojo/verde" para dos y así sucesivamente.
+    GLenum format = GL_RGBA;
+    if (image.comp == 1)
+      format = GL_RED;
+    else if (image.comp == 2)
+      format = GL_RG;
+    else if (image.comp == 3)
+      format = GL_RGB;
+
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, src);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    // Los drivers suelen guardar RGB8 como RGBA8; los mipmaps suman 1/3
+    size_t size = (size_t) image.width * image.height * image.comp;
+    gpu_bytes = (image.comp == 3 ? size / 3 * 4 : size) * 4 / 3;
+  }
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  return gpu_bytes;
+}
+
+void TextureLoader::decode(int index, const std::string &path) {
+  Decoded decoded = Decoded();
+  decoded.index = index;
+
+  Clock::time_point start = Clock::now();
+  std::vector<unsigned char> data;
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp != NULL) {
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    rewind(fp);
+    if (size > 0) {
+      data.resize(size);
+      data.resize(fread(data.data(), 1, size, fp));
+    }
+    fclose(fp);
+  }
+  decoded.read_ms = ms_since(start);
+
+  start = Clock::now();
+  decode_texture(path, data, bc_supported, decoded.image);
+  decoded.decode_ms = ms_since(start);
+  decoded.decoded_at = Clock::now();
+
+  std::lock_guard<std::mutex> lock(ready_mutex);
+  ready.push_back(std::move(decoded));
+}
+
+// Copia al PBO (orphaning con glBufferData para no esperar a la GPU) y
+// devuelve el puntero que hay que pasar a glTex*Image2D, que lee de el de
+// forma asincrona. Deja el PBO enlazado.
+const unsigned char *TextureLoader::stage(const unsigned char *data, size_t size) {
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[next_pbo]);
+  next_pbo = (next_pbo + 1) % 2;
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+  void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (dst == NULL) {
+    // Sin PBO: subida directa desde memoria del cliente
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return data;
+  }
+  memcpy(dst, data, size);
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  return (const unsigned char *) 0;
+}
+
+void TextureLoader::upload(const Decoded &decoded) {
+  const TextureImage &image = decoded.image;
+  TextureLoadStats &entry = results[decoded.index];
+  entry.width = image.width;
+  entry.height = image.height;
+  entry.comp = image.comp;
+  entry.read_ms = decoded.read_ms;
+  entry.decode_ms = decoded.decode_ms;
+  entry.wait_ms = ms_since(decoded.decoded_at);
+
+  if (!image.pixels && image.file.empty()) {
+    printf("Texture failed to load: %s\n", entry.path.c_str());
+    entry.ok = false;
+    return;
+  }
+
+  Clock::time_point start = Clock::now();
+  glBindTexture(GL_TEXTURE_2D, entry.texture);
+
+  const unsigned char *src;
+  if (!image.file.empty()) {
+    entry.format = image.dds.format;
+    src = stage(image.file.data(), image.file.size());
+  } else {
+    entry.format = BC_NONE;
+    src = stage(image.pixels, (size_t) image.width * image.height * image.comp);
+  }
+  entry.gpu_bytes = upload_texture_image(entry.path, image, src);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  entry.upload_ms = ms_since(start);
+  entry.ok = true;
+}
+
+int TextureLoader::poll(int max_uploads) {
+  if (pending == 0)
+    return 0;
+
+  std::vector<Decoded> batch;
+  {
+    std::lock_guard<std::mutex> lock(ready_mutex);
+    size_t n = ready.size();
+    if (max_uploads >= 0 && (size_t) max_uploads < n)
+      n = max_uploads;
+    batch.assign(std::make_move_iterator(ready.begin()),
+                 std::make_move_iterator(ready.begin() + n));
+    ready.erase(ready.begin(), ready.begin() + n);
+  }
+
+  for (Decoded &decoded : batch) {
+    upload(decoded);
+    free_texture_image(decoded.image);
+    pending--;
+  }
+  return pending;
+}
+
+void TextureLoader::finish() {
+  pool.wait();
+  poll();
+}
+
+void TextureLoader::print_stats() const {
+  double read = 0.0, decode = 0.0, upload = 0.0;
+  size_t gpu_bytes = 0;
+  for (const TextureLoadStats &s : results) {
+    printf("Texture %s: %dx%dx%d %s  read %.2f ms  decode %.2f ms  wait %.2f ms  upload %.2f ms  "
+           "%zu KB%s%s\n",
+           s.path.c_str(), s.width, s.height, s.comp, s.format == BC_NONE ? "raw" : bc_format_name(s.format),
+           s.read_ms, s.decode_ms, s.wait_ms, s.upload_ms, s.gpu_bytes / 1024,
+           s.from_pack ? "  (pack)" : "", s.ok ? "" : "  (FAILED)");
+    read += s.read_ms;
+    decode += s.decode_ms;
+    upload += s.upload_ms;
+    gpu_bytes += s.gpu_bytes;
+  }
+  printf("Textures: %zu on %d threads  read %.2f ms  decode %.2f ms  upload %.2f ms  "
+         "%zu KB of video memory (totals)\n",
+         results.size(), pool.size(), read, decode, upload, gpu_bytes / 1024);
+}
@@ -0,0 +1,126 @@
+// texloader.h: carga asincrona de texturas
+//
+// request() crea el objeto textura GL y encola la lectura y decodificacion
+// del fichero (stbi_load_from_memory) en un pool de hilos. El hilo GL llama
+// a poll() cada frame para subir las imagenes ya decodificadas a traves de
+// un pixel buffer object; mientras tanto la textura esta vacia. finish()
+// espera a que este todo subido.
+//
+// Los ficheros .dds (ver texcompress) se suben tal cual con
+// glCompressedTexImage2D, con los mipmaps que traen. Si el driver no
+// soporta el formato se descomprimen en el hilo de trabajo.
+//
+// Con set_pack() las texturas que esten en el AssetPack se suben en el
+// mismo request() desde el fichero proyectado, ya decodificadas.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TEXLOADER_H
+#define TEXLOADER_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "assetpack.h"
+#include "dds.h"
+#include "threadpool.h"
+
+// Formato interno de GL de los bloques de format (no BC_NONE)
+GLenum gl_compressed_format(BcFormat format);
+// Formatos BCn que acepta el driver del contexto actual, indexado por
+// BcFormat (BC_NONE siempre)
+void bc_formats_supported(bool supported[4]);
+
+// Imagen decodificada lista para subir: pixels de stb_image o, si es un
+// .dds, el fichero y sus niveles. expanded indica que los niveles se
+// descomprimieron a RGBA8 porque el driver no soporta el formato (dds.levels
+// apunta entonces a esos datos)
+struct TextureImage {
+  unsigned char *pixels = NULL;
+  int width = 0, height = 0, comp = 0;
+  std::vector<unsigned char> file;
+  DdsImage dds = DdsImage();
+  bool expanded = false;
+};
+
+// Sin GL, desde cualquier hilo: decodifica data, el contenido del fichero
+// path (un .dds pasa a image.file). false si no es una imagen valida
+bool decode_texture(const std::string &path, std::vector<unsigned char> &data, const bool bc_supported[4],
+                    TextureImage &image);
+void free_texture_image(TextureImage &image);
+// Sube image a la textura enlazada en GL_TEXTURE_2D, con mipmaps, repeticion
+// y filtrado trilineal. src es de donde lee GL los datos: pixels o file, o
+// su copia en el PBO enlazado. Devuelve la memoria de video estimada
+size_t upload_texture_image(const std::string &path, const TextureImage &image, const unsigned char *src);
+
+struct TextureLoadStats {
+  std::string path;
+  GLuint texture;
+  int width, height, comp;
+  BcFormat format;   // BC_NONE: imagen sin comprimir
+  size_t gpu_bytes;  // memoria de video estimada, mipmaps incluidos
+  bool ok;
+  bool from_pack;    // subida desde el AssetPack (sin lectura ni decodificacion)
+  double read_ms;    // lectura del fichero (hilo de trabajo)
+  double decode_ms;  // stbi_load_from_memory o cabecera DDS (hilo de trabajo)
+  double wait_ms;    // desde decodificada hasta que el hilo GL la recoge
+  double upload_ms;  // PBO + glTexImage2D + glGenerateMipmap (hilo GL)
+                     // o glCompressedTexImage2D por nivel
+};
+
+class TextureLoader {
+public:
+  // threads == 0: un hilo por nucleo
+  explicit TextureLoader(int threads = 0);
+  ~TextureLoader();
+
+  // Las texturas que esten en pack no se leen del disco (pack tiene que
+  // seguir abierto mientras se use el loader)
+  void set_pack(const AssetPack *pack) { this->pack = pack; }
+
+  // Solo desde el hilo GL
+  GLuint request(const char *path);
+  // Sube como mucho max_uploads texturas listas (-1: todas). Devuelve
+  // cuantas quedan pendientes.
+  int poll(int max_uploads = -1);
+  void finish();
+
+  const std::vector<TextureLoadStats> &stats() const { return results; }
+  void print_stats() const;
+
+private:
+  // Resultado de un hilo de trabajo; los hilos no tocan results, que puede
+  // crecer mientras decodifican
+  struct Decoded {
+    int index;
+    TextureImage image;
+    double read_ms, decode_ms;
+    std::chrono::steady_clock::time_point decoded_at;
+  };
+
+  bool upload_from_pack(TextureLoadStats &entry);
+  void decode(int index, const std::string &path);
+  void upload(const Decoded &decoded);
+  const unsigned char *stage(const unsigned char *data, size_t size);
+
+  ThreadPool pool;
+  std::vector<TextureLoadStats> results;
+  int pending = 0;
+
+  std::mutex ready_mutex;
+  std::vector<Decoded> ready;
+
+  // Ring de PBOs para no esperar a que el driver termine con el anterior
+  GLuint pbos[2];
+  int next_pbo = 0;
+
+  // Formatos BCn que acepta el driver, indexado por BcFormat
+  bool bc_supported[4];
+
+  const AssetPack *pack = NULL;
+};
+
+#endif
@@ -0,0 +1,106 @@
+// threadpool.cpp: pool de hilos (ver threadpool.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "threadpool.h"
+
+#include <atomic>
+
+#include "profiler.h"
+
+ThreadPool::ThreadPool(int threads) {
+  if (threads <= 0)
+    threads = (int) std::thread::hardware_concurrency();
+  if (threads <= 0)
+    threads = 1;
+
+  for (int i = 1; i < threads; i++)
+    workers.emplace_back(&ThreadPool::worker_loop, this);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  task_ready.notify_all();
+  for (std::thread &t : workers)
+    t.join();
+}
+
+void ThreadPool::worker_loop() {
+  profiler_set_thread_name("worker");
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      task_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (tasks.empty())
+        return;
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+
+    task();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending--;
+    }
+    task_done.notify_all();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  if (workers.empty()) {
+    task();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+    pending++;
+  }
+  task_ready.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  task_done.wait(lock, [this] { return pending == 0; });
+}
+
+void ThreadPool::parallel_for(int count, const std::function<void(int)> &fn) {
+  if (count <= 0)
+    return;
+  if (workers.empty() || count == 1) {
+    for (int i = 0; i < count; i++)
+      fn(i);
+    return;
+  }
+
+  std::atomic<int> next(0);
+  auto run = [&next, count, &fn] {
+    PROFILE_SCOPE("parallel_for");
+    for (int i = next++; i < count; i = next++)
+      fn(i);
+  };
+
+  int helpers = (int) workers.size() < count - 1 ? (int) workers.size() : count - 1;
+  std::atomic<int> finished(0);
+  std::mutex done_mutex;
+  std::condition_variable done;
+
+  for (int i = 0; i < helpers; i++) {
+    submit([&] {
+      run();
+      std::lock_guard<std::mutex> lock(done_mutex);
+      finished++;
+      done.notify_one();
+    });
+  }
+
+  run();
+
+  // Solo esperamos a nuestras tareas, no a las que otros hayan encolado
+  std::unique_lock<std::mutex> lock(done_mutex);
+  done.wait(lock, [&] { return finished == helpers; });
+}
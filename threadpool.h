@@ -0,0 +1,47 @@
+// threadpool.h: pool de hilos sencillo para repartir trabajo entre nucleos
+//
+// Los hilos se crean una vez y esperan trabajo. parallel_for() reparte los
+// indices [0, count) con un contador atomico (cada hilo coge el siguiente
+// libre) y bloquea hasta que terminan todos; el hilo que llama tambien
+// trabaja. submit() encola tareas sueltas que se esperan con wait().
+//////////////////////////////////////////////////////////////////////
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+  // threads == 0: un hilo por nucleo (el llamante cuenta como uno)
+  explicit ThreadPool(int threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  int size() const { return (int) workers.size() + 1; }
+
+  void parallel_for(int count, const std::function<void(int)> &fn);
+
+  void submit(std::function<void()> task);
+  void wait();
+
+private:
+  void worker_loop();
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable task_ready;
+  std::condition_variable task_done;
+  int pending = 0;
+  bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,168 @@
+// transforms.cpp: matrices de modelo y normales en lote (ver transforms.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "transforms.h"
+
+#include <math.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Objetos por tarea del pool: suficientes para que el reparto no se note y
+// multiplo de 4 para que solo el ultimo bloque tenga resto escalar
+static const int BLOCK = 4096;
+
+// A partir de este tamano de salida se escribe con stores no temporales: no
+// cabe en cache y nadie en la CPU lo va a volver a leer. Por debajo son mas
+// lentos que un store normal (bench_transforms)
+static const size_t STREAM_BYTES = 8 << 20;
+
+// Giro comun a todos los objetos en un instante
+struct TransformSystem::Frame {
+  float cos_y, sin_y, cos_x, sin_x;
+};
+
+static double spin_radians(double seconds, float deg_per_s) {
+  // fmod en double: con el tiempo acumulado el angulo en float pierde precision
+  return fmod(seconds * deg_per_s, 360.0) * (M_PI / 180.0);
+}
+
+glm::vec4 spin_cos_sin(double seconds) {
+  double y = spin_radians(seconds, SPIN_Y_DEG_PER_S), x = spin_radians(seconds, SPIN_X_DEG_PER_S);
+  return glm::vec4((float) cos(y), (float) sin(y), (float) cos(x), (float) sin(x));
+}
+
+TransformSystem::TransformSystem(int threads) : pool(threads) {}
+
+void TransformSystem::add(glm::vec3 position, float phase) {
+  pos_x.push_back(position.x);
+  pos_y.push_back(position.y);
+  pos_z.push_back(position.z);
+
+  glm::vec4 spin = spin_cos_sin(phase);
+  phase_cos_y.push_back(spin.x);
+  phase_sin_y.push_back(spin.y);
+  phase_cos_x.push_back(spin.z);
+  phase_sin_x.push_back(spin.w);
+}
+
+TransformSystem::Frame TransformSystem::frame_at(double time) const {
+  glm::vec4 spin = spin_cos_sin(time);
+  Frame frame = { spin.x, spin.y, spin.z, spin.w };
+  return frame;
+}
+
+// model = translate(p) * rotate(a, Y) * rotate(b, X). Por columnas:
+//   ( ca, 0, -sa, 0)  (sa*sb, cb, ca*sb, 0)  (sa*cb, -sb, ca*cb, 0)  (p, 1)
+// y la normal matrix son las tres primeras columnas
+static inline void write_scalar(InstanceAttribs &out, float ca, float sa, float cb, float sb,
+                                float px, float py, float pz) {
+  const float columns[4][4] = {
+    { ca, 0.0f, -sa, 0.0f },
+    { sa * sb, cb, ca * sb, 0.0f },
+    { sa * cb, -sb, ca * cb, 0.0f },
+    { px, py, pz, 1.0f },
+  };
+  for (int c = 0; c < 4; c++) {
+    out.model[c] = glm::vec4(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+    if (c < 3)
+      out.normal_matrix[c] = out.model[c];
+  }
+}
+
+#ifdef __SSE2__
+// Los stores no temporales no leen la linea a la cache antes de escribirla;
+// en un buffer mapeado write-combined es ademas la forma natural de escribir
+static inline void store_column(float *dst, __m128 v, bool stream) {
+  if (stream)
+    _mm_stream_ps(dst, v);
+  else
+    _mm_storeu_ps(dst, v);
+}
+#endif
+
+// Con ids, out[i] es el objeto ids[i]; sin ids, el objeto i
+void TransformSystem::compute_range(const Frame &f, int begin, int end, const int *ids,
+                                    InstanceAttribs *out, bool simd) const {
+  int i = begin;
+
+#ifdef __SSE2__
+  if (simd) {
+    const __m128 fcy = _mm_set1_ps(f.cos_y), fsy = _mm_set1_ps(f.sin_y);
+    const __m128 fcx = _mm_set1_ps(f.cos_x), fsx = _mm_set1_ps(f.sin_x);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    // sizeof(InstanceAttribs) es multiplo de 16: si el primero esta
+    // alineado lo estan todos
+    bool stream = ((uintptr_t) (out + begin) & 15) == 0 &&
+                  (size_t) size() * sizeof(InstanceAttribs) >= STREAM_BYTES;
+    // 4 valores seguidos de un array SoA, o recogidos de 4 objetos sueltos
+    auto load = [&](const std::vector<float> &v) {
+      return ids ? _mm_setr_ps(v[ids[i]], v[ids[i + 1]], v[ids[i + 2]], v[ids[i + 3]])
+                 : _mm_loadu_ps(&v[i]);
+    };
+
+    for (; i + 4 <= end; i += 4) {
+      // sin/cos de (giro del frame + desfase del objeto)
+      __m128 pcy = load(phase_cos_y), psy = load(phase_sin_y);
+      __m128 pcx = load(phase_cos_x), psx = load(phase_sin_x);
+      __m128 ca = _mm_sub_ps(_mm_mul_ps(fcy, pcy), _mm_mul_ps(fsy, psy));
+      __m128 sa = _mm_add_ps(_mm_mul_ps(fsy, pcy), _mm_mul_ps(fcy, psy));
+      __m128 cb = _mm_sub_ps(_mm_mul_ps(fcx, pcx), _mm_mul_ps(fsx, psx));
+      __m128 sb = _mm_add_ps(_mm_mul_ps(fsx, pcx), _mm_mul_ps(fcx, psx));
+
+      // Cada columna se calcula en SoA (x, y, z, w de 4 objetos) y se
+      // traspone para tener la columna de cada objeto
+      __m128 col[4][4] = {
+        { ca, zero, _mm_xor_ps(sa, sign), zero },
+        { _mm_mul_ps(sa, sb), cb, _mm_mul_ps(ca, sb), zero },
+        { _mm_mul_ps(sa, cb), _mm_xor_ps(sb, sign), _mm_mul_ps(ca, cb), zero },
+        { load(pos_x), load(pos_y), load(pos_z), one },
+      };
+      for (int c = 0; c < 4; c++) {
+        _MM_TRANSPOSE4_PS(col[c][0], col[c][1], col[c][2], col[c][3]);
+        for (int k = 0; k < 4; k++) {
+          store_column(&out[i + k].model[c][0], col[c][k], stream);
+          if (c < 3)
+            store_column(&out[i + k].normal_matrix[c][0], col[c][k], stream);
+        }
+      }
+    }
+    if (stream)
+      _mm_sfence();
+  }
+#endif
+
+  for (; i < end; i++) {
+    int o = ids ? ids[i] : i;
+    float ca = f.cos_y * phase_cos_y[o] - f.sin_y * phase_sin_y[o];
+    float sa = f.sin_y * phase_cos_y[o] + f.cos_y * phase_sin_y[o];
+    float cb = f.cos_x * phase_cos_x[o] - f.sin_x * phase_sin_x[o];
+    float sb = f.sin_x * phase_cos_x[o] + f.cos_x * phase_sin_x[o];
+    write_scalar(out[i], ca, sa, cb, sb, pos_x[o], pos_y[o], pos_z[o]);
+  }
+}
+
+void TransformSystem::compute_blocks(const Frame &frame, int count, const int *ids,
+                                     InstanceAttribs *out) {
+  int blocks = (count + BLOCK - 1) / BLOCK;
+  pool.parallel_for(blocks, [&](int b) {
+    int begin = b * BLOCK;
+    int end = begin + BLOCK < count ? begin + BLOCK : count;
+    compute_range(frame, begin, end, ids, out, true);
+  });
+}
+
+void TransformSystem::compute(double time, InstanceAttribs *out) {
+  compute_blocks(frame_at(time), size(), NULL, out);
+}
+
+void TransformSystem::compute(double time, const int *ids, int count, InstanceAttribs *out) {
+  compute_blocks(frame_at(time), count, ids, out);
+}
+
+void TransformSystem::compute_serial(double time, InstanceAttribs *out, bool simd) {
+  compute_range(frame_at(time), 0, size(), NULL, out, simd);
+}
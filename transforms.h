@@ -0,0 +1,65 @@
+// transforms.h: matrices de modelo y normales de muchos objetos a la vez
+//
+// Todos los objetos giran como compute_model_matrix(): rotate Y a
+// SPIN_Y_DEG_PER_S y rotate X a SPIN_X_DEG_PER_S, cada uno con su desfase de
+// tiempo. Posiciones y giros se guardan en arrays SoA; el giro de cada
+// objeto se guarda como seno y coseno de su desfase, asi que en cada frame
+// basta con sumar angulos (sin(a + b) = ...) sin llamar a sin/cos por
+// objeto. Como el modelo es rotacion + traslacion, la normal matrix
+// (inversa traspuesta) es la propia rotacion y no hace falta invertir nada.
+//
+// compute() reparte los objetos entre nucleos en bloques y cada bloque se
+// calcula con SSE2, 4 objetos por iteracion, escribiendo directamente al
+// destino (p.ej. un buffer de instancias mapeado).
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TRANSFORMS_H
+#define TRANSFORMS_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "instancing.h"
+#include "threadpool.h"
+
+const float SPIN_Y_DEG_PER_S = 20.0f;
+const float SPIN_X_DEG_PER_S = 40.0f;
+
+// Coseno y seno del giro sobre Y y sobre X tras seconds segundos
+// (cos_y, sin_y, cos_x, sin_x)
+glm::vec4 spin_cos_sin(double seconds);
+
+class TransformSystem {
+public:
+  // threads == 0: un hilo por nucleo
+  explicit TransformSystem(int threads = 0);
+
+  // Objeto en position, girando con phase segundos de adelanto
+  void add(glm::vec3 position, float phase);
+  int size() const { return (int) pos_x.size(); }
+  int threads() const { return pool.size(); }
+
+  // Escribe size() elementos en out con las matrices en el instante time
+  void compute(double time, InstanceAttribs *out);
+  // Solo los objetos ids[0..count), seguidos en out (p.ej. los visibles)
+  void compute(double time, const int *ids, int count, InstanceAttribs *out);
+
+  // Un solo hilo; simd = false usa la version escalar (referencia y
+  // benchmark)
+  void compute_serial(double time, InstanceAttribs *out, bool simd);
+
+private:
+  struct Frame;
+  Frame frame_at(double time) const;
+  void compute_range(const Frame &frame, int begin, int end, const int *ids, InstanceAttribs *out,
+                     bool simd) const;
+  void compute_blocks(const Frame &frame, int count, const int *ids, InstanceAttribs *out);
+
+  ThreadPool pool;
+  std::vector<float> pos_x, pos_y, pos_z;
+  std::vector<float> phase_cos_y, phase_sin_y;  // giro sobre Y del desfase
+  std::vector<float> phase_cos_x, phase_sin_x;  // giro sobre X del desfase
+};
+
+#endif
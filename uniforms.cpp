@@ -0,0 +1,99 @@
+// uniforms.cpp: uniform buffer objects por frame (ver uniforms.h)
+//////////////////////////////////////////////////////////////////////
+
+#include "uniforms.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "glcalls.h"
+
+static GLsizeiptr align_up(GLsizeiptr value, GLint alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+UniformRing::UniformRing() {
+  GLint alignment = 16;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  lights_offset = align_up(sizeof(FrameUniforms), alignment);
+  material_offset = align_up(lights_offset + sizeof(LightUniforms), alignment);
+  region_size = align_up(material_offset + sizeof(MaterialUniforms), alignment);
+
+  GLsizeiptr size = region_size * UNIFORM_FRAMES;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  if (GLEW_ARB_buffer_storage) {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_UNIFORM_BUFFER, size, NULL, flags);
+    mapped = (unsigned char *) glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+  }
+  if (mapped == NULL) {
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    staging.resize(region_size);
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  printf("Uniform buffers: %d x %ld bytes, %s\n", UNIFORM_FRAMES, (long) region_size,
+         mapped ? "persistent mapping" : "glBufferSubData");
+}
+
+UniformRing::~UniformRing() {
+  for (GLsync &fence : fences)
+    if (fence)
+      glDeleteSync(fence);
+  if (mapped) {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glUnmapBuffer(GL_UNIFORM_BUFFER);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  }
+  glDeleteBuffers(1, &buffer);
+}
+
+void UniformRing::bind_blocks(GLuint program) {
+  static const struct { const char *name; GLuint binding; } blocks[] = {
+    { "FrameData", UBO_FRAME_BINDING },
+    { "LightData", UBO_LIGHTS_BINDING },
+    { "MaterialData", UBO_MATERIAL_BINDING },
+  };
+  for (const auto &block : blocks) {
+    GLuint index = glGetUniformBlockIndex(program, block.name);
+    if (index != GL_INVALID_INDEX)
+      glUniformBlockBinding(program, index, block.binding);
+  }
+}
+
+void UniformRing::update(const FrameUniforms &frame, const LightUniforms &lights,
+                         const MaterialUniforms &material) {
+  current = (current + 1) % UNIFORM_FRAMES;
+  GLintptr base = current * region_size;
+
+  if (mapped) {
+    // La region se uso hace UNIFORM_FRAMES frames: normalmente ya esta libre
+    if (fences[current]) {
+      GL_COUNT(glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000));
+      GL_COUNT(glDeleteSync(fences[current]));
+      fences[current] = 0;
+    }
+    memcpy(mapped + base, &frame, sizeof(frame));
+    memcpy(mapped + base + lights_offset, &lights, sizeof(lights));
+    memcpy(mapped + base + material_offset, &material, sizeof(material));
+  } else {
+    // Una sola subida para los tres bloques
+    memcpy(&staging[0], &frame, sizeof(frame));
+    memcpy(&staging[lights_offset], &lights, sizeof(lights));
+    memcpy(&staging[material_offset], &material, sizeof(material));
+    GL_COUNT(glBindBuffer(GL_UNIFORM_BUFFER, buffer));
+    GL_COUNT(glBufferSubData(GL_UNIFORM_BUFFER, base, region_size, staging.data()));
+  }
+
+  GL_COUNT(glBindBufferRange(GL_UNIFORM_BUFFER, UBO_FRAME_BINDING, buffer, base, sizeof(frame)));
+  GL_COUNT(glBindBufferRange(GL_UNIFORM_BUFFER, UBO_LIGHTS_BINDING, buffer, base + lights_offset,
+                             sizeof(lights)));
+  GL_COUNT(glBindBufferRange(GL_UNIFORM_BUFFER, UBO_MATERIAL_BINDING, buffer, base + material_offset,
+                             sizeof(material)));
+}
+
+void UniformRing::end_frame() {
+  if (mapped)
+    fences[current] = GL_COUNT(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
@@ -0,0 +1,85 @@
+// uniforms.h: uniform buffer objects (std140) de camara, luces y material
+//
+// Los tres bloques de los shaders (FrameData, LightData, MaterialData) se
+// escriben una vez por frame en un unico buffer dividido en UNIFORM_FRAMES
+// regiones que se usan por turnos. Con ARB_buffer_storage el buffer se mapea
+// una sola vez (persistente y coherente) y un fence por region evita pisar
+// datos que la GPU aun no ha leido; sin el, cada region se sube con
+// glBufferSubData.
+//////////////////////////////////////////////////////////////////////
+
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <GL/glew.h>
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Puntos de enlace de cada bloque (glUniformBlockBinding)
+enum {
+  UBO_FRAME_BINDING = 0,
+  UBO_LIGHTS_BINDING = 1,
+  UBO_MATERIAL_BINDING = 2
+};
+
+// Mismo layout que los bloques std140 de los shaders: un vec3 ocupa 16 bytes
+struct FrameUniforms {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::vec4 view_pos;  // xyz
+  glm::vec4 cluster_params;  // ver ClusteredLights::shader_params()
+};
+
+struct LightStd140 {
+  glm::vec4 position, ambient, diffuse, specular;  // xyz
+};
+
+// Luces de Phong de la escena (MAX_LIGHTS en el fragment shader)
+const int SCENE_LIGHTS = 2;
+
+struct LightUniforms {
+  LightStd140 lights[SCENE_LIGHTS];
+};
+
+struct MaterialUniforms {
+  float shininess;
+  float pad[3];
+  glm::vec4 specular;  // xyz, la especular sin textura
+};
+
+const int UNIFORM_FRAMES = 3;
+
+class UniformRing {
+public:
+  UniformRing();
+  ~UniformRing();
+
+  // Asocia los bloques del programa a sus puntos de enlace (una vez tras
+  // enlazarlo)
+  static void bind_blocks(GLuint program);
+
+  // Escribe los bloques del frame en la siguiente region y la enlaza
+  void update(const FrameUniforms &frame, const LightUniforms &lights,
+              const MaterialUniforms &material);
+  // Tras el ultimo draw que usa la region
+  void end_frame();
+
+  bool persistent() const { return mapped != NULL; }
+
+private:
+  GLuint buffer = 0;
+  unsigned char *mapped = NULL;
+  GLsync fences[UNIFORM_FRAMES] = {};
+  int current = 0;
+
+  // Offsets dentro de una region (alineados a GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)
+  GLintptr lights_offset = 0, material_offset = 0;
+  GLsizeiptr region_size = 0;
+
+  // Sin mapeo persistente: copia de una region para glBufferSubData
+  std::vector<unsigned char> staging;
+};
+
+#endif